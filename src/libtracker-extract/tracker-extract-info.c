@@ -21,6 +21,8 @@
 
 #include "config-miners.h"
 
+#include <libtracker-miners-common/tracker-file-utils.h>
+
 #include "tracker-extract-info.h"
 
 /**
@@ -44,6 +46,7 @@ struct _TrackerExtractInfo
 	GFile *file;
 	gchar *mimetype;
 	gchar *graph;
+	gchar *content_id;
 
 	gint ref_count;
 };
@@ -122,6 +125,7 @@ tracker_extract_info_unref (TrackerExtractInfo *info)
 		g_object_unref (info->file);
 		g_free (info->mimetype);
 		g_free (info->graph);
+		g_free (info->content_id);
 
 		if (info->resource)
 			g_object_unref (info->resource);
@@ -177,6 +181,49 @@ tracker_extract_info_get_graph (TrackerExtractInfo *info)
 	return info->graph;
 }
 
+/**
+ * tracker_extract_info_set_content_id:
+ * @info: a #TrackerExtractInfo
+ * @content_id: (nullable): the content identifier of the file
+ *
+ * Sets the content identifier of the file, as already known by
+ * the caller, so it does not need to be figured out again.
+ **/
+void
+tracker_extract_info_set_content_id (TrackerExtractInfo *info,
+                                     const gchar        *content_id)
+{
+	g_return_if_fail (info != NULL);
+
+	g_free (info->content_id);
+	info->content_id = g_strdup (content_id);
+}
+
+/**
+ * tracker_extract_info_get_content_id:
+ * @info: a #TrackerExtractInfo
+ * @suffix: (nullable): suffix to append to the identifier
+ *
+ * Returns the content identifier for the file, as returned by
+ * tracker_file_get_content_identifier(). If it was not set through
+ * tracker_extract_info_set_content_id(), the file is queried.
+ *
+ * Returns: (transfer full): the content identifier
+ **/
+gchar *
+tracker_extract_info_get_content_id (TrackerExtractInfo *info,
+                                     const gchar        *suffix)
+{
+	g_return_val_if_fail (info != NULL, NULL);
+
+	if (!info->content_id)
+		return tracker_file_get_content_identifier (info->file, NULL, suffix);
+
+	return g_strconcat (info->content_id,
+	                    suffix ? "/" : NULL,
+	                    suffix, NULL);
+}
+
 /**
  * tracker_extract_info_get_resource:
  * @info: a #TrackerExtractInfo
@@ -44,6 +44,11 @@ GFile *               tracker_extract_info_get_file               (TrackerExtrac
 const gchar *         tracker_extract_info_get_mimetype           (TrackerExtractInfo *info);
 const gchar *         tracker_extract_info_get_graph              (TrackerExtractInfo *info);
 
+void                  tracker_extract_info_set_content_id         (TrackerExtractInfo *info,
+                                                                   const gchar        *content_id);
+gchar *               tracker_extract_info_get_content_id         (TrackerExtractInfo *info,
+                                                                   const gchar        *suffix);
+
 TrackerResource *     tracker_extract_info_get_resource           (TrackerExtractInfo *info);
 void                  tracker_extract_info_set_resource           (TrackerExtractInfo *info,
                                                                    TrackerResource    *resource);
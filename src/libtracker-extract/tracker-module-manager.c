@@ -37,6 +37,9 @@ typedef struct {
 	GStrv fallback_rdf_types;
 	gchar *graph;
 	gchar *hash;
+	gint64 readahead_head;
+	gint64 readahead_tail;
+	gboolean has_readahead;
 } RuleInfo;
 
 typedef struct {
@@ -71,6 +74,30 @@ dummy_extract_func (TrackerExtractInfo  *info,
 	return TRUE;
 }
 
+static gint64
+load_readahead_size (GKeyFile    *key_file,
+                     const gchar *key,
+                     gboolean    *found)
+{
+	gchar *str;
+	gint64 size;
+
+	str = g_key_file_get_string (key_file, "ExtractorRule", key, NULL);
+	if (!str)
+		return 0;
+
+	*found = TRUE;
+
+	if (g_strcmp0 (str, "max-bytes") == 0)
+		size = TRACKER_EXTRACT_READAHEAD_MAX_BYTES;
+	else
+		size = MAX (0, g_ascii_strtoll (str, NULL, 10));
+
+	g_free (str);
+
+	return size;
+}
+
 static gboolean
 load_extractor_rule (GKeyFile    *key_file,
                      const gchar *rule_path,
@@ -129,6 +156,12 @@ load_extractor_rule (GKeyFile    *key_file,
 	rule.graph = g_key_file_get_string (key_file, "ExtractorRule", "Graph", NULL);
 	rule.hash = g_key_file_get_string (key_file, "ExtractorRule", "Hash", NULL);
 
+	/* Optional hints on the byte ranges the module reads */
+	rule.readahead_head = load_readahead_size (key_file, "ReadaheadHead",
+	                                           &rule.has_readahead);
+	rule.readahead_tail = load_readahead_size (key_file, "ReadaheadTail",
+	                                           &rule.has_readahead);
+
 	/* Construct the rule */
 	rule.module_path = g_intern_string (module_path);
 
@@ -608,6 +641,47 @@ tracker_extract_module_manager_get_hash (const gchar *mimetype)
 	return NULL;
 }
 
+/**
+ * tracker_extract_module_manager_get_readahead:
+ * @mimetype: a MIME type string
+ * @head: (out): Return location for the bytes read from the start
+ * @tail: (out): Return location for the bytes read from the end
+ *
+ * Returns the byte ranges the module handling @mimetype is known
+ * to read, as given by the ReadaheadHead and ReadaheadTail keys of
+ * its rule. @head is %TRACKER_EXTRACT_READAHEAD_MAX_BYTES if the
+ * module reads up to the configured maximum of text.
+ *
+ * Returns: %TRUE if the rule has readahead hints.
+ **/
+gboolean
+tracker_extract_module_manager_get_readahead (const gchar *mimetype,
+                                              gint64      *head,
+                                              gint64      *tail)
+{
+	GList *l, *list;
+
+	*head = *tail = 0;
+
+	if (!tracker_extract_module_manager_init ()) {
+		return FALSE;
+	}
+
+	list = lookup_rules (mimetype);
+
+	for (l = list; l; l = l->next) {
+		RuleInfo *r_info = l->data;
+
+		if (r_info->has_readahead) {
+			*head = r_info->readahead_head;
+			*tail = r_info->readahead_tail;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
 void
 tracker_module_manager_shutdown_modules (void)
 {
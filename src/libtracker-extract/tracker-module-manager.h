@@ -34,6 +34,9 @@ G_BEGIN_DECLS
 
 typedef struct _TrackerMimetypeInfo TrackerMimetypeInfo;
 
+/* Readahead head size of modules reading up to the max-bytes setting */
+#define TRACKER_EXTRACT_READAHEAD_MAX_BYTES -1
+
 typedef gboolean (* TrackerExtractInitFunc)     (GError **error);
 typedef void     (* TrackerExtractShutdownFunc) (void);
 
@@ -48,6 +51,10 @@ GStrv     tracker_extract_module_manager_get_rdf_types (const gchar *mimetype);
 const gchar * tracker_extract_module_manager_get_graph (const gchar *mimetype);
 const gchar * tracker_extract_module_manager_get_hash  (const gchar *mimetype);
 
+gboolean tracker_extract_module_manager_get_readahead (const gchar *mimetype,
+                                                       gint64      *head,
+                                                       gint64      *tail);
+
 GModule * tracker_extract_module_manager_get_module (const gchar                 *mimetype,
                                                      const gchar                **rule_out,
                                                      TrackerExtractMetadataFunc  *extract_func_out);
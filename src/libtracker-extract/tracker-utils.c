@@ -26,6 +26,10 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <libtracker-miners-common/tracker-utils.h>
 #include <libtracker-miners-common/tracker-date-time.h>
 
@@ -314,22 +318,64 @@ tracker_text_normalize (const gchar *text,
                         guint       *n_words)
 {
 	GString *string;
+	const gchar *p = text;
 	gboolean in_break = TRUE;
-	gunichar ch;
-	gint words = 0;
+	guint words = 0;
+
+	/* Letters are copied as they are, and runs of anything else
+	 * become a single space, so the output is never longer.
+	 */
+	string = g_string_sized_new (strlen (text));
+
+	while (*p != '\0') {
+		const gchar *next;
+		gunichar ch;
+		gboolean is_letter;
+
+		if ((guchar) *p < 0x80) {
+			if (g_ascii_isalpha (*p)) {
+				const gchar *start = p;
+
+				/* Copy the whole run of ASCII letters */
+				do {
+					p++;
+				} while (g_ascii_isalpha (*p));
+
+				g_string_append_len (string, start, p - start);
+				in_break = FALSE;
 
-	string = g_string_new (NULL);
+				/* Stray continuation bytes belong to the last
+				 * character, as with g_utf8_find_next_char().
+				 */
+				while (((guchar) *p & 0xC0) == 0x80)
+					p++;
 
-	while ((ch = g_utf8_get_char_validated (text, -1)) > 0) {
-		GUnicodeType type;
+				continue;
+			}
+
+			ch = *p;
+			is_letter = FALSE;
 
-		type = g_unichar_type (ch);
+			next = p + 1;
+			while (((guchar) *next & 0xC0) == 0x80)
+				next++;
+		} else {
+			GUnicodeType type;
+
+			/* Invalid sequences are not letters, and are skipped
+			 * up to the next character start.
+			 */
+			ch = g_utf8_get_char_validated (p, -1);
+			type = g_unichar_type (ch);
+			is_letter = (type == G_UNICODE_LOWERCASE_LETTER ||
+			             type == G_UNICODE_MODIFIER_LETTER ||
+			             type == G_UNICODE_OTHER_LETTER ||
+			             type == G_UNICODE_TITLECASE_LETTER ||
+			             type == G_UNICODE_UPPERCASE_LETTER);
+			next = g_utf8_find_next_char (p, NULL);
+		}
 
-		if (type == G_UNICODE_LOWERCASE_LETTER ||
-		    type == G_UNICODE_MODIFIER_LETTER ||
-		    type == G_UNICODE_OTHER_LETTER ||
-		    type == G_UNICODE_TITLECASE_LETTER ||
-		    type == G_UNICODE_UPPERCASE_LETTER) {
+		if (is_letter) {
 			/* Append regular chars */
 			g_string_append_unichar (string, ch);
 			in_break = FALSE;
@@ -344,7 +390,7 @@ tracker_text_normalize (const gchar *text,
 			}
 		}
 
-		text = g_utf8_find_next_char (text, NULL);
+		p = next;
 	}
 
 	if (n_words) {
@@ -360,6 +406,126 @@ tracker_text_normalize (const gchar *text,
 
 // LCOV_EXCL_STOP
 
+#define ONES_MASK  G_GUINT64_CONSTANT (0x0101010101010101)
+#define HIGH_MASK  G_GUINT64_CONSTANT (0x8080808080808080)
+
+/* Returns the length of the valid UTF-8 sequence starting at @p, or 0
+ * if there is none. Overlong forms, surrogates and code points past
+ * U+10FFFF are rejected, just like g_utf8_validate() does.
+ */
+static gsize
+utf8_sequence_length (const guchar *p,
+                      gsize         available)
+{
+	guchar c = p[0];
+
+	if (c < 0xC2 || c > 0xF4)
+		return 0;
+
+	if (c < 0xE0) {
+		if (available < 2 || (p[1] & 0xC0) != 0x80)
+			return 0;
+		return 2;
+	}
+
+	if (c < 0xF0) {
+		if (available < 3 ||
+		    (p[1] & 0xC0) != 0x80 ||
+		    (p[2] & 0xC0) != 0x80)
+			return 0;
+		if ((c == 0xE0 && p[1] < 0xA0) ||
+		    (c == 0xED && p[1] > 0x9F))
+			return 0;
+		return 3;
+	}
+
+	if (available < 4 ||
+	    (p[1] & 0xC0) != 0x80 ||
+	    (p[2] & 0xC0) != 0x80 ||
+	    (p[3] & 0xC0) != 0x80)
+		return 0;
+	if ((c == 0xF0 && p[1] < 0x90) ||
+	    (c == 0xF4 && p[1] > 0x8F))
+		return 0;
+	return 4;
+}
+
+/* Skips the ASCII bytes at @p, nul excepted, 16 bytes at a time with
+ * SSE2 where available, 8 bytes at a time elsewhere.
+ */
+static inline const guchar *
+utf8_skip_ascii (const guchar *p,
+                 const guchar *last)
+{
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128 ();
+
+	while (last - p >= 16) {
+		__m128i chunk;
+		gint mask;
+
+		chunk = _mm_loadu_si128 ((const __m128i *) p);
+
+		/* One bit per byte, set if non-ASCII or nul */
+		mask = _mm_movemask_epi8 (_mm_or_si128 (chunk,
+		                                        _mm_cmpeq_epi8 (chunk, zero)));
+		if (mask != 0)
+			return p + g_bit_nth_lsf (mask, -1);
+
+		p += 16;
+	}
+#endif
+
+	while (last - p >= 8) {
+		guint64 word;
+
+		memcpy (&word, p, sizeof (word));
+
+		/* Stop at any byte that is either non-ASCII or nul */
+		if ((((word - ONES_MASK) & ~word) | word) & HIGH_MASK)
+			break;
+
+		p += 8;
+	}
+
+	return p;
+}
+
+/* Same results as g_utf8_validate(), but runs of ASCII, which is
+ * most of the text we get to see, are skipped in blocks. Other
+ * characters are checked one at a time.
+ */
+static void
+utf8_validate (const gchar  *text,
+               gsize         len,
+               const gchar **end)
+{
+	const guchar *p = (const guchar *) text;
+	const guchar *last = p + len;
+
+	while (p < last) {
+		gsize n;
+
+		p = utf8_skip_ascii (p, last);
+
+		if (p == last)
+			break;
+
+		if (*p != '\0' && *p < 0x80) {
+			p++;
+			continue;
+		}
+
+		n = utf8_sequence_length (p, last - p);
+		if (n == 0)
+			break;
+
+		p += n;
+	}
+
+	*end = (const gchar *) p;
+}
+
 /**
  * tracker_text_validate_utf8:
  * @text: the text to validate
@@ -369,7 +535,7 @@ tracker_text_normalize (const gchar *text,
  * @valid_len: Output number of valid UTF-8 bytes found, or %NULL if not needed
  *
  * This function iterates through @text checking for UTF-8 validity
- * using g_utf8_validate(), appends the first chunk of valid characters
+ * the same way g_utf8_validate() does, appends the first chunk of valid characters
  * to @str, and gives the number of valid UTF-8 bytes in @valid_len.
  *
  * Returns: %TRUE if some bytes were found to be valid, %FALSE otherwise.
@@ -393,7 +559,7 @@ tracker_text_validate_utf8 (const gchar  *text,
 
 		/* Validate string, getting the pointer to first non-valid character
 		 *  (if any) or to the end of the string. */
-		g_utf8_validate (text, len_to_validate, &end);
+		utf8_validate (text, len_to_validate, &end);
 		if (end > text) {
 			/* If str output required... */
 			if (str) {
@@ -19,6 +19,8 @@
 
 #include "config-miners.h"
 
+#include <libtracker-miners-common/tracker-common.h>
+
 #include "tracker-crawler.h"
 #include "tracker-file-data-provider.h"
 #include "tracker-miner-enums.h"
@@ -29,10 +31,17 @@
 	G_FILE_ATTRIBUTE_UNIX_IS_MOUNTPOINT "," \
 	G_FILE_ATTRIBUTE_STANDARD_NAME "," \
 	G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
-	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN
+	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+	G_FILE_ATTRIBUTE_ID_FILESYSTEM "," \
+	G_FILE_ATTRIBUTE_UNIX_INODE
 
 #define MAX_SIMULTANEOUS_ITEMS       64
 
+/* Approximate memory held per file found, the GFile and its GFileInfo,
+ * used to account the crawled trees in the memory budget.
+ */
+#define ESTIMATED_ITEM_SIZE 512
+
 typedef struct TrackerCrawlerPrivate  TrackerCrawlerPrivate;
 typedef struct DirectoryChildData DirectoryChildData;
 typedef struct DirectoryProcessingData DirectoryProcessingData;
@@ -92,6 +101,10 @@ struct TrackerCrawlerPrivate {
 	TrackerCrawlerCheckFunc check_func;
 	gpointer check_func_data;
 	GDestroyNotify check_func_destroy;
+
+	/* Files in the trees being crawled, or waiting to be added */
+	guint n_items;
+	guint budget_id;
 };
 
 enum {
@@ -143,9 +156,31 @@ tracker_crawler_class_init (TrackerCrawlerClass *klass)
 	file_info_quark = g_quark_from_static_string ("tracker-crawler-file-info");
 }
 
+static gsize
+report_memory_usage (gpointer user_data)
+{
+	TrackerCrawlerPrivate *priv;
+
+	priv = tracker_crawler_get_instance_private (user_data);
+
+	return priv->n_items * ESTIMATED_ITEM_SIZE;
+}
+
 static void
 tracker_crawler_init (TrackerCrawler *object)
 {
+	TrackerCrawlerPrivate *priv;
+
+	priv = tracker_crawler_get_instance_private (object);
+
+	/* Trees are only held while a directory is crawled, there is
+	 * nothing to shed, pausing the crawl keeps them at bay.
+	 */
+	priv->budget_id =
+		tracker_memory_budget_register (tracker_memory_budget_get_default (),
+		                                "crawler",
+		                                report_memory_usage,
+		                                NULL, object);
 }
 
 static void
@@ -195,6 +230,9 @@ crawler_finalize (GObject *object)
 
 	priv = tracker_crawler_get_instance_private (TRACKER_CRAWLER (object));
 
+	tracker_memory_budget_unregister (tracker_memory_budget_get_default (),
+	                                  priv->budget_id);
+
 	if (priv->check_func_data && priv->check_func_destroy) {
 		priv->check_func_destroy (priv->check_func_data);
 	}
@@ -345,8 +383,14 @@ directory_processing_data_new (GNode *node)
 }
 
 static void
-directory_processing_data_free (DirectoryProcessingData *data)
+directory_processing_data_free (DirectoryProcessingData *data,
+                                TrackerCrawler          *crawler)
 {
+	TrackerCrawlerPrivate *priv;
+
+	priv = tracker_crawler_get_instance_private (crawler);
+	priv->n_items -= g_slist_length (data->children);
+
 	g_slist_foreach (data->children, (GFunc) directory_child_data_free, NULL);
 	g_slist_free (data->children);
 
@@ -444,6 +488,10 @@ directory_tree_free_foreach (GNode    *node,
 static void
 directory_root_info_free (DirectoryRootInfo *info)
 {
+	TrackerCrawlerPrivate *priv;
+
+	priv = tracker_crawler_get_instance_private (info->crawler);
+
 	if (info->idle_id) {
 		g_source_remove (info->idle_id);
 	}
@@ -454,6 +502,7 @@ directory_root_info_free (DirectoryRootInfo *info)
 
 	g_object_unref (info->directory);
 
+	priv->n_items -= g_node_n_nodes (info->tree, G_TRAVERSE_ALL);
 	g_node_traverse (info->tree,
 			 G_PRE_ORDER,
 			 G_TRAVERSE_ALL,
@@ -464,9 +513,10 @@ directory_root_info_free (DirectoryRootInfo *info)
 
 	g_queue_foreach (info->directory_processing_queue,
 			 (GFunc) directory_processing_data_free,
-			 NULL);
+			 info->crawler);
 	g_queue_free (info->directory_processing_queue);
 
+	g_object_unref (info->crawler);
 	g_slice_free (DirectoryRootInfo, info);
 }
 
@@ -505,6 +555,14 @@ process_next (DirectoryRootInfo *info)
 								  g_object_ref (child_data->child));
 			}
 
+			/* Files taken into the tree stay accounted */
+			if (!child_node) {
+				TrackerCrawlerPrivate *priv;
+
+				priv = tracker_crawler_get_instance_private (info->crawler);
+				priv->n_items--;
+			}
+
 			if (G_NODE_IS_ROOT (dir_data->node) &&
 			    child_node && child_data->is_dir) {
 				DirectoryProcessingData *child_dir_data;
@@ -520,7 +578,7 @@ process_next (DirectoryRootInfo *info)
 			/* No (more) children, or directory ignored. stop processing. */
 			g_queue_pop_head (info->directory_processing_queue);
 			g_task_return_boolean (task, !dir_data->ignored_by_content);
-			directory_processing_data_free (dir_data);
+			directory_processing_data_free (dir_data, info->crawler);
 			g_object_unref (task);
 		}
 	} else {
@@ -645,6 +703,7 @@ data_provider_data_add (DataProviderData *dpd)
 		}
 
 		directory_processing_data_add_child (dpd->dir_info, child, is_dir);
+		priv->n_items++;
 
 		g_object_unref (child);
 		g_object_unref (info);
@@ -900,7 +959,9 @@ tracker_crawler_get (TrackerCrawler        *crawler,
 	g_task_set_task_data (task, info,
 	                      (GDestroyNotify) directory_root_info_free);
 	info->task = task;
-	info->crawler = crawler;
+	info->crawler = g_object_ref (crawler);
+	/* The root node of the tree */
+	priv->n_items++;
 
 	if (!file_info && !check_directory (crawler, info, file)) {
 		g_task_return_boolean (task, FALSE);
@@ -24,4 +24,6 @@
 
 void _tracker_decorator_invalidate_cache (TrackerDecorator *decorator);
 
+GVariant * _tracker_decorator_get_commit_metrics (TrackerDecorator *decorator);
+
 #endif /* __TRACKER_DECORATOR_PRIVATE_H__ */
@@ -54,6 +54,7 @@ struct _TrackerDecoratorInfo {
 	gchar *urn;
 	gchar *url;
 	gchar *mimetype;
+	gchar *content_id;
 	gint id;
 	gint ref_count;
 };
@@ -89,6 +90,13 @@ struct _TrackerDecoratorPrivate {
 	gint batch_size;
 	gint n_updates;
 
+	/* Commit metrics */
+	gint64 commit_start;
+	guint64 n_commits;
+	guint64 n_committed_items;
+	gint64 commit_elapsed;
+	guint64 commit_latency[TRACKER_LATENCY_N_BUCKETS];
+
 	guint processing : 1;
 	guint querying   : 1;
 };
@@ -144,12 +152,16 @@ tracker_decorator_info_new (TrackerDecorator    *decorator,
 {
 	TrackerDecoratorInfo *info;
 	GCancellable *cancellable;
+	const gchar *content_id;
 
 	info = g_slice_new0 (TrackerDecoratorInfo);
 	info->urn = g_strdup (tracker_sparql_cursor_get_string (cursor, 0, NULL));
 	info->id = tracker_sparql_cursor_get_integer (cursor, 1);
 	info->url = g_strdup (tracker_sparql_cursor_get_string (cursor, 2, NULL));
 	info->mimetype = g_strdup (tracker_sparql_cursor_get_string (cursor, 3, NULL));
+	content_id = tracker_sparql_cursor_get_string (cursor, 4, NULL);
+	if (content_id && g_str_has_prefix (content_id, "urn:fileid:"))
+		info->content_id = g_strdup (content_id);
 	info->ref_count = 1;
 
 	cancellable = g_cancellable_new ();
@@ -197,6 +209,7 @@ tracker_decorator_info_unref (TrackerDecoratorInfo *info)
 	g_free (info->urn);
 	g_free (info->url);
 	g_free (info->mimetype);
+	g_free (info->content_id);
 	g_slice_free (TrackerDecoratorInfo, info);
 }
 
@@ -295,6 +308,7 @@ decorator_commit_cb (GObject      *object,
 	TrackerSparqlConnection *conn;
 	TrackerDecoratorPrivate *priv;
 	TrackerDecorator *decorator;
+	gint64 elapsed;
 
 	decorator = user_data;
 	priv = decorator->priv;
@@ -309,6 +323,12 @@ decorator_commit_cb (GObject      *object,
 		tag_success (decorator, priv->commit_buffer);
 	}
 
+	elapsed = g_get_monotonic_time () - priv->commit_start;
+	priv->n_commits++;
+	priv->n_committed_items += priv->commit_buffer->len;
+	priv->commit_elapsed += elapsed;
+	priv->commit_latency[tracker_latency_bucket (elapsed)]++;
+
 	g_clear_pointer (&priv->commit_buffer, g_array_unref);
 
 	if (!decorator_check_commit (decorator))
@@ -363,6 +383,7 @@ decorator_commit_info (TrackerDecorator *decorator)
 	}
 
 	sparql_conn = tracker_miner_get_connection (TRACKER_MINER (decorator));
+	priv->commit_start = g_get_monotonic_time ();
 	tracker_sparql_connection_update_array_async (sparql_conn,
 	                                              (gchar **) array->pdata,
 	                                              array->len,
@@ -551,8 +572,9 @@ append_graph_patterns (TrackerDecorator *decorator,
 			g_string_append (query, "UNION ");
 
 		g_string_append_printf (query,
-		                        "{ GRAPH %s { ?urn a nfo:FileDataObject ; nfo:fileName [] } } ",
-		                        graphs[i]);
+		                        "{ GRAPH %s { ?urn a nfo:FileDataObject ; nfo:fileName [] } "
+		                        "  BIND (%d AS ?priority) } ",
+		                        graphs[i], priority ? 1 : 0);
 		first = FALSE;
 	}
 
@@ -625,6 +647,8 @@ ensure_remaining_items_query (TrackerDecorator *decorator)
 		"tracker:id(?urn)",
 		"?urn",
 		"nie:mimeType(?urn)",
+		"dc:identifier(?urn)",
+		"?priority",
 		NULL
 	};
 
@@ -734,6 +758,112 @@ decorator_item_cache_remove (TrackerDecorator *decorator,
 	}
 }
 
+typedef struct {
+	TrackerDecoratorInfo *info;
+	guint priority;
+	guint anchor;
+	guint64 inode;
+	guint pos;
+} CachedItem;
+
+static guint64
+content_id_get_inode (const gchar *content_id)
+{
+	const gchar *p;
+
+	/* urn:fileid:<filesystem>:<inode>[/<suffix>], the filesystem
+	 * may be a device path or remote source, and the suffix may
+	 * hold anything. The inode is the first run of digits between
+	 * a colon and either a slash or the end.
+	 */
+	if (!content_id || !g_str_has_prefix (content_id, "urn:fileid:"))
+		return 0;
+
+	p = content_id + strlen ("urn:fileid:");
+
+	while ((p = strchr (p, ':')) != NULL) {
+		gchar *end;
+		guint64 inode;
+
+		p++;
+
+		if (!g_ascii_isdigit (*p))
+			continue;
+
+		inode = g_ascii_strtoull (p, &end, 10);
+		if (*end == '\0' || *end == G_DIR_SEPARATOR)
+			return inode;
+	}
+
+	return 0;
+}
+
+static gint
+cached_item_compare (gconstpointer a,
+                     gconstpointer b)
+{
+	const CachedItem *item_a = a, *item_b = b;
+
+	if (item_a->priority != item_b->priority)
+		return item_a->priority > item_b->priority ? -1 : 1;
+	if (item_a->anchor != item_b->anchor)
+		return item_a->anchor < item_b->anchor ? -1 : 1;
+	if (item_a->inode != item_b->inode)
+		return item_a->inode < item_b->inode ? -1 : 1;
+
+	return item_a->pos < item_b->pos ? -1 : (item_a->pos > item_b->pos);
+}
+
+/* Items come in database order, which has nothing to do with where
+ * files are on disk. Items on a rotational disk are grouped where
+ * the first of them was and sorted by inode, which roughly follows
+ * the on-disk layout, so the disk sweeps forward instead of seeking
+ * around. Other items keep their order, priority items go first.
+ */
+static void
+decorator_sort_items (GArray *items)
+{
+	GHashTable *anchors[2];
+	guint i;
+
+	anchors[0] = g_hash_table_new (NULL, NULL);
+	anchors[1] = g_hash_table_new (NULL, NULL);
+
+	for (i = 0; i < items->len; i++) {
+		CachedItem *item = &g_array_index (items, CachedItem, i);
+		TrackerDeviceType type;
+		const gchar *device;
+		gpointer anchor;
+		GFile *file;
+
+		item->pos = item->anchor = i;
+
+		if (!item->info->content_id)
+			continue;
+
+		file = g_file_new_for_uri (item->info->url);
+		device = tracker_file_get_device (file, &type);
+		g_object_unref (file);
+
+		if (!device || type != TRACKER_DEVICE_TYPE_ROTATIONAL)
+			continue;
+
+		item->inode = content_id_get_inode (item->info->content_id);
+
+		if (g_hash_table_lookup_extended (anchors[item->priority],
+		                                  device, NULL, &anchor))
+			item->anchor = GPOINTER_TO_UINT (anchor);
+		else
+			g_hash_table_insert (anchors[item->priority],
+			                     (gpointer) device, GUINT_TO_POINTER (i));
+	}
+
+	g_array_sort (items, cached_item_compare);
+
+	g_hash_table_unref (anchors[0]);
+	g_hash_table_unref (anchors[1]);
+}
+
 static void
 decorator_cache_items_cb (GObject      *object,
                           GAsyncResult *result,
@@ -756,10 +886,27 @@ decorator_cache_items_cb (GObject      *object,
 		decorator_notify_task_error (decorator, error);
 		g_error_free (error);
 	} else {
+		GArray *items;
+		guint i;
+
+		items = g_array_new (FALSE, TRUE, sizeof (CachedItem));
+
 		while (tracker_sparql_cursor_next (cursor, NULL, NULL)) {
-			info = tracker_decorator_info_new (decorator, cursor);
+			CachedItem item = { 0, };
+
+			item.info = tracker_decorator_info_new (decorator, cursor);
+			item.priority = tracker_sparql_cursor_get_integer (cursor, 5) != 0;
+			g_array_append_val (items, item);
+		}
+
+		decorator_sort_items (items);
+
+		for (i = 0; i < items->len; i++) {
+			info = g_array_index (items, CachedItem, i).info;
 			g_queue_push_tail (&priv->item_cache, info);
 		}
+
+		g_array_unref (items);
 	}
 
 	if (!g_queue_is_empty (&priv->item_cache) && !priv->processing) {
@@ -1218,6 +1365,38 @@ tracker_decorator_next_finish (TrackerDecorator  *decorator,
 	return g_task_propagate_pointer (G_TASK (result), error);
 }
 
+/**
+ * tracker_decorator_peek_items:
+ * @decorator: a #TrackerDecorator
+ * @max_items: maximum number of items to return
+ *
+ * Returns the items that tracker_decorator_next() will hand out
+ * next, in order, among those already fetched from the database.
+ * Items are only valid until control returns to the main loop.
+ *
+ * Returns: (transfer container) (element-type TrackerDecoratorInfo):
+ *          a list of up to @max_items items, free with g_list_free()
+ **/
+GList *
+tracker_decorator_peek_items (TrackerDecorator *decorator,
+                              guint             max_items)
+{
+	TrackerDecoratorPrivate *priv;
+	GList *items = NULL, *l;
+	guint i;
+
+	g_return_val_if_fail (TRACKER_IS_DECORATOR (decorator), NULL);
+
+	priv = decorator->priv;
+
+	for (l = g_queue_peek_head_link (&priv->item_cache), i = 0;
+	     l && i < max_items;
+	     l = l->next, i++)
+		items = g_list_prepend (items, l->data);
+
+	return g_list_reverse (items);
+}
+
 void
 tracker_decorator_set_priority_graphs (TrackerDecorator    *decorator,
                                        const gchar * const *graphs)
@@ -1226,6 +1405,11 @@ tracker_decorator_set_priority_graphs (TrackerDecorator    *decorator,
 
 	g_strfreev (priv->priority_graphs);
 	priv->priority_graphs = g_strdupv ((gchar **) graphs);
+
+	/* Queries embed the priority graphs */
+	g_clear_object (&priv->remaining_items_query);
+	g_clear_object (&priv->item_count_query);
+
 	decorator_rebuild_cache (decorator);
 }
 
@@ -1286,6 +1470,25 @@ tracker_decorator_info_get_mimetype (TrackerDecoratorInfo *info)
        return info->mimetype;
 }
 
+/**
+ * tracker_decorator_info_get_content_id:
+ * @info: a #TrackerDecoratorInfo.
+ *
+ * Returns the content identifier the file was indexed with, as
+ * given by tracker_file_get_content_identifier(). The miner stores
+ * it along with the file, so it does not need to be figured out
+ * again.
+ *
+ * Returns: the content identifier for #TrackerDecoratorInfo, or #NULL
+ *          if it is unknown.
+ **/
+const gchar *
+tracker_decorator_info_get_content_id (TrackerDecoratorInfo *info)
+{
+	g_return_val_if_fail (info != NULL, NULL);
+	return info->content_id;
+}
+
 
 /**
  * tracker_decorator_info_get_task:
@@ -1350,3 +1553,30 @@ _tracker_decorator_invalidate_cache (TrackerDecorator *decorator)
 {
 	decorator_rebuild_cache (decorator);
 }
+
+GVariant *
+_tracker_decorator_get_commit_metrics (TrackerDecorator *decorator)
+{
+	TrackerDecoratorPrivate *priv = decorator->priv;
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "remaining-items",
+	                       g_variant_new_uint32 (MAX (priv->n_remaining_items, 0)));
+	g_variant_builder_add (&builder, "{sv}", "pending-updates",
+	                       g_variant_new_uint32 (priv->sparql_buffer ?
+	                                             priv->sparql_buffer->len : 0));
+	g_variant_builder_add (&builder, "{sv}", "commits",
+	                       g_variant_new_uint64 (priv->n_commits));
+	g_variant_builder_add (&builder, "{sv}", "committed-items",
+	                       g_variant_new_uint64 (priv->n_committed_items));
+	g_variant_builder_add (&builder, "{sv}", "commit-time",
+	                       g_variant_new_double ((gdouble) priv->commit_elapsed / G_USEC_PER_SEC));
+	g_variant_builder_add (&builder, "{sv}", "commit-latency",
+	                       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+	                                                  priv->commit_latency,
+	                                                  TRACKER_LATENCY_N_BUCKETS,
+	                                                  sizeof (guint64)));
+
+	return g_variant_builder_end (&builder);
+}
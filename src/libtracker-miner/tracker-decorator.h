@@ -112,6 +112,9 @@ TrackerDecoratorInfo *
                                                    GAsyncResult         *result,
                                                    GError              **error);
 
+GList *       tracker_decorator_peek_items        (TrackerDecorator     *decorator,
+                                                   guint                 max_items);
+
 void          tracker_decorator_set_priority_graphs (TrackerDecorator    *decorator,
                                                      const gchar * const *graphs);
 
@@ -123,6 +126,7 @@ void          tracker_decorator_info_unref        (TrackerDecoratorInfo *info);
 const gchar * tracker_decorator_info_get_urn      (TrackerDecoratorInfo *info);
 const gchar * tracker_decorator_info_get_url      (TrackerDecoratorInfo *info);
 const gchar * tracker_decorator_info_get_mimetype (TrackerDecoratorInfo *info);
+const gchar * tracker_decorator_info_get_content_id (TrackerDecoratorInfo *info);
 GTask       * tracker_decorator_info_get_task     (TrackerDecoratorInfo *info);
 void          tracker_decorator_info_complete     (TrackerDecoratorInfo *info,
                                                    gchar                *sparql);
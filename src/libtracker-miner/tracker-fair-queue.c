@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* A queue of prioritized elements that are grouped by a key (e.g. the
+ * indexing root they belong to). Priorities are strict across the whole
+ * queue, but elements with the same priority are served from each key
+ * by deficit round robin, so each key gets a share of the queue head
+ * proportional to its weight, no matter how many elements it holds.
+ */
+
+#include "config-miners.h"
+
+#include "tracker-fair-queue.h"
+#include "tracker-priority-queue.h"
+
+typedef struct FairSubqueue FairSubqueue;
+
+struct FairSubqueue
+{
+	gpointer key;
+	TrackerPriorityQueue *items;
+	guint deficit;
+	GList *active_link;
+};
+
+struct _TrackerFairQueue
+{
+	GHashTable *subqueues;
+	FairSubqueue *null_subqueue;
+	GHashTable *weights;
+
+	/* Non-empty subqueues, in service order */
+	GQueue active;
+
+	GBoxedCopyFunc key_copy_func;
+	guint length;
+
+	gint ref_count;
+};
+
+static void
+fair_subqueue_free (FairSubqueue *subqueue)
+{
+	tracker_priority_queue_unref (subqueue->items);
+	g_slice_free (FairSubqueue, subqueue);
+}
+
+TrackerFairQueue *
+tracker_fair_queue_new (GHashFunc      hash_func,
+                        GEqualFunc     key_equal_func,
+                        GBoxedCopyFunc key_copy_func,
+                        GDestroyNotify key_destroy_func)
+{
+	TrackerFairQueue *queue;
+
+	queue = g_slice_new0 (TrackerFairQueue);
+	queue->subqueues = g_hash_table_new_full (hash_func, key_equal_func,
+	                                          key_destroy_func,
+	                                          (GDestroyNotify) fair_subqueue_free);
+	queue->weights = g_hash_table_new_full (hash_func, key_equal_func,
+	                                        key_destroy_func, NULL);
+	queue->key_copy_func = key_copy_func;
+	g_queue_init (&queue->active);
+
+	queue->ref_count = 1;
+
+	return queue;
+}
+
+TrackerFairQueue *
+tracker_fair_queue_ref (TrackerFairQueue *queue)
+{
+	g_atomic_int_inc (&queue->ref_count);
+	return queue;
+}
+
+void
+tracker_fair_queue_unref (TrackerFairQueue *queue)
+{
+	if (g_atomic_int_dec_and_test (&queue->ref_count)) {
+		g_queue_clear (&queue->active);
+		g_hash_table_unref (queue->subqueues);
+		g_hash_table_unref (queue->weights);
+
+		if (queue->null_subqueue)
+			fair_subqueue_free (queue->null_subqueue);
+
+		g_slice_free (TrackerFairQueue, queue);
+	}
+}
+
+static gpointer
+copy_key (TrackerFairQueue *queue,
+          gconstpointer     key)
+{
+	if (queue->key_copy_func)
+		return queue->key_copy_func ((gpointer) key);
+
+	return (gpointer) key;
+}
+
+static FairSubqueue *
+lookup_subqueue (TrackerFairQueue *queue,
+                 gconstpointer     key,
+                 gboolean          create)
+{
+	FairSubqueue *subqueue;
+
+	if (key == NULL)
+		subqueue = queue->null_subqueue;
+	else
+		subqueue = g_hash_table_lookup (queue->subqueues, key);
+
+	if (subqueue || !create)
+		return subqueue;
+
+	subqueue = g_slice_new0 (FairSubqueue);
+	subqueue->items = tracker_priority_queue_new ();
+
+	if (key == NULL) {
+		queue->null_subqueue = subqueue;
+	} else {
+		subqueue->key = copy_key (queue, key);
+		g_hash_table_insert (queue->subqueues, subqueue->key, subqueue);
+	}
+
+	/* New keys wait for their turn at the end of the round */
+	g_queue_push_tail (&queue->active, subqueue);
+	subqueue->active_link = queue->active.tail;
+
+	return subqueue;
+}
+
+static void
+release_subqueue_if_empty (TrackerFairQueue *queue,
+                           FairSubqueue     *subqueue)
+{
+	if (!tracker_priority_queue_is_empty (subqueue->items))
+		return;
+
+	g_queue_delete_link (&queue->active, subqueue->active_link);
+
+	if (subqueue == queue->null_subqueue) {
+		queue->null_subqueue = NULL;
+		fair_subqueue_free (subqueue);
+	} else {
+		g_hash_table_remove (queue->subqueues, subqueue->key);
+	}
+}
+
+static FairSubqueue *
+select_subqueue (TrackerFairQueue *queue,
+                 gint             *priority_out)
+{
+	FairSubqueue *selected = NULL;
+	gint selected_priority = 0;
+	GList *l;
+
+	/* Priorities are strict, within the highest priority found,
+	 * the first subqueue in service order gets the turn.
+	 */
+	for (l = queue->active.head; l; l = l->next) {
+		FairSubqueue *subqueue = l->data;
+		gint priority;
+
+		tracker_priority_queue_peek (subqueue->items, &priority);
+
+		if (!selected || priority < selected_priority) {
+			selected = subqueue;
+			selected_priority = priority;
+		}
+	}
+
+	if (selected && priority_out)
+		*priority_out = selected_priority;
+
+	return selected;
+}
+
+void
+tracker_fair_queue_set_weight (TrackerFairQueue *queue,
+                               gconstpointer     key,
+                               guint             weight)
+{
+	g_return_if_fail (queue != NULL);
+	g_return_if_fail (key != NULL);
+
+	weight = MAX (weight, 1);
+
+	if (weight == TRACKER_FAIR_QUEUE_DEFAULT_WEIGHT) {
+		g_hash_table_remove (queue->weights, key);
+	} else {
+		g_hash_table_replace (queue->weights,
+		                      copy_key (queue, key),
+		                      GUINT_TO_POINTER (weight));
+	}
+}
+
+guint
+tracker_fair_queue_get_weight (TrackerFairQueue *queue,
+                               gconstpointer     key)
+{
+	gpointer weight;
+
+	g_return_val_if_fail (queue != NULL, 0);
+
+	if (key == NULL)
+		return TRACKER_FAIR_QUEUE_DEFAULT_WEIGHT;
+
+	if (!g_hash_table_lookup_extended (queue->weights, key, NULL, &weight))
+		return TRACKER_FAIR_QUEUE_DEFAULT_WEIGHT;
+
+	return GPOINTER_TO_UINT (weight);
+}
+
+gboolean
+tracker_fair_queue_is_empty (TrackerFairQueue *queue)
+{
+	g_return_val_if_fail (queue != NULL, FALSE);
+
+	return queue->length == 0;
+}
+
+guint
+tracker_fair_queue_get_length (TrackerFairQueue *queue)
+{
+	g_return_val_if_fail (queue != NULL, 0);
+
+	return queue->length;
+}
+
+guint
+tracker_fair_queue_get_key_length (TrackerFairQueue *queue,
+                                   gconstpointer     key)
+{
+	FairSubqueue *subqueue;
+
+	g_return_val_if_fail (queue != NULL, 0);
+
+	subqueue = lookup_subqueue (queue, key, FALSE);
+	if (!subqueue)
+		return 0;
+
+	return tracker_priority_queue_get_length (subqueue->items);
+}
+
+GList *
+tracker_fair_queue_add (TrackerFairQueue *queue,
+                        gconstpointer     key,
+                        gpointer          data,
+                        gint              priority)
+{
+	FairSubqueue *subqueue;
+
+	g_return_val_if_fail (queue != NULL, NULL);
+	g_return_val_if_fail (data != NULL, NULL);
+
+	subqueue = lookup_subqueue (queue, key, TRUE);
+	queue->length++;
+
+	return tracker_priority_queue_add (subqueue->items, data, priority);
+}
+
+void
+tracker_fair_queue_remove_node (TrackerFairQueue *queue,
+                                gconstpointer     key,
+                                GList            *node)
+{
+	FairSubqueue *subqueue;
+
+	g_return_if_fail (queue != NULL);
+	g_return_if_fail (node != NULL);
+
+	subqueue = lookup_subqueue (queue, key, FALSE);
+	g_return_if_fail (subqueue != NULL);
+
+	tracker_priority_queue_remove_node (subqueue->items, node);
+	queue->length--;
+
+	release_subqueue_if_empty (queue, subqueue);
+}
+
+void
+tracker_fair_queue_foreach (TrackerFairQueue *queue,
+                            GFunc             func,
+                            gpointer          user_data)
+{
+	GList *l;
+
+	g_return_if_fail (queue != NULL);
+	g_return_if_fail (func != NULL);
+
+	for (l = queue->active.head; l; l = l->next) {
+		FairSubqueue *subqueue = l->data;
+
+		tracker_priority_queue_foreach (subqueue->items, func, user_data);
+	}
+}
+
+gboolean
+tracker_fair_queue_foreach_remove (TrackerFairQueue *queue,
+                                   GEqualFunc        compare_func,
+                                   gpointer          compare_user_data,
+                                   GDestroyNotify    destroy_notify)
+{
+	gboolean updated = FALSE;
+	GList *l, *next;
+
+	g_return_val_if_fail (queue != NULL, FALSE);
+	g_return_val_if_fail (compare_func != NULL, FALSE);
+
+	for (l = queue->active.head; l; l = next) {
+		FairSubqueue *subqueue = l->data;
+		guint length;
+
+		next = l->next;
+		length = tracker_priority_queue_get_length (subqueue->items);
+
+		if (!tracker_priority_queue_foreach_remove (subqueue->items,
+		                                            compare_func,
+		                                            compare_user_data,
+		                                            destroy_notify))
+			continue;
+
+		queue->length -= length - tracker_priority_queue_get_length (subqueue->items);
+		updated = TRUE;
+
+		release_subqueue_if_empty (queue, subqueue);
+	}
+
+	return updated;
+}
+
+gpointer
+tracker_fair_queue_peek (TrackerFairQueue *queue,
+                         gint             *priority_out)
+{
+	FairSubqueue *subqueue;
+
+	g_return_val_if_fail (queue != NULL, NULL);
+
+	subqueue = select_subqueue (queue, NULL);
+	if (!subqueue)
+		return NULL;
+
+	return tracker_priority_queue_peek (subqueue->items, priority_out);
+}
+
+gpointer
+tracker_fair_queue_pop (TrackerFairQueue *queue,
+                        gint             *priority_out)
+{
+	FairSubqueue *subqueue;
+	gpointer data;
+
+	g_return_val_if_fail (queue != NULL, NULL);
+
+	subqueue = select_subqueue (queue, NULL);
+	if (!subqueue)
+		return NULL;
+
+	data = tracker_priority_queue_pop (subqueue->items, priority_out);
+	queue->length--;
+
+	/* Each element costs one unit, a subqueue getting its
+	 * turn is granted as many units as its weight.
+	 */
+	if (subqueue->deficit == 0)
+		subqueue->deficit = tracker_fair_queue_get_weight (queue, subqueue->key);
+
+	subqueue->deficit--;
+
+	if (tracker_priority_queue_is_empty (subqueue->items)) {
+		release_subqueue_if_empty (queue, subqueue);
+	} else if (subqueue->deficit == 0) {
+		/* Turn is over, go to the back of the round */
+		g_queue_unlink (&queue->active, subqueue->active_link);
+		g_queue_push_tail_link (&queue->active, subqueue->active_link);
+	}
+
+	return data;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_MINER_FAIR_QUEUE_H__
+#define __LIBTRACKER_MINER_FAIR_QUEUE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define TRACKER_FAIR_QUEUE_DEFAULT_WEIGHT 1
+
+typedef struct _TrackerFairQueue TrackerFairQueue;
+
+TrackerFairQueue *tracker_fair_queue_new   (GHashFunc      hash_func,
+                                            GEqualFunc     key_equal_func,
+                                            GBoxedCopyFunc key_copy_func,
+                                            GDestroyNotify key_destroy_func);
+
+TrackerFairQueue *tracker_fair_queue_ref   (TrackerFairQueue *queue);
+void              tracker_fair_queue_unref (TrackerFairQueue *queue);
+
+void     tracker_fair_queue_set_weight     (TrackerFairQueue *queue,
+                                            gconstpointer     key,
+                                            guint             weight);
+guint    tracker_fair_queue_get_weight     (TrackerFairQueue *queue,
+                                            gconstpointer     key);
+
+gboolean tracker_fair_queue_is_empty       (TrackerFairQueue *queue);
+
+guint    tracker_fair_queue_get_length     (TrackerFairQueue *queue);
+guint    tracker_fair_queue_get_key_length (TrackerFairQueue *queue,
+                                            gconstpointer     key);
+
+GList *  tracker_fair_queue_add         (TrackerFairQueue *queue,
+                                         gconstpointer     key,
+                                         gpointer          data,
+                                         gint              priority);
+void     tracker_fair_queue_remove_node (TrackerFairQueue *queue,
+                                         gconstpointer     key,
+                                         GList            *node);
+
+void     tracker_fair_queue_foreach     (TrackerFairQueue *queue,
+                                         GFunc             func,
+                                         gpointer          user_data);
+
+gboolean tracker_fair_queue_foreach_remove (TrackerFairQueue *queue,
+                                            GEqualFunc        compare_func,
+                                            gpointer          compare_user_data,
+                                            GDestroyNotify    destroy_notify);
+
+gpointer tracker_fair_queue_peek        (TrackerFairQueue *queue,
+                                         gint             *priority_out);
+gpointer tracker_fair_queue_pop         (TrackerFairQueue *queue,
+                                         gint             *priority_out);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_MINER_FAIR_QUEUE_H__ */
@@ -28,6 +28,7 @@
 #include "tracker-file-notifier.h"
 #include "tracker-crawler.h"
 #include "tracker-monitor-glib.h"
+#include "tracker-utils.h"
 
 enum {
 	PROP_0,
@@ -49,6 +50,7 @@ enum {
 };
 
 static guint signals[LAST_SIGNAL] = { 0 };
+static GQuark quark_monitor_event = 0;
 
 enum {
 	FILE_STATE_NONE,
@@ -69,19 +71,41 @@ typedef struct {
 	guint64 disk_mtime;
 	gchar *extractor_hash;
 	gchar *mimetype;
+	gchar *content_id;
+	GFile *move_source;
+	GFile *store_parent;
 } TrackerFileData;
 
 typedef struct {
 	GFile *root;
 	GFile *current_dir;
 	GQueue *pending_dirs;
+	GHashTable *cache;
+	GQueue queue;
+
+	/* Content identifier -> TrackerFileData for store
+	 * entries in the root, used to match files renamed
+	 * while the miner was not running.
+	 */
+	GHashTable *store_ids;
+	GList *moved_files;
+
+	/* Parent GFile -> GList of TrackerFileData for store
+	 * entries, so moved directories only walk their subtree.
+	 */
+	GHashTable *store_children;
+
+	GTimer *timer;
 	guint flags;
 	guint directories_found;
 	guint directories_ignored;
 	guint files_found;
 	guint files_ignored;
+	guint files_moved;
+	guint files_unsniffed;
 	guint current_dir_content_filtered : 1;
 	guint ignore_root                  : 1;
+	guint contents_queried             : 1;
 } RootData;
 
 typedef struct {
@@ -93,30 +117,47 @@ typedef struct {
 	TrackerCrawler *crawler;
 	TrackerMonitor *monitor;
 	TrackerDataProvider *data_provider;
-	GHashTable *cache;
-	GQueue queue;
 
 	TrackerSparqlStatement *content_query;
 	TrackerSparqlStatement *deleted_query;
 
-	GTimer *timer;
 	gchar *file_attributes;
 
 	/* List of pending directory
 	 * trees to get data from
 	 */
 	GList *pending_index_roots;
+
+	/* Roots being crawled, these take turns crawling a
+	 * directory each, the current one is out of the queue.
+	 */
+	GQueue active_roots;
 	RootData *current_index_root;
 
+	guint budget_id;
+	guint rate_limit_id;
+
 	guint stopped : 1;
 	guint high_water : 1;
 	guint active : 1;
 } TrackerFileNotifierPrivate;
 
+/* Rough per-entry cost of the cache, accounting for the GFile
+ * and strings hanging from it.
+ */
+#define ESTIMATED_FILE_DATA_SIZE (sizeof (TrackerFileData) + 256)
+
+/* Roots crawled at once, each holds its store contents
+ * in memory until it is fully crawled.
+ */
+#define MAX_ACTIVE_ROOTS 4
+
 static gboolean notifier_query_root_contents (TrackerFileNotifier *notifier);
 static gboolean crawl_directory_in_current_root (TrackerFileNotifier *notifier);
 static void finish_current_directory (TrackerFileNotifier *notifier,
                                       gboolean             interrupted);
+static void file_notifier_resolve_moves (TrackerFileNotifier *notifier);
+static void file_data_free (TrackerFileData *file_data);
 
 G_DEFINE_TYPE_WITH_PRIVATE (TrackerFileNotifier, tracker_file_notifier, G_TYPE_OBJECT)
 
@@ -191,6 +232,18 @@ root_data_new (TrackerFileNotifier *notifier,
 	data->pending_dirs = g_queue_new ();
 	data->flags = flags;
 	data->ignore_root = ignore_root;
+	data->timer = g_timer_new ();
+
+	g_queue_init (&data->queue);
+	data->cache = g_hash_table_new_full (g_file_hash,
+	                                     (GEqualFunc) g_file_equal,
+	                                     NULL,
+	                                     (GDestroyNotify) file_data_free);
+	data->store_ids = g_hash_table_new (g_str_hash, g_str_equal);
+	data->store_children = g_hash_table_new_full (g_file_hash,
+	                                              (GEqualFunc) g_file_equal,
+	                                              g_object_unref,
+	                                              (GDestroyNotify) g_list_free);
 
 	g_queue_push_tail (data->pending_dirs, g_object_ref (file));
 
@@ -204,6 +257,12 @@ root_data_free (RootData *data)
 	if (data->current_dir) {
 		g_object_unref (data->current_dir);
 	}
+	g_list_free (data->moved_files);
+	g_hash_table_destroy (data->store_ids);
+	g_hash_table_destroy (data->store_children);
+	g_queue_clear (&data->queue);
+	g_hash_table_destroy (data->cache);
+	g_timer_destroy (data->timer);
 	g_object_unref (data->root);
 	g_free (data);
 }
@@ -311,7 +370,21 @@ notifier_check_next_root (TrackerFileNotifier *notifier)
 	priv = tracker_file_notifier_get_instance_private (notifier);
 	g_assert (priv->current_index_root == NULL);
 
-	if (priv->pending_index_roots) {
+	while (priv->pending_index_roots &&
+	       priv->active_roots.length < MAX_ACTIVE_ROOTS) {
+		RootData *data = priv->pending_index_roots->data;
+
+		priv->pending_index_roots =
+			g_list_delete_link (priv->pending_index_roots,
+			                    priv->pending_index_roots);
+
+		if (data->flags & TRACKER_DIRECTORY_FLAG_PRIORITY)
+			g_queue_push_head (&priv->active_roots, data);
+		else
+			g_queue_push_tail (&priv->active_roots, data);
+	}
+
+	if (!g_queue_is_empty (&priv->active_roots)) {
 		return notifier_query_root_contents (notifier);
 	} else {
 		g_signal_emit (notifier, signals[FINISHED], 0);
@@ -319,6 +392,30 @@ notifier_check_next_root (TrackerFileNotifier *notifier)
 	}
 }
 
+/* Roots take turns crawling a directory each, so the ones
+ * with little to crawl do not wait for larger ones to finish.
+ */
+static void
+notifier_crawl_next_turn (TrackerFileNotifier *notifier)
+{
+	TrackerFileNotifierPrivate *priv;
+
+	priv = tracker_file_notifier_get_instance_private (notifier);
+
+	if (!priv->high_water && priv->rate_limit_id == 0 &&
+	    !g_queue_is_empty (priv->current_index_root->pending_dirs) &&
+	    (!g_queue_is_empty (&priv->active_roots) ||
+	     priv->pending_index_roots)) {
+		g_queue_push_tail (&priv->active_roots, priv->current_index_root);
+		priv->current_index_root = NULL;
+		notifier_check_next_root (notifier);
+		return;
+	}
+
+	if (!crawl_directory_in_current_root (notifier))
+		finish_current_directory (notifier, FALSE);
+}
+
 static void
 file_notifier_traverse_tree (TrackerFileNotifier *notifier)
 {
@@ -328,9 +425,13 @@ file_notifier_traverse_tree (TrackerFileNotifier *notifier)
 	priv = tracker_file_notifier_get_instance_private (notifier);
 	g_assert (priv->current_index_root != NULL);
 
-	while ((data = g_queue_pop_tail (&priv->queue)) != NULL) {
+	file_notifier_resolve_moves (notifier);
+	g_hash_table_remove_all (priv->current_index_root->store_ids);
+	g_hash_table_remove_all (priv->current_index_root->store_children);
+
+	while ((data = g_queue_pop_tail (&priv->current_index_root->queue)) != NULL) {
 		file_notifier_notify (data->file, data, notifier);
-		g_hash_table_remove (priv->cache, data->file);
+		g_hash_table_remove (priv->current_index_root->cache, data->file);
 	}
 }
 
@@ -366,8 +467,11 @@ static void
 file_data_free (TrackerFileData *file_data)
 {
 	g_object_unref (file_data->file);
+	g_clear_object (&file_data->move_source);
+	g_clear_object (&file_data->store_parent);
 	g_free (file_data->extractor_hash);
 	g_free (file_data->mimetype);
+	g_free (file_data->content_id);
 	g_slice_free (TrackerFileData, file_data);
 }
 
@@ -380,14 +484,14 @@ ensure_file_data (TrackerFileNotifier *notifier,
 
 	priv = tracker_file_notifier_get_instance_private (notifier);
 
-	file_data = g_hash_table_lookup (priv->cache, file);
+	file_data = g_hash_table_lookup (priv->current_index_root->cache, file);
 	if (!file_data) {
 		file_data = g_slice_new0 (TrackerFileData);
 		file_data->file = g_object_ref (file);
-		g_hash_table_insert (priv->cache, file_data->file, file_data);
+		g_hash_table_insert (priv->current_index_root->cache, file_data->file, file_data);
 		file_data->node = g_list_alloc ();
 		file_data->node->data = file_data;
-		g_queue_push_head_link (&priv->queue, file_data->node);
+		g_queue_push_head_link (&priv->current_index_root->queue, file_data->node);
 	}
 
 	return file_data;
@@ -410,6 +514,245 @@ _insert_disk_info (TrackerFileNotifier *notifier,
 	return file_data;
 }
 
+static void
+file_notifier_add_store_child (TrackerFileNotifier *notifier,
+                               TrackerFileData     *file_data,
+                               GFile               *parent)
+{
+	TrackerFileNotifierPrivate *priv;
+	GList *children = NULL;
+	GFile *key;
+
+	priv = tracker_file_notifier_get_instance_private (notifier);
+
+	if (!parent)
+		return;
+
+	g_set_object (&file_data->store_parent, parent);
+
+	/* Take the list out, replacing it would free the tail
+	 * of the one prepended to.
+	 */
+	if (!g_hash_table_steal_extended (priv->current_index_root->store_children, parent,
+	                                  (gpointer *) &key, (gpointer *) &children))
+		key = g_object_ref (parent);
+
+	children = g_list_prepend (children, file_data);
+	g_hash_table_insert (priv->current_index_root->store_children, key, children);
+}
+
+static void
+file_notifier_remove_store_child (TrackerFileNotifier *notifier,
+                                  TrackerFileData     *file_data)
+{
+	TrackerFileNotifierPrivate *priv;
+	GList *children;
+	GFile *key;
+
+	priv = tracker_file_notifier_get_instance_private (notifier);
+
+	if (!file_data->store_parent)
+		return;
+
+	if (g_hash_table_steal_extended (priv->current_index_root->store_children, file_data->store_parent,
+	                                 (gpointer *) &key, (gpointer *) &children)) {
+		children = g_list_remove (children, file_data);
+
+		if (children)
+			g_hash_table_insert (priv->current_index_root->store_children, key, children);
+		else
+			g_object_unref (key);
+	}
+
+	g_clear_object (&file_data->store_parent);
+}
+
+static void
+file_notifier_forget_file_data (TrackerFileNotifier *notifier,
+                                TrackerFileData     *file_data)
+{
+	TrackerFileNotifierPrivate *priv;
+
+	priv = tracker_file_notifier_get_instance_private (notifier);
+
+	file_notifier_remove_store_child (notifier, file_data);
+
+	if (file_data->content_id &&
+	    g_hash_table_lookup (priv->current_index_root->store_ids, file_data->content_id) == file_data)
+		g_hash_table_remove (priv->current_index_root->store_ids, file_data->content_id);
+
+	g_queue_delete_link (&priv->current_index_root->queue, file_data->node);
+	g_hash_table_remove (priv->current_index_root->cache, file_data->file);
+}
+
+static void
+file_data_take_store_info (TrackerFileData *dest,
+                           TrackerFileData *source)
+{
+	dest->in_store = source->in_store;
+	dest->is_dir_in_store = source->is_dir_in_store;
+	dest->store_mtime = source->store_mtime;
+	g_free (dest->extractor_hash);
+	dest->extractor_hash = g_steal_pointer (&source->extractor_hash);
+	g_free (dest->mimetype);
+	dest->mimetype = g_steal_pointer (&source->mimetype);
+	update_state (dest);
+}
+
+static void
+file_notifier_move_store_children (TrackerFileNotifier *notifier,
+                                   GFile               *source,
+                                   GFile               *dest)
+{
+	TrackerFileNotifierPrivate *priv;
+	TrackerFileData *file_data, *existing;
+	GList *children = NULL, *remaining = NULL, *l;
+	GFile *key;
+
+	priv = tracker_file_notifier_get_instance_private (notifier);
+
+	/* Store entries below the moved directory now live below
+	 * the destination, re-key them so the crawl of the new
+	 * location finds them as already known.
+	 */
+	if (!g_hash_table_steal_extended (priv->current_index_root->store_children, source,
+	                                  (gpointer *) &key, (gpointer *) &children))
+		return;
+
+	for (l = children; l; l = l->next) {
+		GFile *old_file;
+		gchar *basename;
+
+		file_data = l->data;
+
+		if (!file_data->in_store || file_data->in_disk) {
+			remaining = g_list_prepend (remaining, file_data);
+			continue;
+		}
+
+		g_hash_table_steal (priv->current_index_root->cache, file_data->file);
+		g_clear_object (&file_data->store_parent);
+
+		old_file = file_data->file;
+		basename = g_file_get_basename (old_file);
+		file_data->file = g_file_get_child (dest, basename);
+		g_free (basename);
+
+		if (file_data->is_dir_in_store)
+			file_notifier_move_store_children (notifier, old_file, file_data->file);
+
+		g_object_unref (old_file);
+
+		existing = g_hash_table_lookup (priv->current_index_root->cache, file_data->file);
+
+		if (existing && existing->in_disk) {
+			/* Already known at the destination, drop the stale entry */
+			if (file_data->content_id &&
+			    g_hash_table_lookup (priv->current_index_root->store_ids, file_data->content_id) == file_data)
+				g_hash_table_remove (priv->current_index_root->store_ids, file_data->content_id);
+			g_queue_delete_link (&priv->current_index_root->queue, file_data->node);
+			file_data_free (file_data);
+			continue;
+		} else if (existing) {
+			file_notifier_forget_file_data (notifier, existing);
+		}
+
+		g_hash_table_insert (priv->current_index_root->cache, file_data->file, file_data);
+		file_notifier_add_store_child (notifier, file_data, dest);
+	}
+
+	if (remaining)
+		g_hash_table_insert (priv->current_index_root->store_children, key, remaining);
+	else
+		g_object_unref (key);
+
+	g_list_free (children);
+}
+
+/* Matches a file that is new on disk against store entries
+ * that were not found (yet) in the current root. Directories
+ * are handled right away, so their contents are found as
+ * moved along. Files are only resolved after the root was
+ * fully crawled, when it is known that the original location
+ * really vanished.
+ */
+static gboolean
+file_notifier_check_moved (TrackerFileNotifier *notifier,
+                           TrackerFileData     *file_data,
+                           GFileInfo           *file_info)
+{
+	TrackerFileNotifierPrivate *priv;
+	TrackerFileData *source_data;
+	gchar *content_id;
+
+	priv = tracker_file_notifier_get_instance_private (notifier);
+
+	if (file_data->state != FILE_STATE_CREATE ||
+	    g_hash_table_size (priv->current_index_root->store_ids) == 0)
+		return FALSE;
+	if (!g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_UNIX_INODE) ||
+	    g_file_info_get_attribute_boolean (file_info, G_FILE_ATTRIBUTE_UNIX_IS_MOUNTPOINT))
+		return FALSE;
+
+	content_id = tracker_file_get_content_identifier (file_data->file, file_info, NULL);
+	if (!content_id)
+		return FALSE;
+
+	source_data = g_hash_table_lookup (priv->current_index_root->store_ids, content_id);
+	g_free (content_id);
+
+	if (!source_data || source_data->in_disk ||
+	    source_data->is_dir_in_store != file_data->is_dir_in_disk)
+		return FALSE;
+
+	if (file_data->is_dir_in_disk) {
+		GFile *source;
+
+		source = g_object_ref (source_data->file);
+		g_signal_emit (notifier, signals[FILE_MOVED], 0,
+		               source, file_data->file, TRUE);
+
+		file_data_take_store_info (file_data, source_data);
+		file_notifier_forget_file_data (notifier, source_data);
+		file_notifier_move_store_children (notifier, source, file_data->file);
+		priv->current_index_root->files_moved++;
+		g_object_unref (source);
+	} else {
+		file_data->move_source = g_object_ref (source_data->file);
+		priv->current_index_root->moved_files =
+			g_list_prepend (priv->current_index_root->moved_files, file_data);
+	}
+
+	return TRUE;
+}
+
+static void
+file_notifier_resolve_moves (TrackerFileNotifier *notifier)
+{
+	TrackerFileNotifierPrivate *priv;
+	TrackerFileData *file_data, *source_data;
+	GList *l;
+
+	priv = tracker_file_notifier_get_instance_private (notifier);
+
+	for (l = priv->current_index_root->moved_files; l; l = l->next) {
+		file_data = l->data;
+		source_data = g_hash_table_lookup (priv->current_index_root->cache, file_data->move_source);
+
+		if (source_data && source_data->in_store && !source_data->in_disk) {
+			g_signal_emit (notifier, signals[FILE_MOVED], 0,
+			               source_data->file, file_data->file, FALSE);
+			file_data_take_store_info (file_data, source_data);
+			file_notifier_forget_file_data (notifier, source_data);
+			priv->current_index_root->files_moved++;
+		}
+
+		g_clear_object (&file_data->move_source);
+	}
+
+	g_clear_pointer (&priv->current_index_root->moved_files, g_list_free);
+}
+
 static gboolean
 file_notifier_add_node_foreach (GNode    *node,
                                 gpointer  user_data)
@@ -453,13 +796,23 @@ file_notifier_add_node_foreach (GNode    *node,
 			                   g_object_ref (file));
 		}
 
+		if (file_notifier_check_moved (notifier, file_data, file_info) &&
+		    file_data->move_source != NULL) {
+			/* Resolved after crawling the whole root */
+			return FALSE;
+		}
+
 		g_object_ref (file);
-		g_queue_delete_link (&priv->queue, file_data->node);
 
-		if (file_data->state != FILE_STATE_NONE)
+		if (file_data->state != FILE_STATE_NONE) {
 			file_notifier_notify (file, file_data, notifier);
+		} else if (TRACKER_DEBUG_CHECK (STATISTICS) &&
+		           tracker_file_info_needs_sniffing (file, file_info)) {
+			/* Unchanged, its content type is never sniffed */
+			priv->current_index_root->files_unsniffed++;
+		}
 
-		g_hash_table_remove (priv->cache, file);
+		file_notifier_forget_file_data (notifier, file_data);
 		g_object_unref (file);
 	}
 
@@ -506,8 +859,8 @@ crawler_get_cb (TrackerCrawler *crawler,
 			g_free (uri);
 		}
 
-		if (!interrupted && !crawl_directory_in_current_root (notifier))
-			finish_current_directory (notifier, FALSE);
+		if (!interrupted)
+			notifier_crawl_next_turn (notifier);
 
 		g_clear_error (&error);
 		return;
@@ -525,8 +878,13 @@ crawler_get_cb (TrackerCrawler *crawler,
 	priv->current_index_root->files_found += files_found;
 	priv->current_index_root->files_ignored += files_ignored;
 
-	if (!crawl_directory_in_current_root (notifier))
-		finish_current_directory (notifier, FALSE);
+	/* Every crawled file was stat'ed */
+	tracker_rate_limiter_consume (tracker_rate_limiter_get_default (),
+	                              directories_found + directories_ignored +
+	                              files_found + files_ignored,
+	                              0);
+
+	notifier_crawl_next_turn (notifier);
 }
 
 static void
@@ -535,17 +893,51 @@ _insert_store_info (TrackerFileNotifier *notifier,
                     GFileType            file_type,
                     const gchar         *extractor_hash,
                     const gchar         *mimetype,
+                    const gchar         *content_id,
                     guint64              _time)
 {
+	TrackerFileNotifierPrivate *priv;
 	TrackerFileData *file_data;
 
+	priv = tracker_file_notifier_get_instance_private (notifier);
+
 	file_data = ensure_file_data (notifier, file);
+
+	if (!file_data->store_parent) {
+		GFile *parent;
+
+		parent = g_file_get_parent (file);
+		file_notifier_add_store_child (notifier, file_data, parent);
+		g_clear_object (&parent);
+	}
+
 	file_data->in_store = TRUE;
 	file_data->is_dir_in_store = file_type == G_FILE_TYPE_DIRECTORY;
 	file_data->extractor_hash = g_strdup (extractor_hash);
 	file_data->mimetype = g_strdup (mimetype);
 	file_data->store_mtime = _time;
 	update_state (file_data);
+
+	if (!file_data->content_id &&
+	    content_id && g_str_has_prefix (content_id, "urn:fileid:")) {
+		file_data->content_id = g_strdup (content_id);
+		g_hash_table_replace (priv->current_index_root->store_ids, file_data->content_id, file_data);
+	}
+}
+
+static gboolean
+rate_limit_resume_cb (gpointer user_data)
+{
+	TrackerFileNotifier *notifier = user_data;
+	TrackerFileNotifierPrivate *priv;
+
+	priv = tracker_file_notifier_get_instance_private (notifier);
+	priv->rate_limit_id = 0;
+
+	if (!crawl_directory_in_current_root (notifier))
+		finish_current_directory (notifier, FALSE);
+
+	return G_SOURCE_REMOVE;
 }
 
 static gboolean
@@ -553,9 +945,13 @@ crawl_directory_in_current_root (TrackerFileNotifier *notifier)
 {
 	TrackerFileNotifierPrivate *priv;
 	GFile *directory;
+	gint64 delay;
 
 	priv = tracker_file_notifier_get_instance_private (notifier);
 
+	if (priv->rate_limit_id != 0)
+		return TRUE;
+
 	if (priv->high_water) {
 		priv->active = FALSE;
 		return TRUE;
@@ -564,6 +960,17 @@ crawl_directory_in_current_root (TrackerFileNotifier *notifier)
 	if (!priv->current_index_root)
 		return FALSE;
 
+	delay = tracker_rate_limiter_get_delay (tracker_rate_limiter_get_default ());
+
+	if (delay > 0 &&
+	    !g_queue_is_empty (priv->current_index_root->pending_dirs)) {
+		/* Over the I/O budget, resume once there is room */
+		priv->rate_limit_id = g_timeout_add (delay / 1000 + 1,
+		                                     rate_limit_resume_cb,
+		                                     notifier);
+		return TRUE;
+	}
+
 	while (!g_queue_is_empty (priv->current_index_root->pending_dirs)) {
 		TrackerDirectoryFlags flags;
 
@@ -601,8 +1008,11 @@ finish_current_directory (TrackerFileNotifier *notifier,
 	priv = tracker_file_notifier_get_instance_private (notifier);
 
 	if (interrupted) {
-		g_queue_clear (&priv->queue);
-		g_hash_table_remove_all (priv->cache);
+		g_clear_pointer (&priv->current_index_root->moved_files, g_list_free);
+		g_hash_table_remove_all (priv->current_index_root->store_ids);
+		g_hash_table_remove_all (priv->current_index_root->store_children);
+		g_queue_clear (&priv->current_index_root->queue);
+		g_hash_table_remove_all (priv->current_index_root->cache);
 	} else {
 		file_notifier_traverse_tree (notifier);
 	}
@@ -621,7 +1031,7 @@ finish_current_directory (TrackerFileNotifier *notifier,
 
 		TRACKER_NOTE (STATISTICS,
 		              g_message ("  Notified files after %2.2f seconds",
-		                         g_timer_elapsed (priv->timer, NULL)));
+		                         g_timer_elapsed (priv->current_index_root->timer, NULL)));
 		TRACKER_NOTE (STATISTICS,
 		              g_message ("  Found %d directories, ignored %d directories",
 		                        priv->current_index_root->directories_found,
@@ -630,6 +1040,12 @@ finish_current_directory (TrackerFileNotifier *notifier,
 		              g_message ("  Found %d files, ignored %d files",
 		                         priv->current_index_root->files_found,
 		                         priv->current_index_root->files_ignored));
+		TRACKER_NOTE (STATISTICS,
+		              g_message ("  Found %d files moved while not running",
+		                         priv->current_index_root->files_moved));
+		TRACKER_NOTE (STATISTICS,
+		              g_message ("  Skipped sniffing %d unchanged files",
+		                         priv->current_index_root->files_unsniffed));
 
 		if (!interrupted) {
 			g_clear_pointer (&priv->current_index_root, root_data_free);
@@ -658,8 +1074,9 @@ root_data_remove_directory (RootData *data,
 		l = next;
 	}
 
-	return (g_file_equal (data->current_dir, directory) ||
-		g_file_has_prefix (data->current_dir, directory));
+	return (data->current_dir &&
+	        (g_file_equal (data->current_dir, directory) ||
+	         g_file_has_prefix (data->current_dir, directory)));
 }
 
 static void
@@ -667,9 +1084,13 @@ file_notifier_current_root_check_remove_directory (TrackerFileNotifier *notifier
 						   GFile               *file)
 {
 	TrackerFileNotifierPrivate *priv;
+	GList *l;
 
 	priv = tracker_file_notifier_get_instance_private (notifier);
 
+	for (l = priv->active_roots.head; l; l = l->next)
+		root_data_remove_directory (l->data, file);
+
 	if (priv->current_index_root &&
 	    root_data_remove_directory (priv->current_index_root, file)) {
 		g_cancellable_cancel (priv->cancellable);
@@ -692,7 +1113,7 @@ sparql_contents_ensure_statement (TrackerFileNotifier  *notifier,
 
 	priv->content_query =
 		tracker_sparql_connection_query_statement (priv->connection,
-		                                           "SELECT ?uri ?folderUrn ?lastModified ?hash nie:mimeType(?ie) "
+		                                           "SELECT ?uri ?folderUrn ?lastModified ?hash nie:mimeType(?ie) ?ie "
 		                                           "{"
 		                                           "  GRAPH tracker:FileSystem {"
 		                                           "    ?uri a nfo:FileDataObject ;"
@@ -792,6 +1213,7 @@ query_execute_cb (TrackerSparqlStatement *statement,
 		                    file_type,
 		                    tracker_sparql_cursor_get_string (cursor, 3, NULL),
 		                    tracker_sparql_cursor_get_string (cursor, 4, NULL),
+		                    tracker_sparql_cursor_get_string (cursor, 5, NULL),
 		                    _time);
 
 		g_object_unref (file);
@@ -818,7 +1240,7 @@ notifier_query_root_contents (TrackerFileNotifier *notifier)
 		return FALSE;
 	}
 
-	if (!priv->pending_index_roots) {
+	if (g_queue_is_empty (&priv->active_roots)) {
 		return FALSE;
 	}
 
@@ -834,9 +1256,15 @@ notifier_query_root_contents (TrackerFileNotifier *notifier)
 		g_object_unref (priv->cancellable);
 	priv->cancellable = g_cancellable_new ();
 
-	priv->current_index_root = priv->pending_index_roots->data;
-	priv->pending_index_roots = g_list_delete_link (priv->pending_index_roots,
-	                                                priv->pending_index_roots);
+	priv->current_index_root = g_queue_pop_head (&priv->active_roots);
+
+	if (priv->current_index_root->contents_queried) {
+		/* Its turn again, carry on crawling */
+		if (!crawl_directory_in_current_root (notifier))
+			finish_current_directory (notifier, FALSE);
+		return TRUE;
+	}
+
 	directory = priv->current_index_root->root;
 	flags = priv->current_index_root->flags;
 	uri = g_file_get_uri (directory);
@@ -852,7 +1280,8 @@ notifier_query_root_contents (TrackerFileNotifier *notifier)
 		return TRUE;
 	}
 
-	g_timer_reset (priv->timer);
+	priv->current_index_root->contents_queried = TRUE;
+	g_timer_reset (priv->current_index_root->timer);
 	g_signal_emit (notifier, signals[DIRECTORY_STARTED], 0, directory);
 
 	priv = tracker_file_notifier_get_instance_private (notifier);
@@ -894,7 +1323,9 @@ notifier_queue_root (TrackerFileNotifier   *notifier,
 		return;
 
 	if (g_list_find_custom (priv->pending_index_roots, file,
-	                        (GCompareFunc) find_directory_root))
+	                        (GCompareFunc) find_directory_root) ||
+	    g_queue_find_custom (&priv->active_roots, file,
+	                         (GCompareFunc) find_directory_root))
 		return;
 
 	data = root_data_new (notifier, file, flags, ignore_root);
@@ -961,7 +1392,7 @@ monitor_item_created_cb (TrackerMonitor *monitor,
 				/* New file triggered a directory content
 				 * filter, remove parent directory altogether
 				 */
-				g_signal_emit (notifier, signals[FILE_DELETED], 0, parent, TRUE);
+				g_signal_emit (notifier, signals[FILE_DELETED], quark_monitor_event, parent, TRUE);
 				file_notifier_current_root_check_remove_directory (notifier, parent);
 
 				tracker_monitor_remove_recursively (priv->monitor, parent);
@@ -995,7 +1426,7 @@ monitor_item_created_cb (TrackerMonitor *monitor,
 		}
 	}
 
-	g_signal_emit (notifier, signals[FILE_CREATED], 0, file, NULL);
+	g_signal_emit (notifier, signals[FILE_CREATED], quark_monitor_event, file, NULL);
 }
 
 static void
@@ -1015,7 +1446,7 @@ monitor_item_updated_cb (TrackerMonitor *monitor,
 		return;
 	}
 
-	g_signal_emit (notifier, signals[FILE_UPDATED], 0, file, NULL, FALSE);
+	g_signal_emit (notifier, signals[FILE_UPDATED], quark_monitor_event, file, NULL, FALSE);
 }
 
 static void
@@ -1035,7 +1466,7 @@ monitor_item_attribute_updated_cb (TrackerMonitor *monitor,
 		return;
 	}
 
-	g_signal_emit (notifier, signals[FILE_UPDATED], 0, file, NULL, TRUE);
+	g_signal_emit (notifier, signals[FILE_UPDATED], quark_monitor_event, file, NULL, TRUE);
 }
 
 static void
@@ -1121,7 +1552,7 @@ monitor_item_deleted_cb (TrackerMonitor *monitor,
 		return ;
 	}
 
-	g_signal_emit (notifier, signals[FILE_DELETED], 0, file, is_directory);
+	g_signal_emit (notifier, signals[FILE_DELETED], quark_monitor_event, file, is_directory);
 
 	file_notifier_current_root_check_remove_directory (notifier, file);
 }
@@ -1219,7 +1650,7 @@ monitor_item_moved_cb (TrackerMonitor *monitor,
 
 				/* Source file was not stored, check dest file as new */
 				if (!is_directory || !dest_is_recursive) {
-					g_signal_emit (notifier, signals[FILE_CREATED], 0, other_file, NULL);
+					g_signal_emit (notifier, signals[FILE_CREATED], quark_monitor_event, other_file, NULL);
 				} else if (is_directory) {
 					/* Crawl dest directory */
 					notifier_queue_root (notifier, other_file, flags, FALSE);
@@ -1233,7 +1664,7 @@ monitor_item_moved_cb (TrackerMonitor *monitor,
 				                                    file);
 			}
 
-			g_signal_emit (notifier, signals[FILE_DELETED], 0, file, is_directory);
+			g_signal_emit (notifier, signals[FILE_DELETED], quark_monitor_event, file, is_directory);
 			file_notifier_current_root_check_remove_directory (notifier, file);
 		} else {
 			/* Handle move */
@@ -1261,10 +1692,10 @@ monitor_item_moved_cb (TrackerMonitor *monitor,
 				}
 			}
 
-			g_signal_emit (notifier, signals[FILE_MOVED], 0, file, other_file, is_directory);
+			g_signal_emit (notifier, signals[FILE_MOVED], quark_monitor_event, file, other_file, is_directory);
 
 			if (extension_changed (file, other_file))
-				g_signal_emit (notifier, signals[FILE_UPDATED], 0, other_file, NULL, FALSE);
+				g_signal_emit (notifier, signals[FILE_UPDATED], quark_monitor_event, other_file, NULL, FALSE);
 		}
 
 		g_object_unref (other_file);
@@ -1353,6 +1784,14 @@ indexing_tree_directory_removed (TrackerIndexingTree *indexing_tree,
 			g_list_delete_link (priv->pending_index_roots, elem);
 	}
 
+	elem = g_queue_find_custom (&priv->active_roots, directory,
+	                            (GCompareFunc) find_directory_root);
+
+	if (elem) {
+		root_data_free (elem->data);
+		g_queue_delete_link (&priv->active_roots, elem);
+	}
+
 	if (priv->current_index_root &&
 	    g_file_equal (directory, priv->current_index_root->root)) {
 		/* Directory being currently processed */
@@ -1411,8 +1850,12 @@ tracker_file_notifier_finalize (GObject *object)
 
 	priv = tracker_file_notifier_get_instance_private (TRACKER_FILE_NOTIFIER (object));
 
-	g_queue_clear (&priv->queue);
-	g_hash_table_destroy (priv->cache);
+	tracker_memory_budget_unregister (tracker_memory_budget_get_default (),
+	                                  priv->budget_id);
+
+	if (priv->rate_limit_id)
+		g_source_remove (priv->rate_limit_id);
+
 	g_free (priv->file_attributes);
 
 	if (priv->indexing_tree) {
@@ -1440,9 +1883,9 @@ tracker_file_notifier_finalize (GObject *object)
 
 	g_clear_pointer (&priv->current_index_root, root_data_free);
 
+	g_queue_clear_full (&priv->active_roots, (GDestroyNotify) root_data_free);
 	g_list_foreach (priv->pending_index_roots, (GFunc) root_data_free, NULL);
 	g_list_free (priv->pending_index_roots);
-	g_timer_destroy (priv->timer);
 
 	G_OBJECT_CLASS (tracker_file_notifier_parent_class)->finalize (object);
 }
@@ -1574,7 +2017,7 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	signals[FILE_CREATED] =
 		g_signal_new ("file-created",
 		              G_TYPE_FROM_CLASS (klass),
-		              G_SIGNAL_RUN_LAST,
+		              G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
 		              G_STRUCT_OFFSET (TrackerFileNotifierClass,
 		                               file_created),
 		              NULL, NULL,
@@ -1584,7 +2027,7 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	signals[FILE_UPDATED] =
 		g_signal_new ("file-updated",
 		              G_TYPE_FROM_CLASS (klass),
-		              G_SIGNAL_RUN_LAST,
+		              G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
 		              G_STRUCT_OFFSET (TrackerFileNotifierClass,
 		                               file_updated),
 		              NULL, NULL,
@@ -1594,7 +2037,7 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	signals[FILE_DELETED] =
 		g_signal_new ("file-deleted",
 		              G_TYPE_FROM_CLASS (klass),
-		              G_SIGNAL_RUN_LAST,
+		              G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
 		              G_STRUCT_OFFSET (TrackerFileNotifierClass,
 		                               file_deleted),
 		              NULL, NULL,
@@ -1604,7 +2047,7 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	signals[FILE_MOVED] =
 		g_signal_new ("file-moved",
 		              G_TYPE_FROM_CLASS (klass),
-		              G_SIGNAL_RUN_LAST,
+		              G_SIGNAL_RUN_LAST | G_SIGNAL_DETAILED,
 		              G_STRUCT_OFFSET (TrackerFileNotifierClass,
 		                               file_moved),
 		              NULL, NULL,
@@ -1642,6 +2085,8 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 		              NULL,
 		              G_TYPE_NONE, 0, G_TYPE_NONE);
 
+	quark_monitor_event = g_quark_from_static_string (TRACKER_FILE_NOTIFIER_DETAIL_MONITOR);
+
 	g_object_class_install_property (object_class,
 	                                 PROP_INDEXING_TREE,
 	                                 g_param_spec_object ("indexing-tree",
@@ -1680,6 +2125,28 @@ tracker_file_notifier_class_init (TrackerFileNotifierClass *klass)
 	                                                      G_PARAM_STATIC_STRINGS));
 }
 
+static gsize
+report_memory_usage (gpointer user_data)
+{
+	TrackerFileNotifierPrivate *priv;
+	gsize n_files = 0;
+	GList *l;
+
+	priv = tracker_file_notifier_get_instance_private (user_data);
+
+	/* Queued files and store IDs point into the caches */
+	if (priv->current_index_root)
+		n_files += g_hash_table_size (priv->current_index_root->cache);
+
+	for (l = priv->active_roots.head; l; l = l->next) {
+		RootData *data = l->data;
+
+		n_files += g_hash_table_size (data->cache);
+	}
+
+	return n_files * ESTIMATED_FILE_DATA_SIZE;
+}
+
 static void
 tracker_file_notifier_init (TrackerFileNotifier *notifier)
 {
@@ -1687,7 +2154,6 @@ tracker_file_notifier_init (TrackerFileNotifier *notifier)
 	GError *error = NULL;
 
 	priv = tracker_file_notifier_get_instance_private (notifier);
-	priv->timer = g_timer_new ();
 	priv->stopped = TRUE;
 
 	/* Set up monitor */
@@ -1714,11 +2180,16 @@ tracker_file_notifier_init (TrackerFileNotifier *notifier)
 		                  notifier);
 	}
 
-	g_queue_init (&priv->queue);
-	priv->cache = g_hash_table_new_full (g_file_hash,
-	                                     (GEqualFunc) g_file_equal,
-	                                     NULL,
-	                                     (GDestroyNotify) file_data_free);
+	g_queue_init (&priv->active_roots);
+
+	/* The caches only hold the roots being crawled, so there
+	 * is nothing to shed, the miner pausing the crawl keeps them at bay.
+	 */
+	priv->budget_id =
+		tracker_memory_budget_register (tracker_memory_budget_get_default (),
+		                                "file-notifier",
+		                                report_memory_usage,
+		                                NULL, notifier);
 }
 
 TrackerFileNotifier *
@@ -1754,7 +2225,9 @@ tracker_file_notifier_set_high_water (TrackerFileNotifier *notifier,
 	if (!high_water && !priv->active &&
 	    tracker_file_notifier_is_active (notifier)) {
 		/* Maybe kick everything back into action */
-		if (!crawl_directory_in_current_root (notifier))
+		if (!priv->current_index_root)
+			notifier_check_next_root (notifier);
+		else if (!crawl_directory_in_current_root (notifier))
 			finish_current_directory (notifier, FALSE);
 	}
 }
@@ -1789,6 +2262,11 @@ tracker_file_notifier_stop (TrackerFileNotifier *notifier)
 		g_cancellable_cancel (priv->cancellable);
 		priv->stopped = TRUE;
 	}
+
+	if (priv->rate_limit_id) {
+		g_source_remove (priv->rate_limit_id);
+		priv->rate_limit_id = 0;
+	}
 }
 
 gboolean
@@ -1799,5 +2277,21 @@ tracker_file_notifier_is_active (TrackerFileNotifier *notifier)
 	g_return_val_if_fail (TRACKER_IS_FILE_NOTIFIER (notifier), FALSE);
 
 	priv = tracker_file_notifier_get_instance_private (notifier);
-	return priv->pending_index_roots || priv->current_index_root;
+	return (priv->pending_index_roots || priv->current_index_root ||
+	        !g_queue_is_empty (&priv->active_roots));
+}
+
+/* Whether the file-* signal currently being emitted originates
+ * from a monitor event, as opposed to crawling.
+ */
+gboolean
+tracker_file_notifier_is_monitor_event (TrackerFileNotifier *notifier)
+{
+	GSignalInvocationHint *hint;
+
+	g_return_val_if_fail (TRACKER_IS_FILE_NOTIFIER (notifier), FALSE);
+
+	hint = g_signal_get_invocation_hint (notifier);
+
+	return hint != NULL && hint->detail == quark_monitor_event;
 }
@@ -39,6 +39,9 @@ G_BEGIN_DECLS
 #define TRACKER_IS_FILE_NOTIFIER_CLASS(c)  (G_TYPE_CHECK_CLASS_TYPE ((c),    TRACKER_TYPE_FILE_NOTIFIER))
 #define TRACKER_FILE_NOTIFIER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o),  TRACKER_TYPE_FILE_NOTIFIER, TrackerFileNotifierClass))
 
+/* Signal detail for file-* signals emitted in reaction to monitor events */
+#define TRACKER_FILE_NOTIFIER_DETAIL_MONITOR "monitor"
+
 typedef struct _TrackerFileNotifier TrackerFileNotifier;
 typedef struct _TrackerFileNotifierClass TrackerFileNotifierClass;
 typedef enum _TrackerFileNotifierType TrackerFileNotifierType;
@@ -91,6 +94,8 @@ gboolean      tracker_file_notifier_is_active    (TrackerFileNotifier     *notif
 void          tracker_file_notifier_set_high_water (TrackerFileNotifier *notifier,
                                                     gboolean             high_water);
 
+gboolean      tracker_file_notifier_is_monitor_event (TrackerFileNotifier *notifier);
+
 G_END_DECLS
 
 #endif /* __TRACKER_FILE_NOTIFIER_H__ */
@@ -25,7 +25,7 @@
 #include "tracker-miner-fs.h"
 #include "tracker-monitor.h"
 #include "tracker-utils.h"
-#include "tracker-priority-queue.h"
+#include "tracker-fair-queue.h"
 #include "tracker-task-pool.h"
 #include "tracker-sparql-buffer.h"
 #include "tracker-file-notifier.h"
@@ -36,6 +36,11 @@
 #define DEFAULT_READY_POOL_LIMIT 1
 #define DEFAULT_URN_LRU_SIZE 100
 
+/* Rough per-item cost of queued events and cached URNs,
+ * used to account them in the memory budget.
+ */
+#define ESTIMATED_EVENT_SIZE 512
+
 /* Put tasks processing at a lower priority so other events
  * (timeouts, monitor events, etc...) are guaranteed to be
  * dispatched promptly.
@@ -44,6 +49,22 @@
 
 #define MAX_SIMULTANEOUS_ITEMS 64
 
+/* Monitor events and high priority checks go through a separate,
+ * small SPARQL buffer that is flushed after this many milliseconds,
+ * so they don't wait behind bulk crawling batches.
+ */
+#define FAST_LANE_FLUSH_TIMEOUT 100
+#define FAST_LANE_BUFFER_LIMIT 20
+
+/* Upper bounds (in ms) of the event-to-commit latency histogram
+ * buckets, the last bucket holds everything above.
+ */
+static const guint latency_buckets[] = {
+	10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, G_MAXUINT
+};
+
+#define N_LATENCY_BUCKETS G_N_ELEMENTS (latency_buckets)
+
 /**
  * SECTION:tracker-miner-fs
  * @short_description: Abstract base class for filesystem miners
@@ -91,12 +112,27 @@ typedef struct {
 	guint16 type;
 	guint attributes_update : 1;
 	guint is_dir : 1;
+	guint fast_lane : 1;
+	guint prepared : 1;
+	guint crawled : 1; /* Already charged to the rate limiter */
+	gint priority;
+	gint64 queued_time;
 	GFile *file;
 	GFile *dest_file;
 	GFileInfo *info;
+	GFile *queue_root;
 	GList *root_node;
+	GList *batch_node;
 } QueueEvent;
 
+typedef struct {
+	GQueue events;
+	GTask *task;
+	guint targets_set : 1;
+	guint commit_serial;
+	guint fast_commit_serial;
+} CheckFilesBatch;
+
 typedef struct {
 	GFile *file;
 	gchar *urn;
@@ -106,12 +142,26 @@ typedef struct {
 	TrackerTask *task;
 } UpdateProcessingTaskContext;
 
+typedef struct {
+	GFile *root;
+	guint n_holds;
+	GQueue events; /* Events set aside while held, in queue order */
+} HeldSubtree;
+
 struct _TrackerMinerFSPrivate {
-	TrackerPriorityQueue *items;
+	TrackerFairQueue *items;
 	GHashTable *items_by_file;
+	GHashTable *items_by_dest; /* Queued moves, by destination */
 
 	guint item_queues_handler_id;
 
+	/* Subtrees held through tracker_miner_fs_hold_subtree() */
+	GList *held_subtrees;
+
+	/* File info of the next item, queried ahead of processing */
+	GCancellable *prepare_cancellable;
+	guint content_types_sniffed;
+
 	/* Root / tree / index */
 	GFile *root;
 	TrackerIndexingTree *indexing_tree;
@@ -122,12 +172,31 @@ struct _TrackerMinerFSPrivate {
 	TrackerTaskPool *task_pool;
 	TrackerSparqlBuffer *sparql_buffer;
 	guint sparql_buffer_limit;
+	guint flush_serial;
+	guint limit_flush_id;
+
+	/* Low latency lane */
+	TrackerSparqlBuffer *fast_buffer;
+	guint fast_flush_id;
+	guint fast_flush_serial;
+
+	/* Event queue time of items pending commit, for latency stats */
+	GHashTable *pending_times;
+	guint latency_histogram[N_LATENCY_BUCKETS];
+	guint fast_latency_histogram[N_LATENCY_BUCKETS];
+
+	/* Pending tracker_miner_fs_check_files() requests */
+	GList *check_batches;
 
 	/* Folder URN cache */
 	TrackerLRU *urn_lru;
 
+	/* Memory budget registrations */
+	guint queue_budget_id;
+
 	/* Properties */
 	gdouble throttle;
+	gdouble pacing;
 	gchar *file_attributes;
 
 	/* Status */
@@ -140,6 +209,8 @@ struct _TrackerMinerFSPrivate {
 	guint shown_totals : 1;     /* TRUE if totals have been shown */
 	guint is_paused : 1;        /* TRUE if miner is paused */
 	guint flushing : 1;         /* TRUE if flushing SPARQL */
+	guint fast_flushing : 1;    /* TRUE if flushing the fast lane */
+	guint preparing : 1;        /* TRUE if querying file info */
 
 	guint timer_stopped : 1;    /* TRUE if main timer is stopped */
 	guint extraction_timer_stopped : 1; /* TRUE if the extraction
@@ -249,6 +320,8 @@ static void           task_pool_limit_reached_notify_cb       (GObject        *o
                                                                GParamSpec     *pspec,
                                                                gpointer        user_data);
 
+static void           memory_budget_set_up                (TrackerMinerFS       *fs);
+
 static GQuark quark_last_queue_event = 0;
 static GInitableIface* miner_fs_initable_parent_iface;
 static guint signals[LAST_SIGNAL] = { 0, };
@@ -438,9 +511,20 @@ tracker_miner_fs_init (TrackerMinerFS *object)
 	priv->timer_stopped = TRUE;
 	priv->extraction_timer_stopped = TRUE;
 
-	priv->items = tracker_priority_queue_new ();
+	priv->items = tracker_fair_queue_new (g_file_hash,
+	                                      (GEqualFunc) g_file_equal,
+	                                      g_object_ref,
+	                                      g_object_unref);
 	priv->items_by_file = g_hash_table_new (g_file_hash,
 	                                        (GEqualFunc) g_file_equal);
+	priv->items_by_dest = g_hash_table_new (g_file_hash,
+	                                        (GEqualFunc) g_file_equal);
+	priv->prepare_cancellable = g_cancellable_new ();
+
+	priv->pending_times = g_hash_table_new_full (g_file_hash,
+	                                             (GEqualFunc) g_file_equal,
+	                                             g_object_unref,
+	                                             g_free);
 
 	priv->roots_to_notify = g_hash_table_new_full (g_file_hash,
 	                                               (GEqualFunc) g_file_equal,
@@ -483,6 +567,9 @@ miner_fs_initable_init (GInitable     *initable,
 	                  G_CALLBACK (task_pool_limit_reached_notify_cb),
 	                  initable);
 
+	priv->fast_buffer = tracker_sparql_buffer_new (tracker_miner_get_connection (TRACKER_MINER (initable)),
+	                                               FAST_LANE_BUFFER_LIMIT);
+
 	if (!priv->indexing_tree) {
 		g_set_error (error,
 		             tracker_miner_fs_error_quark (),
@@ -531,6 +618,8 @@ miner_fs_initable_init (GInitable     *initable,
 	                  G_CALLBACK (file_notifier_finished),
 	                  initable);
 
+	memory_budget_set_up (TRACKER_MINER_FS (initable));
+
 	return TRUE;
 }
 
@@ -552,6 +641,7 @@ queue_event_new (TrackerMinerFSEventType  type,
 
 	event = g_new0 (QueueEvent, 1);
 	event->type = type;
+	event->queued_time = g_get_monotonic_time ();
 	g_set_object (&event->file, file);
 	g_set_object (&event->info, info);
 
@@ -567,6 +657,7 @@ queue_event_moved_new (GFile    *source,
 
 	event = g_new0 (QueueEvent, 1);
 	event->type = TRACKER_MINER_FS_EVENT_MOVED;
+	event->queued_time = g_get_monotonic_time ();
 	event->is_dir = !!is_dir;
 	g_set_object (&event->dest_file, dest);
 	g_set_object (&event->file, source);
@@ -584,12 +675,38 @@ queue_event_free (QueueEvent *event)
 		g_queue_delete_link (root_queue, event->root_node);
 	}
 
+	if (event->batch_node) {
+		CheckFilesBatch *batch;
+
+		batch = event->batch_node->data;
+		g_queue_delete_link (&batch->events, event->batch_node);
+	}
+
 	g_clear_object (&event->dest_file);
 	g_clear_object (&event->file);
 	g_clear_object (&event->info);
+	g_clear_object (&event->queue_root);
 	g_free (event);
 }
 
+static void
+queue_event_take_batch (QueueEvent *dest,
+                        QueueEvent *source)
+{
+	/* Keep the fast lane and check_files() requests tracking
+	 * on the event that survives coalescing.
+	 */
+	dest->fast_lane |= source->fast_lane;
+	dest->crawled |= source->crawled;
+	dest->queued_time = MIN (dest->queued_time, source->queued_time);
+
+	if (dest->batch_node || !source->batch_node)
+		return;
+
+	dest->batch_node = source->batch_node;
+	source->batch_node = NULL;
+}
+
 static QueueCoalesceAction
 queue_event_coalesce (const QueueEvent  *first,
 		      const QueueEvent  *second,
@@ -658,6 +775,43 @@ queue_event_is_equal_or_descendant (QueueEvent *event,
 		g_file_has_prefix (event->file, prefix));
 }
 
+static gboolean
+queue_event_is_under (QueueEvent *event,
+                      GFile      *root)
+{
+	if (queue_event_is_equal_or_descendant (event, root))
+		return TRUE;
+
+	return (event->dest_file &&
+	        (g_file_equal (event->dest_file, root) ||
+	         g_file_has_prefix (event->dest_file, root)));
+}
+
+static void
+held_subtree_free (HeldSubtree *subtree)
+{
+	g_queue_clear_full (&subtree->events, (GDestroyNotify) queue_event_free);
+	g_object_unref (subtree->root);
+	g_slice_free (HeldSubtree, subtree);
+}
+
+static HeldSubtree *
+held_subtree_lookup (TrackerMinerFS *fs,
+                     QueueEvent     *event)
+{
+	GList *l;
+
+	for (l = fs->priv->held_subtrees; l; l = l->next) {
+		HeldSubtree *subtree = l->data;
+
+		if (subtree->n_holds > 0 &&
+		    queue_event_is_under (event, subtree->root))
+			return subtree;
+	}
+
+	return NULL;
+}
+
 static void
 fs_finalize (GObject *object)
 {
@@ -668,6 +822,13 @@ fs_finalize (GObject *object)
 	g_timer_destroy (priv->timer);
 	g_timer_destroy (priv->extraction_timer);
 
+	if (priv->queue_budget_id) {
+		TrackerMemoryBudget *budget = tracker_memory_budget_get_default ();
+
+		g_signal_handlers_disconnect_by_data (budget, object);
+		tracker_memory_budget_unregister (budget, priv->queue_budget_id);
+	}
+
 	g_clear_pointer (&priv->urn_lru, tracker_lru_unref);
 
 	if (priv->item_queues_handler_id) {
@@ -679,15 +840,33 @@ fs_finalize (GObject *object)
 		tracker_file_notifier_stop (priv->file_notifier);
 	}
 
+	g_cancellable_cancel (priv->prepare_cancellable);
+	g_object_unref (priv->prepare_cancellable);
+
 	if (priv->sparql_buffer) {
 		g_object_unref (priv->sparql_buffer);
 	}
 
+	if (priv->fast_flush_id) {
+		g_source_remove (priv->fast_flush_id);
+		priv->fast_flush_id = 0;
+	}
+
+	if (priv->limit_flush_id) {
+		g_source_remove (priv->limit_flush_id);
+		priv->limit_flush_id = 0;
+	}
+
+	g_clear_object (&priv->fast_buffer);
+	g_hash_table_unref (priv->pending_times);
+
 	g_hash_table_unref (priv->items_by_file);
-	tracker_priority_queue_foreach (priv->items,
+	g_hash_table_unref (priv->items_by_dest);
+	g_list_free_full (priv->held_subtrees, (GDestroyNotify) held_subtree_free);
+	tracker_fair_queue_foreach (priv->items,
 					(GFunc) queue_event_free,
 					NULL);
-	tracker_priority_queue_unref (priv->items);
+	tracker_fair_queue_unref (priv->items);
 
 	g_object_unref (priv->root);
 
@@ -807,13 +986,40 @@ fs_get_property (GObject    *object,
 	}
 }
 
+static gboolean
+sparql_buffer_limit_flush_cb (gpointer user_data)
+{
+	TrackerMinerFS *fs = user_data;
+
+	fs->priv->limit_flush_id = 0;
+
+	if (!fs->priv->flushing &&
+	    tracker_task_pool_limit_reached (TRACKER_TASK_POOL (fs->priv->sparql_buffer)) &&
+	    tracker_sparql_buffer_flush (fs->priv->sparql_buffer,
+	                                 "SPARQL buffer limit reached",
+	                                 sparql_buffer_flush_cb,
+	                                 fs))
+		fs->priv->flushing = TRUE;
+
+	return G_SOURCE_REMOVE;
+}
+
 static void
 task_pool_limit_reached_notify_cb (GObject    *object,
 				   GParamSpec *pspec,
 				   gpointer    user_data)
 {
+	TrackerMinerFS *fs = TRACKER_MINER_FS (user_data);
+
 	if (!tracker_task_pool_limit_reached (TRACKER_TASK_POOL (object))) {
-		item_queue_handlers_set_up (TRACKER_MINER_FS (user_data));
+		item_queue_handlers_set_up (fs);
+	} else if (fs->priv->limit_flush_id == 0) {
+		/* Updates pushed by the implementation outside of event
+		 * handling, e.g. the chunks of a subtree move, fill the
+		 * buffer too. Flush once the current item is done.
+		 */
+		fs->priv->limit_flush_id =
+			g_idle_add (sparql_buffer_limit_flush_cb, fs);
 	}
 }
 
@@ -909,6 +1115,67 @@ notify_roots_finished (TrackerMinerFS *fs)
 	}
 }
 
+static guint
+lane_commit_serial (TrackerSparqlBuffer *buffer,
+                    guint                serial,
+                    gboolean             flushing)
+{
+	/* Anything pushed so far is committed by the next flush to
+	 * finish, or the one after it if there is a flush ongoing.
+	 */
+	if (tracker_task_pool_get_size (TRACKER_TASK_POOL (buffer)) == 0)
+		return serial + (flushing ? 1 : 0);
+
+	return serial + (flushing ? 2 : 1);
+}
+
+static void
+notify_check_files_finished (TrackerMinerFS *fs)
+{
+	TrackerMinerFSPrivate *priv = fs->priv;
+	GList *l, *next, *finished = NULL;
+
+	for (l = priv->check_batches; l; l = next) {
+		CheckFilesBatch *batch = l->data;
+
+		next = l->next;
+
+		if (!g_queue_is_empty (&batch->events))
+			continue;
+
+		if (!batch->targets_set) {
+			batch->commit_serial =
+				lane_commit_serial (priv->sparql_buffer,
+				                    priv->flush_serial,
+				                    priv->flushing);
+			batch->fast_commit_serial =
+				lane_commit_serial (priv->fast_buffer,
+				                    priv->fast_flush_serial,
+				                    priv->fast_flushing);
+			batch->targets_set = TRUE;
+		}
+
+		if (priv->flush_serial < batch->commit_serial ||
+		    priv->fast_flush_serial < batch->fast_commit_serial)
+			continue;
+
+		priv->check_batches = g_list_delete_link (priv->check_batches, l);
+		finished = g_list_prepend (finished, batch);
+	}
+
+	/* Return separately, so callbacks may queue further requests */
+	for (l = finished; l; l = l->next) {
+		CheckFilesBatch *batch = l->data;
+
+		if (!g_task_return_error_if_cancelled (batch->task))
+			g_task_return_boolean (batch->task, TRUE);
+		g_object_unref (batch->task);
+		g_slice_free (CheckFilesBatch, batch);
+	}
+
+	g_list_free (finished);
+}
+
 static void
 log_stats (TrackerMinerFS *fs)
 {
@@ -931,6 +1198,8 @@ log_stats (TrackerMinerFS *fs)
 			g_info ("Changes processed : %d (%d errors)",
 			        fs->priv->changes_processed,
 			        fs->priv->total_files_notified_error);
+			g_info ("Content sniffed   : %d files",
+			        fs->priv->content_types_sniffed);
 			g_info ("--------------------------------------------------\n");
 		}
 	}
@@ -975,6 +1244,10 @@ process_stop (TrackerMinerFS *fs)
 	fs->priv->total_files_ignored = 0;
 	fs->priv->changes_processed = 0;
 	fs->priv->total_files_notified_error = 0;
+	fs->priv->content_types_sniffed = 0;
+
+	/* Nothing is pending commit at this point */
+	g_hash_table_remove_all (fs->priv->pending_times);
 
 	fs->priv->been_crawled = TRUE;
 }
@@ -982,31 +1255,62 @@ process_stop (TrackerMinerFS *fs)
 static void
 check_notifier_high_water (TrackerMinerFS *fs)
 {
+	TrackerMemoryBudgetState state;
 	gboolean high_water;
+	guint limit;
 
 	/* If there is more than worth 2 batches left processing, we can tell
-	 * the notifier to stop a bit.
+	 * the notifier to stop a bit. If over the memory budget, stop it
+	 * with just one, so crawled files don't pile up in memory.
 	 */
-	high_water = (tracker_priority_queue_get_length (fs->priv->items) >
-	              2 * fs->priv->sparql_buffer_limit);
+	state = tracker_memory_budget_get_state (tracker_memory_budget_get_default ());
+	limit = fs->priv->sparql_buffer_limit;
+
+	if (state == TRACKER_MEMORY_BUDGET_OK)
+		limit *= 2;
+
+	high_water = tracker_fair_queue_get_length (fs->priv->items) > limit;
 	tracker_file_notifier_set_high_water (fs->priv->file_notifier, high_water);
 }
 
 static void
-sparql_buffer_flush_cb (GObject      *object,
-                        GAsyncResult *result,
-                        gpointer      user_data)
+record_commit_latency (TrackerMinerFS *fs,
+                       GFile          *file,
+                       gboolean        fast_lane)
+{
+	gint64 *queued_time;
+	guint *histogram;
+	guint i, latency;
+
+	queued_time = g_hash_table_lookup (fs->priv->pending_times, file);
+	if (!queued_time)
+		return;
+
+	latency = (guint) MIN ((g_get_monotonic_time () - *queued_time) / 1000,
+	                       G_MAXUINT);
+	histogram = fast_lane ?
+		fs->priv->fast_latency_histogram : fs->priv->latency_histogram;
+
+	for (i = 0; i < N_LATENCY_BUCKETS; i++) {
+		if (latency <= latency_buckets[i]) {
+			histogram[i]++;
+			break;
+		}
+	}
+
+	g_hash_table_remove (fs->priv->pending_times, file);
+}
+
+static void
+handle_flushed_tasks (TrackerMinerFS *fs,
+                      GPtrArray      *tasks,
+                      GError         *error,
+                      gboolean        fast_lane)
 {
-	TrackerMinerFS *fs = user_data;
-	GPtrArray *tasks;
-	GError *error = NULL;
 	TrackerTask *task;
 	GFile *task_file;
 	guint i;
 
-	tasks = tracker_sparql_buffer_flush_finish (TRACKER_SPARQL_BUFFER (object),
-	                                            result, &error);
-
 	if (error) {
 		g_warning ("Could not execute sparql: %s", error->message);
 	}
@@ -1025,7 +1329,25 @@ sparql_buffer_flush_cb (GObject      *object,
 		} else {
 			tracker_error_report_delete (task_file);
 		}
+
+		record_commit_latency (fs, task_file, fast_lane);
 	}
+}
+
+static void
+sparql_buffer_flush_cb (GObject      *object,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+	TrackerMinerFS *fs = user_data;
+	GPtrArray *tasks;
+	GError *error = NULL;
+
+	tasks = tracker_sparql_buffer_flush_finish (TRACKER_SPARQL_BUFFER (object),
+	                                            result, &error);
+	fs->priv->flush_serial++;
+
+	handle_flushed_tasks (fs, tasks, error, FALSE);
 
 	fs->priv->flushing = FALSE;
 
@@ -1040,19 +1362,213 @@ sparql_buffer_flush_cb (GObject      *object,
 		notify_roots_finished (fs);
 	}
 
+	notify_check_files_finished (fs);
+	check_notifier_high_water (fs);
+	item_queue_handlers_set_up (fs);
+
+	g_ptr_array_unref (tasks);
+	g_clear_error (&error);
+}
+
+static gsize
+report_queue_memory (gpointer user_data)
+{
+	TrackerMinerFS *fs = user_data;
+
+	return (tracker_fair_queue_get_length (fs->priv->items) +
+	        tracker_task_pool_get_size (TRACKER_TASK_POOL (fs->priv->sparql_buffer))) *
+		ESTIMATED_EVENT_SIZE;
+}
+
+static void
+shed_queue_memory (TrackerMemoryBudgetState state,
+                   gpointer                 user_data)
+{
+	TrackerMinerFS *fs = user_data;
+
+	/* Queued events are needed, but pending updates can be pushed
+	 * to the store early.
+	 */
+	if (!fs->priv->flushing &&
+	    tracker_sparql_buffer_flush (fs->priv->sparql_buffer,
+	                                 "Memory budget exceeded",
+	                                 sparql_buffer_flush_cb,
+	                                 fs))
+		fs->priv->flushing = TRUE;
+}
+
+static void
+memory_budget_state_notify_cb (GObject    *object,
+                               GParamSpec *pspec,
+                               gpointer    user_data)
+{
+	TrackerMinerFS *fs = user_data;
+
 	check_notifier_high_water (fs);
+}
+
+static void
+memory_budget_set_up (TrackerMinerFS *fs)
+{
+	TrackerMemoryBudget *budget = tracker_memory_budget_get_default ();
+
+	fs->priv->queue_budget_id =
+		tracker_memory_budget_register (budget, "miner-fs-queue",
+		                                report_queue_memory,
+		                                shed_queue_memory, fs);
+
+	g_signal_connect (budget, "notify::state",
+	                  G_CALLBACK (memory_budget_state_notify_cb), fs);
+}
+
+static void fast_lane_flush (TrackerMinerFS *fs,
+                             const gchar    *reason);
+
+static void
+fast_buffer_flush_cb (GObject      *object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+	TrackerMinerFS *fs = user_data;
+	GPtrArray *tasks;
+	GError *error = NULL;
+
+	tasks = tracker_sparql_buffer_flush_finish (TRACKER_SPARQL_BUFFER (object),
+	                                            result, &error);
+	fs->priv->fast_flush_serial++;
+	fs->priv->fast_flushing = FALSE;
+
+	handle_flushed_tasks (fs, tasks, error, TRUE);
+
+	/* Items pushed meanwhile go out right away */
+	if (tracker_task_pool_get_size (TRACKER_TASK_POOL (object)) > 0)
+		fast_lane_flush (fs, "Fast lane items pushed during flush");
+
+	notify_roots_finished (fs);
+	notify_check_files_finished (fs);
 	item_queue_handlers_set_up (fs);
 
 	g_ptr_array_unref (tasks);
 	g_clear_error (&error);
 }
 
+static void
+fast_lane_flush (TrackerMinerFS *fs,
+                 const gchar    *reason)
+{
+	if (fs->priv->fast_flush_id) {
+		g_source_remove (fs->priv->fast_flush_id);
+		fs->priv->fast_flush_id = 0;
+	}
+
+	if (fs->priv->fast_flushing)
+		return;
+
+	if (tracker_sparql_buffer_flush (fs->priv->fast_buffer, reason,
+	                                 fast_buffer_flush_cb, fs))
+		fs->priv->fast_flushing = TRUE;
+}
+
 static gboolean
-item_add_or_update (TrackerMinerFS *fs,
-                    GFile          *file,
-                    GFileInfo      *info,
-                    gboolean        attributes_update,
-                    gboolean        create)
+fast_lane_flush_timeout_cb (gpointer user_data)
+{
+	TrackerMinerFS *fs = user_data;
+
+	fs->priv->fast_flush_id = 0;
+	fast_lane_flush (fs, "Fast lane timeout");
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+fast_lane_schedule_flush (TrackerMinerFS *fs)
+{
+	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (fs->priv->fast_buffer))) {
+		fast_lane_flush (fs, "Fast lane limit reached");
+		return;
+	}
+
+	if (fs->priv->fast_flush_id != 0 || fs->priv->fast_flushing)
+		return;
+
+	if (tracker_task_pool_get_size (TRACKER_TASK_POOL (fs->priv->fast_buffer)) == 0)
+		return;
+
+	fs->priv->fast_flush_id =
+		g_timeout_add (FAST_LANE_FLUSH_TIMEOUT,
+		               fast_lane_flush_timeout_cb, fs);
+}
+
+static gboolean
+sparql_buffer_has_pending_ancestor (TrackerMinerFS      *fs,
+                                    TrackerSparqlBuffer *buffer,
+                                    GFile               *file)
+{
+	GFile *root, *current, *parent;
+	gboolean found = FALSE;
+
+	if (tracker_task_pool_get_size (TRACKER_TASK_POOL (buffer)) == 0)
+		return FALSE;
+
+	root = tracker_indexing_tree_get_root (fs->priv->indexing_tree,
+	                                       file, NULL);
+	current = g_object_ref (file);
+
+	while (current) {
+		if (tracker_sparql_buffer_get_state (buffer, current) != TRACKER_BUFFER_STATE_UNKNOWN) {
+			found = TRUE;
+			break;
+		}
+
+		if (!root || g_file_equal (current, root))
+			break;
+
+		parent = g_file_get_parent (current);
+		g_object_unref (current);
+		current = parent;
+	}
+
+	g_clear_object (&current);
+
+	return found;
+}
+
+static TrackerSparqlBuffer *
+miner_fs_get_buffer (TrackerMinerFS          *fs,
+                     GFile                   *file,
+                     TrackerMinerFSEventType  type,
+                     gboolean                 is_dir,
+                     gboolean                 fast_lane)
+{
+	TrackerMinerFSPrivate *priv = fs->priv;
+
+	/* Updates for a file must be committed in order, so stick to
+	 * the lane already holding pending changes for it.
+	 */
+	if (tracker_sparql_buffer_get_state (priv->fast_buffer, file) != TRACKER_BUFFER_STATE_UNKNOWN)
+		return priv->fast_buffer;
+
+	if (!fast_lane ||
+	    type == TRACKER_MINER_FS_EVENT_MOVED ||
+	    (type == TRACKER_MINER_FS_EVENT_DELETED && is_dir))
+		return priv->sparql_buffer;
+
+	/* A pending move, deletion or creation of a parent folder must
+	 * also be committed before anything happening inside it.
+	 */
+	if (sparql_buffer_has_pending_ancestor (fs, priv->sparql_buffer, file))
+		return priv->sparql_buffer;
+
+	return priv->fast_buffer;
+}
+
+static gboolean
+item_add_or_update (TrackerMinerFS      *fs,
+                    TrackerSparqlBuffer *buffer,
+                    GFile               *file,
+                    GFileInfo           *info,
+                    gboolean             attributes_update,
+                    gboolean             create)
 {
 	gchar *uri;
 
@@ -1072,12 +1588,11 @@ item_add_or_update (TrackerMinerFS *fs,
 	if (!attributes_update) {
 		TRACKER_NOTE (MINER_FS_EVENTS, g_message ("Processing file '%s'...", uri));
 		TRACKER_MINER_FS_GET_CLASS (fs)->process_file (fs, file, info,
-		                                               fs->priv->sparql_buffer,
-		                                               create);
+		                                               buffer, create);
 	} else {
 		TRACKER_NOTE (MINER_FS_EVENTS, g_message ("Processing attributes in file '%s'...", uri));
 		TRACKER_MINER_FS_GET_CLASS (fs)->process_file_attributes (fs, file, info,
-		                                                          fs->priv->sparql_buffer);
+		                                                          buffer);
 	}
 
 	g_free (uri);
@@ -1087,10 +1602,11 @@ item_add_or_update (TrackerMinerFS *fs,
 }
 
 static gboolean
-item_remove (TrackerMinerFS *fs,
-             GFile          *file,
-             gboolean        is_dir,
-             gboolean        only_children)
+item_remove (TrackerMinerFS      *fs,
+             TrackerSparqlBuffer *buffer,
+             GFile               *file,
+             gboolean             is_dir,
+             gboolean             only_children)
 {
 	gchar *uri;
 
@@ -1106,12 +1622,9 @@ item_remove (TrackerMinerFS *fs,
 
 	/* Call the implementation to generate a SPARQL update for the removal. */
 	if (only_children) {
-		TRACKER_MINER_FS_GET_CLASS (fs)->remove_children (fs, file,
-		                                                  fs->priv->sparql_buffer);
+		TRACKER_MINER_FS_GET_CLASS (fs)->remove_children (fs, file, buffer);
 	} else {
-		TRACKER_MINER_FS_GET_CLASS (fs)->remove_file (fs, file,
-		                                              fs->priv->sparql_buffer,
-		                                              is_dir);
+		TRACKER_MINER_FS_GET_CLASS (fs)->remove_file (fs, file, buffer, is_dir);
 	}
 
 	g_free (uri);
@@ -1144,7 +1657,7 @@ item_move (TrackerMinerFS *fs,
 
 	if (!is_dir) {
 		/* Delete destination item from store if any */
-		item_remove (fs, dest_file, is_dir, FALSE);
+		item_remove (fs, fs->priv->sparql_buffer, dest_file, is_dir, FALSE);
 	}
 
 	/* If the original location is recursive, but the destination location
@@ -1152,7 +1665,7 @@ item_move (TrackerMinerFS *fs,
 	 */
 	if (!recursive &&
 	    (source_flags & TRACKER_DIRECTORY_FLAG_RECURSE) != 0)
-		item_remove (fs, source_file, is_dir, TRUE);
+		item_remove (fs, fs->priv->sparql_buffer, source_file, is_dir, TRUE);
 
 	TRACKER_MINER_FS_GET_CLASS (fs)->move_file (fs, dest_file, source_file,
 	                                            fs->priv->sparql_buffer,
@@ -1169,6 +1682,13 @@ maybe_remove_file_event_node (TrackerMinerFS *fs,
 {
 	GList *link;
 
+	if (event->dest_file) {
+		link = g_hash_table_lookup (fs->priv->items_by_dest, event->dest_file);
+
+		if (link && link->data == event)
+			g_hash_table_remove (fs->priv->items_by_dest, event->dest_file);
+	}
+
 	link = g_hash_table_lookup (fs->priv->items_by_file, event->file);
 
 	if (link && link->data == event) {
@@ -1190,41 +1710,145 @@ remove_items_by_file_foreach (gpointer key,
 	return queue_event_is_equal_or_descendant (link->data, file);
 }
 
-static void
-item_queue_get_next_file (TrackerMinerFS           *fs,
-                          GFile                   **file,
-                          GFile                   **source_file,
-                          GFileInfo               **info,
-                          TrackerMinerFSEventType  *type,
-                          gboolean                 *attributes_update,
-                          gboolean                 *is_dir)
+/* Returns the next event to handle. Events set aside for subtrees
+ * that got released go first, events under held subtrees are set
+ * aside as they come up. @held_events is set to the queue holding
+ * the event if it was set aside.
+ */
+static QueueEvent *
+item_queue_peek (TrackerMinerFS  *fs,
+                 GQueue         **held_events)
 {
+	HeldSubtree *held;
 	QueueEvent *event;
+	GList *l, *next;
 
-	*file = NULL;
-	*source_file = NULL;
+	for (l = fs->priv->held_subtrees; l; l = next) {
+		HeldSubtree *subtree = l->data;
 
-	event = tracker_priority_queue_peek (fs->priv->items, NULL);
+		next = l->next;
 
-	if (event) {
-		if (event->type == TRACKER_MINER_FS_EVENT_MOVED) {
-			g_set_object (file, event->dest_file);
-			g_set_object (source_file, event->file);
-		} else {
+		if (subtree->n_holds > 0)
+			continue;
+
+		while ((event = g_queue_peek_head (&subtree->events)) != NULL) {
+			held = held_subtree_lookup (fs, event);
+
+			if (!held) {
+				if (held_events)
+					*held_events = &subtree->events;
+				return event;
+			}
+
+			/* Also under a subtree that is still held */
+			g_queue_push_tail (&held->events,
+			                   g_queue_pop_head (&subtree->events));
+		}
+
+		fs->priv->held_subtrees =
+			g_list_delete_link (fs->priv->held_subtrees, l);
+		held_subtree_free (subtree);
+	}
+
+	while ((event = tracker_fair_queue_peek (fs->priv->items, NULL)) != NULL) {
+		held = held_subtree_lookup (fs, event);
+
+		if (!held)
+			break;
+
+		/* Later events on the same files will follow it */
+		tracker_fair_queue_pop (fs->priv->items, NULL);
+		maybe_remove_file_event_node (fs, event);
+		g_queue_push_tail (&held->events, event);
+	}
+
+	if (held_events)
+		*held_events = NULL;
+
+	return event;
+}
+
+static void
+item_queue_get_next_file (TrackerMinerFS           *fs,
+                          GFile                   **file,
+                          GFile                   **source_file,
+                          GFileInfo               **info,
+                          TrackerMinerFSEventType  *type,
+                          gboolean                 *attributes_update,
+                          gboolean                 *is_dir,
+                          gboolean                 *fast_lane,
+                          gint64                   *queued_time)
+{
+	GQueue *held_events;
+	QueueEvent *event;
+
+	*file = NULL;
+	*source_file = NULL;
+
+	event = item_queue_peek (fs, &held_events);
+
+	if (event) {
+		if (event->type == TRACKER_MINER_FS_EVENT_MOVED) {
+			g_set_object (file, event->dest_file);
+			g_set_object (source_file, event->file);
+		} else {
 			g_set_object (file, event->file);
 		}
 
 		*type = event->type;
 		*attributes_update = event->attributes_update;
 		*is_dir = event->is_dir;
+		*fast_lane = event->fast_lane;
+		*queued_time = event->queued_time;
 		g_set_object (info, event->info);
 
-		maybe_remove_file_event_node (fs, event);
+		/* Crawled files were charged when stat'ed, others are
+		 * charged here so monitor event bursts keep to the rate.
+		 */
+		if (!event->crawled &&
+		    event->type != TRACKER_MINER_FS_EVENT_DELETED)
+			tracker_rate_limiter_consume (tracker_rate_limiter_get_default (),
+			                              1, 0);
+
+		if (held_events) {
+			g_queue_pop_head (held_events);
+		} else {
+			tracker_fair_queue_pop (fs->priv->items, NULL);
+			maybe_remove_file_event_node (fs, event);
+		}
+
 		queue_event_free (event);
-		tracker_priority_queue_pop (fs->priv->items, NULL);
 	}
 }
 
+static gboolean
+item_queue_next_is_fast (TrackerMinerFS *fs)
+{
+	QueueEvent *event;
+
+	event = item_queue_peek (fs, NULL);
+
+	return event && event->fast_lane;
+}
+
+static gboolean
+item_queue_blocked (TrackerMinerFS *fs)
+{
+	/* The next item waits for its file info, or for
+	 * the implementation to finish an earlier one.
+	 */
+	if (fs->priv->preparing)
+		return TRUE;
+
+	/* Only fast lane items may go through while the bulk
+	 * buffer is full, as long as the fast lane has room.
+	 */
+	if (item_queue_next_is_fast (fs))
+		return tracker_task_pool_limit_reached (TRACKER_TASK_POOL (fs->priv->fast_buffer));
+
+	return tracker_task_pool_limit_reached (TRACKER_TASK_POOL (fs->priv->sparql_buffer));
+}
+
 static gdouble
 item_queue_get_progress (TrackerMinerFS *fs,
                          guint          *n_items_processed,
@@ -1233,7 +1857,7 @@ item_queue_get_progress (TrackerMinerFS *fs,
 	guint items_to_process = 0;
 	guint items_total = 0;
 
-	items_to_process += tracker_priority_queue_get_length (fs->priv->items);
+	items_to_process += tracker_fair_queue_get_length (fs->priv->items);
 
 	items_total += fs->priv->total_directories_found;
 	items_total += fs->priv->total_files_found;
@@ -1256,6 +1880,99 @@ item_queue_get_progress (TrackerMinerFS *fs,
 	return (gdouble) (items_total - items_to_process) / items_total;
 }
 
+static void
+prepare_event_cb (GObject      *object,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+	TrackerMinerFS *fs = user_data;
+	GFile *file = G_FILE (object);
+	GFileInfo *info;
+	GError *error = NULL;
+	QueueEvent *event = NULL;
+	GList *link;
+
+	info = g_file_query_info_finish (file, result, &error);
+
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The miner is gone */
+		g_error_free (error);
+		return;
+	}
+
+	g_clear_error (&error);
+	fs->priv->preparing = FALSE;
+
+	/* The event may have been dropped in the meantime */
+	link = g_hash_table_lookup (fs->priv->items_by_file, file);
+	if (link) {
+		event = link->data;
+	} else {
+		/* Or set aside for a held subtree */
+		event = item_queue_peek (fs, NULL);
+		if (event && !g_file_equal (event->file, file))
+			event = NULL;
+	}
+
+	if (event &&
+	    (event->type == TRACKER_MINER_FS_EVENT_CREATED ||
+	     event->type == TRACKER_MINER_FS_EVENT_UPDATED)) {
+		event->prepared = TRUE;
+
+		if (info && !event->info) {
+			event->info = g_object_ref (info);
+		} else if (info && event->info) {
+			g_file_info_set_content_type (event->info,
+			                              g_file_info_get_content_type (info));
+		}
+	}
+
+	g_clear_object (&info);
+	item_queue_handlers_set_up (fs);
+}
+
+/* Queries the file info the next item lacks, if any, so files are
+ * not stat'ed or opened from the main loop. Returns %TRUE if the
+ * queue has to wait for it.
+ */
+static gboolean
+item_queue_prepare_next (TrackerMinerFS *fs)
+{
+	QueueEvent *event;
+	gchar *attributes;
+
+	event = item_queue_peek (fs, NULL);
+
+	if (!event || event->prepared ||
+	    (event->type != TRACKER_MINER_FS_EVENT_CREATED &&
+	     event->type != TRACKER_MINER_FS_EVENT_UPDATED))
+		return FALSE;
+
+	if (!event->info) {
+		/* GIO sniffs the contents only if the name is ambiguous */
+		attributes = g_strconcat (fs->priv->file_attributes, ",",
+		                          G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+		                          NULL);
+	} else if (tracker_file_info_needs_sniffing (event->file, event->info)) {
+		attributes = g_strdup (G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
+		fs->priv->content_types_sniffed++;
+	} else {
+		return FALSE;
+	}
+
+	fs->priv->preparing = TRUE;
+	g_file_query_info_async (event->file,
+	                         attributes,
+	                         G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+	                         TRACKER_TASK_PRIORITY,
+	                         fs->priv->prepare_cancellable,
+	                         prepare_event_cb,
+	                         fs);
+	g_free (attributes);
+
+	return TRUE;
+}
+
 static gboolean
 miner_handle_next_item (TrackerMinerFS *fs)
 {
@@ -1266,11 +1983,21 @@ miner_handle_next_item (TrackerMinerFS *fs)
 	gboolean keep_processing = TRUE;
 	gboolean attributes_update = FALSE;
 	gboolean is_dir = FALSE;
+	gboolean fast_lane = FALSE;
+	gint64 queued_time = 0;
 	TrackerMinerFSEventType type;
+	TrackerSparqlBuffer *buffer;
 	GFileInfo *info = NULL;
 
+	if (item_queue_blocked (fs))
+		return FALSE;
+
+	if (item_queue_prepare_next (fs))
+		return FALSE;
+
 	item_queue_get_next_file (fs, &file, &source_file, &info, &type,
-	                          &attributes_update, &is_dir);
+	                          &attributes_update, &is_dir,
+	                          &fast_lane, &queued_time);
 
 	if (fs->priv->timer_stopped) {
 		g_timer_start (fs->priv->timer);
@@ -1361,9 +2088,13 @@ miner_handle_next_item (TrackerMinerFS *fs)
 	}
 
 	if (file == NULL) {
+		notify_check_files_finished (fs);
+
 		if (!tracker_file_notifier_is_active (fs->priv->file_notifier)) {
-			if (!fs->priv->flushing &&
-			    tracker_task_pool_get_size (TRACKER_TASK_POOL (fs->priv->sparql_buffer)) == 0) {
+			if (!fs->priv->held_subtrees &&
+			    !fs->priv->flushing && !fs->priv->fast_flushing &&
+			    tracker_task_pool_get_size (TRACKER_TASK_POOL (fs->priv->sparql_buffer)) == 0 &&
+			    tracker_task_pool_get_size (TRACKER_TASK_POOL (fs->priv->fast_buffer)) == 0) {
 				/* Print stats and signal finished */
 				process_stop (fs);
 			} else {
@@ -1385,24 +2116,41 @@ miner_handle_next_item (TrackerMinerFS *fs)
 
 	fs->priv->changes_processed++;
 
+	buffer = miner_fs_get_buffer (fs, file, type, is_dir, fast_lane);
+
+	/* Keep the earliest event time for the commit latency stats */
+	if (!g_hash_table_contains (fs->priv->pending_times, file)) {
+		gint64 *time_ptr;
+
+		time_ptr = g_new (gint64, 1);
+		*time_ptr = queued_time;
+		g_hash_table_insert (fs->priv->pending_times,
+		                     g_object_ref (file), time_ptr);
+	}
+
 	/* Handle queues */
 	switch (type) {
 	case TRACKER_MINER_FS_EVENT_MOVED:
 		keep_processing = item_move (fs, file, source_file, is_dir);
 		break;
 	case TRACKER_MINER_FS_EVENT_DELETED:
-		keep_processing = item_remove (fs, file, is_dir, FALSE);
+		keep_processing = item_remove (fs, buffer, file, is_dir, FALSE);
 		break;
 	case TRACKER_MINER_FS_EVENT_CREATED:
-		keep_processing = item_add_or_update (fs, file, info, FALSE, TRUE);
+		keep_processing = item_add_or_update (fs, buffer, file, info, FALSE, TRUE);
 		break;
 	case TRACKER_MINER_FS_EVENT_UPDATED:
-		keep_processing = item_add_or_update (fs, file, info, attributes_update, FALSE);
+		keep_processing = item_add_or_update (fs, buffer, file, info, attributes_update, FALSE);
 		break;
 	default:
 		g_assert_not_reached ();
 	}
 
+	if (buffer == fs->priv->fast_buffer)
+		fast_lane_schedule_flush (fs);
+
+	notify_check_files_finished (fs);
+
 	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (fs->priv->sparql_buffer))) {
 		if (tracker_sparql_buffer_flush (fs->priv->sparql_buffer,
 						 "SPARQL buffer limit reached",
@@ -1411,9 +2159,9 @@ miner_handle_next_item (TrackerMinerFS *fs)
 			fs->priv->flushing = TRUE;
 		} else {
 			/* If we cannot flush, wait for the pending operations
-			 * to finish.
+			 * to finish. Fast lane items may still go through.
 			 */
-			keep_processing = FALSE;
+			keep_processing = !item_queue_blocked (fs);
 		}
 
 		/* Check if we've finished inserting for given prefixes ... */
@@ -1429,14 +2177,42 @@ miner_handle_next_item (TrackerMinerFS *fs)
 	return keep_processing;
 }
 
+static gboolean
+rate_limit_resume_cb (gpointer user_data)
+{
+	TrackerMinerFS *fs = user_data;
+
+	fs->priv->item_queues_handler_id = 0;
+	item_queue_handlers_set_up (fs);
+
+	return G_SOURCE_REMOVE;
+}
+
 static gboolean
 item_queue_handlers_cb (gpointer user_data)
 {
 	TrackerMinerFS *fs = user_data;
+	TrackerRateLimiter *limiter = tracker_rate_limiter_get_default ();
 	gboolean retval = FALSE;
+	gint64 delay;
 	gint i;
 
 	for (i = 0; i < MAX_SIMULTANEOUS_ITEMS; i++) {
+		delay = tracker_rate_limiter_get_delay (limiter);
+
+		if (delay > 0) {
+			/* Over the I/O budget, come back once there is room */
+			fs->priv->item_queues_handler_id =
+				g_timeout_add_full (TRACKER_TASK_PRIORITY,
+				                    delay / 1000 + 1,
+				                    rate_limit_resume_cb,
+				                    fs, NULL);
+			return G_SOURCE_REMOVE;
+		}
+
+		/* Files are charged when crawled or when taken off
+		 * the queue, see item_queue_get_next_file().
+		 */
 		retval = miner_handle_next_item (fs);
 		if (retval == FALSE)
 			break;
@@ -1454,9 +2230,12 @@ _tracker_idle_add (TrackerMinerFS *fs,
                    GSourceFunc     func,
                    gpointer        user_data)
 {
+	gdouble throttle;
 	guint interval;
 
-	interval = TRACKER_CRAWLER_MAX_TIMEOUT_INTERVAL * fs->priv->throttle;
+	/* Pacing slows down further within the room left by throttle */
+	throttle = fs->priv->throttle + (1 - fs->priv->throttle) * fs->priv->pacing;
+	interval = TRACKER_CRAWLER_MAX_TIMEOUT_INTERVAL * throttle;
 
 	if (interval == 0) {
 		return g_idle_add_full (TRACKER_TASK_PRIORITY, func, user_data, NULL);
@@ -1480,7 +2259,7 @@ item_queue_handlers_set_up (TrackerMinerFS *fs)
 	}
 
 	/* Already processing max number of sparql updates */
-	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (fs->priv->sparql_buffer))) {
+	if (item_queue_blocked (fs)) {
 		trace_eq ("   cancelled: pool limit reached (sparql buffer: %u)",
 		          tracker_task_pool_get_limit (TRACKER_TASK_POOL (fs->priv->sparql_buffer)));
 		return;
@@ -1523,16 +2302,62 @@ miner_fs_get_queue_priority (TrackerMinerFS *fs,
 	        G_PRIORITY_HIGH : G_PRIORITY_DEFAULT;
 }
 
+static gint
+miner_fs_get_event_priority (TrackerMinerFS *fs,
+                             QueueEvent     *event)
+{
+	gint priority;
+
+	priority = miner_fs_get_queue_priority (fs, event->file);
+
+	/* Fast lane events are handled ahead of crawling results */
+	if (event->fast_lane)
+		priority = MIN (priority, G_PRIORITY_HIGH);
+
+	return priority;
+}
+
+static QueueEvent *
+lookup_queued_event (TrackerMinerFS *fs,
+                     GFile          *file)
+{
+	GList *link;
+
+	link = g_hash_table_lookup (fs->priv->items_by_file, file);
+	if (!link)
+		link = g_hash_table_lookup (fs->priv->items_by_dest, file);
+
+	return link ? link->data : NULL;
+}
+
 static void
 assign_root_node (TrackerMinerFS *fs,
                   QueueEvent     *event)
 {
 	GFile *root, *file;
+	QueueEvent *prior;
 	GQueue *queue;
 
 	file = event->dest_file ? event->dest_file : event->file;
 	root = tracker_indexing_tree_get_root (fs->priv->indexing_tree,
 	                                       file, NULL);
+
+	/* Events are scheduled fairly across roots, but roots take
+	 * turns, so events touching a file that has events queued
+	 * under another root follow them there to keep arrival order.
+	 */
+	prior = lookup_queued_event (fs, event->file);
+	if (!prior && event->dest_file)
+		prior = lookup_queued_event (fs, event->dest_file);
+
+	if (prior && prior->queue_root) {
+		g_set_object (&event->queue_root, prior->queue_root);
+		event->fast_lane = prior->fast_lane;
+		event->priority = MAX (event->priority, prior->priority);
+	} else {
+		g_set_object (&event->queue_root, root);
+	}
+
 	if (!root)
 		return;
 
@@ -1556,12 +2381,17 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 {
 	GList *old = NULL, *link = NULL;
 
+	event->priority = priority;
+
 	if (event->type == TRACKER_MINER_FS_EVENT_MOVED) {
 		/* Remove all children of the dest location from being processed. */
 		g_hash_table_foreach_remove (fs->priv->items_by_file,
 		                             remove_items_by_file_foreach,
 		                             event->dest_file);
-		tracker_priority_queue_foreach_remove (fs->priv->items,
+		g_hash_table_foreach_remove (fs->priv->items_by_dest,
+		                             remove_items_by_file_foreach,
+		                             event->dest_file);
+		tracker_fair_queue_foreach_remove (fs->priv->items,
 						       (GEqualFunc) queue_event_is_equal_or_descendant,
 						       event->dest_file,
 						       (GDestroyNotify) queue_event_free);
@@ -1575,11 +2405,26 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 
 		action = queue_event_coalesce (old->data, event, &replacement);
 
+		if (replacement) {
+			queue_event_take_batch (replacement, event);
+			queue_event_take_batch (replacement, old->data);
+		} else if (action == QUEUE_ACTION_DELETE_FIRST) {
+			queue_event_take_batch (event, old->data);
+		} else if (action == QUEUE_ACTION_DELETE_SECOND) {
+			queue_event_take_batch (old->data, event);
+		}
+
 		if (action & QUEUE_ACTION_DELETE_FIRST) {
-			maybe_remove_file_event_node (fs, old->data);
-			queue_event_free (old->data);
-			tracker_priority_queue_remove_node (fs->priv->items,
-							    old);
+			QueueEvent *old_event = old->data;
+			GFile *old_root;
+
+			old_root = old_event->queue_root ?
+				g_object_ref (old_event->queue_root) : NULL;
+			maybe_remove_file_event_node (fs, old_event);
+			queue_event_free (old_event);
+			tracker_fair_queue_remove_node (fs->priv->items,
+			                                old_root, old);
+			g_clear_object (&old_root);
 		}
 
 		if (action & QUEUE_ACTION_DELETE_SECOND) {
@@ -1587,8 +2432,18 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 			event = NULL;
 		}
 
-		if (replacement)
+		if (replacement) {
 			event = replacement;
+			event->priority = priority;
+		} else if (event && (action & QUEUE_ACTION_DELETE_FIRST) == 0) {
+			QueueEvent *old_event = old->data;
+
+			/* Both events stay queued, keep them on the same
+			 * lane and priority so they commit in arrival order.
+			 */
+			event->fast_lane = old_event->fast_lane;
+			event->priority = MAX (event->priority, old_event->priority);
+		}
 	}
 
 	if (event) {
@@ -1597,7 +2452,10 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 			g_hash_table_foreach_remove (fs->priv->items_by_file,
 			                             remove_items_by_file_foreach,
 			                             event->file);
-			tracker_priority_queue_foreach_remove (fs->priv->items,
+			g_hash_table_foreach_remove (fs->priv->items_by_dest,
+			                             remove_items_by_file_foreach,
+			                             event->file);
+			tracker_fair_queue_foreach_remove (fs->priv->items,
 							       (GEqualFunc) queue_event_is_equal_or_descendant,
 							       event->file,
 							       (GDestroyNotify) queue_event_free);
@@ -1606,8 +2464,12 @@ miner_fs_queue_event (TrackerMinerFS *fs,
 		trace_eq_event (event);
 
 		assign_root_node (fs, event);
-		link = tracker_priority_queue_add (fs->priv->items, event, priority);
+		link = tracker_fair_queue_add (fs->priv->items, event->queue_root,
+		                               event, event->priority);
 		g_hash_table_replace (fs->priv->items_by_file, event->file, link);
+
+		if (event->dest_file)
+			g_hash_table_replace (fs->priv->items_by_dest, event->dest_file, link);
 		item_queue_handlers_set_up (fs);
 		check_notifier_high_water (fs);
 	}
@@ -1623,7 +2485,9 @@ file_notifier_file_created (TrackerFileNotifier  *notifier,
 	QueueEvent *event;
 
 	event = queue_event_new (TRACKER_MINER_FS_EVENT_CREATED, file, info);
-	miner_fs_queue_event (fs, event, miner_fs_get_queue_priority (fs, file));
+	event->fast_lane = tracker_file_notifier_is_monitor_event (notifier);
+	event->crawled = !event->fast_lane;
+	miner_fs_queue_event (fs, event, miner_fs_get_event_priority (fs, event));
 }
 
 static void
@@ -1637,7 +2501,9 @@ file_notifier_file_deleted (TrackerFileNotifier  *notifier,
 
 	event = queue_event_new (TRACKER_MINER_FS_EVENT_DELETED, file, NULL);
 	event->is_dir = !!is_dir;
-	miner_fs_queue_event (fs, event, miner_fs_get_queue_priority (fs, file));
+	event->fast_lane = tracker_file_notifier_is_monitor_event (notifier);
+	event->crawled = !event->fast_lane;
+	miner_fs_queue_event (fs, event, miner_fs_get_event_priority (fs, event));
 }
 
 static void
@@ -1652,7 +2518,9 @@ file_notifier_file_updated (TrackerFileNotifier  *notifier,
 
 	event = queue_event_new (TRACKER_MINER_FS_EVENT_UPDATED, file, info);
 	event->attributes_update = attributes_only;
-	miner_fs_queue_event (fs, event, miner_fs_get_queue_priority (fs, file));
+	event->fast_lane = tracker_file_notifier_is_monitor_event (notifier);
+	event->crawled = !event->fast_lane;
+	miner_fs_queue_event (fs, event, miner_fs_get_event_priority (fs, event));
 }
 
 static void
@@ -1754,6 +2622,7 @@ indexing_tree_directory_removed (TrackerIndexingTree *indexing_tree,
 	TrackerMinerFS *fs = user_data;
 	TrackerMinerFSPrivate *priv = fs->priv;
 	GTimer *timer = g_timer_new ();
+	GList *l;
 
 	TRACKER_NOTE (MINER_FS_EVENTS, g_message ("  Cancelled processing pool tasks at %f\n", g_timer_elapsed (timer, NULL)));
 
@@ -1763,18 +2632,39 @@ indexing_tree_directory_removed (TrackerIndexingTree *indexing_tree,
 	g_hash_table_foreach_remove (fs->priv->items_by_file,
 	                             remove_items_by_file_foreach,
 	                             directory);
-	tracker_priority_queue_foreach_remove (priv->items,
+	g_hash_table_foreach_remove (fs->priv->items_by_dest,
+	                             remove_items_by_file_foreach,
+	                             directory);
+	tracker_fair_queue_foreach_remove (priv->items,
 					       (GEqualFunc) queue_event_is_equal_or_descendant,
 					       directory,
 					       (GDestroyNotify) queue_event_free);
 
+	for (l = priv->held_subtrees; l; l = l->next) {
+		HeldSubtree *subtree = l->data;
+		GList *event_link, *next;
+
+		for (event_link = subtree->events.head; event_link; event_link = next) {
+			next = event_link->next;
+
+			if (queue_event_is_equal_or_descendant (event_link->data, directory)) {
+				queue_event_free (event_link->data);
+				g_queue_delete_link (&subtree->events, event_link);
+			}
+		}
+	}
+
+	tracker_fair_queue_set_weight (priv->items, directory,
+	                               TRACKER_FAIR_QUEUE_DEFAULT_WEIGHT);
+
 	TRACKER_NOTE (MINER_FS_EVENTS, g_message ("  Removed files at %f\n", g_timer_elapsed (timer, NULL)));
 	g_timer_destroy (timer);
 }
 
 static gboolean
 check_file_parents (TrackerMinerFS *fs,
-                    GFile          *file)
+                    GFile          *file,
+                    GHashTable     *visited)
 {
 	GFile *parent, *root;
 	GList *parents = NULL, *p;
@@ -1793,9 +2683,12 @@ check_file_parents (TrackerMinerFS *fs,
 		return FALSE;
 	}
 
-	/* Add parent directories until we're past the config dir */
+	/* Add parent directories until we're past the config dir, or
+	 * reach one that was already queued in this same request.
+	 */
 	while (parent &&
-	       !g_file_has_prefix (root, parent)) {
+	       !g_file_has_prefix (root, parent) &&
+	       !(visited && g_hash_table_contains (visited, parent))) {
 		parents = g_list_prepend (parents, parent);
 		parent = g_file_get_parent (parent);
 	}
@@ -1808,7 +2701,11 @@ check_file_parents (TrackerMinerFS *fs,
 	for (p = parents; p; p = p->next) {
 		event = queue_event_new (TRACKER_MINER_FS_EVENT_UPDATED, p->data, NULL);
 		miner_fs_queue_event (fs, event, miner_fs_get_queue_priority (fs, p->data));
-		g_object_unref (p->data);
+
+		if (visited)
+			g_hash_table_add (visited, p->data);
+		else
+			g_object_unref (p->data);
 	}
 
 	g_list_free (parents);
@@ -1816,6 +2713,55 @@ check_file_parents (TrackerMinerFS *fs,
 	return TRUE;
 }
 
+static void
+miner_fs_check_file (TrackerMinerFS  *fs,
+                     GFile           *file,
+                     gint             priority,
+                     gboolean         check_parents,
+                     CheckFilesBatch *batch,
+                     GHashTable      *visited)
+{
+	gboolean should_process = TRUE;
+	QueueEvent *event;
+	gchar *uri;
+
+	if (check_parents) {
+		should_process =
+			tracker_indexing_tree_file_is_indexable (fs->priv->indexing_tree,
+			                                         file, NULL);
+	}
+
+	uri = g_file_get_uri (file);
+
+	TRACKER_NOTE (MINER_FS_EVENTS,
+	              g_message ("%s:'%s' (FILE) (requested by application)",
+	                         should_process ? "Found " : "Ignored",
+	                         uri));
+
+	if (should_process) {
+		if (check_parents && !check_file_parents (fs, file, visited)) {
+			g_free (uri);
+			return;
+		}
+
+		event = queue_event_new (TRACKER_MINER_FS_EVENT_UPDATED, file, NULL);
+		/* Only single files requested by the user take the fast
+		 * lane, bulk requests would flood it.
+		 */
+		event->fast_lane = (!batch && priority <= G_PRIORITY_HIGH);
+
+		if (batch) {
+			event->batch_node = g_list_alloc ();
+			event->batch_node->data = batch;
+			g_queue_push_head_link (&batch->events, event->batch_node);
+		}
+
+		miner_fs_queue_event (fs, event, priority);
+	}
+
+	g_free (uri);
+}
+
 /**
  * tracker_miner_fs_check_file:
  * @fs: a #TrackerMinerFS
@@ -1836,36 +2782,90 @@ tracker_miner_fs_check_file (TrackerMinerFS *fs,
                              gint            priority,
                              gboolean        check_parents)
 {
-	gboolean should_process = TRUE;
-	QueueEvent *event;
-	gchar *uri;
-
 	g_return_if_fail (TRACKER_IS_MINER_FS (fs));
 	g_return_if_fail (G_IS_FILE (file));
 
-	if (check_parents) {
-		should_process =
-			tracker_indexing_tree_file_is_indexable (fs->priv->indexing_tree,
-			                                         file, NULL);
-	}
+	miner_fs_check_file (fs, file, priority, check_parents, NULL, NULL);
+}
 
-	uri = g_file_get_uri (file);
+/**
+ * tracker_miner_fs_check_files:
+ * @fs: a #TrackerMinerFS
+ * @files: (element-type GFile): list of #GFile to check
+ * @priority: the priority of the check tasks
+ * @check_parents: whether to check parents and eligibility or not
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when all files are indexed
+ * @user_data: data to pass to @callback
+ *
+ * Tells the filesystem miner to check and index a set of files at a
+ * given priority, in the same way than tracker_miner_fs_check_file().
+ * @callback will be called once all resulting changes are committed
+ * to the store, call tracker_miner_fs_check_files_finish() from it to
+ * get the result.
+ *
+ * Files that are not eligible for indexing are skipped.
+ **/
+void
+tracker_miner_fs_check_files (TrackerMinerFS      *fs,
+                              GList               *files,
+                              gint                 priority,
+                              gboolean             check_parents,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+	CheckFilesBatch *batch;
+	GHashTable *visited;
+	GList *l;
 
-	TRACKER_NOTE (MINER_FS_EVENTS,
-	              g_message ("%s:'%s' (FILE) (requested by application)",
-	                         should_process ? "Found " : "Ignored",
-	                         uri));
+	g_return_if_fail (TRACKER_IS_MINER_FS (fs));
 
-	if (should_process) {
-		if (check_parents && !check_file_parents (fs, file)) {
-			return;
-		}
+	batch = g_slice_new0 (CheckFilesBatch);
+	g_queue_init (&batch->events);
+	batch->task = g_task_new (fs, cancellable, callback, user_data);
+	g_task_set_source_tag (batch->task, tracker_miner_fs_check_files);
 
-		event = queue_event_new (TRACKER_MINER_FS_EVENT_UPDATED, file, NULL);
-		miner_fs_queue_event (fs, event, priority);
+	/* Files are often handed in bulk from the same folders, avoid
+	 * queueing their common parents once per file.
+	 */
+	visited = g_hash_table_new_full (g_file_hash,
+	                                 (GEqualFunc) g_file_equal,
+	                                 g_object_unref, NULL);
+
+	for (l = files; l; l = l->next) {
+		miner_fs_check_file (fs, l->data, priority, check_parents,
+		                     batch, visited);
 	}
 
-	g_free (uri);
+	g_hash_table_unref (visited);
+
+	fs->priv->check_batches = g_list_append (fs->priv->check_batches, batch);
+
+	/* If nothing was queued, complete on the next check */
+	if (g_queue_is_empty (&batch->events))
+		notify_check_files_finished (fs);
+}
+
+/**
+ * tracker_miner_fs_check_files_finish:
+ * @fs: a #TrackerMinerFS
+ * @result: a #GAsyncResult
+ * @error: location for a #GError, or %NULL
+ *
+ * Finishes an operation started with tracker_miner_fs_check_files().
+ *
+ * Returns: %TRUE if all files were processed, %FALSE on error.
+ **/
+gboolean
+tracker_miner_fs_check_files_finish (TrackerMinerFS  *fs,
+                                     GAsyncResult    *result,
+                                     GError         **error)
+{
+	g_return_val_if_fail (TRACKER_IS_MINER_FS (fs), FALSE);
+	g_return_val_if_fail (g_task_is_valid (result, fs), FALSE);
+
+	return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 /**
@@ -1900,6 +2900,19 @@ tracker_miner_fs_notify_finish (TrackerMinerFS *fs,
 		g_task_return_pointer (task, g_strdup (sparql), g_free);
 }
 
+static void
+reschedule_item_queue_handlers (TrackerMinerFS *fs)
+{
+	if (fs->priv->item_queues_handler_id != 0) {
+		g_source_remove (fs->priv->item_queues_handler_id);
+
+		fs->priv->item_queues_handler_id =
+			_tracker_idle_add (fs,
+			                   item_queue_handlers_cb,
+			                   fs);
+	}
+}
+
 /**
  * tracker_miner_fs_set_throttle:
  * @fs: a #TrackerMinerFS
@@ -1926,16 +2939,7 @@ tracker_miner_fs_set_throttle (TrackerMinerFS *fs,
 	}
 
 	fs->priv->throttle = throttle;
-
-	/* Update timeouts */
-	if (fs->priv->item_queues_handler_id != 0) {
-		g_source_remove (fs->priv->item_queues_handler_id);
-
-		fs->priv->item_queues_handler_id =
-			_tracker_idle_add (fs,
-			                   item_queue_handlers_cb,
-			                   fs);
-	}
+	reschedule_item_queue_handlers (fs);
 }
 
 /**
@@ -1957,6 +2961,47 @@ tracker_miner_fs_get_throttle (TrackerMinerFS *fs)
 	return fs->priv->throttle;
 }
 
+/**
+ * tracker_miner_fs_set_pacing:
+ * @fs: a #TrackerMinerFS
+ * @pacing: a double between 0.0 and 1.0
+ *
+ * Slows down processing on top of tracker_miner_fs_set_throttle(),
+ * meant to be driven by a controller that reacts to system load.
+ * A value of 0.0 keeps the configured throttle, 1.0 goes as slow
+ * as a throttle of 1.0.
+ **/
+void
+tracker_miner_fs_set_pacing (TrackerMinerFS *fs,
+                             gdouble         pacing)
+{
+	g_return_if_fail (TRACKER_IS_MINER_FS (fs));
+
+	pacing = CLAMP (pacing, 0, 1);
+
+	if (fs->priv->pacing == pacing)
+		return;
+
+	fs->priv->pacing = pacing;
+	reschedule_item_queue_handlers (fs);
+}
+
+/**
+ * tracker_miner_fs_get_pacing:
+ * @fs: a #TrackerMinerFS
+ *
+ * Gets the current pacing value, see tracker_miner_fs_set_pacing().
+ *
+ * Returns: a double representing a value between 0.0 and 1.0.
+ **/
+gdouble
+tracker_miner_fs_get_pacing (TrackerMinerFS *fs)
+{
+	g_return_val_if_fail (TRACKER_IS_MINER_FS (fs), 0);
+
+	return fs->priv->pacing;
+}
+
 static const gchar *
 tracker_miner_fs_get_folder_urn (TrackerMinerFS *fs,
 				 GFile          *file)
@@ -1993,6 +3038,141 @@ tracker_miner_fs_get_folder_urn (TrackerMinerFS *fs,
 	return str;
 }
 
+/**
+ * tracker_miner_fs_set_root_weight:
+ * @fs: a #TrackerMinerFS
+ * @root: an indexing root
+ * @weight: relative share of processing given to @root
+ *
+ * Sets the weight of @root when scheduling queued items. Items of
+ * the same priority are processed in turns across indexing roots,
+ * each root getting to process as many items per turn as its weight,
+ * so a large root being crawled does not hold back others.
+ *
+ * All roots have a weight of 1 by default, the weight is kept until
+ * @root is removed from the indexing tree.
+ **/
+void
+tracker_miner_fs_set_root_weight (TrackerMinerFS *fs,
+                                  GFile          *root,
+                                  guint           weight)
+{
+	g_return_if_fail (TRACKER_IS_MINER_FS (fs));
+	g_return_if_fail (G_IS_FILE (root));
+	g_return_if_fail (weight > 0);
+
+	tracker_fair_queue_set_weight (fs->priv->items, root, weight);
+}
+
+/**
+ * tracker_miner_fs_get_commit_latency:
+ * @fs: a #TrackerMinerFS
+ *
+ * Returns histograms of the time elapsed between a file event being
+ * queued and the resulting changes being committed to the store.
+ *
+ * The returned #GVariant has type "(auauau)", the first array contains
+ * the upper bound in milliseconds of each bucket, the second array the
+ * number of changes committed through the low latency lane (monitor
+ * events and high priority checks) in each bucket, and the third array
+ * the number of changes committed through the bulk lane.
+ *
+ * Returns: (transfer floating): a #GVariant with the latency histograms
+ **/
+GVariant *
+tracker_miner_fs_get_commit_latency (TrackerMinerFS *fs)
+{
+	GVariantBuilder limits, fast_counts, counts;
+	guint i;
+
+	g_return_val_if_fail (TRACKER_IS_MINER_FS (fs), NULL);
+
+	g_variant_builder_init (&limits, G_VARIANT_TYPE ("au"));
+	g_variant_builder_init (&fast_counts, G_VARIANT_TYPE ("au"));
+	g_variant_builder_init (&counts, G_VARIANT_TYPE ("au"));
+
+	for (i = 0; i < N_LATENCY_BUCKETS; i++) {
+		g_variant_builder_add (&limits, "u", latency_buckets[i]);
+		g_variant_builder_add (&fast_counts, "u", fs->priv->fast_latency_histogram[i]);
+		g_variant_builder_add (&counts, "u", fs->priv->latency_histogram[i]);
+	}
+
+	return g_variant_new ("(auauau)", &limits, &fast_counts, &counts);
+}
+
+/**
+ * tracker_miner_fs_hold_subtree:
+ * @fs: a #TrackerMinerFS
+ * @root: a #GFile
+ *
+ * Sets aside queued events on @root and its descendants, including
+ * moves from or to there, until tracker_miner_fs_release_subtree()
+ * is called as many times. Implementations use this to complete an
+ * update of a subtree asynchronously, e.g. across several commits,
+ * before later events on it are handled. Other events keep being
+ * handled meanwhile, and @fs does not become idle.
+ **/
+void
+tracker_miner_fs_hold_subtree (TrackerMinerFS *fs,
+                               GFile          *root)
+{
+	HeldSubtree *subtree;
+	GList *l;
+
+	g_return_if_fail (TRACKER_IS_MINER_FS (fs));
+	g_return_if_fail (G_IS_FILE (root));
+
+	for (l = fs->priv->held_subtrees; l; l = l->next) {
+		subtree = l->data;
+
+		if (g_file_equal (subtree->root, root)) {
+			subtree->n_holds++;
+			return;
+		}
+	}
+
+	subtree = g_slice_new0 (HeldSubtree);
+	subtree->root = g_object_ref (root);
+	subtree->n_holds = 1;
+	g_queue_init (&subtree->events);
+
+	fs->priv->held_subtrees =
+		g_list_append (fs->priv->held_subtrees, subtree);
+}
+
+/**
+ * tracker_miner_fs_release_subtree:
+ * @fs: a #TrackerMinerFS
+ * @root: a #GFile
+ *
+ * Releases a hold taken with tracker_miner_fs_hold_subtree(), the
+ * events set aside are handled first once no holds are left on @root.
+ **/
+void
+tracker_miner_fs_release_subtree (TrackerMinerFS *fs,
+                                  GFile          *root)
+{
+	GList *l;
+
+	g_return_if_fail (TRACKER_IS_MINER_FS (fs));
+	g_return_if_fail (G_IS_FILE (root));
+
+	for (l = fs->priv->held_subtrees; l; l = l->next) {
+		HeldSubtree *subtree = l->data;
+
+		if (subtree->n_holds > 0 &&
+		    g_file_equal (subtree->root, root)) {
+			subtree->n_holds--;
+
+			if (subtree->n_holds == 0)
+				item_queue_handlers_set_up (fs);
+			return;
+		}
+	}
+
+	g_critical ("Subtree is not held");
+}
+
 /**
  * tracker_miner_fs_has_items_to_process:
  * @fs: a #TrackerMinerFS
@@ -2013,7 +3193,8 @@ tracker_miner_fs_has_items_to_process (TrackerMinerFS *fs)
 	g_return_val_if_fail (TRACKER_IS_MINER_FS (fs), FALSE);
 
 	if (tracker_file_notifier_is_active (fs->priv->file_notifier) ||
-	    !tracker_priority_queue_is_empty (fs->priv->items)) {
+	    !tracker_fair_queue_is_empty (fs->priv->items) ||
+	    fs->priv->held_subtrees != NULL) {
 		return TRUE;
 	}
 
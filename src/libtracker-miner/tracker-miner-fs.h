@@ -151,12 +151,31 @@ TrackerDataProvider * tracker_miner_fs_get_data_provider     (TrackerMinerFS  *f
 gdouble               tracker_miner_fs_get_throttle          (TrackerMinerFS  *fs);
 void                  tracker_miner_fs_set_throttle          (TrackerMinerFS  *fs,
                                                               gdouble          throttle);
+gdouble               tracker_miner_fs_get_pacing            (TrackerMinerFS  *fs);
+void                  tracker_miner_fs_set_pacing            (TrackerMinerFS  *fs,
+                                                              gdouble          pacing);
 
 /* Queueing files to be processed AFTER checking rules in IndexingTree */
 void                  tracker_miner_fs_check_file            (TrackerMinerFS  *fs,
                                                               GFile           *file,
                                                               gint             priority,
                                                               gboolean         check_parents);
+void                  tracker_miner_fs_check_files           (TrackerMinerFS      *fs,
+                                                              GList               *files,
+                                                              gint                 priority,
+                                                              gboolean             check_parents,
+                                                              GCancellable        *cancellable,
+                                                              GAsyncReadyCallback  callback,
+                                                              gpointer             user_data);
+gboolean              tracker_miner_fs_check_files_finish    (TrackerMinerFS      *fs,
+                                                              GAsyncResult        *result,
+                                                              GError             **error);
+
+/* Holding back events on a subtree while its update completes asynchronously */
+void                  tracker_miner_fs_hold_subtree          (TrackerMinerFS  *fs,
+                                                              GFile           *root);
+void                  tracker_miner_fs_release_subtree       (TrackerMinerFS  *fs,
+                                                              GFile           *root);
 
 /* Continuation for async vmethods */
 void                  tracker_miner_fs_notify_finish         (TrackerMinerFS  *fs,
@@ -171,6 +190,14 @@ const gchar * tracker_miner_fs_get_identifier (TrackerMinerFS *miner,
 /* Progress */
 gboolean              tracker_miner_fs_has_items_to_process  (TrackerMinerFS  *fs);
 
+/* Scheduling */
+void                  tracker_miner_fs_set_root_weight       (TrackerMinerFS  *fs,
+                                                              GFile           *root,
+                                                              guint            weight);
+
+/* Statistics */
+GVariant *            tracker_miner_fs_get_commit_latency    (TrackerMinerFS  *fs);
+
 G_END_DECLS
 
 #endif /* __LIBTRACKER_MINER_MINER_FS_H__ */
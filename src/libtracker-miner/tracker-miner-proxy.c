@@ -42,8 +42,10 @@
 #include <libtracker-miners-common/tracker-dbus.h>
 #include <libtracker-miners-common/tracker-type-utils.h>
 #include <libtracker-miners-common/tracker-domain-ontology.h>
+#include <libtracker-miners-common/tracker-memory-budget.h>
 
 #include "tracker-miner-proxy.h"
+#include "tracker-miner-fs.h"
 
 typedef struct {
 	TrackerMiner *miner;
@@ -52,6 +54,16 @@ typedef struct {
 	gchar *dbus_path;
 	guint registration_id;
 	GHashTable *pauses;
+
+	/* Progress signal coalescing */
+	guint max_progress_rate;
+	gchar *pending_status;
+	gdouble pending_progress;
+	gint pending_remaining_time;
+	gint64 last_progress_time;
+	guint progress_timeout_id;
+	guint progress_updates;
+	guint progress_signals;
 } TrackerMinerProxyPrivate;
 
 typedef struct {
@@ -67,9 +79,14 @@ enum {
 	PROP_MINER,
 	PROP_DBUS_CONNECTION,
 	PROP_DBUS_PATH,
+	PROP_MAX_PROGRESS_RATE,
 };
 
+/* Maximum number of Progress signals emitted per second by default */
+#define DEFAULT_MAX_PROGRESS_RATE 4
+
 static void tracker_miner_proxy_initable_iface_init (GInitableIface *iface);
+static void flush_pending_progress (TrackerMinerProxy *proxy);
 
 G_DEFINE_TYPE_WITH_CODE (TrackerMinerProxy, tracker_miner_proxy, G_TYPE_OBJECT,
                          G_ADD_PRIVATE (TrackerMinerProxy)
@@ -106,6 +123,24 @@ static const gchar introspection_xml[] =
   "    <method name='Resume'>"
   "      <arg type='i' name='cookie' direction='in' />"
   "    </method>"
+  "    <method name='GetProgressStatistics'>"
+  "      <arg type='u' name='progress_updates' direction='out' />"
+  "      <arg type='u' name='progress_signals' direction='out' />"
+  "    </method>"
+  "    <method name='GetCommitLatency'>"
+  "      <arg type='au' name='bucket_limits' direction='out' />"
+  "      <arg type='au' name='fast_lane_counts' direction='out' />"
+  "      <arg type='au' name='bulk_counts' direction='out' />"
+  "    </method>"
+  "    <method name='GetPacing'>"
+  "      <arg type='d' name='throttle' direction='out' />"
+  "      <arg type='d' name='pacing' direction='out' />"
+  "    </method>"
+  "    <method name='GetMemoryUsage'>"
+  "      <arg type='u' name='state' direction='out' />"
+  "      <arg type='t' name='limit' direction='out' />"
+  "      <arg type='a{st}' name='usage' direction='out' />"
+  "    </method>"
   "    <signal name='Started' />"
   "    <signal name='Stopped' />"
   "    <signal name='Paused' />"
@@ -178,6 +213,9 @@ tracker_miner_proxy_set_property (GObject      *object,
 	case PROP_DBUS_PATH:
 		priv->dbus_path = g_value_dup_string (value);
 		break;
+	case PROP_MAX_PROGRESS_RATE:
+		priv->max_progress_rate = g_value_get_uint (value);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -203,20 +241,39 @@ tracker_miner_proxy_get_property (GObject    *object,
 	case PROP_DBUS_PATH:
 		g_value_set_string (value, priv->dbus_path);
 		break;
+	case PROP_MAX_PROGRESS_RATE:
+		g_value_set_uint (value, priv->max_progress_rate);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
 	}
 }
 
+static void
+tracker_miner_proxy_dispose (GObject *object)
+{
+	TrackerMinerProxy *proxy = TRACKER_MINER_PROXY (object);
+	TrackerMinerProxyPrivate *priv = tracker_miner_proxy_get_instance_private (proxy);
+
+	/* Deliver the last Progress while the object is still exported */
+	flush_pending_progress (proxy);
+
+	if (priv->miner) {
+		g_signal_handlers_disconnect_by_data (priv->miner, proxy);
+		g_clear_object (&priv->miner);
+	}
+
+	G_OBJECT_CLASS (tracker_miner_proxy_parent_class)->dispose (object);
+}
+
 static void
 tracker_miner_proxy_finalize (GObject *object)
 {
 	TrackerMinerProxy *proxy = TRACKER_MINER_PROXY (object);
 	TrackerMinerProxyPrivate *priv = tracker_miner_proxy_get_instance_private (proxy);
 
-	g_signal_handlers_disconnect_by_data (priv->miner, proxy);
-	g_clear_object (&priv->miner);
+	g_free (priv->pending_status);
 	g_free (priv->dbus_path);
 	g_hash_table_unref (priv->pauses);
 
@@ -243,6 +300,7 @@ tracker_miner_proxy_class_init (TrackerMinerProxyClass *klass)
 
 	object_class->set_property = tracker_miner_proxy_set_property;
 	object_class->get_property = tracker_miner_proxy_get_property;
+	object_class->dispose = tracker_miner_proxy_dispose;
 	object_class->finalize = tracker_miner_proxy_finalize;
 
 	g_object_class_install_property (object_class,
@@ -272,6 +330,23 @@ tracker_miner_proxy_class_init (TrackerMinerProxyClass *klass)
 	                                                      G_PARAM_READWRITE |
 	                                                      G_PARAM_CONSTRUCT_ONLY |
 	                                                      G_PARAM_STATIC_STRINGS));
+	/**
+	 * TrackerMinerProxy:max-progress-rate:
+	 *
+	 * Maximum number of Progress signals emitted per second over DBus.
+	 * Progress updates arriving faster than this are coalesced, the
+	 * latest value is always eventually emitted. 0 means unlimited.
+	 **/
+	g_object_class_install_property (object_class,
+	                                 PROP_MAX_PROGRESS_RATE,
+	                                 g_param_spec_uint ("max-progress-rate",
+	                                                    "Max progress rate",
+	                                                    "Maximum number of Progress signals per second (0 = unlimited)",
+	                                                    0, G_MAXUINT,
+	                                                    DEFAULT_MAX_PROGRESS_RATE,
+	                                                    G_PARAM_READWRITE |
+	                                                    G_PARAM_CONSTRUCT |
+	                                                    G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -608,6 +683,96 @@ handle_method_call_get_status (TrackerMinerProxy     *proxy,
 	g_free (status);
 }
 
+static void
+handle_method_call_get_progress_statistics (TrackerMinerProxy     *proxy,
+                                            GDBusMethodInvocation *invocation,
+                                            GVariant              *parameters)
+{
+	TrackerDBusRequest *request;
+	TrackerMinerProxyPrivate *priv;
+
+	priv = tracker_miner_proxy_get_instance_private (proxy);
+
+	request = tracker_g_dbus_request_begin (invocation, "%s()", __PRETTY_FUNCTION__);
+
+	tracker_dbus_request_end (request, NULL);
+	g_dbus_method_invocation_return_value (invocation,
+	                                       g_variant_new ("(uu)",
+	                                                      priv->progress_updates,
+	                                                      priv->progress_signals));
+}
+
+static void
+handle_method_call_get_commit_latency (TrackerMinerProxy     *proxy,
+                                       GDBusMethodInvocation *invocation,
+                                       GVariant              *parameters)
+{
+	TrackerDBusRequest *request;
+	TrackerMinerProxyPrivate *priv;
+
+	priv = tracker_miner_proxy_get_instance_private (proxy);
+
+	request = tracker_g_dbus_request_begin (invocation, "%s()", __PRETTY_FUNCTION__);
+
+	if (!TRACKER_IS_MINER_FS (priv->miner)) {
+		tracker_dbus_request_end (request, NULL);
+		g_dbus_method_invocation_return_error (invocation,
+		                                       G_DBUS_ERROR,
+		                                       G_DBUS_ERROR_NOT_SUPPORTED,
+		                                       "Miner does not index files");
+		return;
+	}
+
+	tracker_dbus_request_end (request, NULL);
+	g_dbus_method_invocation_return_value (invocation,
+	                                       tracker_miner_fs_get_commit_latency (TRACKER_MINER_FS (priv->miner)));
+}
+
+static void
+handle_method_call_get_pacing (TrackerMinerProxy     *proxy,
+                               GDBusMethodInvocation *invocation,
+                               GVariant              *parameters)
+{
+	TrackerDBusRequest *request;
+	TrackerMinerProxyPrivate *priv;
+	TrackerMinerFS *fs;
+
+	priv = tracker_miner_proxy_get_instance_private (proxy);
+
+	request = tracker_g_dbus_request_begin (invocation, "%s()", __PRETTY_FUNCTION__);
+
+	if (!TRACKER_IS_MINER_FS (priv->miner)) {
+		tracker_dbus_request_end (request, NULL);
+		g_dbus_method_invocation_return_error (invocation,
+		                                       G_DBUS_ERROR,
+		                                       G_DBUS_ERROR_NOT_SUPPORTED,
+		                                       "Miner does not index files");
+		return;
+	}
+
+	fs = TRACKER_MINER_FS (priv->miner);
+
+	tracker_dbus_request_end (request, NULL);
+	g_dbus_method_invocation_return_value (invocation,
+	                                       g_variant_new ("(dd)",
+	                                                      tracker_miner_fs_get_throttle (fs),
+	                                                      tracker_miner_fs_get_pacing (fs)));
+}
+
+static void
+handle_method_call_get_memory_usage (TrackerMinerProxy     *proxy,
+                                     GDBusMethodInvocation *invocation,
+                                     GVariant              *parameters)
+{
+	TrackerDBusRequest *request;
+
+	request = tracker_g_dbus_request_begin (invocation, "%s()", __PRETTY_FUNCTION__);
+
+	tracker_dbus_request_end (request, NULL);
+	g_dbus_method_invocation_return_value (invocation,
+	                                       tracker_memory_budget_get_usage (tracker_memory_budget_get_default ()));
+}
+
 static void
 handle_method_call (GDBusConnection       *connection,
                     const gchar           *sender,
@@ -636,6 +801,14 @@ handle_method_call (GDBusConnection       *connection,
 		handle_method_call_get_progress (proxy, invocation, parameters);
 	} else if (g_strcmp0 (method_name, "GetStatus") == 0) {
 		handle_method_call_get_status (proxy, invocation, parameters);
+	} else if (g_strcmp0 (method_name, "GetProgressStatistics") == 0) {
+		handle_method_call_get_progress_statistics (proxy, invocation, parameters);
+	} else if (g_strcmp0 (method_name, "GetCommitLatency") == 0) {
+		handle_method_call_get_commit_latency (proxy, invocation, parameters);
+	} else if (g_strcmp0 (method_name, "GetPacing") == 0) {
+		handle_method_call_get_pacing (proxy, invocation, parameters);
+	} else if (g_strcmp0 (method_name, "GetMemoryUsage") == 0) {
+		handle_method_call_get_memory_usage (proxy, invocation, parameters);
 	} else {
 		g_dbus_method_invocation_return_error (invocation,
 		                                       G_DBUS_ERROR,
@@ -687,10 +860,59 @@ emit_dbus_signal (TrackerMinerProxy *proxy,
 	                               NULL);
 }
 
+static void
+emit_progress (TrackerMinerProxy *proxy)
+{
+	TrackerMinerProxyPrivate *priv;
+	GVariant *variant;
+
+	priv = tracker_miner_proxy_get_instance_private (proxy);
+
+	variant = g_variant_new ("(sdi)",
+	                         priv->pending_status ? priv->pending_status : "",
+	                         priv->pending_progress,
+	                         priv->pending_remaining_time);
+	/* variant reference is sunk here */
+	emit_dbus_signal (proxy, "Progress", variant);
+
+	priv->last_progress_time = g_get_monotonic_time ();
+	priv->progress_signals++;
+}
+
+static gboolean
+progress_timeout_cb (gpointer user_data)
+{
+	TrackerMinerProxy *proxy = user_data;
+	TrackerMinerProxyPrivate *priv;
+
+	priv = tracker_miner_proxy_get_instance_private (proxy);
+	priv->progress_timeout_id = 0;
+	emit_progress (proxy);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+flush_pending_progress (TrackerMinerProxy *proxy)
+{
+	TrackerMinerProxyPrivate *priv;
+
+	priv = tracker_miner_proxy_get_instance_private (proxy);
+
+	/* Deliver any coalesced Progress before other state changes,
+	 * so clients see signals in the order they happened.
+	 */
+	if (priv->progress_timeout_id != 0) {
+		g_clear_handle_id (&priv->progress_timeout_id, g_source_remove);
+		emit_progress (proxy);
+	}
+}
+
 static void
 miner_started_cb (TrackerMiner      *miner,
                   TrackerMinerProxy *proxy)
 {
+	flush_pending_progress (proxy);
 	emit_dbus_signal (proxy, "Started", NULL);
 }
 
@@ -698,6 +920,7 @@ static void
 miner_stopped_cb (TrackerMiner      *miner,
                   TrackerMinerProxy *proxy)
 {
+	flush_pending_progress (proxy);
 	emit_dbus_signal (proxy, "Stopped", NULL);
 }
 
@@ -705,6 +928,7 @@ static void
 miner_paused_cb (TrackerMiner      *miner,
                  TrackerMinerProxy *proxy)
 {
+	flush_pending_progress (proxy);
 	emit_dbus_signal (proxy, "Paused", NULL);
 }
 
@@ -712,6 +936,7 @@ static void
 miner_resumed_cb (TrackerMiner      *miner,
                   TrackerMinerProxy *proxy)
 {
+	flush_pending_progress (proxy);
 	emit_dbus_signal (proxy, "Resumed", NULL);
 }
 
@@ -722,11 +947,36 @@ miner_progress_cb (TrackerMiner      *miner,
                    gint               remaining_time,
                    TrackerMinerProxy *proxy)
 {
-	GVariant *variant;
+	TrackerMinerProxyPrivate *priv;
+	gint64 interval, elapsed;
 
-	variant = g_variant_new ("(sdi)", status, progress, remaining_time);
-	/* variant reference is sunk here */
-	emit_dbus_signal (proxy, "Progress", variant);
+	priv = tracker_miner_proxy_get_instance_private (proxy);
+
+	g_free (priv->pending_status);
+	priv->pending_status = g_strdup (status);
+	priv->pending_progress = progress;
+	priv->pending_remaining_time = remaining_time;
+	priv->progress_updates++;
+
+	/* A timeout is already scheduled, it will pick up the latest values */
+	if (priv->progress_timeout_id != 0)
+		return;
+
+	if (priv->max_progress_rate == 0) {
+		emit_progress (proxy);
+		return;
+	}
+
+	interval = G_USEC_PER_SEC / priv->max_progress_rate;
+	elapsed = g_get_monotonic_time () - priv->last_progress_time;
+
+	if (priv->last_progress_time == 0 || elapsed >= interval) {
+		emit_progress (proxy);
+	} else {
+		priv->progress_timeout_id =
+			g_timeout_add (MAX (1, (interval - elapsed) / 1000),
+			               progress_timeout_cb, proxy);
+	}
 }
 
 static gboolean
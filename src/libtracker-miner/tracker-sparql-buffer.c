@@ -46,7 +46,8 @@ struct _TrackerSparqlBufferPrivate
 
 enum {
 	TASK_TYPE_RESOURCE,
-	TASK_TYPE_SPARQL
+	TASK_TYPE_SPARQL,
+	TASK_TYPE_STATEMENT,
 };
 
 struct _SparqlTaskData
@@ -62,6 +63,13 @@ struct _SparqlTaskData
 		struct {
 			gchar *sparql;
 		} sparql;
+
+		struct {
+			TrackerSparqlStatement *statement;
+			guint n_values;
+			const gchar * const *names;
+			GValue *values;
+		} statement;
 	} d;
 };
 
@@ -331,6 +339,30 @@ sparql_task_data_new_sparql (const gchar *sparql)
 	return task_data;
 }
 
+static SparqlTaskData *
+sparql_task_data_new_statement (TrackerSparqlStatement *statement,
+                                guint                   n_values,
+                                const gchar * const    *names,
+                                const GValue           *values)
+{
+	SparqlTaskData *task_data;
+	guint i;
+
+	task_data = g_slice_new0 (SparqlTaskData);
+	task_data->type = TASK_TYPE_STATEMENT;
+	task_data->d.statement.statement = g_object_ref (statement);
+	task_data->d.statement.n_values = n_values;
+	task_data->d.statement.names = names;
+	task_data->d.statement.values = g_new0 (GValue, n_values);
+
+	for (i = 0; i < n_values; i++) {
+		g_value_init (&task_data->d.statement.values[i], G_VALUE_TYPE (&values[i]));
+		g_value_copy (&values[i], &task_data->d.statement.values[i]);
+	}
+
+	return task_data;
+}
+
 static void
 sparql_task_data_free (SparqlTaskData *data)
 {
@@ -339,6 +371,14 @@ sparql_task_data_free (SparqlTaskData *data)
 		g_free (data->d.resource.graph);
 	} else if (data->type == TASK_TYPE_SPARQL) {
 		g_free (data->d.sparql.sparql);
+	} else if (data->type == TASK_TYPE_STATEMENT) {
+		guint i;
+
+		for (i = 0; i < data->d.statement.n_values; i++)
+			g_value_unset (&data->d.statement.values[i]);
+
+		g_free (data->d.statement.values);
+		g_clear_object (&data->d.statement.statement);
 	}
 
 	g_slice_free (SparqlTaskData, data);
@@ -393,6 +433,47 @@ tracker_sparql_buffer_push_sparql (TrackerSparqlBuffer *buffer,
 	tracker_task_unref (task);
 }
 
+/**
+ * tracker_sparql_buffer_push_statement:
+ * @buffer: a #TrackerSparqlBuffer
+ * @file: the file the update is about
+ * @statement: a prepared update statement
+ * @n_values: number of bound values
+ * @names: names of the parameters, must stay valid as long as @buffer
+ * @values: values for the parameters
+ *
+ * Queues @statement with the given parameters. This avoids the
+ * serialization and parsing roundtrip of tracker_sparql_buffer_push()
+ * for updates that follow a fixed template.
+ **/
+void
+tracker_sparql_buffer_push_statement (TrackerSparqlBuffer    *buffer,
+                                      GFile                  *file,
+                                      TrackerSparqlStatement *statement,
+                                      guint                   n_values,
+                                      const gchar * const    *names,
+                                      const GValue           *values)
+{
+	TrackerBatch *batch;
+	TrackerTask *task;
+	SparqlTaskData *data;
+
+	g_return_if_fail (TRACKER_IS_SPARQL_BUFFER (buffer));
+	g_return_if_fail (G_IS_FILE (file));
+	g_return_if_fail (TRACKER_IS_SPARQL_STATEMENT (statement));
+
+	batch = tracker_sparql_buffer_get_current_batch (buffer);
+	tracker_batch_add_statementv (batch, statement, n_values,
+	                              (const gchar **) names, values);
+
+	data = sparql_task_data_new_statement (statement, n_values, names, values);
+
+	task = tracker_task_new (file, data,
+	                         (GDestroyNotify) sparql_task_data_free);
+	sparql_buffer_push_to_pool (buffer, task);
+	tracker_task_unref (task);
+}
+
 gchar *
 tracker_sparql_task_get_sparql (TrackerTask *task)
 {
@@ -406,6 +487,23 @@ tracker_sparql_task_get_sparql (TrackerTask *task)
 		                                             task_data->d.resource.graph);
 	} else if (task_data->type == TASK_TYPE_SPARQL) {
 		return g_strdup (task_data->d.sparql.sparql);
+	} else if (task_data->type == TASK_TYPE_STATEMENT) {
+		GString *str;
+		guint i;
+
+		/* The statement, followed by the bound values as comments */
+		str = g_string_new (tracker_sparql_statement_get_sparql (task_data->d.statement.statement));
+
+		for (i = 0; i < task_data->d.statement.n_values; i++) {
+			gchar *value;
+
+			value = g_strdup_value_contents (&task_data->d.statement.values[i]);
+			g_string_append_printf (str, "\n# ~%s = %s",
+			                        task_data->d.statement.names[i], value);
+			g_free (value);
+		}
+
+		return g_string_free (str, FALSE);
 	}
 
 	return NULL;
@@ -80,6 +80,12 @@ void                 tracker_sparql_buffer_push (TrackerSparqlBuffer *buffer,
 void                 tracker_sparql_buffer_push_sparql (TrackerSparqlBuffer *buffer,
                                                         GFile               *file,
                                                         const gchar         *sparql);
+void                 tracker_sparql_buffer_push_statement (TrackerSparqlBuffer    *buffer,
+                                                           GFile                  *file,
+                                                           TrackerSparqlStatement *statement,
+                                                           guint                   n_values,
+                                                           const gchar * const    *names,
+                                                           const GValue           *values);
 
 TrackerSparqlBufferState tracker_sparql_buffer_get_state (TrackerSparqlBuffer *buffer,
                                                           GFile               *file);
@@ -34,3 +34,32 @@ tracker_accumulator_check_file (GSignalInvocationHint *hint,
 
 	return (use == TRUE);
 }
+
+/* Whether the content type of @file has to be sniffed from its
+ * contents, because @info only has the guess made from its name and
+ * the name matches no glob, or several conflicting ones (e.g. .ogg).
+ */
+gboolean
+tracker_file_info_needs_sniffing (GFile     *file,
+                                  GFileInfo *info)
+{
+	gchar *basename, *content_type;
+	gboolean uncertain = FALSE;
+
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE) ||
+	    !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE) ||
+	    g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR ||
+	    g_file_info_get_size (info) == 0)
+		return FALSE;
+
+	basename = g_file_get_basename (file);
+	content_type = g_content_type_guess (basename, NULL, 0, &uncertain);
+
+	if (g_content_type_is_unknown (content_type))
+		uncertain = TRUE;
+
+	g_free (content_type);
+	g_free (basename);
+
+	return uncertain;
+}
@@ -24,7 +24,7 @@
 #error "Only <libtracker-miner/tracker-miner.h> can be included directly."
 #endif
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -33,6 +33,9 @@ gboolean tracker_accumulator_check_file (GSignalInvocationHint *hint,
                                          const GValue          *handler_return,
                                          gpointer               accumulator_data);
 
+gboolean tracker_file_info_needs_sniffing (GFile     *file,
+                                           GFileInfo *info);
+
 G_END_DECLS
 
 #endif /* __LIBTRACKER_MINER_UTILS_H__ */
@@ -38,6 +38,10 @@
 #include "tracker-fts-config.h"
 #include "tracker-ioprio.h"
 #include "tracker-language.h"
+#include "tracker-memory-budget.h"
+#include "tracker-mount-trie.h"
+#include "tracker-pressure.h"
+#include "tracker-rate-limiter.h"
 #include "tracker-sched.h"
 #include "tracker-seccomp.h"
 #include "tracker-term-utils.h"
@@ -20,6 +20,7 @@
 
 #include "config-miners.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -43,6 +44,7 @@
 
 #include "tracker-file-utils.h"
 #include "tracker-type-utils.h"
+#include "tracker-mount-trie.h"
 
 #define TEXT_SNIFF_SIZE 4096
 
@@ -724,74 +726,188 @@ tracker_filename_casecmp_without_extension (const gchar *a,
 	return g_ascii_strncasecmp (a, b, len_a) == 0;
 }
 
-typedef struct {
-	GFile *file;
-	gchar *mount_point;
-	gchar *id;
-} UnixMountInfo;
-
 typedef struct {
 	GUnixMountMonitor *monitor;
 	blkid_cache id_cache;
-	GArray *mounts;
-	GRWLock lock;
+	/* Serializes updates only. Lookups take no lock: the current
+	 * trie is published atomically, and lookups count themselves
+	 * in the slot of the current epoch. A replaced trie is freed
+	 * after a grace period, once both slots drained.
+	 */
+	GMutex mutex;
+	TrackerMountTrie *mounts;
+	gint epoch;
+	gint readers[2];
 } TrackerUnixMountCache;
 
-static gint
-sort_by_mount (gconstpointer a,
-	       gconstpointer b)
+static gboolean
+read_rotational (const gchar *sysfs_path,
+                 gboolean    *rotational)
 {
-	const UnixMountInfo *info_a =a, *info_b = b;
+	gchar *path, *contents;
+	gboolean retval;
+
+	path = g_build_filename (sysfs_path, "queue", "rotational", NULL);
+	retval = g_file_get_contents (path, &contents, NULL, NULL);
+	g_free (path);
 
-	return g_strcmp0 (info_a->mount_point, info_b->mount_point);
+	if (retval) {
+		*rotational = contents[0] == '1';
+		g_free (contents);
+	}
+
+	return retval;
+}
+
+/**
+ * tracker_file_system_lookup_device:
+ * @sysfs_root: where sysfs is mounted, usually "/sys"
+ * @devname: device path of a mount, as in the mount table
+ * @fs_type: filesystem type of the mount
+ * @device: (out) (transfer none): return location for the interned
+ *          name of the device
+ *
+ * Finds the block device backing a mount, partitions are resolved
+ * to their disk so they share scheduling. If no block device is
+ * found, @device is set to @devname.
+ *
+ * Returns: the type of the device
+ **/
+TrackerDeviceType
+tracker_file_system_lookup_device (const gchar  *sysfs_root,
+                                   const gchar  *devname,
+                                   const gchar  *fs_type,
+                                   const gchar **device)
+{
+	const gchar *remote_types[] = {
+		"nfs", "nfs4", "cifs", "smb3", "smbfs", "9p", "afs",
+		"ceph", "glusterfs", "fuse.sshfs", "fuse.davfs", "davfs",
+	};
+	gchar *dev_path, *dev_name, *sysfs_path, *real_sysfs_path, *disk_path = NULL;
+	TrackerDeviceType type = TRACKER_DEVICE_TYPE_UNKNOWN;
+	gboolean rotational;
+	gint i;
+
+	*device = g_intern_string (devname);
+
+	for (i = 0; i < G_N_ELEMENTS (remote_types); i++) {
+		if (g_strcmp0 (fs_type, remote_types[i]) == 0)
+			return TRACKER_DEVICE_TYPE_REMOTE;
+	}
+
+	if (!g_str_has_prefix (devname, "/dev/"))
+		return TRACKER_DEVICE_TYPE_UNKNOWN;
+
+	/* Resolve /dev/disk/by-* and /dev/mapper links */
+	dev_path = realpath (devname, NULL);
+	dev_name = g_path_get_basename (dev_path ? dev_path : devname);
+
+	sysfs_path = g_build_filename (sysfs_root, "class", "block", dev_name, NULL);
+	real_sysfs_path = realpath (sysfs_path, NULL);
+
+	if (real_sysfs_path) {
+		if (read_rotational (real_sysfs_path, &rotational)) {
+			disk_path = g_strdup (real_sysfs_path);
+		} else {
+			disk_path = g_path_get_dirname (real_sysfs_path);
+
+			if (!read_rotational (disk_path, &rotational))
+				g_clear_pointer (&disk_path, g_free);
+		}
+	}
+
+	if (disk_path) {
+		gchar *disk = g_path_get_basename (disk_path);
+
+		*device = g_intern_string (disk);
+		type = rotational ?
+			TRACKER_DEVICE_TYPE_ROTATIONAL :
+			TRACKER_DEVICE_TYPE_SOLID_STATE;
+		g_free (disk);
+	}
+
+	g_free (disk_path);
+	free (real_sysfs_path);
+	g_free (sysfs_path);
+	g_free (dev_name);
+	free (dev_path);
+
+	return type;
+}
+
+static TrackerMountTrie *
+lookup_enter (TrackerUnixMountCache *cache,
+              gint                  *slot)
+{
+	*slot = g_atomic_int_get (&cache->epoch) & 1;
+	g_atomic_int_inc (&cache->readers[*slot]);
+
+	return g_atomic_pointer_get (&cache->mounts);
 }
 
 static void
-clear_mount_info (gpointer user_data)
+lookup_leave (TrackerUnixMountCache *cache,
+              gint                   slot)
 {
-	UnixMountInfo *info = user_data;
+	g_atomic_int_add (&cache->readers[slot], -1);
+}
 
-	g_object_unref (info->file);
-	g_free (info->mount_point);
-	g_free (info->id);
+/* Waits for the lookups that may still see the trie replaced
+ * before this call. Flipping the epoch sends new lookups to the
+ * other slot, so the one drained is not refilled meanwhile.
+ */
+static void
+synchronize_lookups (TrackerUnixMountCache *cache)
+{
+	gint i, slot;
+
+	for (i = 0; i < 2; i++) {
+		slot = g_atomic_int_add (&cache->epoch, 1) & 1;
+
+		while (g_atomic_int_get (&cache->readers[slot]) > 0)
+			g_thread_yield ();
+	}
 }
 
 static void
 update_mounts (TrackerUnixMountCache *cache)
 {
+	TrackerMountTrie *trie, *old;
 	GList *mounts;
 	const GList *l;
 
-	g_rw_lock_writer_lock (&cache->lock);
-
-	g_array_set_size (cache->mounts, 0);
-
+	trie = tracker_mount_trie_new ();
 	mounts = g_unix_mounts_get (NULL);
 
 	for (l = mounts; l; l = l->next) {
 		GUnixMountEntry *entry = l->data;
-		const gchar *devname;
+		TrackerDeviceType device_type;
+		const gchar *devname, *device;
 		gchar *id;
-		UnixMountInfo mount;
 
 		devname = g_unix_mount_get_device_path (entry);
 		id = blkid_get_tag_value (cache->id_cache, "UUID", devname);
 		if (!id && strchr (devname, G_DIR_SEPARATOR) != NULL)
 			id = g_strdup (devname);
 
-		if (!id)
-			continue;
-
-		mount.mount_point = g_strdup (g_unix_mount_get_mount_path (entry));
-		mount.file = g_file_new_for_path (mount.mount_point);
-		mount.id = id;
-		g_array_append_val (cache->mounts, mount);
+		device_type = tracker_file_system_lookup_device ("/sys", devname,
+		                                                 g_unix_mount_get_fs_type (entry),
+		                                                 &device);
+		tracker_mount_trie_add (trie, g_unix_mount_get_mount_path (entry),
+		                        id, device, device_type);
+		g_free (id);
 	}
 
-	g_array_sort (cache->mounts, sort_by_mount);
-
-	g_rw_lock_writer_unlock (&cache->lock);
 	g_list_free_full (mounts, (GDestroyNotify) g_unix_mount_free);
+
+	g_mutex_lock (&cache->mutex);
+	old = g_atomic_pointer_get (&cache->mounts);
+	g_atomic_pointer_set (&cache->mounts, trie);
+	synchronize_lookups (cache);
+	g_mutex_unlock (&cache->mutex);
+
+	if (old)
+		tracker_mount_trie_unref (old);
 }
 
 static void
@@ -807,47 +923,42 @@ static TrackerUnixMountCache *
 tracker_unix_mount_cache_get (void)
 {
 	static TrackerUnixMountCache *cache = NULL;
-	TrackerUnixMountCache *obj;
 
-	if (cache == NULL) {
+	if (g_once_init_enter (&cache)) {
+		TrackerUnixMountCache *obj;
+
 		obj = g_new0 (TrackerUnixMountCache, 1);
-		g_rw_lock_init (&obj->lock);
 		obj->monitor = g_unix_mount_monitor_get ();
-		obj->mounts = g_array_new (FALSE, FALSE, sizeof (UnixMountInfo));
-		g_array_set_clear_func (obj->mounts, clear_mount_info);
+		g_mutex_init (&obj->mutex);
 
 		blkid_get_cache (&obj->id_cache, NULL);
 
 		g_signal_connect (obj->monitor, "mounts-changed",
 				  G_CALLBACK (on_mounts_changed), obj);
 		update_mounts (obj);
-		cache = obj;
+		g_once_init_leave (&cache, obj);
 	}
 
 	return cache;
 }
 
-static const gchar *
+static gchar *
 tracker_unix_mount_cache_lookup_filesystem_id (GFile *file)
 {
 	TrackerUnixMountCache *cache;
-	const gchar *id = NULL;
-	gint i;
+	TrackerMountTrie *trie;
+	const gchar *path;
+	gchar *id = NULL;
+	gint slot;
 
-	cache = tracker_unix_mount_cache_get ();
-
-	g_rw_lock_reader_lock (&cache->lock);
-
-	for (i = (gint) cache->mounts->len - 1; i >= 0; i--) {
-		UnixMountInfo *info = &g_array_index (cache->mounts, UnixMountInfo, i);
-
-		if (g_file_has_prefix (file, info->file)) {
-			id = info->id;
-			break;
-		}
-	}
+	path = g_file_peek_path (file);
+	if (!path)
+		return NULL;
 
-	g_rw_lock_reader_unlock (&cache->lock);
+	cache = tracker_unix_mount_cache_get ();
+	trie = lookup_enter (cache, &slot);
+	tracker_mount_trie_lookup (trie, path, &id, NULL, NULL);
+	lookup_leave (cache, slot);
 
 	return id;
 }
@@ -866,8 +977,7 @@ tracker_file_get_content_identifier (GFile       *file,
                                      GFileInfo   *info,
                                      const gchar *suffix)
 {
-	const gchar *id;
-	gchar *inode, *str;
+	gchar *id, *inode, *str;
 
 	if (info) {
 		g_object_ref (info);
@@ -885,8 +995,8 @@ tracker_file_get_content_identifier (GFile       *file,
 	id = tracker_unix_mount_cache_lookup_filesystem_id (file);
 
 	if (!id) {
-		id = g_file_info_get_attribute_string (info,
-		                                       G_FILE_ATTRIBUTE_ID_FILESYSTEM);
+		id = g_strdup (g_file_info_get_attribute_string (info,
+		                                                 G_FILE_ATTRIBUTE_ID_FILESYSTEM));
 	}
 
 	inode = g_file_info_get_attribute_as_string (info, G_FILE_ATTRIBUTE_UNIX_INODE);
@@ -897,6 +1007,43 @@ tracker_file_get_content_identifier (GFile       *file,
 
 	g_object_unref (info);
 	g_free (inode);
+	g_free (id);
 
 	return str;
 }
+
+/**
+ * tracker_file_get_device:
+ * @file: a #GFile
+ * @type: (out) (optional): return location for the device type
+ *
+ * Finds the device backing the mount point that @file lives in,
+ * for I/O to be scheduled per device.
+ *
+ * Returns: (nullable): an interned string identifying the device,
+ *          or %NULL if unknown
+ **/
+const gchar *
+tracker_file_get_device (GFile             *file,
+                         TrackerDeviceType *type)
+{
+	TrackerUnixMountCache *cache;
+	TrackerMountTrie *trie;
+	const gchar *path, *device = NULL;
+	gint slot;
+
+	if (type)
+		*type = TRACKER_DEVICE_TYPE_UNKNOWN;
+
+	path = g_file_peek_path (file);
+	if (!path)
+		return NULL;
+
+	/* Devices are interned, they outlive the trie */
+	cache = tracker_unix_mount_cache_get ();
+	trie = lookup_enter (cache, &slot);
+	tracker_mount_trie_lookup (trie, path, NULL, &device, type);
+	lookup_leave (cache, slot);
+
+	return device;
+}
@@ -31,6 +31,13 @@ G_BEGIN_DECLS
 #error "only <libtracker-miners-common/tracker-common.h> must be included directly."
 #endif
 
+typedef enum {
+	TRACKER_DEVICE_TYPE_UNKNOWN,
+	TRACKER_DEVICE_TYPE_SOLID_STATE,
+	TRACKER_DEVICE_TYPE_ROTATIONAL,
+	TRACKER_DEVICE_TYPE_REMOTE,
+} TrackerDeviceType;
+
 /* File utils */
 int      tracker_file_open_fd                               (const gchar *path);
 FILE*    tracker_file_open                                  (const gchar *path);
@@ -49,6 +56,9 @@ void     tracker_content_identifier_cache_init              (void);
 gchar *  tracker_file_get_content_identifier                (GFile       *file,
                                                              GFileInfo   *info,
                                                              const gchar *suffix);
+const gchar *
+         tracker_file_get_device                            (GFile             *file,
+                                                             TrackerDeviceType *type);
 
 /* Path utils */
 gboolean tracker_path_is_in_path                            (const gchar *path,
@@ -64,6 +74,11 @@ gboolean tracker_filename_casecmp_without_extension         (const gchar *a,
 /* File system utils */
 guint64  tracker_file_system_get_remaining_space            (const gchar *path);
 gdouble  tracker_file_system_get_remaining_space_percentage (const gchar *path);
+TrackerDeviceType
+         tracker_file_system_lookup_device                  (const gchar  *sysfs_root,
+                                                             const gchar  *devname,
+                                                             const gchar  *fs_type,
+                                                             const gchar **device);
 
 G_END_DECLS
 
@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include "tracker-debug.h"
+#include "tracker-memory-budget.h"
+
+#define CHECK_INTERVAL_SECONDS 5
+
+/* Once over budget, usage has to go this far below the
+ * limit before things go back to normal.
+ */
+#define LOW_WATER_RATIO 0.9
+
+/* Low memory warnings are one-off, the critical state is held
+ * this long after one before looking at the budget again.
+ */
+#define CRITICAL_HOLD_SECONDS 30
+
+typedef struct {
+	guint id;
+	gchar *name;
+	TrackerMemoryReportFunc report_func;
+	TrackerMemoryShedFunc shed_func;
+	gpointer user_data;
+} Consumer;
+
+struct _TrackerMemoryBudget {
+	GObject parent_instance;
+	GArray *consumers;
+	guint next_id;
+	gsize limit;
+	guint check_id;
+	gint64 critical_until;
+	TrackerMemoryBudgetState state;
+};
+
+enum {
+	PROP_0,
+	PROP_LIMIT,
+	PROP_STATE,
+	N_PROPS
+};
+
+static GParamSpec *props[N_PROPS] = { 0, };
+
+G_DEFINE_TYPE (TrackerMemoryBudget, tracker_memory_budget, G_TYPE_OBJECT)
+
+static void
+consumer_clear (gpointer data)
+{
+	Consumer *consumer = data;
+
+	g_free (consumer->name);
+}
+
+static gsize
+get_total_usage (TrackerMemoryBudget *budget)
+{
+	gsize total = 0;
+	guint i;
+
+	for (i = 0; i < budget->consumers->len; i++) {
+		Consumer *consumer = &g_array_index (budget->consumers, Consumer, i);
+
+		total += consumer->report_func (consumer->user_data);
+	}
+
+	return total;
+}
+
+static void
+set_state (TrackerMemoryBudget      *budget,
+           TrackerMemoryBudgetState  state)
+{
+	if (budget->state == state)
+		return;
+
+	TRACKER_NOTE (CONFIG, g_message ("Memory budget state changed to %d", state));
+	budget->state = state;
+	g_object_notify_by_pspec (G_OBJECT (budget), props[PROP_STATE]);
+}
+
+static void
+shed_consumers (TrackerMemoryBudget      *budget,
+                TrackerMemoryBudgetState  state)
+{
+	guint i;
+
+	for (i = 0; i < budget->consumers->len; i++) {
+		Consumer *consumer = &g_array_index (budget->consumers, Consumer, i);
+
+		if (consumer->shed_func)
+			consumer->shed_func (state, consumer->user_data);
+	}
+}
+
+static gboolean
+check_cb (gpointer user_data)
+{
+	tracker_memory_budget_check (user_data);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+tracker_memory_budget_finalize (GObject *object)
+{
+	TrackerMemoryBudget *budget = TRACKER_MEMORY_BUDGET (object);
+
+	if (budget->check_id)
+		g_source_remove (budget->check_id);
+
+	g_array_unref (budget->consumers);
+
+	G_OBJECT_CLASS (tracker_memory_budget_parent_class)->finalize (object);
+}
+
+static void
+tracker_memory_budget_set_property (GObject      *object,
+                                    guint         prop_id,
+                                    const GValue *value,
+                                    GParamSpec   *pspec)
+{
+	TrackerMemoryBudget *budget = TRACKER_MEMORY_BUDGET (object);
+
+	switch (prop_id) {
+	case PROP_LIMIT:
+		tracker_memory_budget_set_limit (budget, g_value_get_uint64 (value));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
+static void
+tracker_memory_budget_get_property (GObject    *object,
+                                    guint       prop_id,
+                                    GValue     *value,
+                                    GParamSpec *pspec)
+{
+	TrackerMemoryBudget *budget = TRACKER_MEMORY_BUDGET (object);
+
+	switch (prop_id) {
+	case PROP_LIMIT:
+		g_value_set_uint64 (value, budget->limit);
+		break;
+	case PROP_STATE:
+		g_value_set_int (value, budget->state);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
+static void
+tracker_memory_budget_class_init (TrackerMemoryBudgetClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = tracker_memory_budget_finalize;
+	object_class->set_property = tracker_memory_budget_set_property;
+	object_class->get_property = tracker_memory_budget_get_property;
+
+	props[PROP_LIMIT] =
+		g_param_spec_uint64 ("limit",
+		                     "Limit",
+		                     "Memory budget in bytes, or 0 for no limit",
+		                     0, G_MAXUINT64, 0,
+		                     G_PARAM_READWRITE |
+		                     G_PARAM_STATIC_STRINGS);
+	props[PROP_STATE] =
+		g_param_spec_int ("state",
+		                  "State",
+		                  "A TrackerMemoryBudgetState",
+		                  TRACKER_MEMORY_BUDGET_OK,
+		                  TRACKER_MEMORY_BUDGET_CRITICAL,
+		                  TRACKER_MEMORY_BUDGET_OK,
+		                  G_PARAM_READABLE |
+		                  G_PARAM_STATIC_STRINGS);
+
+	g_object_class_install_properties (object_class, N_PROPS, props);
+}
+
+static void
+tracker_memory_budget_init (TrackerMemoryBudget *budget)
+{
+	budget->consumers = g_array_new (FALSE, FALSE, sizeof (Consumer));
+	g_array_set_clear_func (budget->consumers, consumer_clear);
+	budget->next_id = 1;
+}
+
+TrackerMemoryBudget *
+tracker_memory_budget_new (void)
+{
+	return g_object_new (TRACKER_TYPE_MEMORY_BUDGET, NULL);
+}
+
+/**
+ * tracker_memory_budget_get_default:
+ *
+ * Returns the memory budget shared by all the caches and queues
+ * in the process.
+ *
+ * Returns: (transfer none): the default #TrackerMemoryBudget
+ **/
+TrackerMemoryBudget *
+tracker_memory_budget_get_default (void)
+{
+	static TrackerMemoryBudget *budget = NULL;
+
+	if (g_once_init_enter (&budget)) {
+		TrackerMemoryBudget *obj;
+
+		obj = tracker_memory_budget_new ();
+		g_once_init_leave (&budget, obj);
+	}
+
+	return budget;
+}
+
+/**
+ * tracker_memory_budget_register:
+ * @budget: a #TrackerMemoryBudget
+ * @name: name of the subsystem, used when reporting usage
+ * @report_func: function returning the memory used by the subsystem
+ * @shed_func: (nullable): function releasing memory when asked to
+ * @user_data: data for @report_func and @shed_func
+ *
+ * Adds a subsystem whose memory is accounted in the budget. Its
+ * usage is polled periodically, and it is asked to shed memory
+ * while the budget is exceeded or the system is low on memory.
+ *
+ * Returns: an ID for tracker_memory_budget_unregister()
+ **/
+guint
+tracker_memory_budget_register (TrackerMemoryBudget     *budget,
+                                const gchar             *name,
+                                TrackerMemoryReportFunc  report_func,
+                                TrackerMemoryShedFunc    shed_func,
+                                gpointer                 user_data)
+{
+	Consumer consumer;
+
+	g_return_val_if_fail (TRACKER_IS_MEMORY_BUDGET (budget), 0);
+	g_return_val_if_fail (name != NULL, 0);
+	g_return_val_if_fail (report_func != NULL, 0);
+
+	consumer.id = budget->next_id++;
+	consumer.name = g_strdup (name);
+	consumer.report_func = report_func;
+	consumer.shed_func = shed_func;
+	consumer.user_data = user_data;
+	g_array_append_val (budget->consumers, consumer);
+
+	return consumer.id;
+}
+
+void
+tracker_memory_budget_unregister (TrackerMemoryBudget *budget,
+                                  guint                id)
+{
+	guint i;
+
+	g_return_if_fail (TRACKER_IS_MEMORY_BUDGET (budget));
+
+	for (i = 0; i < budget->consumers->len; i++) {
+		Consumer *consumer = &g_array_index (budget->consumers, Consumer, i);
+
+		if (consumer->id == id) {
+			g_array_remove_index (budget->consumers, i);
+			return;
+		}
+	}
+}
+
+void
+tracker_memory_budget_set_limit (TrackerMemoryBudget *budget,
+                                 gsize                limit)
+{
+	g_return_if_fail (TRACKER_IS_MEMORY_BUDGET (budget));
+
+	if (budget->limit == limit)
+		return;
+
+	budget->limit = limit;
+
+	/* Usage is only polled while there is a limit to keep */
+	if (limit > 0 && budget->check_id == 0) {
+		budget->check_id = g_timeout_add_seconds (CHECK_INTERVAL_SECONDS,
+		                                          check_cb, budget);
+	} else if (limit == 0 && budget->check_id != 0) {
+		g_source_remove (budget->check_id);
+		budget->check_id = 0;
+	}
+
+	g_object_notify_by_pspec (G_OBJECT (budget), props[PROP_LIMIT]);
+	tracker_memory_budget_check (budget);
+}
+
+static gboolean
+limit_get_mapping (GValue   *value,
+                   GVariant *variant,
+                   gpointer  user_data)
+{
+	/* The setting is in MiB */
+	g_value_set_uint64 (value, (guint64) MAX (g_variant_get_int32 (variant), 0) * 1024 * 1024);
+	return TRUE;
+}
+
+/**
+ * tracker_memory_budget_bind_limit:
+ * @budget: a #TrackerMemoryBudget
+ * @settings: a #GSettings
+ * @key: an integer key holding the limit in MiB
+ *
+ * Keeps the limit of @budget in sync with @key, 0 meaning no limit.
+ **/
+void
+tracker_memory_budget_bind_limit (TrackerMemoryBudget *budget,
+                                  GSettings           *settings,
+                                  const gchar         *key)
+{
+	g_return_if_fail (TRACKER_IS_MEMORY_BUDGET (budget));
+	g_return_if_fail (G_IS_SETTINGS (settings));
+
+	g_settings_bind_with_mapping (settings, key,
+	                              budget, "limit",
+	                              G_SETTINGS_BIND_GET,
+	                              limit_get_mapping, NULL,
+	                              NULL, NULL);
+}
+
+gsize
+tracker_memory_budget_get_limit (TrackerMemoryBudget *budget)
+{
+	g_return_val_if_fail (TRACKER_IS_MEMORY_BUDGET (budget), 0);
+
+	return budget->limit;
+}
+
+TrackerMemoryBudgetState
+tracker_memory_budget_get_state (TrackerMemoryBudget *budget)
+{
+	g_return_val_if_fail (TRACKER_IS_MEMORY_BUDGET (budget), TRACKER_MEMORY_BUDGET_OK);
+
+	return budget->state;
+}
+
+/**
+ * tracker_memory_budget_check:
+ * @budget: a #TrackerMemoryBudget
+ *
+ * Polls the memory used by every subsystem, asking them to shed
+ * memory if over budget. This happens periodically on its own.
+ **/
+void
+tracker_memory_budget_check (TrackerMemoryBudget *budget)
+{
+	TrackerMemoryBudgetState state = TRACKER_MEMORY_BUDGET_OK;
+	gsize total;
+
+	g_return_if_fail (TRACKER_IS_MEMORY_BUDGET (budget));
+
+	if (budget->critical_until > g_get_monotonic_time ())
+		return;
+
+	total = get_total_usage (budget);
+
+	if (budget->limit > 0) {
+		if (total > budget->limit) {
+			shed_consumers (budget, TRACKER_MEMORY_BUDGET_OVER);
+			total = get_total_usage (budget);
+		}
+
+		if (total > budget->limit ||
+		    (budget->state != TRACKER_MEMORY_BUDGET_OK &&
+		     total > budget->limit * LOW_WATER_RATIO))
+			state = TRACKER_MEMORY_BUDGET_OVER;
+	}
+
+	set_state (budget, state);
+}
+
+/**
+ * tracker_memory_budget_shed:
+ * @budget: a #TrackerMemoryBudget
+ * @state: the reason to shed memory
+ *
+ * Asks every subsystem to shed memory right away, e.g. on a low
+ * memory warning from the system. A %TRACKER_MEMORY_BUDGET_CRITICAL
+ * state holds for a while regardless of usage.
+ **/
+void
+tracker_memory_budget_shed (TrackerMemoryBudget      *budget,
+                            TrackerMemoryBudgetState  state)
+{
+	g_return_if_fail (TRACKER_IS_MEMORY_BUDGET (budget));
+
+	if (state == TRACKER_MEMORY_BUDGET_OK)
+		return;
+
+	if (state == TRACKER_MEMORY_BUDGET_CRITICAL) {
+		budget->critical_until = g_get_monotonic_time () +
+			CRITICAL_HOLD_SECONDS * G_USEC_PER_SEC;
+	}
+
+	shed_consumers (budget, state);
+	set_state (budget, MAX (budget->state, state));
+}
+
+/**
+ * tracker_memory_budget_get_usage:
+ * @budget: a #TrackerMemoryBudget
+ *
+ * Returns the state, the limit and the memory used by every
+ * subsystem, as a "(uta{st})" #GVariant.
+ *
+ * Returns: (transfer floating): a #GVariant
+ **/
+GVariant *
+tracker_memory_budget_get_usage (TrackerMemoryBudget *budget)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_return_val_if_fail (TRACKER_IS_MEMORY_BUDGET (budget), NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{st}"));
+
+	for (i = 0; i < budget->consumers->len; i++) {
+		Consumer *consumer = &g_array_index (budget->consumers, Consumer, i);
+
+		g_variant_builder_add (&builder, "{st}", consumer->name,
+		                       (guint64) consumer->report_func (consumer->user_data));
+	}
+
+	return g_variant_new ("(uta{st})",
+	                      (guint32) budget->state,
+	                      (guint64) budget->limit,
+	                      &builder);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_COMMON_MEMORY_BUDGET_H__
+#define __LIBTRACKER_COMMON_MEMORY_BUDGET_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#if !defined (__LIBTRACKER_COMMON_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "only <libtracker-miners-common/tracker-common.h> must be included directly."
+#endif
+
+typedef enum {
+	TRACKER_MEMORY_BUDGET_OK,
+	TRACKER_MEMORY_BUDGET_OVER,
+	TRACKER_MEMORY_BUDGET_CRITICAL,
+} TrackerMemoryBudgetState;
+
+/* Returns the approximate memory used by a subsystem, in bytes */
+typedef gsize (* TrackerMemoryReportFunc) (gpointer user_data);
+
+/* Asks a subsystem to release whatever memory it can */
+typedef void  (* TrackerMemoryShedFunc)   (TrackerMemoryBudgetState state,
+                                           gpointer                 user_data);
+
+#define TRACKER_TYPE_MEMORY_BUDGET (tracker_memory_budget_get_type ())
+
+G_DECLARE_FINAL_TYPE (TrackerMemoryBudget,
+		      tracker_memory_budget,
+		      TRACKER, MEMORY_BUDGET,
+		      GObject)
+
+TrackerMemoryBudget * tracker_memory_budget_new         (void);
+TrackerMemoryBudget * tracker_memory_budget_get_default (void);
+
+guint  tracker_memory_budget_register   (TrackerMemoryBudget     *budget,
+                                         const gchar             *name,
+                                         TrackerMemoryReportFunc  report_func,
+                                         TrackerMemoryShedFunc    shed_func,
+                                         gpointer                 user_data);
+void   tracker_memory_budget_unregister (TrackerMemoryBudget     *budget,
+                                         guint                    id);
+
+void   tracker_memory_budget_set_limit  (TrackerMemoryBudget     *budget,
+                                         gsize                    limit);
+gsize  tracker_memory_budget_get_limit  (TrackerMemoryBudget     *budget);
+void   tracker_memory_budget_bind_limit (TrackerMemoryBudget     *budget,
+                                         GSettings               *settings,
+                                         const gchar             *key);
+
+TrackerMemoryBudgetState
+       tracker_memory_budget_get_state  (TrackerMemoryBudget     *budget);
+
+void   tracker_memory_budget_check      (TrackerMemoryBudget     *budget);
+void   tracker_memory_budget_shed       (TrackerMemoryBudget      *budget,
+                                         TrackerMemoryBudgetState  state);
+
+GVariant * tracker_memory_budget_get_usage (TrackerMemoryBudget *budget);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_COMMON_MEMORY_BUDGET_H__ */
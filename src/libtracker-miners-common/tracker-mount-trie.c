@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include <string.h>
+
+#include "tracker-mount-trie.h"
+
+/* Mount points are kept in a trie of path components, every node
+ * holding the filesystem ID and backing device if it is a mount
+ * point. A trie is not modified after being published, mount changes
+ * build a new one. Readers hold a reference for as long as they
+ * walk it, and everything they get out of it is copied or interned.
+ */
+typedef struct _MountNode MountNode;
+
+struct _MountNode {
+	gchar *component;
+	gsize len;
+	gchar *id;
+	const gchar *device;
+	TrackerDeviceType device_type;
+	MountNode *children;
+	MountNode *next;
+};
+
+struct _TrackerMountTrie {
+	MountNode root;
+};
+
+static void
+mount_node_free (MountNode *node)
+{
+	while (node) {
+		MountNode *next = node->next;
+
+		mount_node_free (node->children);
+		g_free (node->component);
+		g_free (node->id);
+		g_slice_free (MountNode, node);
+		node = next;
+	}
+}
+
+static MountNode *
+mount_node_lookup_child (MountNode   *node,
+                         const gchar *component,
+                         gsize        len)
+{
+	MountNode *child;
+
+	for (child = node->children; child; child = child->next) {
+		if (child->len == len &&
+		    memcmp (child->component, component, len) == 0)
+			return child;
+	}
+
+	return NULL;
+}
+
+static void
+mount_trie_clear (TrackerMountTrie *trie)
+{
+	mount_node_free (trie->root.children);
+	g_free (trie->root.id);
+}
+
+TrackerMountTrie *
+tracker_mount_trie_new (void)
+{
+	return g_atomic_rc_box_new0 (TrackerMountTrie);
+}
+
+TrackerMountTrie *
+tracker_mount_trie_ref (TrackerMountTrie *trie)
+{
+	return g_atomic_rc_box_acquire (trie);
+}
+
+void
+tracker_mount_trie_unref (TrackerMountTrie *trie)
+{
+	g_atomic_rc_box_release_full (trie, (GDestroyNotify) mount_trie_clear);
+}
+
+/**
+ * tracker_mount_trie_add:
+ * @trie: a #TrackerMountTrie not yet visible to other threads
+ * @mount_point: path of the mount point
+ * @id: (nullable): filesystem ID of the mount
+ * @device: (nullable): device backing the mount
+ * @device_type: type of @device
+ *
+ * Adds a mount point to @trie. Later mounts on the same path shadow
+ * earlier ones, as in the mount table.
+ **/
+void
+tracker_mount_trie_add (TrackerMountTrie  *trie,
+                        const gchar       *mount_point,
+                        const gchar       *id,
+                        const gchar       *device,
+                        TrackerDeviceType  device_type)
+{
+	MountNode *node = &trie->root;
+	const gchar *p = mount_point;
+
+	while (*p) {
+		MountNode *child;
+		const gchar *end;
+
+		while (*p == G_DIR_SEPARATOR)
+			p++;
+		if (!*p)
+			break;
+
+		end = strchr (p, G_DIR_SEPARATOR);
+		if (!end)
+			end = p + strlen (p);
+
+		child = mount_node_lookup_child (node, p, end - p);
+
+		if (!child) {
+			child = g_slice_new0 (MountNode);
+			child->component = g_strndup (p, end - p);
+			child->len = end - p;
+			child->next = node->children;
+			node->children = child;
+		}
+
+		node = child;
+		p = end;
+	}
+
+	g_free (node->id);
+	node->id = g_strdup (id);
+	node->device = g_intern_string (device);
+	node->device_type = device_type;
+}
+
+/**
+ * tracker_mount_trie_lookup:
+ * @trie: a #TrackerMountTrie
+ * @path: an absolute path
+ * @id: (out) (optional) (transfer full): return location for the
+ *      filesystem ID
+ * @device: (out) (optional) (transfer none): return location for the
+ *          interned device name
+ * @device_type: (out) (optional): return location for the device type
+ *
+ * Finds the deepest mount point that is a strict parent of @path.
+ * The filesystem ID and device are looked up separately, a mount
+ * without either falls back to the one it is mounted on.
+ *
+ * Returns: %TRUE if a mount was found.
+ **/
+gboolean
+tracker_mount_trie_lookup (TrackerMountTrie   *trie,
+                           const gchar        *path,
+                           gchar             **id,
+                           const gchar       **device,
+                           TrackerDeviceType  *device_type)
+{
+	MountNode *node = &trie->root, *id_node = NULL, *device_node = NULL;
+	const gchar *p = path;
+
+	while (node) {
+		const gchar *end;
+
+		while (*p == G_DIR_SEPARATOR)
+			p++;
+		if (!*p)
+			break;
+
+		if (node->id)
+			id_node = node;
+		if (node->device)
+			device_node = node;
+
+		end = strchr (p, G_DIR_SEPARATOR);
+		if (!end)
+			end = p + strlen (p);
+
+		node = mount_node_lookup_child (node, p, end - p);
+		p = end;
+	}
+
+	if (id)
+		*id = id_node ? g_strdup (id_node->id) : NULL;
+	if (device)
+		*device = device_node ? device_node->device : NULL;
+	if (device_type) {
+		*device_type = device_node ?
+			device_node->device_type : TRACKER_DEVICE_TYPE_UNKNOWN;
+	}
+
+	return id_node != NULL || device_node != NULL;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_COMMON_MOUNT_TRIE_H__
+#define __LIBTRACKER_COMMON_MOUNT_TRIE_H__
+
+#include <glib.h>
+
+#include "tracker-file-utils.h"
+
+G_BEGIN_DECLS
+
+#if !defined (__LIBTRACKER_COMMON_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "only <libtracker-miners-common/tracker-common.h> must be included directly."
+#endif
+
+typedef struct _TrackerMountTrie TrackerMountTrie;
+
+TrackerMountTrie * tracker_mount_trie_new    (void);
+TrackerMountTrie * tracker_mount_trie_ref    (TrackerMountTrie  *trie);
+void               tracker_mount_trie_unref  (TrackerMountTrie  *trie);
+
+void               tracker_mount_trie_add    (TrackerMountTrie  *trie,
+                                              const gchar       *mount_point,
+                                              const gchar       *id,
+                                              const gchar       *device,
+                                              TrackerDeviceType  device_type);
+gboolean           tracker_mount_trie_lookup (TrackerMountTrie  *trie,
+                                              const gchar       *path,
+                                              gchar            **id,
+                                              const gchar      **device,
+                                              TrackerDeviceType *device_type);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_COMMON_MOUNT_TRIE_H__ */
@@ -0,0 +1,514 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include <string.h>
+
+#include "tracker-debug.h"
+#include "tracker-pressure.h"
+
+/* Pressure stall information is sampled this often, the kernel
+ * averages it over 10 seconds so there is no use in going faster.
+ */
+#define SAMPLE_INTERVAL_SECONDS 2
+
+/* Pressure above the target gives up this fraction of the remaining
+ * headroom at once, pressure below TARGET_LOW times the target gives
+ * back RECOVERY_STEP per sample. Backing off fast and recovering
+ * slowly keeps the loop from oscillating around the target.
+ */
+#define BACKOFF_FACTOR 0.5
+#define RECOVERY_STEP 0.05
+#define TARGET_LOW 0.75
+
+#define PACING_EPSILON 0.001
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+static const gchar *resource_names[] = {
+	"cpu",
+	"io",
+	"memory",
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (resource_names) == TRACKER_N_PRESSURE_RESOURCES);
+
+struct _TrackerPressure {
+	GObject parent_instance;
+	gchar *path;
+	/* Files are "<resource>.pressure" in cgroups */
+	const gchar *suffix;
+	gboolean available;
+	guint sample_id;
+
+	gint targets[TRACKER_N_PRESSURE_RESOURCES];
+	gdouble levels[TRACKER_N_PRESSURE_RESOURCES];
+	gdouble pacing;
+};
+
+enum {
+	PROP_0,
+	PROP_PATH,
+	PROP_CPU_TARGET,
+	PROP_IO_TARGET,
+	PROP_MEMORY_TARGET,
+	PROP_PACING,
+	N_PROPS
+};
+
+static GParamSpec *props[N_PROPS] = { 0, };
+
+G_DEFINE_TYPE (TrackerPressure, tracker_pressure, G_TYPE_OBJECT)
+
+/* Finds the cgroup v2 directory of the process, pressure there only
+ * accounts for stalls of the service itself rather than the whole
+ * system.
+ */
+static gchar *
+find_cgroup_path (void)
+{
+	gchar *contents, **lines, *path = NULL;
+	gint i;
+
+	if (!g_file_get_contents ("/proc/self/cgroup", &contents, NULL, NULL))
+		return NULL;
+
+	lines = g_strsplit (contents, "\n", -1);
+
+	for (i = 0; lines[i]; i++) {
+		if (g_str_has_prefix (lines[i], "0::")) {
+			path = g_build_filename (CGROUP_ROOT,
+			                         lines[i] + strlen ("0::"),
+			                         NULL);
+			break;
+		}
+	}
+
+	g_strfreev (lines);
+	g_free (contents);
+
+	return path;
+}
+
+/* Reads the "some avg10" value of a PSI file, which is the
+ * percentage of time at least one task was stalled on the
+ * resource over the last 10 seconds.
+ */
+static gdouble
+read_pressure (TrackerPressure         *pressure,
+               TrackerPressureResource  resource)
+{
+	gchar *filename, *basename, *contents = NULL, *p;
+	gdouble level = -1;
+
+	basename = g_strconcat (resource_names[resource], pressure->suffix, NULL);
+	filename = g_build_filename (pressure->path, basename, NULL);
+	g_free (basename);
+
+	if (g_file_get_contents (filename, &contents, NULL, NULL)) {
+		p = strstr (contents, "some avg10=");
+
+		if (p) {
+			gchar *end;
+			gdouble value;
+
+			p += strlen ("some avg10=");
+			value = g_ascii_strtod (p, &end);
+
+			if (end != p)
+				level = CLAMP (value, 0, 100);
+		}
+	}
+
+	g_free (contents);
+	g_free (filename);
+
+	return level;
+}
+
+static void
+set_pacing (TrackerPressure *pressure,
+            gdouble          pacing)
+{
+	/* Snap to the ends, so full speed is reached */
+	if (pacing < PACING_EPSILON)
+		pacing = 0;
+	else if (pacing > 1 - PACING_EPSILON)
+		pacing = 1;
+
+	if (pressure->pacing == pacing)
+		return;
+
+	pressure->pacing = pacing;
+	g_object_notify_by_pspec (G_OBJECT (pressure), props[PROP_PACING]);
+}
+
+static gboolean
+sample_cb (gpointer user_data)
+{
+	tracker_pressure_update (user_data);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+tracker_pressure_constructed (GObject *object)
+{
+	TrackerPressure *pressure = TRACKER_PRESSURE (object);
+
+	G_OBJECT_CLASS (tracker_pressure_parent_class)->constructed (object);
+
+	if (!pressure->path) {
+		pressure->path = find_cgroup_path ();
+		pressure->suffix = ".pressure";
+
+		/* Not in a cgroup v2 hierarchy, or in the root cgroup
+		 * that has no pressure files of its own.
+		 */
+		if (!pressure->path ||
+		    read_pressure (pressure, TRACKER_PRESSURE_CPU) < 0) {
+			g_free (pressure->path);
+			pressure->path = g_strdup (TRACKER_PRESSURE_DEFAULT_PATH);
+			pressure->suffix = "";
+		}
+	} else {
+		pressure->suffix = "";
+
+		if (read_pressure (pressure, TRACKER_PRESSURE_CPU) < 0)
+			pressure->suffix = ".pressure";
+	}
+
+	/* Kernels without PSI, or with it disabled, have no such files
+	 * and leave the miners running at their configured pace.
+	 */
+	pressure->available =
+		read_pressure (pressure, TRACKER_PRESSURE_CPU) >= 0;
+
+	if (!pressure->available) {
+		TRACKER_NOTE (CONFIG, g_message ("Pressure stall information not available at '%s'",
+		                                 pressure->path));
+		return;
+	}
+
+	tracker_pressure_update (pressure);
+	pressure->sample_id = g_timeout_add_seconds (SAMPLE_INTERVAL_SECONDS,
+	                                             sample_cb, pressure);
+}
+
+static void
+tracker_pressure_finalize (GObject *object)
+{
+	TrackerPressure *pressure = TRACKER_PRESSURE (object);
+
+	if (pressure->sample_id)
+		g_source_remove (pressure->sample_id);
+
+	g_free (pressure->path);
+
+	G_OBJECT_CLASS (tracker_pressure_parent_class)->finalize (object);
+}
+
+static void
+tracker_pressure_set_property (GObject      *object,
+                               guint         prop_id,
+                               const GValue *value,
+                               GParamSpec   *pspec)
+{
+	TrackerPressure *pressure = TRACKER_PRESSURE (object);
+
+	switch (prop_id) {
+	case PROP_PATH:
+		pressure->path = g_value_dup_string (value);
+		break;
+	case PROP_CPU_TARGET:
+		tracker_pressure_set_target (pressure, TRACKER_PRESSURE_CPU,
+		                             g_value_get_int (value));
+		break;
+	case PROP_IO_TARGET:
+		tracker_pressure_set_target (pressure, TRACKER_PRESSURE_IO,
+		                             g_value_get_int (value));
+		break;
+	case PROP_MEMORY_TARGET:
+		tracker_pressure_set_target (pressure, TRACKER_PRESSURE_MEMORY,
+		                             g_value_get_int (value));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
+static void
+tracker_pressure_get_property (GObject    *object,
+                               guint       prop_id,
+                               GValue     *value,
+                               GParamSpec *pspec)
+{
+	TrackerPressure *pressure = TRACKER_PRESSURE (object);
+
+	switch (prop_id) {
+	case PROP_PATH:
+		g_value_set_string (value, pressure->path);
+		break;
+	case PROP_CPU_TARGET:
+		g_value_set_int (value, pressure->targets[TRACKER_PRESSURE_CPU]);
+		break;
+	case PROP_IO_TARGET:
+		g_value_set_int (value, pressure->targets[TRACKER_PRESSURE_IO]);
+		break;
+	case PROP_MEMORY_TARGET:
+		g_value_set_int (value, pressure->targets[TRACKER_PRESSURE_MEMORY]);
+		break;
+	case PROP_PACING:
+		g_value_set_double (value, pressure->pacing);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
+static void
+tracker_pressure_class_init (TrackerPressureClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->constructed = tracker_pressure_constructed;
+	object_class->finalize = tracker_pressure_finalize;
+	object_class->set_property = tracker_pressure_set_property;
+	object_class->get_property = tracker_pressure_get_property;
+
+	props[PROP_PATH] =
+		g_param_spec_string ("path",
+		                     "Path",
+		                     "Directory containing the PSI files, or NULL for the cgroup of the process",
+		                     NULL,
+		                     G_PARAM_READWRITE |
+		                     G_PARAM_CONSTRUCT_ONLY |
+		                     G_PARAM_STATIC_STRINGS);
+	props[PROP_CPU_TARGET] =
+		g_param_spec_int ("cpu-target",
+		                  "CPU target",
+		                  "CPU pressure to stay under, in percent, or 0 to ignore",
+		                  0, 100, 20,
+		                  G_PARAM_READWRITE |
+		                  G_PARAM_CONSTRUCT |
+		                  G_PARAM_STATIC_STRINGS);
+	props[PROP_IO_TARGET] =
+		g_param_spec_int ("io-target",
+		                  "IO target",
+		                  "IO pressure to stay under, in percent, or 0 to ignore",
+		                  0, 100, 10,
+		                  G_PARAM_READWRITE |
+		                  G_PARAM_CONSTRUCT |
+		                  G_PARAM_STATIC_STRINGS);
+	props[PROP_MEMORY_TARGET] =
+		g_param_spec_int ("memory-target",
+		                  "Memory target",
+		                  "Memory pressure to stay under, in percent, or 0 to ignore",
+		                  0, 100, 5,
+		                  G_PARAM_READWRITE |
+		                  G_PARAM_CONSTRUCT |
+		                  G_PARAM_STATIC_STRINGS);
+	props[PROP_PACING] =
+		g_param_spec_double ("pacing",
+		                     "Pacing",
+		                     "How much to slow down, from 0 (full speed) to 1",
+		                     0, 1, 0,
+		                     G_PARAM_READABLE |
+		                     G_PARAM_STATIC_STRINGS);
+
+	g_object_class_install_properties (object_class, N_PROPS, props);
+}
+
+static void
+tracker_pressure_init (TrackerPressure *pressure)
+{
+	gint i;
+
+	for (i = 0; i < TRACKER_N_PRESSURE_RESOURCES; i++)
+		pressure->levels[i] = -1;
+}
+
+/**
+ * tracker_pressure_new:
+ * @path: (nullable): directory containing the PSI files, either a
+ *   cgroup directory or %TRACKER_PRESSURE_DEFAULT_PATH
+ *
+ * Creates a controller that samples Linux pressure stall information
+ * and turns it into a pacing value, raised while any resource is under
+ * more pressure than its target and lowered back while there is spare
+ * capacity.
+ *
+ * With a %NULL @path, the cgroup of the process is sampled, so only
+ * stalls of the service count, falling back to the system wide
+ * %TRACKER_PRESSURE_DEFAULT_PATH where cgroups have no PSI files.
+ *
+ * Returns: (transfer full): a new #TrackerPressure
+ **/
+TrackerPressure *
+tracker_pressure_new (const gchar *path)
+{
+	return g_object_new (TRACKER_TYPE_PRESSURE,
+	                     "path", path,
+	                     NULL);
+}
+
+gboolean
+tracker_pressure_is_available (TrackerPressure *pressure)
+{
+	g_return_val_if_fail (TRACKER_IS_PRESSURE (pressure), FALSE);
+
+	return pressure->available;
+}
+
+/**
+ * tracker_pressure_update:
+ * @pressure: a #TrackerPressure
+ *
+ * Samples the PSI files and runs one step of the control loop. This
+ * happens periodically on its own, it is only exposed for tests.
+ **/
+void
+tracker_pressure_update (TrackerPressure *pressure)
+{
+	gdouble ratio = 0;
+	gint i;
+
+	g_return_if_fail (TRACKER_IS_PRESSURE (pressure));
+
+	for (i = 0; i < TRACKER_N_PRESSURE_RESOURCES; i++) {
+		pressure->levels[i] = read_pressure (pressure, i);
+
+		if (pressure->levels[i] < 0 || pressure->targets[i] == 0)
+			continue;
+
+		ratio = MAX (ratio, pressure->levels[i] / pressure->targets[i]);
+	}
+
+	if (ratio >= 1)
+		set_pacing (pressure, pressure->pacing + (1 - pressure->pacing) * BACKOFF_FACTOR);
+	else if (ratio < TARGET_LOW)
+		set_pacing (pressure, pressure->pacing - RECOVERY_STEP);
+
+	TRACKER_NOTE (CONFIG, g_message ("Pressure cpu:%.2f io:%.2f memory:%.2f, pacing at %.3f",
+	                                 pressure->levels[TRACKER_PRESSURE_CPU],
+	                                 pressure->levels[TRACKER_PRESSURE_IO],
+	                                 pressure->levels[TRACKER_PRESSURE_MEMORY],
+	                                 pressure->pacing));
+}
+
+gdouble
+tracker_pressure_get_pacing (TrackerPressure *pressure)
+{
+	g_return_val_if_fail (TRACKER_IS_PRESSURE (pressure), 0);
+
+	return pressure->pacing;
+}
+
+/**
+ * tracker_pressure_scale_limit:
+ * @pressure: a #TrackerPressure
+ * @max: the limit at full speed
+ *
+ * Scales a limit, e.g. on work done at once, with the current
+ * pacing: full speed allows @max, full pacing allows 1.
+ *
+ * Returns: the limit to apply, between 1 and @max
+ **/
+guint
+tracker_pressure_scale_limit (TrackerPressure *pressure,
+                              guint            max)
+{
+	g_return_val_if_fail (TRACKER_IS_PRESSURE (pressure), 1);
+
+	max = MAX (max, 1);
+
+	return max - (guint) (pressure->pacing * (max - 1) + 0.5);
+}
+
+/**
+ * tracker_pressure_get_level:
+ * @pressure: a #TrackerPressure
+ * @resource: the resource to query
+ *
+ * Returns: the last sampled pressure on @resource in percent,
+ *   or -1 if unknown.
+ **/
+gdouble
+tracker_pressure_get_level (TrackerPressure         *pressure,
+                            TrackerPressureResource  resource)
+{
+	g_return_val_if_fail (TRACKER_IS_PRESSURE (pressure), -1);
+	g_return_val_if_fail (resource < TRACKER_N_PRESSURE_RESOURCES, -1);
+
+	return pressure->levels[resource];
+}
+
+void
+tracker_pressure_set_target (TrackerPressure         *pressure,
+                             TrackerPressureResource  resource,
+                             gint                     target)
+{
+	static const guint target_props[] = {
+		PROP_CPU_TARGET,
+		PROP_IO_TARGET,
+		PROP_MEMORY_TARGET,
+	};
+
+	g_return_if_fail (TRACKER_IS_PRESSURE (pressure));
+	g_return_if_fail (resource < TRACKER_N_PRESSURE_RESOURCES);
+
+	target = CLAMP (target, 0, 100);
+
+	if (pressure->targets[resource] == target)
+		return;
+
+	pressure->targets[resource] = target;
+	g_object_notify_by_pspec (G_OBJECT (pressure),
+	                          props[target_props[resource]]);
+}
+
+/**
+ * tracker_pressure_get_state:
+ * @pressure: a #TrackerPressure
+ *
+ * Returns the current pacing and the last sampled pressure on each
+ * resource, as a "a{sd}" dictionary with "pacing", "cpu", "io" and
+ * "memory" keys.
+ *
+ * Returns: (transfer floating): a #GVariant
+ **/
+GVariant *
+tracker_pressure_get_state (TrackerPressure *pressure)
+{
+	GVariantBuilder builder;
+	gint i;
+
+	g_return_val_if_fail (TRACKER_IS_PRESSURE (pressure), NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sd}"));
+	g_variant_builder_add (&builder, "{sd}", "pacing", pressure->pacing);
+
+	for (i = 0; i < TRACKER_N_PRESSURE_RESOURCES; i++) {
+		g_variant_builder_add (&builder, "{sd}",
+		                       resource_names[i], pressure->levels[i]);
+	}
+
+	return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_COMMON_PRESSURE_H__
+#define __LIBTRACKER_COMMON_PRESSURE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#if !defined (__LIBTRACKER_COMMON_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "only <libtracker-miners-common/tracker-common.h> must be included directly."
+#endif
+
+#define TRACKER_PRESSURE_DEFAULT_PATH "/proc/pressure"
+
+typedef enum {
+	TRACKER_PRESSURE_CPU,
+	TRACKER_PRESSURE_IO,
+	TRACKER_PRESSURE_MEMORY,
+	TRACKER_N_PRESSURE_RESOURCES
+} TrackerPressureResource;
+
+#define TRACKER_TYPE_PRESSURE (tracker_pressure_get_type ())
+
+G_DECLARE_FINAL_TYPE (TrackerPressure,
+		      tracker_pressure,
+		      TRACKER, PRESSURE,
+		      GObject)
+
+TrackerPressure * tracker_pressure_new          (const gchar     *path);
+
+gboolean          tracker_pressure_is_available (TrackerPressure *pressure);
+void              tracker_pressure_update       (TrackerPressure *pressure);
+
+gdouble           tracker_pressure_get_pacing   (TrackerPressure         *pressure);
+guint             tracker_pressure_scale_limit  (TrackerPressure         *pressure,
+                                                 guint                    max);
+gdouble           tracker_pressure_get_level    (TrackerPressure         *pressure,
+                                                 TrackerPressureResource  resource);
+void              tracker_pressure_set_target   (TrackerPressure         *pressure,
+                                                 TrackerPressureResource  resource,
+                                                 gint                     target);
+
+GVariant *        tracker_pressure_get_state    (TrackerPressure *pressure);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_COMMON_PRESSURE_H__ */
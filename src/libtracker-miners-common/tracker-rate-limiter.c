@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include "tracker-rate-limiter.h"
+
+/* Unused budget accumulates for at most this long, so an idle
+ * period is followed by a short burst rather than a long one.
+ */
+#define BURST_SECONDS 1
+
+typedef struct {
+	gdouble rate;
+	gdouble tokens;
+} Bucket;
+
+struct _TrackerRateLimiter {
+	GObject parent_instance;
+	GMutex mutex;
+	Bucket files;
+	Bucket bytes;
+	gint64 last_refill;
+	TrackerRateLimiterClockFunc clock_func;
+	gpointer clock_data;
+};
+
+enum {
+	PROP_0,
+	PROP_FILE_RATE,
+	PROP_READ_RATE,
+	N_PROPS
+};
+
+static GParamSpec *props[N_PROPS] = { 0, };
+
+G_DEFINE_TYPE (TrackerRateLimiter, tracker_rate_limiter, G_TYPE_OBJECT)
+
+static void
+bucket_set_rate (Bucket  *bucket,
+                 gdouble  rate)
+{
+	bucket->rate = rate;
+	bucket->tokens = rate * BURST_SECONDS;
+}
+
+static void
+bucket_refill (Bucket  *bucket,
+               gdouble  elapsed)
+{
+	if (bucket->rate == 0)
+		return;
+
+	bucket->tokens = MIN (bucket->tokens + bucket->rate * elapsed,
+	                      bucket->rate * BURST_SECONDS);
+}
+
+static void
+bucket_consume (Bucket  *bucket,
+                gdouble  amount)
+{
+	/* Tokens may go negative, the debt is paid by waiting */
+	if (bucket->rate > 0)
+		bucket->tokens -= amount;
+}
+
+static gint64
+bucket_get_delay (Bucket *bucket)
+{
+	if (bucket->rate == 0 || bucket->tokens >= 0)
+		return 0;
+
+	return (gint64) ((-bucket->tokens / bucket->rate) * G_USEC_PER_SEC) + 1;
+}
+
+static gint64
+get_time (TrackerRateLimiter *limiter)
+{
+	if (limiter->clock_func)
+		return limiter->clock_func (limiter->clock_data);
+
+	return g_get_monotonic_time ();
+}
+
+/* Must be called with the mutex held */
+static void
+refill (TrackerRateLimiter *limiter)
+{
+	gint64 now;
+	gdouble elapsed;
+
+	now = get_time (limiter);
+	elapsed = (gdouble) (now - limiter->last_refill) / G_USEC_PER_SEC;
+	limiter->last_refill = now;
+
+	bucket_refill (&limiter->files, elapsed);
+	bucket_refill (&limiter->bytes, elapsed);
+}
+
+static void
+tracker_rate_limiter_finalize (GObject *object)
+{
+	TrackerRateLimiter *limiter = TRACKER_RATE_LIMITER (object);
+
+	g_mutex_clear (&limiter->mutex);
+
+	G_OBJECT_CLASS (tracker_rate_limiter_parent_class)->finalize (object);
+}
+
+static void
+tracker_rate_limiter_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+	TrackerRateLimiter *limiter = TRACKER_RATE_LIMITER (object);
+
+	switch (prop_id) {
+	case PROP_FILE_RATE:
+		tracker_rate_limiter_set_file_rate (limiter, g_value_get_int (value));
+		break;
+	case PROP_READ_RATE:
+		tracker_rate_limiter_set_read_rate (limiter,
+		                                    (guint64) g_value_get_int (value) * 1024);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
+static void
+tracker_rate_limiter_get_property (GObject    *object,
+                                   guint       prop_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+	TrackerRateLimiter *limiter = TRACKER_RATE_LIMITER (object);
+
+	switch (prop_id) {
+	case PROP_FILE_RATE:
+		g_value_set_int (value, (gint) limiter->files.rate);
+		break;
+	case PROP_READ_RATE:
+		g_value_set_int (value, (gint) (limiter->bytes.rate / 1024));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
+static void
+tracker_rate_limiter_class_init (TrackerRateLimiterClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = tracker_rate_limiter_finalize;
+	object_class->set_property = tracker_rate_limiter_set_property;
+	object_class->get_property = tracker_rate_limiter_get_property;
+
+	props[PROP_FILE_RATE] =
+		g_param_spec_int ("file-rate",
+		                  "File rate",
+		                  "Files handled per second, or 0 for no limit",
+		                  0, G_MAXINT, 0,
+		                  G_PARAM_READWRITE |
+		                  G_PARAM_STATIC_STRINGS);
+	props[PROP_READ_RATE] =
+		g_param_spec_int ("read-rate",
+		                  "Read rate",
+		                  "KiB read from storage per second, or 0 for no limit",
+		                  0, G_MAXINT, 0,
+		                  G_PARAM_READWRITE |
+		                  G_PARAM_STATIC_STRINGS);
+
+	g_object_class_install_properties (object_class, N_PROPS, props);
+}
+
+static void
+tracker_rate_limiter_init (TrackerRateLimiter *limiter)
+{
+	g_mutex_init (&limiter->mutex);
+	limiter->last_refill = g_get_monotonic_time ();
+}
+
+TrackerRateLimiter *
+tracker_rate_limiter_new (void)
+{
+	return g_object_new (TRACKER_TYPE_RATE_LIMITER, NULL);
+}
+
+/**
+ * tracker_rate_limiter_get_default:
+ *
+ * Returns the rate limiter shared by everything crawling, indexing
+ * or extracting files in the process.
+ *
+ * Returns: (transfer none): the default #TrackerRateLimiter
+ **/
+TrackerRateLimiter *
+tracker_rate_limiter_get_default (void)
+{
+	static TrackerRateLimiter *limiter = NULL;
+
+	if (g_once_init_enter (&limiter))
+		g_once_init_leave (&limiter, tracker_rate_limiter_new ());
+
+	return limiter;
+}
+
+/**
+ * tracker_rate_limiter_set_clock:
+ * @limiter: a #TrackerRateLimiter
+ * @clock_func: (nullable): function returning the current time, or
+ *   %NULL for g_get_monotonic_time()
+ * @user_data: data for @clock_func
+ *
+ * Replaces the clock used to refill the budget. This is only
+ * meant for tests.
+ **/
+void
+tracker_rate_limiter_set_clock (TrackerRateLimiter          *limiter,
+                                TrackerRateLimiterClockFunc  clock_func,
+                                gpointer                     user_data)
+{
+	g_return_if_fail (TRACKER_IS_RATE_LIMITER (limiter));
+
+	g_mutex_lock (&limiter->mutex);
+	limiter->clock_func = clock_func;
+	limiter->clock_data = user_data;
+	limiter->last_refill = get_time (limiter);
+	g_mutex_unlock (&limiter->mutex);
+}
+
+void
+tracker_rate_limiter_set_file_rate (TrackerRateLimiter *limiter,
+                                    guint               files_per_second)
+{
+	g_return_if_fail (TRACKER_IS_RATE_LIMITER (limiter));
+
+	g_mutex_lock (&limiter->mutex);
+
+	if (limiter->files.rate == files_per_second) {
+		g_mutex_unlock (&limiter->mutex);
+		return;
+	}
+
+	bucket_set_rate (&limiter->files, files_per_second);
+	g_mutex_unlock (&limiter->mutex);
+
+	g_object_notify_by_pspec (G_OBJECT (limiter), props[PROP_FILE_RATE]);
+}
+
+void
+tracker_rate_limiter_set_read_rate (TrackerRateLimiter *limiter,
+                                    guint64             bytes_per_second)
+{
+	g_return_if_fail (TRACKER_IS_RATE_LIMITER (limiter));
+
+	g_mutex_lock (&limiter->mutex);
+
+	if (limiter->bytes.rate == bytes_per_second) {
+		g_mutex_unlock (&limiter->mutex);
+		return;
+	}
+
+	bucket_set_rate (&limiter->bytes, bytes_per_second);
+	g_mutex_unlock (&limiter->mutex);
+
+	g_object_notify_by_pspec (G_OBJECT (limiter), props[PROP_READ_RATE]);
+}
+
+/**
+ * tracker_rate_limiter_consume:
+ * @limiter: a #TrackerRateLimiter
+ * @n_files: number of files handled
+ * @n_bytes: bytes read from storage
+ *
+ * Accounts work done against the budget. This may be called
+ * from any thread.
+ **/
+void
+tracker_rate_limiter_consume (TrackerRateLimiter *limiter,
+                              guint               n_files,
+                              guint64             n_bytes)
+{
+	g_return_if_fail (TRACKER_IS_RATE_LIMITER (limiter));
+
+	g_mutex_lock (&limiter->mutex);
+	refill (limiter);
+	bucket_consume (&limiter->files, n_files);
+	bucket_consume (&limiter->bytes, n_bytes);
+	g_mutex_unlock (&limiter->mutex);
+}
+
+/**
+ * tracker_rate_limiter_get_delay:
+ * @limiter: a #TrackerRateLimiter
+ *
+ * Returns how long to wait before doing more work so the
+ * configured rates are respected.
+ *
+ * Returns: the delay in microseconds, 0 if there is budget left
+ **/
+gint64
+tracker_rate_limiter_get_delay (TrackerRateLimiter *limiter)
+{
+	gint64 delay;
+
+	g_return_val_if_fail (TRACKER_IS_RATE_LIMITER (limiter), 0);
+
+	g_mutex_lock (&limiter->mutex);
+	refill (limiter);
+	delay = MAX (bucket_get_delay (&limiter->files),
+	             bucket_get_delay (&limiter->bytes));
+	g_mutex_unlock (&limiter->mutex);
+
+	return delay;
+}
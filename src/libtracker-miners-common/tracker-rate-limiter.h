@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __LIBTRACKER_COMMON_RATE_LIMITER_H__
+#define __LIBTRACKER_COMMON_RATE_LIMITER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#if !defined (__LIBTRACKER_COMMON_INSIDE__) && !defined (TRACKER_COMPILATION)
+#error "only <libtracker-miners-common/tracker-common.h> must be included directly."
+#endif
+
+/* Returns the current time in microseconds, as g_get_monotonic_time() */
+typedef gint64 (* TrackerRateLimiterClockFunc) (gpointer user_data);
+
+#define TRACKER_TYPE_RATE_LIMITER (tracker_rate_limiter_get_type ())
+
+G_DECLARE_FINAL_TYPE (TrackerRateLimiter,
+		      tracker_rate_limiter,
+		      TRACKER, RATE_LIMITER,
+		      GObject)
+
+TrackerRateLimiter * tracker_rate_limiter_new         (void);
+TrackerRateLimiter * tracker_rate_limiter_get_default (void);
+
+void   tracker_rate_limiter_set_clock     (TrackerRateLimiter          *limiter,
+                                           TrackerRateLimiterClockFunc  clock_func,
+                                           gpointer                     user_data);
+
+void   tracker_rate_limiter_set_file_rate (TrackerRateLimiter *limiter,
+                                           guint               files_per_second);
+void   tracker_rate_limiter_set_read_rate (TrackerRateLimiter *limiter,
+                                           guint64             bytes_per_second);
+
+void   tracker_rate_limiter_consume       (TrackerRateLimiter *limiter,
+                                           guint               n_files,
+                                           guint64             n_bytes);
+gint64 tracker_rate_limiter_get_delay     (TrackerRateLimiter *limiter);
+
+G_END_DECLS
+
+#endif /* __LIBTRACKER_COMMON_RATE_LIMITER_H__ */
@@ -233,3 +233,26 @@ tracker_utf8_truncate (const gchar  *str,
 
 	return retv;
 }
+
+/**
+ * tracker_latency_bucket:
+ * @usecs: Elapsed time in microseconds
+ *
+ * Returns the latency histogram bucket for @usecs, bucket N holds
+ * times under 2^N milliseconds.
+ *
+ * Returns: A bucket index below %TRACKER_LATENCY_N_BUCKETS
+ */
+guint
+tracker_latency_bucket (gint64 usecs)
+{
+	gint64 limit = 1000;
+	guint bucket = 0;
+
+	while (bucket < TRACKER_LATENCY_N_BUCKETS - 1 && usecs >= limit) {
+		limit *= 2;
+		bucket++;
+	}
+
+	return bucket;
+}
@@ -25,6 +25,11 @@
 
 G_BEGIN_DECLS
 
+/* Latency histograms have power of two buckets in milliseconds,
+ * the last one holds everything that took longer.
+ */
+#define TRACKER_LATENCY_N_BUCKETS 16
+
 #if !defined (__LIBTRACKER_COMMON_INSIDE__) && !defined (TRACKER_COMPILATION)
 #error "only <libtracker-miners-common/tracker-common.h> must be included directly."
 #endif
@@ -45,6 +50,7 @@ gchar *  tracker_strhex                     (const guint8 *data,
                                              gchar         delimiter);
 gchar *  tracker_utf8_truncate              (const gchar  *str,
                                              gsize         max_size);
+guint    tracker_latency_bucket             (gint64        usecs);
 
 G_END_DECLS
 
@@ -39,6 +39,11 @@ struct _TrackerExtractWatchdog {
 	guint extractor_watchdog_id;
 	guint progress_signal_id;
 	gboolean initializing;
+
+	/* Last status forwarded, to drop redundant updates */
+	gchar *last_status;
+	gdouble last_progress;
+	gint last_remaining;
 };
 
 static void extract_watchdog_start (TrackerExtractWatchdog *watchdog,
@@ -78,6 +83,20 @@ on_extract_progress_cb (GDBusConnection *conn,
 
 	g_variant_get (parameters, "(&sdi)",
 	               &status, &progress, &remaining);
+
+	/* Extractor progress is already rate limited on its side, but
+	 * identical updates would still wake up the miner for nothing.
+	 */
+	if (g_strcmp0 (status, watchdog->last_status) == 0 &&
+	    progress == watchdog->last_progress &&
+	    remaining == watchdog->last_remaining)
+		return;
+
+	g_free (watchdog->last_status);
+	watchdog->last_status = g_strdup (status);
+	watchdog->last_progress = progress;
+	watchdog->last_remaining = remaining;
+
 	g_signal_emit (watchdog, signals[STATUS], 0,
 	               status, progress, (gint) remaining);
 }
@@ -171,6 +190,7 @@ tracker_extract_watchdog_finalize (GObject *object)
 	TrackerExtractWatchdog *watchdog = TRACKER_EXTRACT_WATCHDOG (object);
 
 	extract_watchdog_stop (watchdog);
+	g_free (watchdog->last_status);
 	g_free (watchdog->domain);
 
 	G_OBJECT_CLASS (tracker_extract_watchdog_parent_class)->finalize (object);
@@ -58,9 +58,14 @@
 #define DBUS_PATH "/org/freedesktop/Tracker3/Miner/Files"
 #define LOCALE_FILENAME "locale-for-miner-apps.txt"
 
+/* Number of locations stat()ed per thread when handling
+ * files handed through the Index interface.
+ */
+#define PROXY_STAT_BATCH_SIZE 256
+
 static GMainLoop *main_loop;
 static GDBusProxy *index_proxy;
-static GPtrArray *proxy_folders;
+static GHashTable *proxy_locations;
 static guint cleanup_id;
 
 static gint initial_sleep = -1;
@@ -471,8 +476,14 @@ on_low_memory (GMemoryMonitor            *monitor,
                GMemoryMonitorWarningLevel level,
                gpointer                   user_data)
 {
-	if (level > G_MEMORY_MONITOR_WARNING_LEVEL_LOW)
+	TrackerMemoryBudget *budget = tracker_memory_budget_get_default ();
+
+	if (level > G_MEMORY_MONITOR_WARNING_LEVEL_LOW) {
+		tracker_memory_budget_shed (budget, TRACKER_MEMORY_BUDGET_CRITICAL);
 		release_heap_memory ();
+	} else {
+		tracker_memory_budget_shed (budget, TRACKER_MEMORY_BUDGET_OVER);
+	}
 }
 #endif
 
@@ -841,12 +852,189 @@ setup_connection_and_endpoint (TrackerDomainOntology    *domain,
 	return TRUE;
 }
 
+typedef struct {
+	GPtrArray *files;
+	GPtrArray *infos;
+} ProxyStatBatch;
+
+static void
+proxy_stat_batch_free (ProxyStatBatch *batch)
+{
+	guint i;
+
+	for (i = 0; i < batch->infos->len; i++) {
+		GFileInfo *file_info = g_ptr_array_index (batch->infos, i);
+
+		if (file_info)
+			g_object_unref (file_info);
+	}
+
+	g_ptr_array_unref (batch->files);
+	g_ptr_array_unref (batch->infos);
+	g_slice_free (ProxyStatBatch, batch);
+}
+
+static void
+notify_locations_indexed (GStrv    uris,
+                          gboolean folders)
+{
+	if (!index_proxy)
+		return;
+
+	/* The control side reports each IndexLocations call once all
+	 * of its locations were notified, and drops indexed files
+	 * from IndexedLocations.
+	 */
+	g_dbus_proxy_call (index_proxy,
+	                   "NotifyLocationsIndexed",
+	                   g_variant_new ("(^asb)", uris, folders),
+	                   G_DBUS_CALL_FLAGS_NONE,
+	                   -1, NULL, NULL, NULL);
+}
+
+static void
+proxy_check_files_cb (GObject      *object,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+	GStrv uris = user_data;
+	GError *error = NULL;
+
+	if (!tracker_miner_fs_check_files_finish (TRACKER_MINER_FS (object),
+	                                          res, &error)) {
+		g_warning ("Could not index files: %s", error->message);
+		g_error_free (error);
+	} else {
+		notify_locations_indexed (uris, FALSE);
+	}
+
+	g_strfreev (uris);
+}
+
+static void
+proxy_stat_batch_thread (GTask        *task,
+                         gpointer      source_object,
+                         gpointer      task_data,
+                         GCancellable *cancellable)
+{
+	ProxyStatBatch *batch = task_data;
+	guint i;
+
+	for (i = 0; i < batch->files->len; i++) {
+		GFileInfo *file_info;
+
+		file_info = g_file_query_info (g_ptr_array_index (batch->files, i),
+		                               G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+		                               G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
+		                               G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+		                               cancellable, NULL);
+		g_ptr_array_add (batch->infos, file_info);
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+proxy_stat_batch_cb (GObject      *object,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+	TrackerMinerFiles *miner = TRACKER_MINER_FILES (object);
+	TrackerIndexingTree *indexing_tree;
+	ProxyStatBatch *batch;
+	GList *check_files = NULL;
+	GPtrArray *check_uris, *missing_uris;
+	guint i;
+
+	batch = g_task_get_task_data (G_TASK (res));
+	indexing_tree = tracker_miner_fs_get_indexing_tree (TRACKER_MINER_FS (miner));
+	check_uris = g_ptr_array_new ();
+	missing_uris = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; i < batch->files->len; i++) {
+		GFileInfo *file_info;
+		GFile *file;
+
+		file = g_ptr_array_index (batch->files, i);
+		file_info = g_ptr_array_index (batch->infos, i);
+
+		/* Location was removed meanwhile */
+		if (!g_hash_table_contains (proxy_locations, file))
+			continue;
+
+		if (!file_info) {
+			/* Nothing to index, but the request is done with it */
+			g_ptr_array_add (missing_uris, g_file_get_uri (file));
+			continue;
+		}
+
+		if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY) {
+			if (!tracker_indexing_tree_file_is_indexable (indexing_tree,
+			                                              file, file_info)) {
+				tracker_indexing_tree_add (indexing_tree,
+				                           file,
+				                           TRACKER_DIRECTORY_FLAG_RECURSE |
+				                           TRACKER_DIRECTORY_FLAG_CHECK_MTIME |
+				                           TRACKER_DIRECTORY_FLAG_MONITOR);
+				g_hash_table_insert (proxy_locations,
+				                     g_object_ref (file),
+				                     GINT_TO_POINTER (TRUE));
+			} else {
+				/* Already within an indexed folder, report
+				 * it once the folder itself is checked.
+				 */
+				tracker_indexing_tree_notify_update (indexing_tree,
+				                                     file, TRUE);
+				check_files = g_list_prepend (check_files, file);
+				g_ptr_array_add (check_uris, g_file_get_uri (file));
+			}
+		} else {
+			check_files = g_list_prepend (check_files, file);
+			g_ptr_array_add (check_uris, g_file_get_uri (file));
+		}
+	}
+
+	if (check_files) {
+		g_ptr_array_add (check_uris, NULL);
+		tracker_miner_fs_check_files (TRACKER_MINER_FS (miner),
+		                              check_files, G_PRIORITY_HIGH, TRUE,
+		                              NULL, proxy_check_files_cb,
+		                              g_ptr_array_free (check_uris, FALSE));
+		g_list_free (check_files);
+	} else {
+		g_ptr_array_free (check_uris, TRUE);
+	}
+
+	if (missing_uris->len > 0) {
+		g_ptr_array_add (missing_uris, NULL);
+		notify_locations_indexed ((GStrv) missing_uris->pdata, FALSE);
+	}
+
+	g_ptr_array_unref (missing_uris);
+}
+
+static void
+proxy_stat_batch_run (TrackerMinerFiles *miner,
+                      ProxyStatBatch    *batch)
+{
+	GTask *task;
+
+	task = g_task_new (miner, NULL, proxy_stat_batch_cb, NULL);
+	g_task_set_task_data (task, batch, (GDestroyNotify) proxy_stat_batch_free);
+	g_task_run_in_thread (task, proxy_stat_batch_thread);
+	g_object_unref (task);
+}
+
 static void
 update_indexed_files_from_proxy (TrackerMinerFiles *miner,
                                  GDBusProxy        *proxy)
 {
 	TrackerIndexingTree *indexing_tree;
 	const gchar **indexed_uris = NULL;
+	ProxyStatBatch *batch = NULL;
+	GHashTable *uri_set;
+	GHashTableIter iter;
+	gpointer key, value;
 	GVariant *v;
 	gint i;
 
@@ -856,69 +1044,81 @@ update_indexed_files_from_proxy (TrackerMinerFiles *miner,
 
 	indexing_tree = tracker_miner_fs_get_indexing_tree (TRACKER_MINER_FS (miner));
 
-	/* Remove folders no longer there */
-	for (i = 0; i < proxy_folders->len; i++) {
-		GFile *file;
+	uri_set = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; indexed_uris && indexed_uris[i]; i++)
+		g_hash_table_add (uri_set, (gpointer) indexed_uris[i]);
+
+	/* Remove locations no longer there */
+	g_hash_table_iter_init (&iter, proxy_locations);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GFile *file = key;
 		gchar *uri;
 
-		file = g_ptr_array_index (proxy_folders, i);
 		uri = g_file_get_uri (file);
 
-		if (!indexed_uris || !g_strv_contains (indexed_uris, uri)) {
-			tracker_indexing_tree_remove (indexing_tree,
-			                              file);
+		if (!g_hash_table_contains (uri_set, uri)) {
+			if (GPOINTER_TO_INT (value)) {
+				tracker_indexing_tree_remove (indexing_tree,
+				                              file);
+			}
+
+			g_hash_table_iter_remove (&iter);
 		}
 
 		g_free (uri);
 	}
 
+	/* Query new locations in batches from a thread, so many
+	 * files handed at once don't block the main loop.
+	 */
 	for (i = 0; indexed_uris && indexed_uris[i]; i++) {
-		GFileInfo *file_info;
 		GFile *file;
 
 		file = g_file_new_for_uri (indexed_uris[i]);
-		if (g_ptr_array_find_with_equal_func (proxy_folders,
-		                                      file,
-		                                      (GEqualFunc) g_file_equal,
-		                                      NULL)) {
+		if (g_hash_table_contains (proxy_locations, file)) {
 			g_object_unref (file);
 			continue;
 		}
 
-		file_info = g_file_query_info (file,
-		                               G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-		                               G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
-		                               G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-		                               NULL, NULL);
+		g_hash_table_insert (proxy_locations, g_object_ref (file),
+		                     GINT_TO_POINTER (FALSE));
 
-		if (!file_info) {
-			g_object_unref (file);
-			continue;
+		if (!batch) {
+			batch = g_slice_new0 (ProxyStatBatch);
+			batch->files = g_ptr_array_new_with_free_func (g_object_unref);
+			batch->infos = g_ptr_array_new ();
 		}
 
-		if (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY) {
-			if (!tracker_indexing_tree_file_is_indexable (indexing_tree,
-			                                              file, file_info)) {
-				tracker_indexing_tree_add (indexing_tree,
-				                           file,
-				                           TRACKER_DIRECTORY_FLAG_RECURSE |
-				                           TRACKER_DIRECTORY_FLAG_CHECK_MTIME |
-				                           TRACKER_DIRECTORY_FLAG_MONITOR);
-				g_ptr_array_add (proxy_folders, g_object_ref (file));
-			} else {
-				tracker_indexing_tree_notify_update (indexing_tree,
-				                                     file, TRUE);
-			}
-		} else {
-			tracker_miner_fs_check_file (TRACKER_MINER_FS (miner),
-			                             file, G_PRIORITY_HIGH, TRUE);
-		}
+		g_ptr_array_add (batch->files, file);
 
-		g_object_unref (file_info);
-		g_object_unref (file);
+		if (batch->files->len >= PROXY_STAT_BATCH_SIZE) {
+			proxy_stat_batch_run (miner, batch);
+			batch = NULL;
+		}
 	}
 
+	if (batch)
+		proxy_stat_batch_run (miner, batch);
+
+	g_hash_table_unref (uri_set);
 	g_free (indexed_uris);
+	g_clear_pointer (&v, g_variant_unref);
+}
+
+static void
+miner_finished_root_cb (TrackerMinerFS *fs,
+                        GFile          *root,
+                        gpointer        user_data)
+{
+	gchar *uris[2] = { NULL, NULL };
+
+	if (!proxy_locations ||
+	    !GPOINTER_TO_INT (g_hash_table_lookup (proxy_locations, root)))
+		return;
+
+	uris[0] = g_file_get_uri (root);
+	notify_locations_indexed (uris, TRUE);
+	g_free (uris[0]);
 }
 
 static void
@@ -1082,7 +1282,9 @@ main (gint argc, gchar *argv[])
 		return EXIT_FAILURE;
 	}
 
-	proxy_folders = g_ptr_array_new_with_free_func (g_object_unref);
+	proxy_locations = g_hash_table_new_full (g_file_hash,
+	                                         (GEqualFunc) g_file_equal,
+	                                         g_object_unref, NULL);
 	cancellable = g_cancellable_new ();
 	g_dbus_proxy_new (connection,
 	                  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
@@ -1159,6 +1361,9 @@ main (gint argc, gchar *argv[])
 	g_signal_connect (miner_files, "finished",
 			  G_CALLBACK (miner_finished_cb),
 			  NULL);
+	g_signal_connect (miner_files, "finished-root",
+			  G_CALLBACK (miner_finished_root_cb),
+			  NULL);
 
 #if GLIB_CHECK_VERSION (2, 64, 0)
 	memory_monitor = g_memory_monitor_dup_default ();
@@ -1196,7 +1401,7 @@ main (gint argc, gchar *argv[])
 	g_cancellable_cancel (cancellable);
 	g_object_unref (cancellable);
 	g_clear_object (&index_proxy);
-	g_clear_pointer (&proxy_folders, g_ptr_array_unref);
+	g_clear_pointer (&proxy_locations, g_hash_table_unref);
 
 	g_object_unref (miner_files);
 
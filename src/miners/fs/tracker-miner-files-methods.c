@@ -54,6 +54,19 @@ miner_files_add_to_datasource (TrackerMinerFiles *mf,
 	}
 }
 
+/* The content identifier is stored on the file, so the extractor
+ * has the filesystem ID and inode without having to stat it again.
+ */
+static gchar *
+miner_files_get_content_id (GFile     *file,
+                            GFileInfo *file_info)
+{
+	if (!g_file_info_has_attribute (file_info, G_FILE_ATTRIBUTE_UNIX_INODE))
+		return NULL;
+
+	return tracker_file_get_content_identifier (file, file_info, NULL);
+}
+
 static void
 miner_files_add_mount_info (TrackerMinerFiles *miner,
                             TrackerResource   *resource,
@@ -120,6 +133,251 @@ miner_files_create_folder_information_element (TrackerMinerFiles *miner,
 	return resource;
 }
 
+/* Prepared updates, key -> TrackerSparqlStatement, owned by the miner */
+static GHashTable *
+get_update_statements (TrackerMinerFiles *mf)
+{
+	static GQuark quark = 0;
+	GHashTable *statements;
+
+	if (G_UNLIKELY (quark == 0))
+		quark = g_quark_from_static_string ("tracker-miner-files-update-statements");
+
+	statements = g_object_get_qdata (G_OBJECT (mf), quark);
+
+	if (!statements) {
+		statements = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                    g_free, g_object_unref);
+		g_object_set_qdata_full (G_OBJECT (mf), quark, statements,
+		                         (GDestroyNotify) g_hash_table_unref);
+	}
+
+	return statements;
+}
+
+static TrackerSparqlStatement *
+get_file_statement (TrackerMinerFiles *mf,
+                    const gchar       *graph,
+                    gboolean           with_created,
+                    gboolean           with_content_id,
+                    gboolean           with_graph_file)
+{
+	TrackerSparqlStatement *statement;
+	GHashTable *statements;
+	GError *error = NULL;
+	GString *sparql;
+	gchar key[64];
+
+	statements = get_update_statements (mf);
+	g_snprintf (key, sizeof (key), "file:%s:%d:%d:%d",
+	            graph ? graph : "", with_created, with_content_id,
+	            with_graph_file);
+
+	statement = g_hash_table_lookup (statements, key);
+	if (statement)
+		return statement;
+
+	sparql = g_string_new (NULL);
+
+	if (graph) {
+		/* Same as in tracker_miner_files_process_file(), ensure
+		 * the file is extracted again.
+		 */
+		g_string_append (sparql,
+		                 "DELETE WHERE {"
+		                 "  GRAPH ?g {"
+		                 "    ~file nie:interpretedAs ?ie . "
+		                 "    ?ie a rdfs:Resource . "
+		                 "  }"
+		                 "}; "
+		                 "DELETE WHERE {"
+		                 "  GRAPH " DEFAULT_GRAPH " {"
+		                 "    ~file tracker:extractorHash ?h ."
+		                 "  }"
+		                 "}; ");
+	}
+
+	/* nie:dataSource is multi-valued, replace it as
+	 * tracker_resource_set_uri() does, files may move
+	 * between indexing roots.
+	 */
+	g_string_append (sparql,
+	                 "DELETE WHERE {"
+	                 "  GRAPH ?g {"
+	                 "    ~file nie:dataSource ?ds ."
+	                 "  }"
+	                 "}; "
+	                 "DELETE WHERE {"
+	                 "  GRAPH " DEFAULT_GRAPH " {"
+	                 "    ~file dc:identifier ?id ."
+	                 "  }"
+	                 "}; ");
+
+	g_string_append (sparql,
+	                 "INSERT {"
+	                 "  GRAPH " DEFAULT_GRAPH " {"
+	                 "    ~file a nfo:FileDataObject ; "
+	                 "      nfo:belongsToContainer ~parent ; "
+	                 "      nfo:fileName ~name ; "
+	                 "      nfo:fileSize ~size ; "
+	                 "      nfo:fileLastModified ~modified ; "
+	                 "      nfo:fileLastAccessed ~accessed ; "
+	                 "      nie:url ~url ; "
+	                 "      nie:dataSource ~dataSource . ");
+
+	if (with_created)
+		g_string_append (sparql, "    ~file nfo:fileCreated ~created . ");
+	if (with_content_id)
+		g_string_append (sparql, "    ~file dc:identifier ~contentId . ");
+
+	g_string_append (sparql, "  } ");
+
+	if (with_graph_file) {
+		g_string_append_printf (sparql,
+		                        "  GRAPH %s {"
+		                        "    ~file a nfo:FileDataObject ; "
+		                        "      nfo:fileName ~name ; "
+		                        "      nfo:fileSize ~size ; "
+		                        "      nfo:fileLastModified ~modified ; "
+		                        "      nie:dataSource ~dataSource . "
+		                        "  } ",
+		                        graph);
+	}
+
+	g_string_append (sparql, "} WHERE {}");
+
+	statement = tracker_sparql_connection_update_statement (tracker_miner_get_connection (TRACKER_MINER (mf)),
+	                                                        sparql->str,
+	                                                        NULL, &error);
+	g_string_free (sparql, TRUE);
+
+	if (!statement) {
+		g_warning ("Could not prepare file update: %s", error->message);
+		g_error_free (error);
+		return NULL;
+	}
+
+	g_hash_table_insert (statements, g_strdup (key), statement);
+
+	return statement;
+}
+
+/* Handles the common case of a regular file inside an indexed
+ * folder with a prepared statement, returns FALSE if the file
+ * needs the generic TrackerResource path.
+ */
+static gboolean
+miner_files_push_file_statement (TrackerMinerFS      *fs,
+                                 GFile               *file,
+                                 GFileInfo           *file_info,
+                                 const gchar         *uri,
+                                 const gchar         *mime_type,
+                                 TrackerSparqlBuffer *buffer)
+{
+	static const gchar *names[] = {
+		"file", "url", "name", "size", "modified",
+		"accessed", "parent", "dataSource", "created",
+		"contentId",
+	};
+	/* Bound values are positional, for files without creation time */
+	static const gchar *names_no_created[] = {
+		"file", "url", "name", "size", "modified",
+		"accessed", "parent", "dataSource", "contentId",
+	};
+	GValue values[G_N_ELEMENTS (names)] = { G_VALUE_INIT, };
+	TrackerIndexingTree *indexing_tree;
+	TrackerSparqlStatement *statement;
+	const gchar *parent_urn, *datasource_urn = NULL, *graph;
+	GDateTime *modified, *accessed, *created;
+	GFile *parent, *root;
+	gchar *content_id;
+	guint n_values, i;
+
+	indexing_tree = tracker_miner_fs_get_indexing_tree (fs);
+
+	parent = g_file_get_parent (file);
+	parent_urn = tracker_miner_fs_get_identifier (fs, parent);
+	g_object_unref (parent);
+
+	root = tracker_indexing_tree_get_root (indexing_tree, file, NULL);
+	if (root)
+		datasource_urn = tracker_miner_fs_get_identifier (fs, root);
+
+	if (!parent_urn || !datasource_urn)
+		return FALSE;
+
+	graph = tracker_extract_module_manager_get_graph (mime_type);
+#ifdef GIO_SUPPORTS_CREATION_TIME
+	created = g_file_info_get_creation_date_time (file_info);
+#else
+	created = NULL;
+#endif
+	content_id = miner_files_get_content_id (file, file_info);
+
+	/* Empty files skipped as mime-type for those cannot be trusted */
+	statement = get_file_statement (TRACKER_MINER_FILES (fs), graph,
+	                                created != NULL,
+	                                content_id != NULL,
+	                                graph && g_file_info_get_size (file_info) > 0);
+	if (!statement) {
+		g_clear_pointer (&created, g_date_time_unref);
+		g_free (content_id);
+		return FALSE;
+	}
+
+	modified = g_file_info_get_modification_date_time (file_info);
+	if (!modified)
+		modified = g_date_time_new_from_unix_utc (0);
+
+#ifdef GIO_SUPPORTS_CREATION_TIME
+	accessed = g_file_info_get_access_date_time (file_info);
+	if (!accessed)
+		accessed = g_date_time_new_from_unix_utc (0);
+#else
+	accessed = g_date_time_new_from_unix_utc ((gint64) g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_ACCESS));
+#endif
+
+	g_value_init (&values[0], G_TYPE_STRING);
+	g_value_set_string (&values[0], uri);
+	g_value_init (&values[1], G_TYPE_STRING);
+	g_value_set_string (&values[1], uri);
+	g_value_init (&values[2], G_TYPE_STRING);
+	g_value_set_string (&values[2], g_file_info_get_display_name (file_info));
+	g_value_init (&values[3], G_TYPE_INT64);
+	g_value_set_int64 (&values[3], g_file_info_get_size (file_info));
+	g_value_init (&values[4], G_TYPE_DATE_TIME);
+	g_value_take_boxed (&values[4], modified);
+	g_value_init (&values[5], G_TYPE_DATE_TIME);
+	g_value_take_boxed (&values[5], accessed);
+	g_value_init (&values[6], G_TYPE_STRING);
+	g_value_set_string (&values[6], parent_urn);
+	g_value_init (&values[7], G_TYPE_STRING);
+	g_value_set_string (&values[7], datasource_urn);
+	n_values = 8;
+
+	if (created) {
+		g_value_init (&values[n_values], G_TYPE_DATE_TIME);
+		g_value_take_boxed (&values[n_values], created);
+		n_values++;
+	}
+
+	if (content_id) {
+		g_value_init (&values[n_values], G_TYPE_STRING);
+		g_value_take_string (&values[n_values], content_id);
+		n_values++;
+	}
+
+	tracker_sparql_buffer_push_statement (buffer, file, statement,
+	                                      n_values,
+	                                      created ? names : names_no_created,
+	                                      values);
+
+	for (i = 0; i < n_values; i++)
+		g_value_unset (&values[i]);
+
+	return TRUE;
+}
+
 void
 tracker_miner_files_process_file (TrackerMinerFS      *fs,
                                   GFile               *file,
@@ -132,7 +390,7 @@ tracker_miner_files_process_file (TrackerMinerFS      *fs,
 	const gchar *mime_type, *graph;
 	const gchar *parent_urn;
 	GFile *parent;
-	gchar *uri;
+	gchar *uri, *content_id;
 	gboolean is_directory;
 	GDateTime *modified;
 #ifdef GIO_SUPPORTS_CREATION_TIME
@@ -144,11 +402,19 @@ tracker_miner_files_process_file (TrackerMinerFS      *fs,
 
 	uri = g_file_get_uri (file);
 	indexing_tree = tracker_miner_fs_get_indexing_tree (fs);
-	mime_type = g_file_info_get_content_type (file_info);
+	mime_type = tracker_miner_files_get_content_type (TRACKER_MINER_FILES (fs),
+	                                                  file, file_info);
 
 	is_directory = (g_file_info_get_file_type (file_info) == G_FILE_TYPE_DIRECTORY ?
 	                TRUE : FALSE);
 
+	if (!is_directory &&
+	    !tracker_indexing_tree_file_is_root (indexing_tree, file) &&
+	    miner_files_push_file_statement (fs, file, file_info, uri, mime_type, buffer)) {
+		g_free (uri);
+		return;
+	}
+
 	modified = g_file_info_get_modification_date_time (file_info);
 	if (!modified)
 		modified = g_date_time_new_from_unix_utc (0);
@@ -195,6 +461,12 @@ tracker_miner_files_process_file (TrackerMinerFS      *fs,
 	/* The URL of the DataObject (because IE = DO, this is correct) */
 	tracker_resource_set_string (resource, "nie:url", uri);
 
+	content_id = miner_files_get_content_id (file, file_info);
+	if (content_id) {
+		tracker_resource_set_string (resource, "dc:identifier", content_id);
+		g_free (content_id);
+	}
+
 	if (is_directory || tracker_indexing_tree_file_is_root (indexing_tree, file)) {
 		folder_resource =
 			miner_files_create_folder_information_element (TRACKER_MINER_FILES (fs),
@@ -316,7 +588,8 @@ tracker_miner_files_process_file_attributes (TrackerMinerFS      *fs,
 	if (!modified)
 		modified = g_date_time_new_from_unix_utc (0);
 
-	mime_type = g_file_info_get_content_type (info);
+	mime_type = tracker_miner_files_get_content_type (TRACKER_MINER_FILES (fs),
+	                                                  file, info);
 	graph = tracker_extract_module_manager_get_graph (mime_type);
 
 	/* Update nfo:fileLastModified */
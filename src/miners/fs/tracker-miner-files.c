@@ -56,14 +56,21 @@
 
 #define DEFAULT_GRAPH "tracker:FileSystem"
 
+/* The content type is guessed from the file name, sniffing the
+ * contents is deferred to tracker_miner_files_get_content_type().
+ */
 #define FILE_ATTRIBUTES	  \
 	G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
-	G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
+	G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE "," \
 	G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
 	G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
 	G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
 	G_FILE_ATTRIBUTE_TIME_CREATED "," \
-	G_FILE_ATTRIBUTE_TIME_ACCESS
+	G_FILE_ATTRIBUTE_TIME_ACCESS "," \
+	G_FILE_ATTRIBUTE_ID_FILESYSTEM "," \
+	G_FILE_ATTRIBUTE_UNIX_INODE
+
+typedef struct _SubtreeMove SubtreeMove;
 
 #define TRACKER_MINER_FILES_GET_PRIVATE(o) (tracker_miner_files_get_instance_private (TRACKER_MINER_FILES (o)))
 
@@ -91,6 +98,8 @@ struct TrackerMinerFilesPrivate {
 
 	gboolean start_extractor;
 
+	TrackerPressure *pressure;
+
 #if defined(HAVE_UPOWER) || defined(HAVE_HAL)
 	TrackerPower *power;
 #endif /* defined(HAVE_UPOWER) || defined(HAVE_HAL) */
@@ -111,6 +120,17 @@ struct TrackerMinerFilesPrivate {
 	gboolean mount_points_initialized;
 
 	guint stale_volumes_check_id;
+
+	/* Folders of the subtree being moved whose subfolders are
+	 * not known yet, the miner-fs holds events on the subtree
+	 * meanwhile. Other subtree moves wait for their turn.
+	 */
+	GQueue subtree_moves;
+	GQueue subtree_moves_waiting;
+	SubtreeMove *subtree_move_root;
+	TrackerSparqlBuffer *subtree_move_buffer;
+	GCancellable *subtree_move_cancellable;
+	gulong subtree_move_limit_id;
 };
 
 enum {
@@ -133,6 +153,12 @@ static void        miner_files_get_property             (GObject              *o
                                                          GValue               *value,
                                                          GParamSpec           *pspec);
 static void        miner_files_finalize                 (GObject              *object);
+static void        subtree_move_free                    (SubtreeMove          *move);
+static void        miner_files_start_subtree_move       (TrackerMinerFiles    *mf,
+                                                         TrackerSparqlBuffer  *buffer,
+                                                         const gchar          *folder_urn,
+                                                         const gchar          *source_uri,
+                                                         const gchar          *uri);
 static void        miner_files_initable_iface_init      (GInitableIface       *iface);
 static gboolean    miner_files_initable_init            (GInitable            *initable,
                                                          GCancellable         *cancellable,
@@ -168,6 +194,12 @@ static void        disk_space_check_stop                (TrackerMinerFiles    *m
 static void        low_disk_space_limit_cb              (GObject              *gobject,
                                                          GParamSpec           *arg1,
                                                          gpointer              user_data);
+static void        pressure_pacing_start                (TrackerMinerFiles    *mf);
+static void        memory_budget_start                  (TrackerMinerFiles    *mf);
+static void        rate_limiter_start                   (TrackerMinerFiles    *mf);
+static void        pressure_pacing_cb                   (GObject              *gobject,
+                                                         GParamSpec           *arg1,
+                                                         gpointer              user_data);
 static void        index_recursive_directories_cb       (GObject              *gobject,
                                                          GParamSpec           *arg1,
                                                          gpointer              user_data);
@@ -335,6 +367,7 @@ tracker_miner_files_init (TrackerMinerFiles *mf)
 	priv = mf->private = TRACKER_MINER_FILES_GET_PRIVATE (mf);
 
 	priv->storage = tracker_storage_new ();
+	priv->subtree_move_cancellable = g_cancellable_new ();
 
 	g_signal_connect (priv->storage, "mount-point-added",
 	                  G_CALLBACK (mount_point_added_cb),
@@ -662,6 +695,9 @@ miner_files_initable_init (GInitable     *initable,
 	g_slist_free (mounts);
 
 	disk_space_check_start (mf);
+	pressure_pacing_start (mf);
+	memory_budget_start (mf);
+	rate_limiter_start (mf);
 
 	domain_name = tracker_domain_ontology_get_domain (mf->private->domain_ontology, NULL);
 	mf->private->extract_watchdog = tracker_extract_watchdog_new (domain_name);
@@ -750,6 +786,13 @@ miner_files_finalize (GObject *object)
 
 	disk_space_check_stop (TRACKER_MINER_FILES (object));
 
+	if (priv->pressure) {
+		g_signal_handlers_disconnect_by_func (priv->pressure,
+		                                      pressure_pacing_cb,
+		                                      mf);
+		g_object_unref (priv->pressure);
+	}
+
 	g_slist_free_full (mf->private->application_dirs, g_object_unref);
 
 	if (priv->index_recursive_directories) {
@@ -791,6 +834,22 @@ miner_files_finalize (GObject *object)
 		priv->stale_volumes_check_id = 0;
 	}
 
+	g_cancellable_cancel (priv->subtree_move_cancellable);
+	g_object_unref (priv->subtree_move_cancellable);
+	g_queue_foreach (&priv->subtree_moves, (GFunc) subtree_move_free, NULL);
+	g_queue_clear (&priv->subtree_moves);
+	g_queue_foreach (&priv->subtree_moves_waiting, (GFunc) subtree_move_free, NULL);
+	g_queue_clear (&priv->subtree_moves_waiting);
+	g_clear_pointer (&priv->subtree_move_root, subtree_move_free);
+
+	if (priv->subtree_move_limit_id) {
+		g_signal_handler_disconnect (priv->subtree_move_buffer,
+		                             priv->subtree_move_limit_id);
+		priv->subtree_move_limit_id = 0;
+	}
+
+	g_clear_object (&priv->subtree_move_buffer);
+
 	G_OBJECT_CLASS (tracker_miner_files_parent_class)->finalize (object);
 }
 
@@ -1519,6 +1578,66 @@ low_disk_space_limit_cb (GObject    *gobject,
 	disk_space_check_cb (mf);
 }
 
+static void
+pressure_pacing_cb (GObject    *gobject,
+                    GParamSpec *arg1,
+                    gpointer    user_data)
+{
+	TrackerMinerFiles *mf = user_data;
+	gdouble pacing;
+
+	pacing = tracker_pressure_get_pacing (mf->private->pressure);
+	TRACKER_NOTE (CONFIG, g_message ("Setting new pacing to %0.3f", pacing));
+	tracker_miner_fs_set_pacing (TRACKER_MINER_FS (mf), pacing);
+}
+
+static void
+pressure_pacing_start (TrackerMinerFiles *mf)
+{
+	GSettings *settings = G_SETTINGS (mf->private->config);
+
+	mf->private->pressure = tracker_pressure_new (NULL);
+
+	if (!tracker_pressure_is_available (mf->private->pressure)) {
+		g_clear_object (&mf->private->pressure);
+		return;
+	}
+
+	g_settings_bind (settings, "cpu-pressure-target",
+	                 mf->private->pressure, "cpu-target",
+	                 G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "io-pressure-target",
+	                 mf->private->pressure, "io-target",
+	                 G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "memory-pressure-target",
+	                 mf->private->pressure, "memory-target",
+	                 G_SETTINGS_BIND_GET);
+
+	g_signal_connect (mf->private->pressure, "notify::pacing",
+	                  G_CALLBACK (pressure_pacing_cb), mf);
+	pressure_pacing_cb (NULL, NULL, mf);
+}
+
+static void
+memory_budget_start (TrackerMinerFiles *mf)
+{
+	tracker_memory_budget_bind_limit (tracker_memory_budget_get_default (),
+	                                  G_SETTINGS (mf->private->config),
+	                                  "memory-budget");
+}
+
+static void
+rate_limiter_start (TrackerMinerFiles *mf)
+{
+	GSettings *settings = G_SETTINGS (mf->private->config);
+	TrackerRateLimiter *limiter = tracker_rate_limiter_get_default ();
+
+	/* File contents are not read here, only the file rate applies */
+	g_settings_bind (settings, "file-rate-limit",
+	                 limiter, "file-rate",
+	                 G_SETTINGS_BIND_GET);
+}
+
 static void
 indexing_tree_update_filter (TrackerIndexingTree *indexing_tree,
 			     TrackerFilterType    filter,
@@ -2106,6 +2225,454 @@ miner_files_remove_file (TrackerMinerFS      *fs,
 	add_delete_sparql (file, buffer, TRUE, is_dir);
 }
 
+/* Subtree moves rewrite the URLs of one folder's children at a time,
+ * with one update per folder, so the cost scales with the size of the
+ * subtree. Subfolders are queried level by level, and the updates are
+ * pushed to the SPARQL buffer after the move of the folder itself, so
+ * they are committed in order across as many batches as needed. The
+ * next level is not queried while the buffer is full, so every batch
+ * stays bounded and other updates go in between. Only the events on
+ * the source and destination subtrees are held back until done.
+ */
+#define SUBTREE_MOVE_QUERY_FOLDERS 100
+
+struct _SubtreeMove {
+	gchar *folder_urn;
+	gchar *source_uri;
+	gchar *uri;
+};
+
+#define FS_PROPERTIES \
+	"  nfo:fileSize ?fileSize ;" \
+	"  nfo:fileLastModified ?fileLastModified ;" \
+	"  nfo:fileLastAccessed ?fileLastAccessed ;" \
+	"  nfo:fileCreated ?fileCreated ;" \
+	"  nie:dataSource ?dataSource ;" \
+	"  nie:interpretedAs ?interpretedAs ;" \
+	"  tracker:extractorHash ?extractorHash ."
+#define FS_WHERE \
+	"  ?f a nfo:FileDataObject ;" \
+	"    nfo:fileSize ?fileSize ;" \
+	"    nfo:fileLastModified ?fileLastModified ;" \
+	"    nfo:fileLastAccessed ?fileLastAccessed ." \
+	"  OPTIONAL { ?f nfo:fileCreated ?fileCreated } ." \
+	"  OPTIONAL { ?f nie:dataSource ?dataSource } ." \
+	"  OPTIONAL { ?f nie:interpretedAs ?interpretedAs } ." \
+	"  OPTIONAL { ?f tracker:extractorHash ?extractorHash } ."
+
+#define GRAPH_PROPERTIES \
+	"  nfo:fileSize ?fileSize ;" \
+	"  nfo:fileLastModified ?fileLastModified ;" \
+	"  nie:dataSource ?dataSource ;" \
+	"  nie:interpretedAs ?interpretedAs ."
+#define GRAPH_WHERE \
+	"  ?f a nfo:FileDataObject ; " \
+	"    nfo:fileSize ?fileSize ;" \
+	"    nfo:fileLastModified ?fileLastModified ;" \
+	"  OPTIONAL { ?f nie:dataSource ?dataSource } ." \
+	"  OPTIONAL { ?f nie:interpretedAs ?interpretedAs } ."
+
+static SubtreeMove *
+subtree_move_new (const gchar *folder_urn,
+                  const gchar *source_uri,
+                  const gchar *uri)
+{
+	SubtreeMove *move;
+
+	move = g_slice_new0 (SubtreeMove);
+	move->folder_urn = g_strdup (folder_urn);
+	move->source_uri = g_strdup (source_uri);
+	move->uri = g_strdup (uri);
+
+	return move;
+}
+
+static void
+subtree_move_free (SubtreeMove *move)
+{
+	g_free (move->folder_urn);
+	g_free (move->source_uri);
+	g_free (move->uri);
+	g_slice_free (SubtreeMove, move);
+}
+
+static gchar *
+subtree_move_get_sparql (SubtreeMove *move)
+{
+	GString *sparql;
+
+	sparql = g_string_new (NULL);
+
+#define CHILDREN_WHERE \
+	"  GRAPH " DEFAULT_GRAPH " {" \
+	"    ?f nfo:belongsToContainer <%s> ." \
+	"  }" \
+	"  BIND (CONCAT (\"%s/\", SUBSTR (STR (?f), STRLEN (\"%s/\") + 1)) AS ?new_url) ." \
+	"  FILTER (STRSTARTS (STR (?f), \"%s/\")) . "
+
+	/* Update nie:isStoredAs in the nie:InformationElements */
+	g_string_append_printf (sparql,
+	                        "DELETE { "
+	                        "  GRAPH ?g {"
+	                        "    ?ie nie:isStoredAs ?f "
+	                        "  }"
+	                        "} INSERT {"
+	                        "  GRAPH ?g {"
+	                        "    ?ie nie:isStoredAs ?new_url "
+	                        "  }"
+	                        "} WHERE {"
+	                        CHILDREN_WHERE
+	                        "  GRAPH ?g {"
+	                        "    ?ie nie:isStoredAs ?f ."
+	                        "  }"
+	                        "}; ",
+	                        move->folder_urn, move->uri,
+	                        move->source_uri, move->source_uri);
+	/* Update nfo:FileDataObject in data graphs, before the
+	 * parent link in tracker:FileSystem changes.
+	 */
+	g_string_append_printf (sparql,
+	                        "DELETE { "
+	                        "  GRAPH ?g {"
+	                        "    ?f a rdfs:Resource "
+	                        "  }"
+	                        "} INSERT {"
+	                        "  GRAPH ?g {"
+	                        "    ?new_url a nfo:FileDataObject ; "
+	                        "      nfo:fileName ?fileName ;"
+	                        GRAPH_PROPERTIES
+	                        "  }"
+	                        "} WHERE {"
+	                        CHILDREN_WHERE
+	                        "  GRAPH ?g {"
+	                        GRAPH_WHERE
+	                        "    ?f nfo:fileName ?fileName ."
+	                        "  }"
+	                        "  FILTER (?g != " DEFAULT_GRAPH ") ."
+	                        "}; ",
+	                        move->folder_urn, move->uri,
+	                        move->source_uri, move->source_uri);
+	/* Update tracker:FileSystem nfo:FileDataObject information */
+	g_string_append_printf (sparql,
+	                        "WITH " DEFAULT_GRAPH " "
+	                        "DELETE { "
+	                        "  ?f a rdfs:Resource . "
+	                        "} INSERT { "
+	                        "  ?new_url a nfo:FileDataObject ; "
+	                        "       nie:url ?new_url ; "
+	                        "       nfo:belongsToContainer <%s> ;"
+	                        "       nfo:fileName ?fileName ;"
+	                        FS_PROPERTIES
+	                        "} WHERE { "
+	                        "  ?f nfo:belongsToContainer <%s> ."
+	                        FS_WHERE
+	                        "  ?f nfo:fileName ?fileName ."
+	                        "  BIND (CONCAT (\"%s/\", SUBSTR (STR (?f), STRLEN (\"%s/\") + 1)) AS ?new_url) ."
+	                        "  FILTER (STRSTARTS (STR (?f), \"%s/\")) . "
+	                        "}",
+	                        move->folder_urn, move->folder_urn, move->uri,
+	                        move->source_uri, move->source_uri);
+
+#undef CHILDREN_WHERE
+
+	return g_string_free (sparql, FALSE);
+}
+
+static void subtree_move_next (TrackerMinerFiles *mf);
+
+static void
+subtree_move_push (TrackerMinerFiles *mf,
+                   SubtreeMove       *move)
+{
+	gchar *sparql;
+	GFile *file;
+
+	TRACKER_NOTE (MINER_FS_EVENTS,
+	              g_message ("Moving children of '%s' to '%s'",
+	                         move->source_uri, move->uri));
+
+	file = g_file_new_for_uri (move->uri);
+	sparql = subtree_move_get_sparql (move);
+	tracker_sparql_buffer_push_sparql (mf->private->subtree_move_buffer,
+	                                   file, sparql);
+	g_free (sparql);
+	g_object_unref (file);
+
+	/* Its subfolders come next */
+	g_queue_push_tail (&mf->private->subtree_moves, move);
+}
+
+static void subtree_move_start (TrackerMinerFiles *mf,
+                                SubtreeMove       *move);
+
+static void
+subtree_move_finish (TrackerMinerFiles *mf)
+{
+	SubtreeMove *root = mf->private->subtree_move_root;
+	GFile *source, *dest;
+
+	g_queue_foreach (&mf->private->subtree_moves, (GFunc) subtree_move_free, NULL);
+	g_queue_clear (&mf->private->subtree_moves);
+
+	source = g_file_new_for_uri (root->source_uri);
+	dest = g_file_new_for_uri (root->uri);
+	tracker_miner_fs_release_subtree (TRACKER_MINER_FS (mf), source);
+	tracker_miner_fs_release_subtree (TRACKER_MINER_FS (mf), dest);
+	g_object_unref (source);
+	g_object_unref (dest);
+
+	g_clear_pointer (&mf->private->subtree_move_root, subtree_move_free);
+
+	if (!g_queue_is_empty (&mf->private->subtree_moves_waiting))
+		subtree_move_start (mf, g_queue_pop_head (&mf->private->subtree_moves_waiting));
+}
+
+static void
+subtree_move_limit_notify_cb (GObject    *object,
+                              GParamSpec *pspec,
+                              gpointer    user_data)
+{
+	TrackerMinerFiles *mf = user_data;
+
+	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (object)))
+		return;
+
+	g_signal_handler_disconnect (object, mf->private->subtree_move_limit_id);
+	mf->private->subtree_move_limit_id = 0;
+	subtree_move_next (mf);
+}
+
+static void
+subtree_move_query_cb (GObject      *object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+	TrackerMinerFiles *mf = user_data;
+	TrackerSparqlCursor *cursor;
+	GHashTable *parents;
+	GError *error = NULL;
+	guint i;
+
+	cursor = tracker_sparql_connection_query_finish (TRACKER_SPARQL_CONNECTION (object),
+	                                                 result, &error);
+
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		return;
+	}
+
+	if (!cursor) {
+		SubtreeMove *move = g_queue_peek_head (&mf->private->subtree_moves);
+
+		/* The children stay at their old location until
+		 * the next crawl notices.
+		 */
+		g_warning ("Could not query subfolders of '%s': %s",
+		           move->uri, error->message);
+		g_error_free (error);
+		subtree_move_finish (mf);
+		return;
+	}
+
+	/* The folders that were queried, by URN */
+	parents = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+	                                 (GDestroyNotify) subtree_move_free);
+
+	for (i = 0; i < SUBTREE_MOVE_QUERY_FOLDERS; i++) {
+		SubtreeMove *move;
+
+		move = g_queue_pop_head (&mf->private->subtree_moves);
+		if (!move)
+			break;
+
+		g_hash_table_insert (parents, move->folder_urn, move);
+	}
+
+	while (tracker_sparql_cursor_next (cursor, NULL, NULL)) {
+		const gchar *parent_urn, *folder_urn, *file_uri, *basename;
+		gchar *source_uri, *uri;
+		SubtreeMove *parent;
+
+		parent_urn = tracker_sparql_cursor_get_string (cursor, 0, NULL);
+		folder_urn = tracker_sparql_cursor_get_string (cursor, 1, NULL);
+		file_uri = tracker_sparql_cursor_get_string (cursor, 2, NULL);
+		parent = parent_urn ? g_hash_table_lookup (parents, parent_urn) : NULL;
+		basename = file_uri ? strrchr (file_uri, '/') : NULL;
+
+		if (!parent || !folder_urn || !basename)
+			continue;
+
+		source_uri = g_strconcat (parent->source_uri, basename, NULL);
+		uri = g_strconcat (parent->uri, basename, NULL);
+		subtree_move_push (mf, subtree_move_new (folder_urn, source_uri, uri));
+		g_free (source_uri);
+		g_free (uri);
+	}
+
+	g_object_unref (cursor);
+	g_hash_table_unref (parents);
+
+	subtree_move_next (mf);
+}
+
+static void
+subtree_move_next (TrackerMinerFiles *mf)
+{
+	GString *query;
+	GList *l;
+	guint i;
+
+	if (g_queue_is_empty (&mf->private->subtree_moves)) {
+		subtree_move_finish (mf);
+		return;
+	}
+
+	if (tracker_task_pool_limit_reached (TRACKER_TASK_POOL (mf->private->subtree_move_buffer))) {
+		/* Wait for the pushed updates to be committed */
+		mf->private->subtree_move_limit_id =
+			g_signal_connect (mf->private->subtree_move_buffer,
+			                  "notify::limit-reached",
+			                  G_CALLBACK (subtree_move_limit_notify_cb),
+			                  mf);
+		return;
+	}
+
+	/* Folder URNs survive the move, and only basenames are
+	 * taken from the URLs, so it does not matter whether the
+	 * updates of the parent folders were committed yet.
+	 */
+	query = g_string_new ("SELECT ?parent ?folder ?f {"
+	                      "  VALUES ?parent {");
+
+	for (l = mf->private->subtree_moves.head, i = 0;
+	     l && i < SUBTREE_MOVE_QUERY_FOLDERS;
+	     l = l->next, i++) {
+		SubtreeMove *move = l->data;
+
+		g_string_append_printf (query, " <%s>", move->folder_urn);
+	}
+
+	g_string_append (query,
+	                 "  }"
+	                 "  GRAPH " DEFAULT_GRAPH " {"
+	                 "    ?f nfo:belongsToContainer ?parent ."
+	                 "    ?folder a nfo:Folder ;"
+	                 "      nie:isStoredAs ?f ."
+	                 "  }"
+	                 "}");
+
+	tracker_sparql_connection_query_async (tracker_miner_get_connection (TRACKER_MINER (mf)),
+	                                       query->str,
+	                                       mf->private->subtree_move_cancellable,
+	                                       subtree_move_query_cb,
+	                                       mf);
+	g_string_free (query, TRUE);
+}
+
+static void
+subtree_move_root_cb (GObject      *object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+	TrackerMinerFiles *mf = user_data;
+	TrackerSparqlCursor *cursor;
+	SubtreeMove *move;
+	GError *error = NULL;
+
+	cursor = tracker_sparql_connection_query_finish (TRACKER_SPARQL_CONNECTION (object),
+	                                                 result, &error);
+
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		return;
+	}
+
+	/* The URN was not passed in, only the root move is queued */
+	move = g_queue_pop_head (&mf->private->subtree_moves);
+
+	if (cursor && tracker_sparql_cursor_next (cursor, NULL, NULL)) {
+		g_free (move->folder_urn);
+		move->folder_urn = g_strdup (tracker_sparql_cursor_get_string (cursor, 0, NULL));
+		subtree_move_push (mf, move);
+	} else {
+		/* Not in the store, so neither are its children */
+		if (error) {
+			g_warning ("Could not query folder '%s': %s",
+			           move->source_uri, error->message);
+			g_error_free (error);
+		}
+
+		subtree_move_free (move);
+	}
+
+	g_clear_object (&cursor);
+	subtree_move_next (mf);
+}
+
+static void
+subtree_move_start (TrackerMinerFiles *mf,
+                    SubtreeMove       *move)
+{
+	gchar *query;
+
+	mf->private->subtree_move_root =
+		subtree_move_new (NULL, move->source_uri, move->uri);
+
+	if (move->folder_urn) {
+		subtree_move_push (mf, move);
+		subtree_move_next (mf);
+		return;
+	}
+
+	/* Folder URNs are based on the inode, which could not
+	 * be read. Look it up from the old location instead.
+	 */
+	g_queue_push_tail (&mf->private->subtree_moves, move);
+
+	query = g_strdup_printf ("SELECT ?folder {"
+	                         "  GRAPH " DEFAULT_GRAPH " {"
+	                         "    ?folder a nfo:Folder ;"
+	                         "      nie:isStoredAs <%s> ."
+	                         "  }"
+	                         "}",
+	                         move->source_uri);
+	tracker_sparql_connection_query_async (tracker_miner_get_connection (TRACKER_MINER (mf)),
+	                                       query,
+	                                       mf->private->subtree_move_cancellable,
+	                                       subtree_move_root_cb,
+	                                       mf);
+	g_free (query);
+}
+
+static void
+miner_files_start_subtree_move (TrackerMinerFiles   *mf,
+                                TrackerSparqlBuffer *buffer,
+                                const gchar         *folder_urn,
+                                const gchar         *source_uri,
+                                const gchar         *uri)
+{
+	SubtreeMove *move;
+	GFile *source, *dest;
+
+	/* Later events on either location wait for the move, e.g.
+	 * a new file at the old location of a child.
+	 */
+	source = g_file_new_for_uri (source_uri);
+	dest = g_file_new_for_uri (uri);
+	tracker_miner_fs_hold_subtree (TRACKER_MINER_FS (mf), source);
+	tracker_miner_fs_hold_subtree (TRACKER_MINER_FS (mf), dest);
+	g_object_unref (source);
+	g_object_unref (dest);
+
+	g_set_object (&mf->private->subtree_move_buffer, buffer);
+	move = subtree_move_new (folder_urn, source_uri, uri);
+
+	if (mf->private->subtree_move_root)
+		g_queue_push_tail (&mf->private->subtree_moves_waiting, move);
+	else
+		subtree_move_start (mf, move);
+}
+
 static void
 miner_files_move_file (TrackerMinerFS      *fs,
                        GFile               *file,
@@ -2141,36 +2708,6 @@ miner_files_move_file (TrackerMinerFS      *fs,
 		}
 	}
 
-#define FS_PROPERTIES \
-	"  nfo:fileSize ?fileSize ;" \
-	"  nfo:fileLastModified ?fileLastModified ;" \
-	"  nfo:fileLastAccessed ?fileLastAccessed ;" \
-	"  nfo:fileCreated ?fileCreated ;" \
-	"  nie:dataSource ?dataSource ;" \
-	"  nie:interpretedAs ?interpretedAs ;" \
-	"  tracker:extractorHash ?extractorHash ."
-#define FS_WHERE \
-	"  ?f a nfo:FileDataObject ;" \
-	"    nfo:fileSize ?fileSize ;" \
-	"    nfo:fileLastModified ?fileLastModified ;" \
-	"    nfo:fileLastAccessed ?fileLastAccessed ." \
-	"  OPTIONAL { ?f nfo:fileCreated ?fileCreated } ." \
-	"  OPTIONAL { ?f nie:dataSource ?dataSource } ." \
-	"  OPTIONAL { ?f nie:interpretedAs ?interpretedAs } ." \
-	"  OPTIONAL { ?f tracker:extractorHash ?extractorHash } ."
-
-#define GRAPH_PROPERTIES \
-	"  nfo:fileSize ?fileSize ;" \
-	"  nfo:fileLastModified ?fileLastModified ;" \
-	"  nie:dataSource ?dataSource ;" \
-	"  nie:interpretedAs ?interpretedAs ."
-#define GRAPH_WHERE \
-	"  ?f a nfo:FileDataObject ; " \
-	"    nfo:fileSize ?fileSize ;" \
-	"    nfo:fileLastModified ?fileLastModified ;" \
-	"  OPTIONAL { ?f nie:dataSource ?dataSource } ." \
-	"  OPTIONAL { ?f nie:interpretedAs ?interpretedAs } ."
-
 	/* Update nie:isStoredAs in the nie:InformationElement */
 	g_string_append_printf (sparql,
 	                        "DELETE { "
@@ -2226,74 +2763,19 @@ miner_files_move_file (TrackerMinerFS      *fs,
 	                        source_uri, uri, display_name, source_uri);
 	g_free (container_clause);
 
-	if (recursive) {
-		/* Update nie:isStoredAs in the nie:InformationElement */
-		g_string_append_printf (sparql,
-		                        "DELETE { "
-		                        "  GRAPH ?g {"
-		                        "    ?ie nie:isStoredAs ?f "
-		                        "  }"
-		                        "} INSERT {"
-		                        "  GRAPH ?g {"
-		                        "    ?ie nie:isStoredAs ?new_url "
-		                        "  }"
-		                        "} WHERE {"
-		                        "  GRAPH ?g {"
-		                        "    ?f a nfo:FileDataObject ."
-		                        "    ?ie nie:isStoredAs ?f ."
-		                        "    BIND (CONCAT (\"%s/\", SUBSTR (STR (?f), STRLEN (\"%s/\") + 1)) AS ?new_url) ."
-		                        "    FILTER (STRSTARTS (STR (?f), \"%s/\")) . "
-		                        "  }"
-		                        "}; ",
-		                        uri, source_uri, source_uri);
-		/* Update tracker:FileSystem nfo:FileDataObject information */
-		g_string_append_printf (sparql,
-		                        "WITH " DEFAULT_GRAPH " "
-		                        "DELETE { "
-		                        "  ?f a rdfs:Resource . "
-		                        "} INSERT { "
-		                        "  ?new_url a nfo:FileDataObject ; "
-		                        "       nie:url ?new_url ; "
-					"       nfo:belongsToContainer ?belongsToContainer ;"
-					"       nfo:fileName ?fileName ;"
-		                        FS_PROPERTIES
-		                        "} WHERE { "
-		                        FS_WHERE
-					"  ?f nfo:fileName ?fileName ;"
-					"  OPTIONAL { ?f nfo:belongsToContainer ?belongsToContainer } ."
-		                        "  BIND (CONCAT (\"%s/\", SUBSTR (STR (?f), STRLEN (\"%s/\") + 1)) AS ?new_url) ."
-		                        "  FILTER (STRSTARTS (STR (?f), \"%s/\")) . "
-		                        "} ",
-		                        uri, source_uri, source_uri);
-		/* Update nfo:FileDataObject in data graphs */
-		g_string_append_printf (sparql,
-		                        "DELETE { "
-		                        "  GRAPH ?g {"
-		                        "    ?f a rdfs:Resource "
-		                        "  }"
-		                        "} INSERT {"
-		                        "  GRAPH ?g {"
-		                        "    ?new_url a nfo:FileDataObject ; "
-					"      nfo:fileName ?fileName ;"
-		                        GRAPH_PROPERTIES
-		                        "  }"
-		                        "} WHERE {"
-		                        "  GRAPH ?g {"
-		                        GRAPH_WHERE
-					"    ?f nfo:fileName ?fileName ."
-		                        "    BIND (CONCAT (\"%s/\", SUBSTR (STR (?f), STRLEN (\"%s/\") + 1)) AS ?new_url) ."
-		                        "    FILTER (STRSTARTS (STR (?f), \"%s/\")) . "
-		                        "  }"
-		                        "}",
-		                        uri, source_uri, source_uri);
-	}
+	tracker_sparql_buffer_push_sparql (buffer, file, sparql->str);
 
-#undef FS_PROPERTIES
-#undef FS_WHERE
-#undef GRAPH_PROPERTIES
-#undef GRAPH_WHERE
+	if (recursive) {
+		const gchar *folder_urn;
 
-	tracker_sparql_buffer_push_sparql (buffer, file, sparql->str);
+		/* Folder URNs are based on the inode and survive
+		 * the move, children are found through their
+		 * nfo:belongsToContainer link.
+		 */
+		folder_urn = tracker_miner_fs_get_identifier (fs, file);
+		miner_files_start_subtree_move (TRACKER_MINER_FILES (fs), buffer,
+		                                folder_urn, source_uri, uri);
+	}
 
 	g_free (uri);
 	g_free (source_uri);
@@ -2302,6 +2784,11 @@ miner_files_move_file (TrackerMinerFS      *fs,
 	g_string_free (sparql, TRUE);
 }
 
+#undef FS_PROPERTIES
+#undef FS_WHERE
+#undef GRAPH_PROPERTIES
+#undef GRAPH_WHERE
+
 TrackerMiner *
 tracker_miner_files_new (TrackerSparqlConnection  *connection,
                          TrackerConfig            *config,
@@ -2747,3 +3234,28 @@ tracker_miner_files_get_storage (TrackerMinerFiles *mf)
 {
 	return mf->private->storage;
 }
+
+/**
+ * tracker_miner_files_get_content_type:
+ * @mf: a #TrackerMinerFiles
+ * @file: a #GFile
+ * @info: the #GFileInfo of @file
+ *
+ * Returns the content type of @file. #TrackerMinerFS sniffs the
+ * contents of new and modified files with ambiguous names before
+ * they are processed, otherwise the guess made from the file name
+ * is used. Unchanged files are never opened during a crawl.
+ *
+ * Returns: the content type, or %NULL if @info has none.
+ **/
+const gchar *
+tracker_miner_files_get_content_type (TrackerMinerFiles *mf,
+                                      GFile             *file,
+                                      GFileInfo         *info)
+{
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE))
+		return g_file_info_get_content_type (info);
+
+	return g_file_info_get_attribute_string (info,
+	                                         G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+}
@@ -80,6 +80,10 @@ void     tracker_miner_files_writeback_notify     (TrackerMinerFiles *mf,
                                                    const GError      *error);
 TrackerStorage * tracker_miner_files_get_storage (TrackerMinerFiles *mf);
 
+const gchar * tracker_miner_files_get_content_type (TrackerMinerFiles *mf,
+                                                    GFile             *file,
+                                                    GFileInfo         *info);
+
 G_END_DECLS
 
 #endif /* __TRACKER_MINER_FS_FILES_H__ */
@@ -19,6 +19,8 @@
 
 #include "config-miners.h"
 
+#include <string.h>
+
 #include <libtracker-miners-common/tracker-dbus.h>
 #include <libtracker-miners-common/tracker-enums.h>
 #include <libtracker-miners-common/tracker-miners-enum-types.h>
@@ -45,8 +47,18 @@ typedef struct {
 	GArray *indexed_files;
 	GStrv graphs;
 	gchar *full_path;
+
+	/* IndexLocations calls waiting for their locations */
+	GList *pending_requests;
+	/* Locations the miner reported as indexed */
+	GHashTable *indexed_locations;
 } TrackerMinerFilesIndexPrivate;
 
+typedef struct {
+	GStrv uris;
+	GHashTable *pending;
+} IndexRequest;
+
 enum {
 	PROP_0,
 	PROP_FILES_MINER
@@ -113,11 +125,22 @@ tracker_miner_files_index_class_init (TrackerMinerFilesIndexClass *klass)
 		              G_TYPE_NONE, 0);
 }
 
+static void
+index_request_free (IndexRequest *request)
+{
+	g_strfreev (request->uris);
+	g_hash_table_unref (request->pending);
+	g_slice_free (IndexRequest, request);
+}
+
 static void
 index_finalize (GObject *object)
 {
 	TrackerMinerFilesIndexPrivate *priv = TRACKER_MINER_FILES_INDEX_GET_PRIVATE (object);
 
+	g_list_free_full (priv->pending_requests, (GDestroyNotify) index_request_free);
+	g_hash_table_unref (priv->indexed_locations);
+
 	g_object_unref (priv->skeleton);
 	g_object_unref (priv->proxy_skeleton);
 
@@ -207,18 +230,44 @@ tracker_miner_files_index_handle_index_location (TrackerDBusMinerFilesIndex *ske
 	return TRUE;
 }
 
+static gint
+compare_uri_length (gconstpointer a,
+                    gconstpointer b)
+{
+	const gchar *uri_a = *((const gchar **) a);
+	const gchar *uri_b = *((const gchar **) b);
+
+	return (gint) strlen (uri_a) - (gint) strlen (uri_b);
+}
+
+static gboolean
+file_has_ancestor_in_set (GFile      *file,
+                          GHashTable *set)
+{
+	GFile *parent, *next;
+	gboolean found = FALSE;
+
+	parent = g_file_get_parent (file);
+
+	while (parent && !found) {
+		found = g_hash_table_contains (set, parent);
+		next = g_file_get_parent (parent);
+		g_object_unref (parent);
+		parent = next;
+	}
+
+	g_clear_object (&parent);
+
+	return found;
+}
+
 static void
-peer_listener_unwatch_file (TrackerMinerFilesPeerListener *listener,
-                            GFile                         *file,
-                            gpointer                       user_data)
+remove_indexed_file (TrackerMinerFilesIndex *index,
+                     const gchar            *uri)
 {
-	TrackerMinerFilesIndex *index = user_data;
 	TrackerMinerFilesIndexPrivate *priv = TRACKER_MINER_FILES_INDEX_GET_PRIVATE (index);
-	gchar *uri;
 	gint i;
 
-	uri = g_file_get_uri (file);
-
 	for (i = 0; i < priv->indexed_files->len; i++) {
 		const gchar *indexed_uri;
 
@@ -229,6 +278,193 @@ peer_listener_unwatch_file (TrackerMinerFilesPeerListener *listener,
 			break;
 		}
 	}
+}
+
+/* Drops @uri from the pending requests, requests waiting for no
+ * other location are reported as indexed if @indexed is set.
+ */
+static void
+finish_pending_location (TrackerMinerFilesIndex *index,
+                         const gchar            *uri,
+                         gboolean                indexed)
+{
+	TrackerMinerFilesIndexPrivate *priv = TRACKER_MINER_FILES_INDEX_GET_PRIVATE (index);
+	GList *l, *next;
+
+	for (l = priv->pending_requests; l; l = next) {
+		IndexRequest *request = l->data;
+
+		next = l->next;
+
+		if (!g_hash_table_remove (request->pending, uri) ||
+		    g_hash_table_size (request->pending) > 0)
+			continue;
+
+		if (indexed) {
+			tracker_dbus_miner_files_index_emit_locations_indexed (priv->skeleton,
+			                                                       (const gchar * const *) request->uris);
+		}
+
+		priv->pending_requests = g_list_delete_link (priv->pending_requests, l);
+		index_request_free (request);
+	}
+}
+
+static gboolean
+tracker_miner_files_index_handle_index_locations (TrackerDBusMinerFilesIndex *skeleton,
+                                                  GDBusMethodInvocation      *invocation,
+                                                  const gchar * const        *file_uris,
+                                                  const gchar * const        *graphs,
+                                                  const gchar * const        *flags,
+                                                  TrackerMinerFilesIndex     *index)
+{
+	TrackerMinerFilesIndexPrivate *priv;
+	TrackerDBusRequest *request;
+	TrackerIndexLocationFlags index_flags;
+	IndexRequest *index_request;
+	GHashTable *accepted;
+	GPtrArray *uris, *accepted_uris;
+	gboolean changed = FALSE;
+	const gchar *sender;
+	guint i;
+
+	priv = TRACKER_MINER_FILES_INDEX_GET_PRIVATE (index);
+
+	request = tracker_g_dbus_request_begin (invocation, "%s(%d uris)", __FUNCTION__,
+	                                        g_strv_length ((gchar **) file_uris));
+
+	index_flags = parse_index_location_flags (flags);
+	sender = g_dbus_method_invocation_get_sender (invocation);
+
+	/* Handle shorter URIs first, so locations contained in other
+	 * locations from the same request can be dropped, those will
+	 * be indexed as part of their parent folder.
+	 */
+	uris = g_ptr_array_new ();
+	for (i = 0; file_uris[i]; i++)
+		g_ptr_array_add (uris, (gpointer) file_uris[i]);
+	g_ptr_array_sort (uris, compare_uri_length);
+
+	accepted = g_hash_table_new_full (g_file_hash,
+	                                  (GEqualFunc) g_file_equal,
+	                                  g_object_unref, NULL);
+	accepted_uris = g_ptr_array_new ();
+	index_request = g_slice_new0 (IndexRequest);
+	index_request->pending = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                                g_free, NULL);
+
+	for (i = 0; i < uris->len; i++) {
+		const gchar *file_uri = g_ptr_array_index (uris, i);
+		GFile *file;
+
+		file = g_file_new_for_uri (file_uri);
+
+		if (g_hash_table_contains (accepted, file) ||
+		    file_has_ancestor_in_set (file, accepted)) {
+			g_object_unref (file);
+			continue;
+		}
+
+		if (!tracker_miner_files_peer_listener_is_file_watched (priv->peer_listener, file)) {
+			gchar *uri = g_strdup (file_uri);
+			g_array_append_val (priv->indexed_files, uri);
+			changed = TRUE;
+		}
+
+		tracker_miner_files_peer_listener_add_watch (priv->peer_listener,
+		                                             sender, file,
+		                                             graphs, index_flags);
+		g_hash_table_add (accepted, file);
+		g_ptr_array_add (accepted_uris, g_strdup (file_uri));
+
+		/* Locations indexed earlier need no waiting */
+		if (!g_hash_table_contains (priv->indexed_locations, file_uri))
+			g_hash_table_add (index_request->pending, g_strdup (file_uri));
+	}
+
+	g_ptr_array_add (accepted_uris, NULL);
+	index_request->uris = (GStrv) g_ptr_array_free (accepted_uris, FALSE);
+
+	/* Update the indexed locations once for the whole request */
+	if (changed)
+		update_indexed_files (index);
+
+	tracker_dbus_request_end (request, NULL);
+	g_dbus_method_invocation_return_value (invocation, NULL);
+
+	/* LocationsIndexed is emitted once, after the last location
+	 * of the request was indexed.
+	 */
+	if (g_hash_table_size (index_request->pending) == 0) {
+		tracker_dbus_miner_files_index_emit_locations_indexed (priv->skeleton,
+		                                                       (const gchar * const *) index_request->uris);
+		index_request_free (index_request);
+	} else {
+		priv->pending_requests = g_list_append (priv->pending_requests,
+		                                        index_request);
+	}
+
+	g_hash_table_unref (accepted);
+	g_ptr_array_unref (uris);
+
+	return TRUE;
+}
+
+static gboolean
+tracker_miner_files_index_handle_notify_locations_indexed (TrackerDBusMinerFilesProxy *skeleton,
+                                                           GDBusMethodInvocation      *invocation,
+                                                           const gchar * const        *file_uris,
+                                                           gboolean                    folders,
+                                                           TrackerMinerFilesIndex     *index)
+{
+	TrackerMinerFilesIndexPrivate *priv;
+	gboolean changed = FALSE;
+	guint i;
+
+	priv = TRACKER_MINER_FILES_INDEX_GET_PRIVATE (index);
+
+	for (i = 0; file_uris[i]; i++) {
+		GFile *file;
+
+		/* Only locations still requested are remembered */
+		file = g_file_new_for_uri (file_uris[i]);
+		if (tracker_miner_files_peer_listener_is_file_watched (priv->peer_listener, file))
+			g_hash_table_add (priv->indexed_locations, g_strdup (file_uris[i]));
+		g_object_unref (file);
+
+		/* Files are done once indexed, folders stay as indexing
+		 * roots, the miner drops what is no longer listed.
+		 */
+		if (!folders) {
+			remove_indexed_file (index, file_uris[i]);
+			changed = TRUE;
+		}
+
+		finish_pending_location (index, file_uris[i], TRUE);
+	}
+
+	if (changed)
+		update_indexed_files (index);
+
+	g_dbus_method_invocation_return_value (invocation, NULL);
+
+	return TRUE;
+}
+
+static void
+peer_listener_unwatch_file (TrackerMinerFilesPeerListener *listener,
+                            GFile                         *file,
+                            gpointer                       user_data)
+{
+	TrackerMinerFilesIndex *index = user_data;
+	TrackerMinerFilesIndexPrivate *priv = TRACKER_MINER_FILES_INDEX_GET_PRIVATE (index);
+	gchar *uri;
+
+	uri = g_file_get_uri (file);
+
+	remove_indexed_file (index, uri);
+	g_hash_table_remove (priv->indexed_locations, uri);
+	finish_pending_location (index, uri, FALSE);
 
 	update_indexed_files (index);
 
@@ -266,13 +502,21 @@ tracker_miner_files_index_init (TrackerMinerFilesIndex *object)
 	priv = TRACKER_MINER_FILES_INDEX_GET_PRIVATE (object);
 
 	priv->proxy_skeleton = tracker_dbus_miner_files_proxy_skeleton_new ();
+	g_signal_connect (priv->proxy_skeleton, "handle-notify-locations-indexed",
+	                  G_CALLBACK (tracker_miner_files_index_handle_notify_locations_indexed),
+	                  object);
 
 	priv->skeleton = tracker_dbus_miner_files_index_skeleton_new ();
 	g_signal_connect (priv->skeleton, "handle-index-location",
 	                  G_CALLBACK (tracker_miner_files_index_handle_index_location),
 	                  object);
+	g_signal_connect (priv->skeleton, "handle-index-locations",
+	                  G_CALLBACK (tracker_miner_files_index_handle_index_locations),
+	                  object);
 	priv->indexed_files = g_array_new (TRUE, TRUE, sizeof (gchar *));
 	g_array_set_clear_func (priv->indexed_files, string_clear);
+	priv->indexed_locations = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                                 g_free, NULL);
 }
 
 TrackerMinerFilesIndex *
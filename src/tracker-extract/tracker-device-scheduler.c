@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include "tracker-device-scheduler.h"
+
+/* Tasks waiting for a worker are queued per device, devices with
+ * waiting tasks are served round robin. Tasks are opaque here,
+ * the caller owns them.
+ */
+struct _TrackerDeviceQueue {
+	const gchar *device;
+	GQueue tasks;
+	guint n_busy;
+	guint max_busy;
+};
+
+struct _TrackerDeviceScheduler {
+	GHashTable *queues; /* Interned device -> TrackerDeviceQueue */
+	GQueue ready_devices;
+	guint n_waiting;
+	guint n_busy;
+	guint n_busy_devices;
+	guint max_busy;
+};
+
+static void
+device_queue_free (TrackerDeviceQueue *queue)
+{
+	g_queue_clear (&queue->tasks);
+	g_slice_free (TrackerDeviceQueue, queue);
+}
+
+/**
+ * tracker_device_scheduler_new:
+ * @max_busy: maximum number of tasks running at once, across devices
+ *
+ * Returns: (transfer full): a new #TrackerDeviceScheduler
+ **/
+TrackerDeviceScheduler *
+tracker_device_scheduler_new (guint max_busy)
+{
+	TrackerDeviceScheduler *scheduler;
+
+	g_return_val_if_fail (max_busy > 0, NULL);
+
+	scheduler = g_slice_new0 (TrackerDeviceScheduler);
+	scheduler->queues = g_hash_table_new_full (NULL, NULL, NULL,
+	                                           (GDestroyNotify) device_queue_free);
+	g_queue_init (&scheduler->ready_devices);
+	scheduler->max_busy = max_busy;
+
+	return scheduler;
+}
+
+/**
+ * tracker_device_scheduler_free:
+ * @scheduler: a #TrackerDeviceScheduler
+ *
+ * Frees @scheduler, waiting tasks are dropped without being freed.
+ **/
+void
+tracker_device_scheduler_free (TrackerDeviceScheduler *scheduler)
+{
+	g_queue_clear (&scheduler->ready_devices);
+	g_hash_table_unref (scheduler->queues);
+	g_slice_free (TrackerDeviceScheduler, scheduler);
+}
+
+static TrackerDeviceQueue *
+lookup_device_queue (TrackerDeviceScheduler *scheduler,
+                     const gchar            *device,
+                     TrackerDeviceType       device_type)
+{
+	TrackerDeviceQueue *queue;
+
+	device = g_intern_string (device ? device : "");
+	queue = g_hash_table_lookup (scheduler->queues, device);
+
+	if (!queue) {
+		queue = g_slice_new0 (TrackerDeviceQueue);
+		queue->device = device;
+		g_queue_init (&queue->tasks);
+
+		if (device_type == TRACKER_DEVICE_TYPE_ROTATIONAL)
+			queue->max_busy = TRACKER_DEVICE_ROTATIONAL_WORKERS;
+		else if (device_type == TRACKER_DEVICE_TYPE_REMOTE)
+			queue->max_busy = TRACKER_DEVICE_REMOTE_WORKERS;
+		else
+			queue->max_busy = scheduler->max_busy;
+
+		TRACKER_NOTE (CONFIG, g_message ("Extracting from device '%s' with up to %d workers",
+		                                 device, queue->max_busy));
+		g_hash_table_insert (scheduler->queues, (gpointer) device, queue);
+	}
+
+	return queue;
+}
+
+/**
+ * tracker_device_scheduler_push:
+ * @scheduler: a #TrackerDeviceScheduler
+ * @device: (nullable): device holding the file of @task
+ * @device_type: type of @device
+ * @task: the task
+ *
+ * Queues @task behind the other tasks on @device. The number of
+ * tasks running at once on a device depends on @device_type, which
+ * is taken into account the first time the device is seen.
+ *
+ * Returns: (transfer none): the queue for @device
+ **/
+TrackerDeviceQueue *
+tracker_device_scheduler_push (TrackerDeviceScheduler *scheduler,
+                               const gchar            *device,
+                               TrackerDeviceType       device_type,
+                               gpointer                task)
+{
+	TrackerDeviceQueue *queue;
+
+	queue = lookup_device_queue (scheduler, device, device_type);
+	g_queue_push_tail (&queue->tasks, task);
+	scheduler->n_waiting++;
+
+	if (queue->tasks.length == 1)
+		g_queue_push_tail (&scheduler->ready_devices, queue);
+
+	return queue;
+}
+
+/**
+ * tracker_device_scheduler_pop:
+ * @scheduler: a #TrackerDeviceScheduler
+ * @queue: (out) (transfer none): return location for the queue of
+ *         the task
+ *
+ * Takes the next task that may run now, taking turns between the
+ * devices that have room for more. The task counts as running until
+ * tracker_device_scheduler_release() is called on @queue.
+ *
+ * Returns: (nullable): the task, or %NULL if none may run now
+ **/
+gpointer
+tracker_device_scheduler_pop (TrackerDeviceScheduler  *scheduler,
+                              TrackerDeviceQueue     **queue)
+{
+	TrackerDeviceQueue *candidate = NULL;
+	GList *l;
+
+	if (scheduler->n_busy >= scheduler->max_busy)
+		return NULL;
+
+	for (l = scheduler->ready_devices.head; l; l = l->next) {
+		candidate = l->data;
+
+		if (candidate->n_busy < candidate->max_busy)
+			break;
+	}
+
+	if (!l)
+		return NULL;
+
+	g_queue_delete_link (&scheduler->ready_devices, l);
+
+	/* Back to the end of the line if it has more */
+	if (candidate->tasks.length > 1)
+		g_queue_push_tail (&scheduler->ready_devices, candidate);
+
+	if (candidate->n_busy == 0)
+		scheduler->n_busy_devices++;
+	candidate->n_busy++;
+	scheduler->n_busy++;
+	scheduler->n_waiting--;
+
+	*queue = candidate;
+
+	return g_queue_pop_head (&candidate->tasks);
+}
+
+/**
+ * tracker_device_scheduler_release:
+ * @scheduler: a #TrackerDeviceScheduler
+ * @queue: the queue a finished task was popped from
+ *
+ * Gives back the room taken by a task, once it finished or failed
+ * to start.
+ **/
+void
+tracker_device_scheduler_release (TrackerDeviceScheduler *scheduler,
+                                  TrackerDeviceQueue     *queue)
+{
+	g_return_if_fail (queue->n_busy > 0);
+
+	queue->n_busy--;
+	scheduler->n_busy--;
+
+	if (queue->n_busy == 0)
+		scheduler->n_busy_devices--;
+}
+
+/**
+ * tracker_device_scheduler_get_n_waiting:
+ * @scheduler: a #TrackerDeviceScheduler
+ *
+ * Returns: the number of tasks waiting for room on their device
+ **/
+guint
+tracker_device_scheduler_get_n_waiting (TrackerDeviceScheduler *scheduler)
+{
+	return scheduler->n_waiting;
+}
+
+/**
+ * tracker_device_scheduler_get_n_busy:
+ * @scheduler: a #TrackerDeviceScheduler
+ *
+ * Returns: the number of tasks running
+ **/
+guint
+tracker_device_scheduler_get_n_busy (TrackerDeviceScheduler *scheduler)
+{
+	return scheduler->n_busy;
+}
+
+/**
+ * tracker_device_scheduler_get_n_busy_devices:
+ * @scheduler: a #TrackerDeviceScheduler
+ *
+ * Returns: the number of devices with tasks running
+ **/
+guint
+tracker_device_scheduler_get_n_busy_devices (TrackerDeviceScheduler *scheduler)
+{
+	return scheduler->n_busy_devices;
+}
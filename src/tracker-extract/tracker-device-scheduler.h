@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __TRACKER_DEVICE_SCHEDULER_H__
+#define __TRACKER_DEVICE_SCHEDULER_H__
+
+#include <glib.h>
+
+#include <libtracker-miners-common/tracker-common.h>
+
+G_BEGIN_DECLS
+
+/* Workers reading from a device at once, rotational disks are
+ * read one file at a time to avoid seeking back and forth.
+ */
+#define TRACKER_DEVICE_ROTATIONAL_WORKERS 1
+#define TRACKER_DEVICE_REMOTE_WORKERS 2
+
+typedef struct _TrackerDeviceScheduler TrackerDeviceScheduler;
+typedef struct _TrackerDeviceQueue TrackerDeviceQueue;
+
+TrackerDeviceScheduler * tracker_device_scheduler_new  (guint                    max_busy);
+void                     tracker_device_scheduler_free (TrackerDeviceScheduler  *scheduler);
+
+TrackerDeviceQueue * tracker_device_scheduler_push    (TrackerDeviceScheduler  *scheduler,
+                                                       const gchar             *device,
+                                                       TrackerDeviceType        device_type,
+                                                       gpointer                 task);
+gpointer             tracker_device_scheduler_pop     (TrackerDeviceScheduler  *scheduler,
+                                                       TrackerDeviceQueue     **queue);
+void                 tracker_device_scheduler_release (TrackerDeviceScheduler  *scheduler,
+                                                       TrackerDeviceQueue      *queue);
+
+guint tracker_device_scheduler_get_n_waiting      (TrackerDeviceScheduler *scheduler);
+guint tracker_device_scheduler_get_n_busy         (TrackerDeviceScheduler *scheduler);
+guint tracker_device_scheduler_get_n_busy_devices (TrackerDeviceScheduler *scheduler);
+
+G_END_DECLS
+
+#endif /* __TRACKER_DEVICE_SCHEDULER_H__ */
@@ -21,8 +21,22 @@
 
 #include "tracker-extract-controller.h"
 
+#include <libtracker-miners-common/tracker-common.h>
+#include <libtracker-miner/tracker-decorator-private.h>
+
 #include "tracker-main.h"
 
+#define TRACKER_EXTRACT_METRICS_INTERFACE "org.freedesktop.Tracker3.Extract.Metrics"
+
+static const gchar introspection_xml[] =
+	"<node>"
+	"  <interface name='" TRACKER_EXTRACT_METRICS_INTERFACE "'>"
+	"    <method name='GetMetrics'>"
+	"      <arg type='a{sv}' name='metrics' direction='out' />"
+	"    </method>"
+	"  </interface>"
+	"</node>";
+
 enum {
 	PROP_DECORATOR = 1,
 	PROP_CONNECTION,
@@ -33,6 +47,12 @@ struct TrackerExtractControllerPrivate {
 	TrackerConfig *config;
 	GCancellable *cancellable;
 	GDBusConnection *connection;
+	TrackerPressure *pressure;
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	GMemoryMonitor *memory_monitor;
+#endif
+	GDBusNodeInfo *introspection_data;
+	guint registration_id;
 	guint watch_id;
 	guint progress_signal_id;
 	gint paused;
@@ -194,6 +214,190 @@ update_wait_for_miner_fs (TrackerExtractController *self)
 	}
 }
 
+static void
+handle_method_call_get_metrics (TrackerExtractController *self,
+                                GDBusMethodInvocation    *invocation)
+{
+	TrackerDecorator *decorator = self->priv->decorator;
+	TrackerExtract *extract;
+	GVariantBuilder builder;
+
+	g_object_get (decorator, "extractor", &extract, NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "extractor",
+	                       tracker_extract_get_metrics (extract));
+	g_variant_builder_add (&builder, "{sv}", "decorator",
+	                       _tracker_decorator_get_commit_metrics (decorator));
+	g_variant_builder_add (&builder, "{sv}", "concurrency",
+	                       g_variant_new_uint32 (tracker_extract_decorator_get_concurrency (TRACKER_EXTRACT_DECORATOR (decorator))));
+	if (self->priv->pressure) {
+		g_variant_builder_add (&builder, "{sv}", "pressure",
+		                       tracker_pressure_get_state (self->priv->pressure));
+	}
+	g_variant_builder_add (&builder, "{sv}", "memory",
+	                       tracker_memory_budget_get_usage (tracker_memory_budget_get_default ()));
+	g_object_unref (extract);
+
+	g_dbus_method_invocation_return_value (invocation,
+	                                       g_variant_new ("(@a{sv})",
+	                                                      g_variant_builder_end (&builder)));
+}
+
+static void
+handle_method_call (GDBusConnection       *connection,
+                    const gchar           *sender,
+                    const gchar           *object_path,
+                    const gchar           *interface_name,
+                    const gchar           *method_name,
+                    GVariant              *parameters,
+                    GDBusMethodInvocation *invocation,
+                    gpointer               user_data)
+{
+	TrackerExtractController *self = user_data;
+
+	if (g_strcmp0 (method_name, "GetMetrics") == 0) {
+		handle_method_call_get_metrics (self, invocation);
+	} else {
+		g_dbus_method_invocation_return_error (invocation,
+		                                       G_DBUS_ERROR,
+		                                       G_DBUS_ERROR_UNKNOWN_METHOD,
+		                                       "Unknown method '%s'", method_name);
+	}
+}
+
+static void
+register_metrics_object (TrackerExtractController *self)
+{
+	GDBusInterfaceVTable interface_vtable = {
+		handle_method_call,
+		NULL, NULL
+	};
+	GError *error = NULL;
+
+	if (!self->priv->connection)
+		return;
+
+	self->priv->introspection_data =
+		g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+	g_assert (self->priv->introspection_data != NULL);
+
+	self->priv->registration_id =
+		g_dbus_connection_register_object (self->priv->connection,
+		                                   TRACKER_EXTRACT_PATH,
+		                                   self->priv->introspection_data->interfaces[0],
+		                                   &interface_vtable,
+		                                   self,
+		                                   NULL,
+		                                   &error);
+	if (error) {
+		g_warning ("Could not register the D-Bus object " TRACKER_EXTRACT_PATH ", %s",
+		           error->message);
+		g_error_free (error);
+	}
+}
+
+static void
+update_concurrency (TrackerExtractController *self)
+{
+	GSettings *settings = G_SETTINGS (self->priv->config);
+	guint max, concurrency;
+
+	/* Full speed extracts as many files at once as configured,
+	 * or as there are CPUs, full pacing goes back to one file
+	 * at a time.
+	 */
+	max = g_settings_get_int (settings, "max-extracting-files");
+	if (max == 0)
+		max = g_get_num_processors ();
+
+	max = CLAMP (max, 1, tracker_extract_decorator_get_max_concurrency ());
+
+	if (self->priv->pressure)
+		concurrency = tracker_pressure_scale_limit (self->priv->pressure, max);
+	else
+		concurrency = max;
+
+	tracker_extract_decorator_set_concurrency (TRACKER_EXTRACT_DECORATOR (self->priv->decorator),
+	                                           concurrency);
+}
+
+static void
+set_up_pressure (TrackerExtractController *self)
+{
+	GSettings *settings = G_SETTINGS (self->priv->config);
+
+	g_signal_connect_object (settings,
+	                         "changed::max-extracting-files",
+	                         G_CALLBACK (update_concurrency),
+	                         self, G_CONNECT_SWAPPED);
+
+	self->priv->pressure = tracker_pressure_new (NULL);
+
+	if (!tracker_pressure_is_available (self->priv->pressure)) {
+		g_clear_object (&self->priv->pressure);
+		update_concurrency (self);
+		return;
+	}
+
+	g_settings_bind (settings, "cpu-pressure-target",
+	                 self->priv->pressure, "cpu-target",
+	                 G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "io-pressure-target",
+	                 self->priv->pressure, "io-target",
+	                 G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "memory-pressure-target",
+	                 self->priv->pressure, "memory-target",
+	                 G_SETTINGS_BIND_GET);
+
+	g_signal_connect_object (self->priv->pressure,
+	                         "notify::pacing",
+	                         G_CALLBACK (update_concurrency),
+	                         self, G_CONNECT_SWAPPED);
+	update_concurrency (self);
+}
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+static void
+on_low_memory (GMemoryMonitor             *monitor,
+               GMemoryMonitorWarningLevel  level,
+               gpointer                    user_data)
+{
+	tracker_memory_budget_shed (tracker_memory_budget_get_default (),
+	                            level > G_MEMORY_MONITOR_WARNING_LEVEL_LOW ?
+	                            TRACKER_MEMORY_BUDGET_CRITICAL :
+	                            TRACKER_MEMORY_BUDGET_OVER);
+}
+#endif
+
+static void
+set_up_rate_limiter (TrackerExtractController *self)
+{
+	GSettings *settings = G_SETTINGS (self->priv->config);
+	TrackerRateLimiter *limiter = tracker_rate_limiter_get_default ();
+
+	g_settings_bind (settings, "file-rate-limit",
+	                 limiter, "file-rate",
+	                 G_SETTINGS_BIND_GET);
+	g_settings_bind (settings, "read-rate-limit",
+	                 limiter, "read-rate",
+	                 G_SETTINGS_BIND_GET);
+}
+
+static void
+set_up_memory_budget (TrackerExtractController *self)
+{
+	tracker_memory_budget_bind_limit (tracker_memory_budget_get_default (),
+	                                  G_SETTINGS (self->priv->config),
+	                                  "memory-budget");
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	self->priv->memory_monitor = g_memory_monitor_dup_default ();
+	g_signal_connect (self->priv->memory_monitor, "low-memory-warning",
+	                  G_CALLBACK (on_low_memory), NULL);
+#endif
+}
+
 static void
 tracker_extract_controller_constructed (GObject *object)
 {
@@ -209,6 +413,11 @@ tracker_extract_controller_constructed (GObject *object)
 	                         G_CALLBACK (update_wait_for_miner_fs),
 	                         self, G_CONNECT_SWAPPED);
 	update_wait_for_miner_fs (self);
+
+	set_up_pressure (self);
+	set_up_memory_budget (self);
+	set_up_rate_limiter (self);
+	register_metrics_object (self);
 }
 
 static void
@@ -254,6 +463,22 @@ tracker_extract_controller_dispose (GObject *object)
 	TrackerExtractController *self = (TrackerExtractController *) object;
 
 	disconnect_all (self);
+
+	if (self->priv->registration_id != 0) {
+		g_dbus_connection_unregister_object (self->priv->connection,
+		                                     self->priv->registration_id);
+		self->priv->registration_id = 0;
+	}
+
+	g_clear_pointer (&self->priv->introspection_data, g_dbus_node_info_unref);
+	g_clear_object (&self->priv->pressure);
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	if (self->priv->memory_monitor) {
+		g_signal_handlers_disconnect_by_func (self->priv->memory_monitor,
+		                                      on_low_memory, NULL);
+		g_clear_object (&self->priv->memory_monitor);
+	}
+#endif
 	g_clear_object (&self->priv->decorator);
 	g_clear_object (&self->priv->config);
 
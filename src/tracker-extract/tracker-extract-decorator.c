@@ -29,7 +29,18 @@ enum {
 	PROP_EXTRACTOR = 1
 };
 
-#define MAX_EXTRACTING_FILES 1
+/* Files extracted at once, the actual limit is set
+ * through tracker_extract_decorator_set_concurrency().
+ */
+#define MAX_EXTRACTING_FILES 4
+
+/* Files waiting behind a busy device, on top of those extracted */
+#define MAX_WAITING_FILES 16
+
+/* Files about to be extracted whose reads are hinted to the
+ * kernel, so the disk works while extractors parse.
+ */
+#define READAHEAD_WINDOW 4
 
 #define TRACKER_EXTRACT_DECORATOR_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TRACKER_TYPE_EXTRACT_DECORATOR, TrackerExtractDecoratorPrivate))
 
@@ -48,6 +59,8 @@ struct _TrackerExtractDecoratorPrivate {
 	TrackerExtract *extractor;
 	GTimer *timer;
 	guint n_extracting_files;
+	guint max_extracting_files;
+	GHashTable *readahead_items; /* Set of TrackerDecoratorInfo */
 
 	TrackerExtractPersistence *persistence;
 	GDBusProxy *index_proxy;
@@ -103,6 +116,9 @@ tracker_extract_decorator_set_property (GObject      *object,
 	switch (param_id) {
 	case PROP_EXTRACTOR:
 		priv->extractor = g_value_dup_object (value);
+		g_signal_connect_object (priv->extractor, "notify::n-waiting-tasks",
+		                         G_CALLBACK (decorator_get_next_file),
+		                         object, G_CONNECT_SWAPPED);
 		break;
 	}
 }
@@ -120,6 +136,7 @@ tracker_extract_decorator_finalize (GObject *object)
 	if (priv->timer)
 		g_timer_destroy (priv->timer);
 
+	g_clear_pointer (&priv->readahead_items, g_hash_table_unref);
 	g_clear_object (&priv->index_proxy);
 
 	G_OBJECT_CLASS (tracker_extract_decorator_parent_class)->finalize (object);
@@ -170,9 +187,15 @@ get_metadata_cb (TrackerExtract *extract,
 	}
 
 	if (error) {
-		decorator_ignore_file (data->file,
-		                       TRACKER_EXTRACT_DECORATOR (data->decorator),
-		                       error->message, NULL);
+		/* Files whose worker timed out or crashed are
+		 * flagged as failed, cancelled ones are not.
+		 */
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			decorator_ignore_file (data->file,
+			                       TRACKER_EXTRACT_DECORATOR (data->decorator),
+			                       error->message, NULL);
+		}
+
 		tracker_decorator_info_complete_error (data->decorator_info, error);
 	} else {
 		gchar *resource_sparql, *sparql;
@@ -235,12 +258,47 @@ task_cancellable_cancelled_cb (GCancellable *cancellable,
 	tracker_extract_persistence_remove_file (priv->persistence, data->file);
 	uri = g_file_get_uri (data->file);
 
-	g_debug ("Cancelled task for '%s' was currently being "
-		 "processed, _exit()ing immediately",
+	/* The extraction worker handling the file is killed,
+	 * the task will finish with G_IO_ERROR_CANCELLED.
+	 */
+	g_debug ("Cancelled task for '%s' was currently being processed",
 		 uri);
 	g_free (uri);
+}
+
+/* Hints the items next in line that were not hinted yet, items
+ * are kept around so they are not taken for new ones.
+ */
+static void
+decorator_readahead_next_items (TrackerDecorator *decorator)
+{
+	TrackerExtractDecoratorPrivate *priv;
+	GHashTable *items;
+	GList *next, *l;
 
-	_exit (EXIT_FAILURE);
+	priv = tracker_extract_decorator_get_instance_private (TRACKER_EXTRACT_DECORATOR (decorator));
+	next = tracker_decorator_peek_items (decorator, READAHEAD_WINDOW);
+	items = g_hash_table_new_full (NULL, NULL,
+	                               (GDestroyNotify) tracker_decorator_info_unref,
+	                               NULL);
+
+	for (l = next; l; l = l->next) {
+		TrackerDecoratorInfo *info = l->data;
+
+		if ((!priv->readahead_items ||
+		     !g_hash_table_contains (priv->readahead_items, info)) &&
+		    tracker_decorator_info_get_url (info)) {
+			tracker_extract_readahead (priv->extractor,
+			                           tracker_decorator_info_get_url (info),
+			                           tracker_decorator_info_get_mimetype (info));
+		}
+
+		g_hash_table_add (items, tracker_decorator_info_ref (info));
+	}
+
+	g_list_free (next);
+	g_clear_pointer (&priv->readahead_items, g_hash_table_unref);
+	priv->readahead_items = items;
 }
 
 static void
@@ -303,6 +361,9 @@ decorator_next_item_cb (TrackerDecorator *decorator,
 
 	g_debug ("Extracting metadata for '%s'", tracker_decorator_info_get_url (info));
 
+	/* The cache may have been refilled for this item */
+	decorator_readahead_next_items (decorator);
+
 	tracker_extract_persistence_add_file (priv->persistence, data->file);
 
 	g_set_object (&data->cancellable, g_task_get_cancellable (task));
@@ -316,10 +377,37 @@ decorator_next_item_cb (TrackerDecorator *decorator,
 	tracker_extract_file (priv->extractor,
 	                      tracker_decorator_info_get_url (info),
 	                      tracker_decorator_info_get_mimetype (info),
+	                      tracker_decorator_info_get_content_id (info),
 	                      g_task_get_cancellable (task),
 	                      (GAsyncReadyCallback) get_metadata_cb, data);
 }
 
+static guint
+get_max_in_flight (TrackerExtractDecorator *decorator)
+{
+	TrackerExtractDecoratorPrivate *priv;
+	guint n_waiting, max_running;
+
+	priv = tracker_extract_decorator_get_instance_private (decorator);
+	n_waiting = tracker_extract_get_n_waiting_tasks (priv->extractor);
+	max_running = priv->max_extracting_files;
+
+	/* Once a device is saturated, pacing alone would leave
+	 * every other device idle behind it. Keep one file in
+	 * flight per busy device plus one more, so files on
+	 * other devices are found and extracted meanwhile.
+	 */
+	if (n_waiting > 0) {
+		max_running = MAX (max_running,
+		                   tracker_extract_get_n_busy_devices (priv->extractor) + 1);
+	}
+
+	/* Waiting files don't take a slot, their own allowance
+	 * does not depend on the concurrency.
+	 */
+	return max_running + MIN (n_waiting, MAX_WAITING_FILES);
+}
+
 static void
 decorator_get_next_file (TrackerDecorator *decorator)
 {
@@ -331,12 +419,15 @@ decorator_get_next_file (TrackerDecorator *decorator)
 	    tracker_miner_is_paused (TRACKER_MINER (decorator)))
 		return;
 
-	while (priv->n_extracting_files < MAX_EXTRACTING_FILES) {
+	while (priv->n_extracting_files <
+	       get_max_in_flight (TRACKER_EXTRACT_DECORATOR (decorator))) {
 		priv->n_extracting_files++;
 		tracker_decorator_next (decorator, NULL,
 		                        (GAsyncReadyCallback) decorator_next_item_cb,
 		                        NULL);
 	}
+
+	decorator_readahead_next_items (decorator);
 }
 
 static void
@@ -517,6 +608,10 @@ persistence_ignore_file (GFile    *file,
 static void
 tracker_extract_decorator_init (TrackerExtractDecorator *decorator)
 {
+	TrackerExtractDecoratorPrivate *priv;
+
+	priv = tracker_extract_decorator_get_instance_private (decorator);
+	priv->max_extracting_files = 1;
 }
 
 static void
@@ -614,3 +709,43 @@ tracker_extract_decorator_new (TrackerSparqlConnection  *connection,
 	                       "extractor", extract,
 	                       NULL);
 }
+
+/* Sets how many files are extracted at once, lowering it
+ * lets the files being extracted finish.
+ */
+void
+tracker_extract_decorator_set_concurrency (TrackerExtractDecorator *decorator,
+                                           guint                    concurrency)
+{
+	TrackerExtractDecoratorPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_EXTRACT_DECORATOR (decorator));
+
+	priv = tracker_extract_decorator_get_instance_private (decorator);
+	concurrency = CLAMP (concurrency, 1, MAX_EXTRACTING_FILES);
+
+	if (priv->max_extracting_files == concurrency)
+		return;
+
+	g_debug ("Extracting up to %d files at once", concurrency);
+	priv->max_extracting_files = concurrency;
+	decorator_get_next_file (TRACKER_DECORATOR (decorator));
+}
+
+guint
+tracker_extract_decorator_get_concurrency (TrackerExtractDecorator *decorator)
+{
+	TrackerExtractDecoratorPrivate *priv;
+
+	g_return_val_if_fail (TRACKER_IS_EXTRACT_DECORATOR (decorator), 0);
+
+	priv = tracker_extract_decorator_get_instance_private (decorator);
+
+	return priv->max_extracting_files;
+}
+
+guint
+tracker_extract_decorator_get_max_concurrency (void)
+{
+	return MAX_EXTRACTING_FILES;
+}
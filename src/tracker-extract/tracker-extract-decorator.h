@@ -52,6 +52,11 @@ TrackerDecorator * tracker_extract_decorator_new (TrackerSparqlConnection  *conn
                                                   GCancellable             *cancellable,
                                                   GError                  **error);
 
+void  tracker_extract_decorator_set_concurrency     (TrackerExtractDecorator *decorator,
+                                                     guint                    concurrency);
+guint tracker_extract_decorator_get_concurrency     (TrackerExtractDecorator *decorator);
+guint tracker_extract_decorator_get_max_concurrency (void);
+
 G_END_DECLS
 
 #endif /* __TRACKER_EXTRACT_DECORATOR_H__ */
@@ -298,11 +298,8 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 {
 	TrackerResource *metadata;
 	gchar *resource_uri;
-	GFile *file;
 
-	file = tracker_extract_info_get_file (info);
-
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (info, NULL);
 	metadata = tracker_resource_new (resource_uri);
 	g_free (resource_uri);
 
@@ -532,7 +532,7 @@ content_xml_text_handler (GMarkupParseContext   *context,
 }
 
 static gchar *
-extract_opf_path (const gchar *uri)
+extract_opf_path (TrackerGsfZip *zip)
 {
 	GMarkupParseContext *context;
 	gchar *path = NULL;
@@ -548,7 +548,7 @@ extract_opf_path (const gchar *uri)
 	/* Load the internal container file from the Zip archive,
 	 * and parse it to extract the .opf file to get metadata from
 	 */
-	tracker_gsf_parse_xml_in_zip (uri, "META-INF/container.xml", context, &error);
+	tracker_gsf_zip_parse_xml (zip, "META-INF/container.xml", context, &error);
 	g_markup_parse_context_free (context);
 
 	if (error || !path) {
@@ -562,9 +562,9 @@ extract_opf_path (const gchar *uri)
 }
 
 static gchar *
-extract_opf_contents (const gchar *uri,
-                      const gchar *content_prefix,
-                      GList       *content_files)
+extract_opf_contents (TrackerGsfZip *zip,
+                      const gchar   *content_prefix,
+                      GList         *content_files)
 {
 	OPFContentData content_data = { 0 };
 	TrackerConfig *config;
@@ -591,7 +591,7 @@ extract_opf_contents (const gchar *uri,
 
 		/* Page file is relative to OPF file location */
 		path = g_build_filename (content_prefix, l->data, NULL);
-		tracker_gsf_parse_xml_in_zip (uri, path, context, &error);
+		tracker_gsf_zip_parse_xml (zip, path, context, &error);
 
 		if (error) {
 			g_warning ("Error extracting EPUB contents (%s): %s",
@@ -613,6 +613,7 @@ extract_opf_contents (const gchar *uri,
 
 static TrackerResource *
 extract_opf (const gchar          *uri,
+             TrackerGsfZip        *zip,
              const gchar          *opf_path)
 {
 	TrackerResource *ebook;
@@ -645,7 +646,7 @@ extract_opf (const gchar          *uri,
 	/* Load the internal container file from the Zip archive,
 	 * and parse it to extract the .opf file to get metadata from
 	 */
-	tracker_gsf_parse_xml_in_zip (uri, opf_path, context, &error);
+	tracker_gsf_zip_parse_xml (zip, opf_path, context, &error);
 	g_markup_parse_context_free (context);
 
 	if (error) {
@@ -658,7 +659,7 @@ extract_opf (const gchar          *uri,
 	}
 
 	dirname = g_path_get_dirname (opf_path);
-	contents = extract_opf_contents (uri, dirname, data->pages);
+	contents = extract_opf_contents (zip, dirname, data->pages);
 	g_free (dirname);
 
 	if (contents && *contents) {
@@ -676,20 +677,29 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
                               GError             **error)
 {
 	TrackerResource *ebook;
+	TrackerGsfZip *zip;
 	gchar *opf_path, *uri;
 	GFile *file;
 
 	file = tracker_extract_info_get_file (info);
 	uri = g_file_get_uri (file);
 
-	opf_path = extract_opf_path (uri);
+	zip = tracker_gsf_zip_open (uri, error);
+	if (!zip) {
+		g_free (uri);
+		return FALSE;
+	}
+
+	opf_path = extract_opf_path (zip);
 
 	if (!opf_path) {
+		tracker_gsf_zip_close (zip);
 		g_free (uri);
 		return FALSE;
 	}
 
-	ebook = extract_opf (uri, opf_path);
+	ebook = extract_opf (uri, zip, opf_path);
+	tracker_gsf_zip_close (zip);
 	g_free (opf_path);
 	g_free (uri);
 
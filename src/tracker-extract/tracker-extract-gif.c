@@ -111,10 +111,9 @@ read_metadata (GifFileType          *gifFile,
 	GifRecordType RecordType;
 	int frameheight;
 	int framewidth;
-	unsigned char *framedata = NULL;
 	GPtrArray *keywords;
 	guint i;
-	gint h;
+	guint n_frames = 0;
 	int status;
 	MergeData md = { 0 };
 	GifData   gd = { 0 };
@@ -136,7 +135,10 @@ read_metadata (GifFileType          *gifFile,
 		}
 
 		switch (RecordType) {
-			case IMAGE_DESC_RECORD_TYPE:
+			case IMAGE_DESC_RECORD_TYPE: {
+			GifByteType *CodeBlock;
+			int CodeSize;
+
 			if (DGifGetImageDesc(gifFile) == GIF_ERROR) {
 #if GIFLIB_MAJOR < 5
 				print_gif_error();
@@ -148,28 +150,36 @@ read_metadata (GifFileType          *gifFile,
 
 			framewidth  = gifFile->Image.Width;
 			frameheight = gifFile->Image.Height;
+			n_frames++;
+
+			/* Skip over the LZW compressed image data sub-blocks
+			 * without decoding them, we only care about the
+			 * extension blocks that may follow.
+			 */
+			status = DGifGetCode (gifFile, &CodeSize, &CodeBlock);
+
+			while (status == GIF_OK && CodeBlock != NULL)
+				status = DGifGetCodeNext (gifFile, &CodeBlock);
 
-			framedata = g_malloc_n (framewidth, sizeof(GifPixelType));
-			for (h = 0; h < frameheight; h++)
-			{
-				if (DGifGetLine(gifFile, framedata, framewidth)==GIF_ERROR) {
-					g_free (framedata);
+			if (status == GIF_ERROR) {
 #if GIFLIB_MAJOR < 5
-					print_gif_error();
+				print_gif_error();
 #else  /* GIFLIB_MAJOR < 5 */
-					gif_error ("Could not load a block of GIF pixes", gifFile->Error);
+				gif_error ("Could not skip a block of GIF pixels", gifFile->Error);
 #endif /* GIFLIB_MAJOR < 5 */
-					return NULL;
-				}
+				g_free (gd.width);
+				g_free (gd.height);
+				g_free (gd.comment);
+				return NULL;
 			}
 
+			g_free (gd.width);
+			g_free (gd.height);
 			gd.width  = g_strdup_printf ("%d", framewidth);
 			gd.height = g_strdup_printf ("%d", frameheight);
 
-
-			g_free (framedata);
-
 		break;
+		}
 		case EXTENSION_RECORD_TYPE:
 			extBlock.bytes = NULL;
 			extBlock.byteCount = 0;
@@ -240,6 +250,8 @@ read_metadata (GifFileType          *gifFile,
 		}
 	} while (RecordType != TERMINATE_RECORD_TYPE);
 
+	g_debug ("GIF contains %u frame(s)", n_frames);
+
 
 	if (!xd) {
 		xd = tracker_xmp_new_from_sidecar (file, &sidecar);
@@ -20,31 +20,37 @@
 
 #include "config-miners.h"
 
+#include <errno.h>
 #include <string.h>
 
 #include <glib.h>
 
 #include <libxml/HTMLparser.h>
-#include <libtracker-miners-common/tracker-file-utils.h>
-#include <libtracker-miners-common/tracker-utils.h>
+#include <libtracker-miners-common/tracker-common.h>
 #include <libtracker-extract/tracker-extract.h>
 
 #include "tracker-main.h"
 
+/* Size of the chunks fed to the parser */
+#define HTML_BUFFER_SIZE 16384
+
 typedef enum {
 	READ_TITLE,
 	READ_IGNORE
 } tag_type;
 
 typedef struct {
+	htmlParserCtxtPtr ctxt;
 	TrackerResource *metadata;
 	tag_type current;
 	guint in_body : 1;
 	guint has_license : 1;
 	guint has_description : 1;
+	guint stopped : 1;
 	GString *title;
 	GString *plain_text;
 	guint n_bytes_remaining;
+	gsize n_bytes_read;
 } parser_data;
 
 static gboolean
@@ -196,7 +202,7 @@ parser_characters (void          *data,
 
 	switch (pd->current) {
 	case READ_TITLE:
-		g_string_append (pd->title, ch);
+		g_string_append_len (pd->title, (const gchar *) ch, len);
 		break;
 	case READ_IGNORE:
 		break;
@@ -204,7 +210,8 @@ parser_characters (void          *data,
 		if (pd->in_body && pd->n_bytes_remaining > 0) {
 			gsize text_len;
 
-			text_len = strlen (ch);
+			/* Pushed data is not nul terminated */
+			text_len = len;
 
 			if (tracker_text_validate_utf8 (ch,
 			                                (pd->n_bytes_remaining < text_len ?
@@ -224,11 +231,69 @@ parser_characters (void          *data,
 			} else {
 				pd->n_bytes_remaining = 0;
 			}
+
+			/* The head is behind, and no more text is wanted,
+			 * nothing else in the document is of interest.
+			 */
+			if (pd->n_bytes_remaining == 0) {
+				xmlStopParser (pd->ctxt);
+				pd->stopped = TRUE;
+			}
 		}
 		break;
 	}
 }
 
+static void
+parse_file (parser_data       *pd,
+            htmlSAXHandlerPtr  handler,
+            const gchar       *filename)
+{
+	gchar buf[HTML_BUFFER_SIZE];
+	size_t n_read;
+	FILE *f;
+
+	f = tracker_file_open (filename);
+	if (!f) {
+		g_debug ("Could not open '%s': %s", filename, g_strerror (errno));
+		return;
+	}
+
+	/* Sniff the encoding from the first chunk */
+	n_read = fread (buf, 1, sizeof (buf), f);
+	pd->n_bytes_read += n_read;
+
+	pd->ctxt = htmlCreatePushParserCtxt (handler, pd, buf, n_read,
+	                                     filename, XML_CHAR_ENCODING_NONE);
+	if (!pd->ctxt) {
+		tracker_file_close (f, FALSE);
+		return;
+	}
+
+	htmlCtxtUseOptions (pd->ctxt,
+	                    HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING |
+	                    HTML_PARSE_NONET);
+
+	while (!pd->stopped && n_read > 0) {
+		n_read = fread (buf, 1, sizeof (buf), f);
+		pd->n_bytes_read += n_read;
+
+		if (n_read > 0)
+			htmlParseChunk (pd->ctxt, buf, n_read, 0);
+	}
+
+	if (!pd->stopped)
+		htmlParseChunk (pd->ctxt, NULL, 0, 1);
+
+	if (pd->ctxt->myDoc)
+		xmlFreeDoc (pd->ctxt->myDoc);
+
+	htmlFreeParserCtxt (pd->ctxt);
+	pd->ctxt = NULL;
+
+	tracker_file_close (f, FALSE);
+}
+
 G_MODULE_EXPORT gboolean
 tracker_extract_get_metadata (TrackerExtractInfo  *info,
                               GError             **error)
@@ -236,8 +301,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 	TrackerResource *metadata;
 	GFile *file;
 	TrackerConfig *config;
-	htmlDocPtr doc;
-	parser_data pd;
+	parser_data pd = { 0 };
 	gchar *filename, *resource_uri;
 	xmlSAXHandler handler = {
 		NULL, /* internalSubset */
@@ -276,7 +340,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 
 	file = tracker_extract_info_get_file (info);
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (info, NULL);
 	metadata = tracker_resource_new (resource_uri);
 	tracker_resource_add_uri (metadata, "rdf:type", "nfo:HtmlDocument");
 	g_free (resource_uri);
@@ -291,12 +355,13 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 	pd.n_bytes_remaining = tracker_config_get_max_bytes (config);
 
 	filename = g_file_get_path (file);
-	doc = htmlSAXParseFile (filename, NULL, &handler, &pd);
-	g_free (filename);
+	parse_file (&pd, &handler, filename);
 
-	if (doc) {
-		xmlFreeDoc (doc);
-	}
+	TRACKER_NOTE (STATISTICS,
+	              g_message ("HTML: Read %" G_GSIZE_FORMAT " of %" G_GOFFSET_FORMAT " bytes from '%s'%s",
+	                         pd.n_bytes_read, tracker_file_get_size (filename), filename,
+	                         pd.stopped ? ", stopped early" : ""));
+	g_free (filename);
 
 	g_strstrip (pd.plain_text->str);
 	g_strstrip (pd.title->str);
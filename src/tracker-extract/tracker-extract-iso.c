@@ -61,7 +61,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info_,
 	file = tracker_extract_info_get_file (info_);
 	filename = g_file_get_path (file);
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (info_, NULL);
 	metadata = tracker_resource_new (resource_uri);
 	g_free (resource_uri);
 
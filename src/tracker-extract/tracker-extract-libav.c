@@ -22,7 +22,7 @@
 #include <glib.h>
 
 #include <libtracker-sparql/tracker-ontologies.h>
-#include <libtracker-miners-common/tracker-file-utils.h>
+#include <libtracker-miners-common/tracker-common.h>
 
 #include <libtracker-extract/tracker-extract.h>
 
@@ -30,6 +30,12 @@
 #include <libavformat/avformat.h>
 #include <libavutil/mathematics.h>
 
+/* Only tags and container level information are extracted, so limit
+ * how much of the streams is read and analyzed while probing them.
+ */
+#define PROBE_SIZE       "1048576"
+#define ANALYZE_DURATION "1000000"
+
 static AVDictionaryEntry *
 find_tag (AVFormatContext *format,
           AVStream        *stream1,
@@ -47,6 +53,27 @@ find_tag (AVFormatContext *format,
 	return tag;
 }
 
+static gint64
+get_duration (AVFormatContext *format,
+              AVStream        *stream)
+{
+	/* Prefer the duration given by the container, that does not
+	 * depend on how much of the stream got analyzed.
+	 */
+	if (format->duration > 0 &&
+	    format->duration_estimation_method != AVFMT_DURATION_FROM_BITRATE)
+		return format->duration / AV_TIME_BASE;
+
+	if (stream->duration > 0)
+		return av_rescale (stream->duration, stream->time_base.num,
+		                   stream->time_base.den);
+
+	if (format->duration > 0)
+		return format->duration / AV_TIME_BASE;
+
+	return -1;
+}
+
 G_MODULE_EXPORT gboolean
 tracker_extract_get_metadata (TrackerExtractInfo  *info,
                               GError             **error)
@@ -62,22 +89,52 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 	int audio_stream_index;
 	int video_stream_index;
 	AVDictionaryEntry *tag = NULL;
+	AVDictionary *options = NULL;
 	const char *title = NULL;
+	gint64 duration;
+#ifdef G_ENABLE_DEBUG
+	GTimer *timer = NULL;
+
+	if (TRACKER_DEBUG_CHECK (STATISTICS))
+		timer = g_timer_new ();
+#endif
 
 	file = tracker_extract_info_get_file (info);
 
 	uri = g_file_get_uri (file);
 
+	/* TRACKER_EXTRACT_FULL_PROBE keeps the libav defaults, as
+	 * a baseline for extractor-media-benchmark.py.
+	 */
+	if (!g_getenv ("TRACKER_EXTRACT_FULL_PROBE")) {
+		av_dict_set (&options, "probesize", PROBE_SIZE, 0);
+		av_dict_set (&options, "analyzeduration", ANALYZE_DURATION, 0);
+	}
+
 	absolute_file_path = g_file_get_path (file);
-	if (avformat_open_input (&format, absolute_file_path, NULL, NULL)) {
+	if (avformat_open_input (&format, absolute_file_path, NULL, &options)) {
+		av_dict_free (&options);
 		g_free (absolute_file_path);
 		g_free (uri);
+#ifdef G_ENABLE_DEBUG
+		g_clear_pointer (&timer, g_timer_destroy);
+#endif
 		return FALSE;
 	}
+	av_dict_free (&options);
 	g_free (absolute_file_path);
 
 	avformat_find_stream_info (format, NULL);
 
+#ifdef G_ENABLE_DEBUG
+	if (timer) {
+		g_message ("libav: Probed '%s', %" G_GINT64_FORMAT " bytes read in %f seconds",
+		           uri, format->pb ? (gint64) format->pb->bytes_read : 0,
+		           g_timer_elapsed (timer, NULL));
+		g_timer_destroy (timer);
+	}
+#endif
+
 	audio_stream_index = av_find_best_stream (format, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
 	if (audio_stream_index >= 0) {
 		audio_stream = format->streams[audio_stream_index];
@@ -94,7 +151,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 		return FALSE;
 	}
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (info, NULL);
 	metadata = tracker_resource_new (resource_uri);
 	g_free (resource_uri);
 
@@ -121,9 +178,8 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 			tracker_resource_set_double (metadata, "nfo:frameRate", frame_rate);
 		}
 
-		if (video_stream->duration > 0) {
-			gint64 duration = av_rescale(video_stream->duration, video_stream->time_base.num,
-			                             video_stream->time_base.den);
+		duration = get_duration (format, video_stream);
+		if (duration > 0) {
 			tracker_resource_set_int64 (metadata, "nfo:duration", duration);
 		}
 
@@ -164,9 +220,8 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 		tracker_resource_add_uri (metadata, "rdf:type", "nmm:MusicPiece");
 		tracker_resource_add_uri (metadata, "rdf:type", "nfo:Audio");
 
-		if (audio_stream->duration > 0) {
-			gint64 duration = av_rescale(audio_stream->duration, audio_stream->time_base.num,
-			                             audio_stream->time_base.den);
+		duration = get_duration (format, audio_stream);
+		if (duration > 0) {
 			tracker_resource_set_int64 (metadata, "nfo:duration", duration);
 		}
 
@@ -32,10 +32,6 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 
-#ifndef G_OS_WIN32
-#include <sys/mman.h>
-#endif /* G_OS_WIN32 */
-
 #include <libtracker-miners-common/tracker-common.h>
 
 #include <libtracker-extract/tracker-extract.h>
@@ -44,19 +40,18 @@
 #warning Frame traces enabled
 #endif /* FRAME_ENABLE_TRACE */
 
-/* We mmap the beginning of the file and read separately the last 128
- * bytes for id3v1 tags. While these are probably cornercases the
- * rationale is that we don't want to fault a whole page for the last
- * 128 bytes and on the other we don't want to mmap the whole file
- * with unlimited size (might need to create private copy in some
- * special cases, finding continuous space etc). We now take 5 first
- * MB of the file and assume that this is enough. In theory there is
- * no maximum size as someone could embed 50 gigabytes of album art
- * there.
+/* The beginning of the file is read on demand: first the ID3v2 tag
+ * headers to find out how large the tags are, then the tags plus a
+ * small window for the first audio frames, which is only extended if
+ * frame scanning goes beyond it. The last 128 bytes are read
+ * separately for id3v1 tags. In theory there is no maximum size as
+ * someone could embed 50 gigabytes of album art, so we never read
+ * past the first 5 MB of the file.
  */
 
 #define MAX_FILE_READ     1024 * 1024 * 5
 #define MAX_MP3_SCAN_DEEP 16768
+#define MP3_WINDOW_SIZE   64 * 1024
 
 #define MAX_FRAMES_SCAN   512
 #define VBR_THRESHOLD     16
@@ -211,6 +206,17 @@ typedef struct {
 	id3v2tag id3v24;
 } MP3Data;
 
+/* The beginning of the file, data grows as it is needed, so pointers
+ * into it are only valid until the next mp3_buffer_ensure().
+ */
+typedef struct {
+	int fd;
+	gchar *data;
+	gsize size;
+	gsize max_size;
+	gsize bytes_read;
+} MP3Buffer;
+
 enum {
 	MPEG_ERR,
 	MPEG_V1,
@@ -669,6 +675,69 @@ read_id3v1_buffer (int     fd,
 	return buffer;
 }
 
+static gboolean
+mp3_buffer_ensure (MP3Buffer *buffer,
+                   gsize      size)
+{
+	gsize wanted;
+	gssize rc;
+
+	if (size <= buffer->size) {
+		return TRUE;
+	}
+
+	if (buffer->size >= buffer->max_size) {
+		return FALSE;
+	}
+
+	/* Read ahead a window, so scanning frames does not
+	 * turn into a read() per frame.
+	 */
+	wanted = MIN (MAX (size, buffer->size + MP3_WINDOW_SIZE),
+	              buffer->max_size);
+	buffer->data = g_realloc (buffer->data, wanted);
+
+	while (buffer->size < wanted) {
+		rc = pread (buffer->fd,
+		            buffer->data + buffer->size,
+		            wanted - buffer->size,
+		            buffer->size);
+		if (rc == -1) {
+			if (errno != EINTR) {
+				break;
+			}
+		} else if (rc == 0) {
+			break;
+		} else {
+			buffer->size += rc;
+			buffer->bytes_read += rc;
+		}
+	}
+
+	if (buffer->size < wanted) {
+		/* File got truncated, or a read error */
+		buffer->max_size = buffer->size;
+	}
+
+	return size <= buffer->size;
+}
+
+static void
+mp3_buffer_read_id3v2 (MP3Buffer *buffer)
+{
+	gsize offset = 0;
+
+	/* Walk the chained tag headers, so the tags are read in
+	 * one go, along with the window for the first frames.
+	 */
+	while (mp3_buffer_ensure (buffer, offset + 10) &&
+	       buffer->data[offset] == 0x49 &&
+	       buffer->data[offset + 1] == 0x44 &&
+	       buffer->data[offset + 2] == 0x33) {
+		offset += extract_uint32_7bit (&buffer->data[offset + 6]) + 10;
+	}
+}
+
 /* Convert from UCS-2 to UTF-8 checking the BOM.*/
 static gchar *
 ucs2_to_utf8(const gchar *data, guint len)
@@ -959,12 +1028,13 @@ get_id3 (const gchar *data,
 }
 
 static gboolean
-mp3_parse_xing_header (const gchar          *data,
+mp3_parse_xing_header (MP3Buffer            *buffer,
                        size_t                frame_pos,
                        gchar                 mpeg_version,
                        gint                  n_channels,
                        guint32              *nr_frames)
 {
+	const gchar *data;
 	guint32 field_flags;
 	size_t pos;
 	guint xing_header_offset;
@@ -977,6 +1047,13 @@ mp3_parse_xing_header (const gchar          *data,
 
 	pos = frame_pos + xing_header_offset;
 
+	/* Magic, flags and number of frames */
+	if (!mp3_buffer_ensure (buffer, pos + 12)) {
+		return FALSE;
+	}
+
+	data = buffer->data;
+
 	/* header starts with "Xing" or "Info" */
 	if ((data[pos] == 0x58 && data[pos+1] == 0x69 && data[pos+2] == 0x6E && data[pos+3] == 0x67) ||
 	    (data[pos] == 0x49 && data[pos+1] == 0x6E && data[pos+2] == 0x46 && data[pos+3] == 0x6F)) {
@@ -1000,8 +1077,7 @@ mp3_parse_xing_header (const gchar          *data,
  * http://www.mp3-tech.org/programmer/frame_header.html
  */
 static gboolean
-mp3_parse_header (const gchar          *data,
-                  size_t                size,
+mp3_parse_header (MP3Buffer            *buffer,
                   size_t                seek_pos,
                   const gchar          *uri,
                   TrackerResource      *resource,
@@ -1027,7 +1103,7 @@ mp3_parse_header (const gchar          *data,
 
 	pos = seek_pos;
 
-	memcpy (&header, &data[pos], sizeof (header));
+	memcpy (&header, &buffer->data[pos], sizeof (header));
 
 	switch (header & mpeg_ver_mask) {
 	case 0x1000:
@@ -1104,16 +1180,16 @@ mp3_parse_header (const gchar          *data,
 			vbr_flag = 1;
 		}
 
-		if (pos + sizeof (header) > size) {
-			/* EOF */
+		if ((!vbr_flag) && (frames > VBR_THRESHOLD)) {
 			break;
 		}
 
-		if ((!vbr_flag) && (frames > VBR_THRESHOLD)) {
+		if (!mp3_buffer_ensure (buffer, pos + sizeof (header))) {
+			/* EOF */
 			break;
 		}
 
-		memcpy(&header, &data[pos], sizeof (header));
+		memcpy(&header, &buffer->data[pos], sizeof (header));
 	} while ((header & sync_mask) == sync_mask);
 
 	/* At least 2 frames to check the right position */
@@ -1128,7 +1204,7 @@ mp3_parse_header (const gchar          *data,
 	   try to get the number of frames from the xing header
 	   to compute the file duration.  */
 	if (vbr_flag) {
-		mp3_parse_xing_header (data, seek_pos, mpeg_ver, n_channels, &xing_nr_frames);
+		mp3_parse_xing_header (buffer, seek_pos, mpeg_ver, n_channels, &xing_nr_frames);
 	}
 
 	tracker_resource_set_string (resource, "nfo:codec", "MPEG");
@@ -1165,35 +1241,47 @@ mp3_parse_header (const gchar          *data,
 }
 
 static gboolean
-mp3_parse (const gchar          *data,
-           size_t                size,
+mp3_parse (MP3Buffer            *buffer,
            size_t                offset,
            const gchar          *uri,
            TrackerResource      *resource,
            MP3Data              *filedata)
 {
+	const gchar *sync;
 	guint header;
-	guint counter = 0;
-	guint pos = offset;
+	size_t pos = offset;
+	size_t limit = offset + MAX_MP3_SCAN_DEEP;
+	size_t end;
 
-	do {
+	while (pos < limit) {
 		/* Seek for frame start */
-		if (pos + sizeof (header) > size) {
+		if (!mp3_buffer_ensure (buffer, pos + sizeof (header))) {
 			return FALSE;
 		}
 
-		memcpy (&header, &data[pos], sizeof (header));
+		/* Frame headers start with a 0xFF byte, let memchr()
+		 * find the candidates in what we have buffered.
+		 */
+		end = MIN (limit, buffer->size - sizeof (header) + 1);
+		sync = memchr (&buffer->data[pos], 0xFF, end - pos);
+
+		if (!sync) {
+			pos = end;
+			continue;
+		}
+
+		pos = sync - buffer->data;
+		memcpy (&header, &buffer->data[pos], sizeof (header));
 
 		if ((header & sync_mask) == sync_mask) {
 			/* Found header sync */
-			if (mp3_parse_header (data, size, pos, uri, resource, filedata)) {
+			if (mp3_parse_header (buffer, pos, uri, resource, filedata)) {
 				return TRUE;
 			}
 		}
 
 		pos++;
-		counter++;
-	} while (counter < MAX_MP3_SCAN_DEEP);
+	}
 
 	return FALSE;
 }
@@ -2637,12 +2725,10 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
                               GError             **error)
 {
 	gchar *filename, *uri, *resource_uri;
-	int fd;
-	void *buffer;
 	void *id3v1_buffer;
 	goffset size;
-	goffset  buffer_size;
 	goffset audio_offset;
+	MP3Buffer buffer = { 0 };
 	MP3Data md = { 0 };
 	GFile *file;
 	gboolean parsed;
@@ -2659,34 +2745,27 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 	}
 
 	md.size = size;
-	buffer_size = MIN (size, MAX_FILE_READ);
 
-	fd = tracker_file_open_fd (filename);
+	buffer.fd = tracker_file_open_fd (filename);
+	buffer.max_size = MIN (size, MAX_FILE_READ);
 
-	if (fd == -1) {
+	if (buffer.fd == -1) {
+		g_free (filename);
 		return FALSE;
 	}
 
-#ifndef G_OS_WIN32
-	/* We don't use GLib's mmap because size can not be specified */
-	buffer = mmap (NULL,
-	               buffer_size,
-	               PROT_READ,
-	               MAP_PRIVATE,
-	               fd,
-	               0);
-#endif
-
-	id3v1_buffer = read_id3v1_buffer (fd, size);
+	id3v1_buffer = read_id3v1_buffer (buffer.fd, size);
 
-#ifdef HAVE_POSIX_FADVISE
-	if (posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED) != 0)
-		g_warning ("posix_fadvise() call failed: %m");
-#endif /* HAVE_POSIX_FADVISE */
+	if (id3v1_buffer) {
+		buffer.bytes_read += ID3V1_SIZE;
+	}
 
-	close (fd);
+	/* Reads the tags and the window for the first frames */
+	mp3_buffer_read_id3v2 (&buffer);
 
-	if (buffer == NULL || buffer == (void*) -1) {
+	if (buffer.size == 0) {
+		g_free (id3v1_buffer);
+		close (buffer.fd);
 		g_free (filename);
 		return FALSE;
 	}
@@ -2697,13 +2776,13 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 
 	g_free (id3v1_buffer);
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (info, NULL);
 	main_resource = tracker_resource_new (resource_uri);
 	g_free (resource_uri);
 
 	/* Get other embedded tags */
 	uri = g_file_get_uri (file);
-	audio_offset = parse_id3v2 (buffer, buffer_size, &md.id3v1, uri, main_resource, &md);
+	audio_offset = parse_id3v2 (buffer.data, buffer.size, &md.id3v1, uri, main_resource, &md);
 
 	md.title = tracker_coalesce_strip (4, md.id3v24.title2,
 	                                   md.id3v23.title2,
@@ -2998,7 +3077,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 	}
 
 	/* Get mp3 stream info */
-	parsed = mp3_parse (buffer, buffer_size, audio_offset, uri, main_resource, &md);
+	parsed = mp3_parse (&buffer, audio_offset, uri, main_resource, &md);
 	g_clear_object (&md.artist);
 
 	id3v2tag_free (&md.id3v22);
@@ -3006,9 +3085,17 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 	id3v2tag_free (&md.id3v24);
 	id3tag_free (&md.id3v1);
 
-#ifndef G_OS_WIN32
-	munmap (buffer, buffer_size);
-#endif
+	TRACKER_NOTE (STATISTICS,
+	              g_message ("MP3: Read %" G_GSIZE_FORMAT " of %" G_GOFFSET_FORMAT " bytes from '%s'",
+	                         buffer.bytes_read, size, filename));
+
+#ifdef HAVE_POSIX_FADVISE
+	if (posix_fadvise (buffer.fd, 0, 0, POSIX_FADV_DONTNEED) != 0)
+		g_warning ("posix_fadvise() call failed: %m");
+#endif /* HAVE_POSIX_FADVISE */
+
+	close (buffer.fd);
+	g_free (buffer.data);
 
 	if (main_resource) {
 		tracker_extract_info_set_resource (info, main_resource);
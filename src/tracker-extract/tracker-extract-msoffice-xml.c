@@ -62,6 +62,7 @@ typedef enum {
 typedef struct {
 	/* Common constant stuff */
 	const gchar *uri;
+	TrackerGsfZip *zip;
 	MsOfficeXMLFileType file_type;
 
 	/* Tag type, reused by Content and Metadata parsers */
@@ -618,10 +619,10 @@ xml_read (MsOfficeXMLParserInfo *parser_info,
 
 		/* Load the internal XML file from the Zip archive, and parse it
 		 * using the given context */
-		tracker_gsf_parse_xml_in_zip (parser_info->uri,
-		                              xml_filename,
-		                              context,
-		                              &error);
+		tracker_gsf_zip_parse_xml (parser_info->zip,
+		                           xml_filename,
+		                           context,
+		                           &error);
 		g_markup_parse_context_free (context);
 
 		if (error) {
@@ -790,6 +791,10 @@ extract_content (MsOfficeXMLParserInfo *info)
 			g_debug ("Skipping '%s' as already reached max bytes to extract",
 			         part_name);
 			break;
+		} else if (tracker_gsf_zip_get_bytes_remaining (info->zip) == 0) {
+			g_debug ("Skipping '%s' as already reached max bytes to read",
+			         part_name);
+			break;
 		} else if (g_timer_elapsed (info->timer, NULL) > 5) {
 			g_debug ("Skipping '%s' as already reached max time to extract",
 			         part_name);
@@ -828,7 +833,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *extract_info,
 
 	g_debug ("Extracting MsOffice XML format...");
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (extract_info, NULL);
 	metadata = tracker_resource_new (resource_uri);
 	tracker_resource_add_uri (metadata, "rdf:type", "nfo:PaginatedTextDocument");
 	g_free (resource_uri);
@@ -845,6 +850,15 @@ tracker_extract_get_metadata (TrackerExtractInfo  *extract_info,
 	info.generator_already_set = FALSE;
 	info.bytes_pending = tracker_config_get_max_bytes (config);
 
+	/* The archive is opened once for all the parts */
+	info.zip = tracker_gsf_zip_open (uri, &inner_error);
+	if (!info.zip) {
+		g_propagate_prefixed_error (error, inner_error, "Could not open:");
+		g_object_unref (metadata);
+		g_free (uri);
+		return FALSE;
+	}
+
 	/* Create content-type parser context */
 	context = g_markup_parse_context_new (&content_types_parser,
 	                                      0,
@@ -854,12 +868,18 @@ tracker_extract_get_metadata (TrackerExtractInfo  *extract_info,
 	info.timer = g_timer_new ();
 	/* Load the internal XML file from the Zip archive, and parse it
 	 * using the given context */
-	tracker_gsf_parse_xml_in_zip (uri,
-	                              "[Content_Types].xml",
-	                              context,
-	                              &inner_error);
+	tracker_gsf_zip_parse_xml (info.zip,
+	                           "[Content_Types].xml",
+	                           context,
+	                           &inner_error);
 	if (inner_error) {
 		g_propagate_prefixed_error (error, inner_error, "Could not open:");
+		g_list_free_full (info.parts, g_free);
+		g_timer_destroy (info.timer);
+		g_markup_parse_context_free (context);
+		tracker_gsf_zip_close (info.zip);
+		g_object_unref (metadata);
+		g_free (uri);
 		return FALSE;
 	}
 
@@ -885,6 +905,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *extract_info,
 
 	g_timer_destroy (info.timer);
 	g_markup_parse_context_free (context);
+	tracker_gsf_zip_close (info.zip);
 	g_free (uri);
 
 	tracker_extract_info_set_resource (extract_info, metadata);
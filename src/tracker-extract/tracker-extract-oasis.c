@@ -108,13 +108,13 @@ static void xml_text_handler_content           (GMarkupParseContext   *context,
                                                 gsize                  text_len,
                                                 gpointer               user_data,
                                                 GError               **error);
-static void extract_oasis_content              (const gchar           *uri,
+static void extract_oasis_content              (TrackerGsfZip         *zip,
                                                 gulong                 total_bytes,
                                                 ODTFileType            file_type,
                                                 TrackerResource       *metadata);
 
 static void
-extract_oasis_content (const gchar     *uri,
+extract_oasis_content (TrackerGsfZip   *zip,
                        gulong           total_bytes,
                        ODTFileType      file_type,
                        TrackerResource *metadata)
@@ -147,7 +147,7 @@ extract_oasis_content (const gchar     *uri,
 
 	/* Load the internal XML file from the Zip archive, and parse it
 	 * using the given context */
-	tracker_gsf_parse_xml_in_zip (uri, "content.xml", context, &error);
+	tracker_gsf_zip_parse_xml (zip, "content.xml", context, &error);
 
 	if (!error || g_error_matches (error, maximum_size_error_quark, 0)) {
 		content = g_string_free (info.content, FALSE);
@@ -174,6 +174,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *extract_info,
 	TrackerConfig *config;
 	ODTMetadataParseInfo info = { 0 };
 	ODTFileType file_type;
+	TrackerGsfZip *zip;
 	GFile *file;
 	gchar *uri, *resource_uri;
 	const gchar *mime_used;
@@ -191,14 +192,20 @@ tracker_extract_get_metadata (TrackerExtractInfo  *extract_info,
 	}
 
 	file = tracker_extract_info_get_file (extract_info);
+	uri = g_file_get_uri (file);
+
+	/* Both meta.xml and content.xml are read from one open archive */
+	zip = tracker_gsf_zip_open (uri, error);
+	if (!zip) {
+		g_free (uri);
+		return FALSE;
+	}
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (extract_info, NULL);
 	metadata = tracker_resource_new (resource_uri);
 	mime_used = tracker_extract_info_get_mimetype (extract_info);
 	g_free (resource_uri);
 
-	uri = g_file_get_uri (file);
-
 	/* Setup conf */
 	config = tracker_main_get_config ();
 
@@ -218,7 +225,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *extract_info,
 
 	/* Load the internal XML file from the Zip archive, and parse it
 	 * using the given context */
-	tracker_gsf_parse_xml_in_zip (uri, "meta.xml", context, NULL);
+	tracker_gsf_zip_parse_xml (zip, "meta.xml", context, NULL);
 	g_markup_parse_context_free (context);
 
 	if (g_ascii_strcasecmp (mime_used, "application/vnd.oasis.opendocument.text") == 0) {
@@ -235,13 +242,14 @@ tracker_extract_get_metadata (TrackerExtractInfo  *extract_info,
 	}
 
 	/* Extract content with the given limitations */
-	extract_oasis_content (uri,
+	extract_oasis_content (zip,
 	                       tracker_config_get_max_bytes (config),
 	                       file_type,
 	                       metadata);
 
 	g_queue_free (info.tag_stack);
 
+	tracker_gsf_zip_close (zip);
 	g_free (uri);
 
 	tracker_extract_info_set_resource (extract_info, metadata);
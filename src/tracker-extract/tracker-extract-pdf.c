@@ -357,7 +357,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 
 	if (inner_error) {
 		if (inner_error->code == POPPLER_ERROR_ENCRYPTED) {
-			resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+			resource_uri = tracker_extract_info_get_content_id (info, NULL);
 			metadata = tracker_resource_new (resource_uri);
 			g_free (resource_uri);
 
@@ -390,7 +390,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 		return FALSE;
 	}
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (info, NULL);
 	metadata = tracker_resource_new (resource_uri);
 	tracker_resource_add_uri (metadata, "rdf:type", "nfo:PaginatedTextDocument");
 	g_free (resource_uri);
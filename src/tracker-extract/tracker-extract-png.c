@@ -20,7 +20,10 @@
 
 #include "config-miners.h"
 
+#include <string.h>
+
 #include <png.h>
+#include <zlib.h>
 
 #include <libtracker-miners-common/tracker-file-utils.h>
 #include <libtracker-miners-common/tracker-date-time.h>
@@ -29,6 +32,12 @@
 #define RFC1123_DATE_FORMAT "%d %B %Y %H:%M:%S %z"
 #define CMS_PER_INCH        2.54
 
+#define PNG_SIGNATURE_SIZE  8
+#define PNG_IHDR_SIZE       13
+
+/* Upper limit for metadata chunks, both compressed and inflated */
+#define MAX_TEXT_SIZE       (16 * 1024 * 1024)
+
 typedef struct {
 	const gchar *title;
 	const gchar *copyright;
@@ -67,6 +76,22 @@ typedef struct {
 	const gchar *software;
 } PngData;
 
+typedef struct {
+	gchar *key;
+	gchar *text;
+	gsize length;
+} PngText;
+
+typedef struct {
+	png_uint_32 width;
+	png_uint_32 height;
+	gint bit_depth;
+	gint color_type;
+	GPtrArray *texts;
+	GBytes *exif;
+	goffset skipped;
+} PngChunks;
+
 static gchar *
 rfc1123_to_iso8601_date (const gchar *date)
 {
@@ -76,7 +101,7 @@ rfc1123_to_iso8601_date (const gchar *date)
 	return tracker_date_format_to_iso8601 (date, RFC1123_DATE_FORMAT);
 }
 
-#if defined(PNG_iTXt_SUPPORTED) && (defined(HAVE_EXEMPI) || defined(HAVE_LIBEXIF))
+#if defined(HAVE_EXEMPI) || defined(HAVE_LIBEXIF)
 
 /* Handle raw profiles by Imagemagick (at least). Hex encoded with
  * line-changes and other (undocumented/unofficial) twists.
@@ -179,13 +204,278 @@ raw_profile_new (const gchar *input,
 	return output;
 }
 
-#endif /* defined(PNG_iTXt_SUPPORTED) && (defined(HAVE_EXEMPI) || defined(HAVE_LIBEXIF)) */
+#endif /* defined(HAVE_EXEMPI) || defined(HAVE_LIBEXIF) */
+
+static void
+png_text_free (PngText *text)
+{
+	g_free (text->key);
+	g_free (text->text);
+	g_slice_free (PngText, text);
+}
+
+static PngChunks *
+chunks_new (void)
+{
+	PngChunks *chunks;
+
+	chunks = g_slice_new0 (PngChunks);
+	chunks->texts = g_ptr_array_new_with_free_func ((GDestroyNotify) png_text_free);
+
+	return chunks;
+}
+
+static void
+chunks_free (PngChunks *chunks)
+{
+	g_ptr_array_unref (chunks->texts);
+	g_clear_pointer (&chunks->exif, g_bytes_unref);
+	g_slice_free (PngChunks, chunks);
+}
+
+static gchar *
+inflate_text (const guchar *data,
+              gsize         len,
+              gsize        *out_len)
+{
+	GByteArray *array;
+	z_stream stream = { 0 };
+	guchar buffer[8192];
+	gint result;
+
+	if (inflateInit (&stream) != Z_OK)
+		return NULL;
+
+	array = g_byte_array_new ();
+	stream.next_in = (Bytef *) data;
+	stream.avail_in = len;
+
+	do {
+		stream.next_out = buffer;
+		stream.avail_out = sizeof (buffer);
+		result = inflate (&stream, Z_NO_FLUSH);
+
+		if (result != Z_OK && result != Z_STREAM_END)
+			break;
+
+		g_byte_array_append (array, buffer, sizeof (buffer) - stream.avail_out);
+
+		if (array->len > MAX_TEXT_SIZE) {
+			result = Z_MEM_ERROR;
+			break;
+		}
+	} while (result != Z_STREAM_END &&
+	         (stream.avail_in > 0 || stream.avail_out == 0));
+
+	inflateEnd (&stream);
+
+	if (result != Z_STREAM_END) {
+		g_byte_array_unref (array);
+		return NULL;
+	}
+
+	*out_len = array->len;
+	g_byte_array_append (array, (const guint8 *) "", 1);
+
+	return (gchar *) g_byte_array_free (array, FALSE);
+}
+
+static void
+add_text (PngChunks    *chunks,
+          const gchar  *key,
+          const guchar *text,
+          gsize         len,
+          gboolean      compressed)
+{
+	PngText *png_text;
+	gchar *str;
+
+	if (compressed) {
+		str = inflate_text (text, len, &len);
+		if (!str)
+			return;
+	} else {
+		str = g_strndup ((const gchar *) text, len);
+	}
+
+	png_text = g_slice_new0 (PngText);
+	png_text->key = g_strdup (key);
+	png_text->text = str;
+	png_text->length = len;
+	g_ptr_array_add (chunks->texts, png_text);
+}
+
+static void
+parse_text_chunk (PngChunks    *chunks,
+                  const gchar  *type,
+                  const guchar *data,
+                  gsize         len)
+{
+	const guchar *end = data + len, *ptr;
+	const gchar *key;
+	gboolean compressed = FALSE;
+
+	/* All text chunks start with a nul-terminated keyword */
+	key = (const gchar *) data;
+	ptr = memchr (data, '\0', len);
+	if (!ptr || ptr == data)
+		return;
+
+	ptr++;
+
+	if (memcmp (type, "zTXt", 4) == 0) {
+		/* Compression method, only deflate is defined */
+		if (ptr >= end || *ptr != 0)
+			return;
+
+		ptr++;
+		compressed = TRUE;
+	} else if (memcmp (type, "iTXt", 4) == 0) {
+		gint i;
+
+		/* Compression flag and method */
+		if (end - ptr < 2 || (ptr[0] && ptr[1] != 0))
+			return;
+
+		compressed = ptr[0] != 0;
+		ptr += 2;
+
+		/* Skip language tag and translated keyword */
+		for (i = 0; i < 2; i++) {
+			ptr = memchr (ptr, '\0', end - ptr);
+			if (!ptr)
+				return;
+			ptr++;
+		}
+	}
+
+	add_text (chunks, key, ptr, end - ptr, compressed);
+}
+
+static gboolean
+read_chunks (FILE       *f,
+             PngChunks  *chunks,
+             GError    **error)
+{
+	guchar signature[PNG_SIGNATURE_SIZE];
+	gboolean has_header = FALSE;
+
+	if (fread (signature, 1, PNG_SIGNATURE_SIZE, f) != PNG_SIGNATURE_SIZE ||
+	    png_sig_cmp (signature, 0, PNG_SIGNATURE_SIZE) != 0) {
+		g_set_error (error,
+		             G_IO_ERROR,
+		             G_IO_ERROR_INVALID_DATA,
+		             "Not a PNG file");
+		return FALSE;
+	}
+
+	/* Walk over the chunks, only metadata chunks are read, image
+	 * data is skipped over without being decompressed.
+	 */
+	while (TRUE) {
+		guchar header[8], *data;
+		png_uint_32 length, crc;
+		gchar type[5] = { 0 };
+
+		if (fread (header, 1, sizeof (header), f) != sizeof (header))
+			break;
+
+		length = png_get_uint_32 (header);
+		memcpy (type, &header[4], 4);
+
+		if (length > PNG_UINT_31_MAX)
+			break;
+
+		if (!has_header && strcmp (type, "IHDR") != 0)
+			break;
+
+		if (strcmp (type, "IEND") == 0)
+			break;
+
+		if (strcmp (type, "IHDR") != 0 &&
+		    strcmp (type, "tEXt") != 0 &&
+		    strcmp (type, "zTXt") != 0 &&
+		    strcmp (type, "iTXt") != 0 &&
+		    strcmp (type, "eXIf") != 0) {
+			/* Skip data and CRC */
+			if (fseeko (f, (off_t) length + 4, SEEK_CUR) != 0)
+				break;
+
+			chunks->skipped += length;
+			continue;
+		}
+
+		if (length > MAX_TEXT_SIZE) {
+			if (fseeko (f, (off_t) length + 4, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+
+		data = g_malloc (length + 4);
+
+		if (fread (data, 1, length + 4, f) != length + 4) {
+			g_free (data);
+			break;
+		}
+
+		/* Like libpng, ignore ancillary chunks with a bad CRC */
+		crc = crc32 (0, &header[4], 4);
+		crc = crc32 (crc, data, length);
+
+		if (crc != png_get_uint_32 (&data[length])) {
+			g_debug ("Ignoring PNG '%s' chunk with bad CRC", type);
+			g_free (data);
+
+			if (!has_header)
+				break;
+			continue;
+		}
+
+		if (strcmp (type, "IHDR") == 0) {
+			if (has_header || length != PNG_IHDR_SIZE) {
+				g_free (data);
+				break;
+			}
+
+			chunks->width = png_get_uint_32 (data);
+			chunks->height = png_get_uint_32 (&data[4]);
+			chunks->bit_depth = data[8];
+			chunks->color_type = data[9];
+			has_header = TRUE;
+		} else if (strcmp (type, "eXIf") == 0) {
+			/* Raw TIFF data, add the header expected by libexif */
+			if (!chunks->exif && length > 0) {
+				GByteArray *exif;
+
+				exif = g_byte_array_sized_new (length + 6);
+				g_byte_array_append (exif, (const guint8 *) "Exif\0\0", 6);
+				g_byte_array_append (exif, data, length);
+				chunks->exif = g_byte_array_free_to_bytes (exif);
+			}
+		} else {
+			parse_text_chunk (chunks, type, data, length);
+		}
+
+		g_free (data);
+	}
+
+	if (!has_header) {
+		g_set_error (error,
+		             G_IO_ERROR,
+		             G_IO_ERROR_INVALID_DATA,
+		             "Could not read PNG header");
+		return FALSE;
+	}
+
+	g_debug ("Skipped %" G_GOFFSET_FORMAT " bytes of PNG image data",
+	         chunks->skipped);
+
+	return TRUE;
+}
 
 static void
 read_metadata (TrackerResource      *metadata,
-               png_structp           png_ptr,
-               png_infop             info_ptr,
-               png_infop             end_ptr,
+               PngChunks            *chunks,
                GFile                *file,
                const gchar          *uri)
 {
@@ -193,141 +483,122 @@ read_metadata (TrackerResource      *metadata,
 	PngData pd = { 0 };
 	TrackerExifData *ed = NULL;
 	TrackerXmpData *xd = NULL;
-	png_infop info_ptrs[2];
-	png_textp text_ptr;
-	gint info_index;
-	gint num_text;
 	gint i;
-	gint found;
 	GPtrArray *keywords;
 
-	info_ptrs[0] = info_ptr;
-	info_ptrs[1] = end_ptr;
+#ifdef HAVE_LIBEXIF
+	if (chunks->exif) {
+		ed = tracker_exif_new (g_bytes_get_data (chunks->exif, NULL),
+		                       g_bytes_get_size (chunks->exif),
+		                       uri);
+	}
+#endif /* HAVE_LIBEXIF */
 
-	for (info_index = 0; info_index < 2; info_index++) {
-		if ((found = png_get_text (png_ptr, info_ptrs[info_index], &text_ptr, &num_text)) < 1) {
-			g_debug ("Calling png_get_text() returned %d (< 1)", found);
+	for (i = 0; i < chunks->texts->len; i++) {
+		PngText *text = g_ptr_array_index (chunks->texts, i);
+
+		if (text->text[0] == '\0') {
 			continue;
 		}
 
-		for (i = 0; i < num_text; i++) {
-			if (!text_ptr[i].key || !text_ptr[i].text || text_ptr[i].text[0] == '\0') {
-				continue;
-			}
+#ifdef HAVE_EXEMPI
+		if (g_strcmp0 ("XML:com.adobe.xmp", text->key) == 0) {
+			/* ATM tracker_extract_xmp_read supports setting xd
+			 * multiple times, keep it that way as here it's
+			 * theoretically possible that the function gets
+			 * called multiple times
+			 */
+			xd = tracker_xmp_new (text->text,
+			                      text->length,
+			                      uri);
 
-#if defined(HAVE_EXEMPI) && defined(PNG_iTXt_SUPPORTED)
-			if (g_strcmp0 ("XML:com.adobe.xmp", text_ptr[i].key) == 0) {
-				/* ATM tracker_extract_xmp_read supports setting xd
-				 * multiple times, keep it that way as here it's
-				 * theoretically possible that the function gets
-				 * called multiple times
-				 */
-				xd = tracker_xmp_new (text_ptr[i].text,
-				                      text_ptr[i].itxt_length,
-				                      uri);
-
-				continue;
-			}
-
-			if (!xd && g_strcmp0 ("Raw profile type xmp", text_ptr[i].key) == 0) {
-				gchar *xmp_buffer;
-				guint xmp_buffer_length = 0;
-				guint input_len;
-
-				if (text_ptr[i].text_length) {
-					input_len = text_ptr[i].text_length;
-				} else {
-					input_len = text_ptr[i].itxt_length;
-				}
-
-				xmp_buffer = raw_profile_new (text_ptr[i].text,
-				                              input_len,
-				                              &xmp_buffer_length);
+			continue;
+		}
 
-				if (xmp_buffer) {
-					xd = tracker_xmp_new (xmp_buffer,
-					                      xmp_buffer_length,
-					                      uri);
-				}
+		if (!xd && g_strcmp0 ("Raw profile type xmp", text->key) == 0) {
+			gchar *xmp_buffer;
+			guint xmp_buffer_length = 0;
 
-				g_free (xmp_buffer);
+			xmp_buffer = raw_profile_new (text->text,
+			                              text->length,
+			                              &xmp_buffer_length);
 
-				continue;
+			if (xmp_buffer) {
+				xd = tracker_xmp_new (xmp_buffer,
+				                      xmp_buffer_length,
+				                      uri);
 			}
-#endif /*HAVE_EXEMPI && PNG_iTXt_SUPPORTED */
 
-#if defined(HAVE_LIBEXIF) && defined(PNG_iTXt_SUPPORTED)
-			if (!ed && g_strcmp0 ("Raw profile type exif", text_ptr[i].key) == 0) {
-				gchar *exif_buffer;
-				guint exif_buffer_length = 0;
-				guint input_len;
+			g_free (xmp_buffer);
 
-				if (text_ptr[i].text_length) {
-					input_len = text_ptr[i].text_length;
-				} else {
-					input_len = text_ptr[i].itxt_length;
-				}
-
-				exif_buffer = raw_profile_new (text_ptr[i].text,
-				                               input_len,
-				                               &exif_buffer_length);
+			continue;
+		}
+#endif /* HAVE_EXEMPI */
 
-				if (exif_buffer) {
-					ed = tracker_exif_new (exif_buffer,
-					                       exif_buffer_length,
-					                       uri);
-				}
+#ifdef HAVE_LIBEXIF
+		if (!ed && g_strcmp0 ("Raw profile type exif", text->key) == 0) {
+			gchar *exif_buffer;
+			guint exif_buffer_length = 0;
 
-				g_free (exif_buffer);
+			exif_buffer = raw_profile_new (text->text,
+			                               text->length,
+			                               &exif_buffer_length);
 
-				continue;
+			if (exif_buffer) {
+				ed = tracker_exif_new (exif_buffer,
+				                       exif_buffer_length,
+				                       uri);
 			}
-#endif /* HAVE_LIBEXIF && PNG_iTXt_SUPPORTED */
 
-			if (g_strcmp0 (text_ptr[i].key, "Author") == 0) {
-				pd.author = text_ptr[i].text;
-				continue;
-			}
+			g_free (exif_buffer);
 
-			if (g_strcmp0 (text_ptr[i].key, "Creator") == 0) {
-				pd.creator = text_ptr[i].text;
-				continue;
-			}
+			continue;
+		}
+#endif /* HAVE_LIBEXIF */
 
-			if (g_strcmp0 (text_ptr[i].key, "Description") == 0) {
-				pd.description = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text->key, "Author") == 0) {
+			pd.author = text->text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Comment") == 0) {
-				pd.comment = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text->key, "Creator") == 0) {
+			pd.creator = text->text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Copyright") == 0) {
-				pd.copyright = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text->key, "Description") == 0) {
+			pd.description = text->text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Creation Time") == 0) {
-				pd.creation_time = rfc1123_to_iso8601_date (text_ptr[i].text);
-				continue;
-			}
+		if (g_strcmp0 (text->key, "Comment") == 0) {
+			pd.comment = text->text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Title") == 0) {
-				pd.title = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text->key, "Copyright") == 0) {
+			pd.copyright = text->text;
+			continue;
+		}
 
-			if (g_strcmp0 (text_ptr[i].key, "Disclaimer") == 0) {
-				pd.disclaimer = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text->key, "Creation Time") == 0) {
+			pd.creation_time = rfc1123_to_iso8601_date (text->text);
+			continue;
+		}
 
-			if (g_strcmp0(text_ptr[i].key, "Software") == 0) {
-				pd.software = text_ptr[i].text;
-				continue;
-			}
+		if (g_strcmp0 (text->key, "Title") == 0) {
+			pd.title = text->text;
+			continue;
+		}
+
+		if (g_strcmp0 (text->key, "Disclaimer") == 0) {
+			pd.disclaimer = text->text;
+			continue;
+		}
+
+		if (g_strcmp0(text->key, "Software") == 0) {
+			pd.software = text->text;
+			continue;
 		}
 	}
 
@@ -643,14 +914,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 	TrackerResource *metadata;
 	goffset size;
 	FILE *f;
-	png_structp png_ptr;
-	png_infop info_ptr;
-	png_infop end_ptr;
-	png_bytep row_data;
-	guint row;
-	png_uint_32 width, height;
-	gint bit_depth, color_type;
-	gint interlace_type, compression_type, filter_type;
+	PngChunks *chunks;
 	const gchar *dlna_profile, *dlna_mimetype;
 	gchar *filename, *uri, *resource_uri;
 	GFile *file;
@@ -674,63 +938,20 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 		return FALSE;
 	}
 
-	png_ptr = png_create_read_struct (PNG_LIBPNG_VER_STRING,
-	                                  NULL,
-	                                  NULL,
-	                                  NULL);
-	if (!png_ptr) {
-		tracker_file_close (f, FALSE);
-		return FALSE;
-	}
-
-	info_ptr = png_create_info_struct (png_ptr);
-	if (!info_ptr) {
-		png_destroy_read_struct (&png_ptr, NULL, NULL);
-		tracker_file_close (f, FALSE);
-		return FALSE;
-	}
-
-	end_ptr = png_create_info_struct (png_ptr);
-	if (!end_ptr) {
-		png_destroy_read_struct (&png_ptr, &info_ptr, NULL);
-		tracker_file_close (f, FALSE);
-		return FALSE;
-	}
-
-	if (setjmp (png_jmpbuf (png_ptr))) {
-		png_destroy_read_struct (&png_ptr, &info_ptr, &end_ptr);
-		tracker_file_close (f, FALSE);
-		return FALSE;
-	}
-
-	png_init_io (png_ptr, f);
-	png_read_info (png_ptr, info_ptr);
+	/* Metadata may come after the image data, read it by walking
+	 * over the chunks instead of decoding the whole image.
+	 */
+	chunks = chunks_new ();
 
-	if (!png_get_IHDR (png_ptr,
-	                   info_ptr,
-	                   &width,
-	                   &height,
-	                   &bit_depth,
-	                   &color_type,
-	                   &interlace_type,
-	                   &compression_type,
-	                   &filter_type)) {
-		png_destroy_read_struct (&png_ptr, &info_ptr, &end_ptr);
+	if (!read_chunks (f, chunks, error)) {
+		chunks_free (chunks);
 		tracker_file_close (f, FALSE);
 		return FALSE;
 	}
 
-	/* Read the image. FIXME We should be able to skip this step and
-	 * just get the info from the end. This causes some errors atm.
-	 */
-	row_data = png_malloc (png_ptr, png_get_rowbytes (png_ptr, info_ptr));
-	for (row = 0; row < height; row++)
-		png_read_row (png_ptr, row_data, NULL);
-	png_free (png_ptr, row_data);
-
-	png_read_end (png_ptr, end_ptr);
+	tracker_file_close (f, FALSE);
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (info, NULL);
 	metadata = tracker_resource_new (resource_uri);
 	g_free (resource_uri);
 
@@ -739,19 +960,19 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 
 	uri = g_file_get_uri (file);
 
-	read_metadata (metadata, png_ptr, info_ptr, end_ptr, file, uri);
+	read_metadata (metadata, chunks, file, uri);
 	g_free (uri);
 
-	tracker_resource_set_int64 (metadata, "nfo:width", width);
-	tracker_resource_set_int64 (metadata, "nfo:height", height);
+	tracker_resource_set_int64 (metadata, "nfo:width", chunks->width);
+	tracker_resource_set_int64 (metadata, "nfo:height", chunks->height);
 
-	if (guess_dlna_profile (bit_depth, width, height, &dlna_profile, &dlna_mimetype)) {
+	if (guess_dlna_profile (chunks->bit_depth, chunks->width, chunks->height,
+	                        &dlna_profile, &dlna_mimetype)) {
 		tracker_resource_set_string (metadata, "nmm:dlnaProfile", dlna_profile);
 		tracker_resource_set_string (metadata, "nmm:dlnaMime", dlna_mimetype);
 	}
 
-	png_destroy_read_struct (&png_ptr, &info_ptr, &end_ptr);
-	tracker_file_close (f, FALSE);
+	chunks_free (chunks);
 
 	tracker_extract_info_set_resource (info, metadata);
 	g_object_unref (metadata);
@@ -345,7 +345,7 @@ tracker_extract_get_metadata (TrackerExtractInfo  *info,
 		goto out;
 	}
 
-	resource_uri = tracker_file_get_content_identifier (file, NULL, NULL);
+	resource_uri = tracker_extract_info_get_content_id (info, NULL);
 	resource = tracker_resource_new (resource_uri);
 	tracker_resource_add_uri (resource, "rdf:type", "nfo:Image");
 	tracker_resource_add_uri (resource, "rdf:type", "nmm:Photo");
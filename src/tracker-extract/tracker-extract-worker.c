@@ -0,0 +1,574 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <gio/gunixinputstream.h>
+
+#include "tracker-extract-worker.h"
+
+/* Requests and replies are tiny compared to what a module may
+ * produce, but refuse anything absurd coming from a broken peer.
+ */
+#define MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+
+typedef enum {
+	KILL_REASON_NONE,
+	KILL_REASON_TIMEOUT,
+	KILL_REASON_CANCELLED,
+} KillReason;
+
+struct _TrackerExtractWorker {
+	GSubprocess *subprocess;
+	GInputStream *input;
+	gint fd;
+
+	/* The request being handled, if any */
+	GTask *task;
+	GCancellable *cancellable;
+	gulong cancelled_id;
+	guint timeout_id;
+	gint kill_reason;
+
+	guint32 reply_size;
+	gchar *reply;
+
+	guint dead : 1;
+	guint orphaned : 1;
+};
+
+static gboolean
+write_all (gint           fd,
+           gconstpointer  data,
+           gsize          size,
+           GError       **error)
+{
+	const gchar *ptr = data;
+
+	while (size > 0) {
+		gssize written;
+
+		/* Don't get SIGPIPE if the other end went away */
+		written = send (fd, ptr, size, MSG_NOSIGNAL);
+
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			g_set_error (error, G_IO_ERROR,
+			             g_io_error_from_errno (errno),
+			             "Could not write message: %s",
+			             g_strerror (errno));
+			return FALSE;
+		}
+
+		ptr += written;
+		size -= written;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+read_all (gint       fd,
+          gpointer   data,
+          gsize      size,
+          gsize     *bytes_read,
+          GError   **error)
+{
+	gchar *ptr = data;
+
+	*bytes_read = 0;
+
+	while (*bytes_read < size) {
+		gssize r;
+
+		r = read (fd, ptr + *bytes_read, size - *bytes_read);
+
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+
+			g_set_error (error, G_IO_ERROR,
+			             g_io_error_from_errno (errno),
+			             "Could not read message: %s",
+			             g_strerror (errno));
+			return FALSE;
+		} else if (r == 0) {
+			break;
+		}
+
+		*bytes_read += r;
+	}
+
+	return TRUE;
+}
+
+/**
+ * tracker_extract_worker_write_message:
+ * @fd: socket to write to
+ * @message: message to send, floating references are sunk
+ * @error: return location for errors
+ *
+ * Sends @message over @fd. Used on both ends of the connection.
+ *
+ * Returns: %TRUE if the whole message was written.
+ **/
+gboolean
+tracker_extract_worker_write_message (gint       fd,
+                                      GVariant  *message,
+                                      GError   **error)
+{
+	guint32 size;
+	gboolean retval;
+
+	g_variant_ref_sink (message);
+	size = g_variant_get_size (message);
+
+	retval = (write_all (fd, &size, sizeof (size), error) &&
+	          write_all (fd, g_variant_get_data (message), size, error));
+
+	g_variant_unref (message);
+
+	return retval;
+}
+
+/**
+ * tracker_extract_worker_read_message:
+ * @fd: socket to read from
+ * @type: expected type of the message
+ * @error: return location for errors
+ *
+ * Reads a message from @fd, blocking until it arrives.
+ *
+ * Returns: the message, or %NULL on errors and once the other end
+ *   closed the connection, in which case @error is left unset.
+ **/
+GVariant *
+tracker_extract_worker_read_message (gint                 fd,
+                                     const GVariantType  *type,
+                                     GError             **error)
+{
+	GVariant *message;
+	guint32 size;
+	gchar *data;
+	gsize bytes_read;
+
+	if (!read_all (fd, &size, sizeof (size), &bytes_read, error))
+		return NULL;
+	if (bytes_read == 0)
+		return NULL;
+
+	if (bytes_read != sizeof (size) || size > MAX_MESSAGE_SIZE) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+		             "Malformed message header");
+		return NULL;
+	}
+
+	data = g_malloc (size);
+
+	if (!read_all (fd, data, size, &bytes_read, error)) {
+		g_free (data);
+		return NULL;
+	}
+
+	if (bytes_read != size) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+		             "Truncated message");
+		g_free (data);
+		return NULL;
+	}
+
+	message = g_variant_new_from_data (type, data, size, FALSE,
+	                                   g_free, data);
+
+	return g_variant_ref_sink (message);
+}
+
+TrackerExtractWorker *
+tracker_extract_worker_new (const gchar * const  *argv,
+                            GError              **error)
+{
+	TrackerExtractWorker *worker;
+	GSubprocessLauncher *launcher;
+	GSubprocess *subprocess;
+	gint fds[2];
+
+	g_return_val_if_fail (argv != NULL && argv[0] != NULL, NULL);
+
+	if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+		g_set_error (error, G_IO_ERROR,
+		             g_io_error_from_errno (errno),
+		             "Could not create worker socket: %s",
+		             g_strerror (errno));
+		return NULL;
+	}
+
+	launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+	/* The launcher takes ownership of the worker end */
+	g_subprocess_launcher_take_fd (launcher, fds[1], TRACKER_EXTRACT_WORKER_FD);
+	subprocess = g_subprocess_launcher_spawnv (launcher, argv, error);
+	g_object_unref (launcher);
+
+	if (!subprocess) {
+		close (fds[0]);
+		return NULL;
+	}
+
+	worker = g_slice_new0 (TrackerExtractWorker);
+	worker->subprocess = subprocess;
+	worker->fd = fds[0];
+	worker->input = g_unix_input_stream_new (fds[0], TRUE);
+
+	g_debug ("Spawned extraction worker %s",
+	         g_subprocess_get_identifier (subprocess));
+
+	return worker;
+}
+
+static void
+worker_disconnect_request (TrackerExtractWorker *worker)
+{
+	if (worker->timeout_id) {
+		g_source_remove (worker->timeout_id);
+		worker->timeout_id = 0;
+	}
+
+	if (worker->cancellable) {
+		g_cancellable_disconnect (worker->cancellable,
+		                          worker->cancelled_id);
+		g_clear_object (&worker->cancellable);
+		worker->cancelled_id = 0;
+	}
+}
+
+static void
+worker_destroy (TrackerExtractWorker *worker)
+{
+	/* Closing our end makes the worker see EOF and exit */
+	g_input_stream_close (worker->input, NULL, NULL);
+	g_object_unref (worker->input);
+
+	if (worker->dead)
+		g_subprocess_force_exit (worker->subprocess);
+
+	g_object_unref (worker->subprocess);
+	g_free (worker->reply);
+
+	g_slice_free (TrackerExtractWorker, worker);
+}
+
+/**
+ * tracker_extract_worker_free:
+ * @worker: a worker
+ *
+ * Frees @worker and makes its process exit. If a request is being
+ * handled, the process is killed and the request is dropped without
+ * calling its callback, the memory is released once the pending
+ * read notices.
+ **/
+void
+tracker_extract_worker_free (TrackerExtractWorker *worker)
+{
+	g_return_if_fail (worker != NULL);
+
+	if (worker->task) {
+		worker_disconnect_request (worker);
+		g_clear_object (&worker->task);
+		worker->orphaned = TRUE;
+		worker->dead = TRUE;
+		g_subprocess_force_exit (worker->subprocess);
+		return;
+	}
+
+	worker_destroy (worker);
+}
+
+gboolean
+tracker_extract_worker_is_alive (TrackerExtractWorker *worker)
+{
+	return !worker->dead;
+}
+
+/* Resident memory of the worker process, or 0 if unknown */
+gsize
+tracker_extract_worker_get_rss (TrackerExtractWorker *worker)
+{
+	const gchar *pid;
+	gchar *path, *contents = NULL;
+	guint64 size, resident = 0;
+
+	pid = g_subprocess_get_identifier (worker->subprocess);
+	if (!pid)
+		return 0;
+
+	path = g_strdup_printf ("/proc/%s/statm", pid);
+
+	if (g_file_get_contents (path, &contents, NULL, NULL) &&
+	    sscanf (contents, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT,
+	            &size, &resident) != 2)
+		resident = 0;
+
+	g_free (contents);
+	g_free (path);
+
+	return resident * sysconf (_SC_PAGESIZE);
+}
+
+static void
+worker_kill (TrackerExtractWorker *worker,
+             KillReason            reason)
+{
+	/* The first reason wins */
+	if (g_atomic_int_compare_and_exchange (&worker->kill_reason,
+	                                       KILL_REASON_NONE, reason))
+		g_subprocess_force_exit (worker->subprocess);
+}
+
+static gboolean
+worker_timeout_cb (gpointer user_data)
+{
+	TrackerExtractWorker *worker = user_data;
+	GTask *task = worker->task;
+
+	g_warning ("File '%s' took too long to process, killing worker %s",
+	           (const gchar *) g_task_get_task_data (task),
+	           g_subprocess_get_identifier (worker->subprocess));
+
+	worker->timeout_id = 0;
+	worker_kill (worker, KILL_REASON_TIMEOUT);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+worker_cancelled_cb (GCancellable *cancellable,
+                     gpointer      user_data)
+{
+	/* May be called from any thread */
+	worker_kill (user_data, KILL_REASON_CANCELLED);
+}
+
+static void
+worker_finish_request (TrackerExtractWorker *worker,
+                       GVariant             *reply)
+{
+	GTask *task;
+
+	g_clear_pointer (&worker->reply, g_free);
+
+	if (worker->orphaned) {
+		g_clear_pointer (&reply, g_variant_unref);
+		worker_destroy (worker);
+		return;
+	}
+
+	task = g_steal_pointer (&worker->task);
+	worker_disconnect_request (worker);
+
+	if (reply) {
+		g_task_return_pointer (task, reply,
+		                       (GDestroyNotify) g_variant_unref);
+	} else {
+		/* Whatever happened, this worker is not usable anymore */
+		worker->dead = TRUE;
+		g_subprocess_force_exit (worker->subprocess);
+
+		switch (g_atomic_int_get (&worker->kill_reason)) {
+		case KILL_REASON_TIMEOUT:
+			g_task_return_new_error (task, G_IO_ERROR,
+			                         G_IO_ERROR_TIMED_OUT,
+			                         "Extraction took too long");
+			break;
+		case KILL_REASON_CANCELLED:
+			g_task_return_new_error (task, G_IO_ERROR,
+			                         G_IO_ERROR_CANCELLED,
+			                         "Extraction was cancelled");
+			break;
+		default:
+			g_task_return_new_error (task, G_IO_ERROR,
+			                         G_IO_ERROR_FAILED,
+			                         "Extraction worker exited unexpectedly");
+			break;
+		}
+	}
+
+	g_object_unref (task);
+}
+
+static void
+reply_read_cb (GObject      *object,
+               GAsyncResult *res,
+               gpointer      user_data)
+{
+	TrackerExtractWorker *worker = user_data;
+	GVariant *reply = NULL;
+	gsize bytes_read;
+
+	if (g_input_stream_read_all_finish (G_INPUT_STREAM (object), res,
+	                                    &bytes_read, NULL) &&
+	    bytes_read == worker->reply_size) {
+		gchar *data;
+
+		/* The variant takes ownership of the data */
+		data = g_steal_pointer (&worker->reply);
+		reply = g_variant_new_from_data (G_VARIANT_TYPE (TRACKER_EXTRACT_WORKER_REPLY_TYPE),
+		                                 data, worker->reply_size,
+		                                 FALSE, g_free, data);
+		g_variant_ref_sink (reply);
+
+		/* Don't trust a worker that may have been compromised */
+		if (!g_variant_is_normal_form (reply)) {
+			GVariant *normal;
+
+			normal = g_variant_get_normal_form (reply);
+			g_variant_unref (reply);
+			reply = g_variant_ref_sink (normal);
+		}
+	}
+
+	worker_finish_request (worker, reply);
+}
+
+static void
+reply_size_read_cb (GObject      *object,
+                    GAsyncResult *res,
+                    gpointer      user_data)
+{
+	TrackerExtractWorker *worker = user_data;
+	gsize bytes_read;
+
+	if (!g_input_stream_read_all_finish (G_INPUT_STREAM (object), res,
+	                                     &bytes_read, NULL) ||
+	    bytes_read != sizeof (worker->reply_size) ||
+	    worker->reply_size > MAX_MESSAGE_SIZE) {
+		worker_finish_request (worker, NULL);
+		return;
+	}
+
+	worker->reply = g_malloc (worker->reply_size);
+	g_input_stream_read_all_async (worker->input,
+	                               worker->reply,
+	                               worker->reply_size,
+	                               G_PRIORITY_DEFAULT,
+	                               NULL,
+	                               reply_read_cb,
+	                               worker);
+}
+
+/**
+ * tracker_extract_worker_extract_async:
+ * @worker: an idle worker
+ * @uri: file to extract
+ * @mimetype: mimetype of the file
+ * @graph: graph the file goes into
+ * @content_id: (nullable): content identifier of the file, if known
+ * @timeout_seconds: time after which the worker is killed
+ * @cancellable: a #GCancellable, cancelling kills the worker
+ * @callback: callback to call when done
+ * @user_data: data for @callback
+ *
+ * Hands a file over to the worker. The request finishes when
+ * the worker replies, or when it dies for any reason.
+ **/
+void
+tracker_extract_worker_extract_async (TrackerExtractWorker *worker,
+                                      const gchar          *uri,
+                                      const gchar          *mimetype,
+                                      const gchar          *graph,
+                                      const gchar          *content_id,
+                                      guint                 timeout_seconds,
+                                      GCancellable         *cancellable,
+                                      GAsyncReadyCallback   callback,
+                                      gpointer              user_data)
+{
+	GError *error = NULL;
+
+	g_return_if_fail (worker != NULL);
+	g_return_if_fail (worker->task == NULL);
+
+	/* Cancellation is handled by killing the worker, so the
+	 * cancellable is not given to the task nor to the reads.
+	 */
+	worker->task = g_task_new (NULL, NULL, callback, user_data);
+	g_task_set_task_data (worker->task, g_strdup (uri), g_free);
+	worker->kill_reason = KILL_REASON_NONE;
+
+	if (worker->dead ||
+	    !tracker_extract_worker_write_message (worker->fd,
+	                                           g_variant_new (TRACKER_EXTRACT_WORKER_REQUEST_TYPE,
+	                                                          uri, mimetype, graph,
+	                                                          content_id ? content_id : ""),
+	                                           &error)) {
+		if (error) {
+			g_debug ("Could not send request to worker: %s", error->message);
+			g_error_free (error);
+		}
+
+		worker_finish_request (worker, NULL);
+		return;
+	}
+
+	worker->timeout_id = g_timeout_add_seconds (timeout_seconds,
+	                                            worker_timeout_cb,
+	                                            worker);
+
+	if (cancellable) {
+		worker->cancellable = g_object_ref (cancellable);
+		worker->cancelled_id = g_cancellable_connect (cancellable,
+		                                              G_CALLBACK (worker_cancelled_cb),
+		                                              worker, NULL);
+	}
+
+	g_input_stream_read_all_async (worker->input,
+	                               &worker->reply_size,
+	                               sizeof (worker->reply_size),
+	                               G_PRIORITY_DEFAULT,
+	                               NULL,
+	                               reply_size_read_cb,
+	                               worker);
+}
+
+/**
+ * tracker_extract_worker_extract_finish:
+ * @worker: a worker
+ * @result: the #GAsyncResult
+ * @error: return location for errors
+ *
+ * Finishes a request. Errors are in the %G_IO_ERROR domain,
+ * %G_IO_ERROR_TIMED_OUT and %G_IO_ERROR_CANCELLED are used if the
+ * worker was killed for these reasons. After an error the worker
+ * is no longer alive.
+ *
+ * Returns: the reply of type %TRACKER_EXTRACT_WORKER_REPLY_TYPE
+ **/
+GVariant *
+tracker_extract_worker_extract_finish (TrackerExtractWorker  *worker,
+                                       GAsyncResult          *result,
+                                       GError               **error)
+{
+	g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
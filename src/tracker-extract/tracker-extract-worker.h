@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __TRACKER_EXTRACT_WORKER_H__
+#define __TRACKER_EXTRACT_WORKER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* The worker end of the socket is passed as this fd */
+#define TRACKER_EXTRACT_WORKER_FD 3
+
+/* Messages are a 32 bit size in host byte order followed by a
+ * serialized GVariant of these types.
+ *
+ * Requests carry the URI, mimetype, graph and content identifier,
+ * the latter is empty if unknown. Replies carry whether
+ * extraction succeeded, the serialized resource if any, the error
+ * domain, code and message, the bytes read from storage and the
+ * growth of peak RSS while extracting.
+ */
+#define TRACKER_EXTRACT_WORKER_REQUEST_TYPE "(ssss)"
+#define TRACKER_EXTRACT_WORKER_REPLY_TYPE   "(bmvsistt)"
+
+typedef struct _TrackerExtractWorker TrackerExtractWorker;
+
+gboolean   tracker_extract_worker_write_message (gint                 fd,
+                                                 GVariant            *message,
+                                                 GError             **error);
+GVariant * tracker_extract_worker_read_message  (gint                 fd,
+                                                 const GVariantType  *type,
+                                                 GError             **error);
+
+TrackerExtractWorker * tracker_extract_worker_new  (const gchar * const  *argv,
+                                                    GError              **error);
+void                   tracker_extract_worker_free (TrackerExtractWorker  *worker);
+
+gboolean tracker_extract_worker_is_alive (TrackerExtractWorker *worker);
+gsize    tracker_extract_worker_get_rss  (TrackerExtractWorker *worker);
+
+void       tracker_extract_worker_extract_async  (TrackerExtractWorker  *worker,
+                                                  const gchar           *uri,
+                                                  const gchar           *mimetype,
+                                                  const gchar           *graph,
+                                                  const gchar           *content_id,
+                                                  guint                  timeout_seconds,
+                                                  GCancellable          *cancellable,
+                                                  GAsyncReadyCallback    callback,
+                                                  gpointer               user_data);
+GVariant * tracker_extract_worker_extract_finish (TrackerExtractWorker  *worker,
+                                                  GAsyncResult          *result,
+                                                  GError               **error);
+
+G_END_DECLS
+
+#endif /* __TRACKER_EXTRACT_WORKER_H__ */
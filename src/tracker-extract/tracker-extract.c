@@ -19,8 +19,12 @@
 
 #include "config-miners.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 
 #include <gmodule.h>
 #include <glib/gi18n.h>
@@ -34,7 +38,9 @@
 
 #include <libtracker-extract/tracker-extract.h>
 
+#include "tracker-device-scheduler.h"
 #include "tracker-extract.h"
+#include "tracker-extract-worker.h"
 #include "tracker-main.h"
 
 #ifdef THREAD_ENABLE_TRACE
@@ -47,16 +53,26 @@ G_DEFINE_QUARK (TrackerExtractError, tracker_extract_error)
 
 #define DEADLINE_SECONDS 30
 
+/* Maximum number of worker processes extracting at once */
+#define MAX_WORKERS 4
+
+/* Rough cost of a task waiting for a worker */
+#define ESTIMATED_TASK_SIZE 1024
+
 extern gboolean debug;
 
 typedef struct {
-	GTimer *elapsed;
+	gint64 elapsed;
 	gint extracted_count;
 	gint failed_count;
+	gint timeout_count;
+	guint64 bytes_read;
+	guint64 peak_rss_delta; /* Largest growth of peak RSS in one extraction */
+	guint64 latency[TRACKER_LATENCY_N_BUCKETS];
 } StatisticsData;
 
 typedef struct {
-	GHashTable *statistics_data;
+	GHashTable *statistics_data; /* GModule -> StatisticsData */
 	GList *running_tasks;
 
 	/* used to maintain the running tasks
@@ -75,14 +91,38 @@ typedef struct {
 	GTimer *total_elapsed;
 
 	gint unhandled_count;
+
+	/* Extraction happens in worker processes if set,
+	 * only accessed from the main thread.
+	 */
+	GStrv worker_argv;
+	GQueue idle_workers;
+	GQueue busy_workers;
+
+	/* Tasks waiting for a worker, queued per device */
+	TrackerDeviceScheduler *scheduler;
+	guint budget_id;
+
+	/* Issues readahead hints off the main thread */
+	GThreadPool *readahead_pool;
+#if !GLIB_CHECK_VERSION (2, 70, 0)
+	gint readahead_dropped;
+#endif
 } TrackerExtractPrivate;
 
+typedef struct {
+	gchar *path;
+	gint64 head;
+	gint64 tail;
+} ReadaheadRequest;
+
 typedef struct {
 	TrackerExtract *extract;
 	GCancellable *cancellable;
 	GAsyncResult *res;
 	gchar *file;
 	gchar *mimetype;
+	gchar *content_id;
 	const gchar *graph;
 
 	TrackerExtractMetadataFunc func;
@@ -90,8 +130,20 @@ typedef struct {
 
 	guint timeout_id;
 	guint success : 1;
+
+	TrackerExtractWorker *worker;
+	TrackerDeviceQueue *device;
+	gint64 start_time;
 } TrackerExtractTask;
 
+enum {
+	PROP_0,
+	PROP_N_WAITING_TASKS,
+	N_PROPS
+};
+
+static GParamSpec *props[N_PROPS] = { 0, };
+
 static void tracker_extract_finalize (GObject *object);
 static void log_statistics        (GObject *object);
 static gboolean get_metadata         (TrackerExtractTask *task);
@@ -100,6 +152,22 @@ static gboolean dispatch_task_cb     (TrackerExtractTask *task);
 
 G_DEFINE_TYPE_WITH_PRIVATE(TrackerExtract, tracker_extract, G_TYPE_OBJECT)
 
+static void
+tracker_extract_get_property (GObject    *object,
+                              guint       prop_id,
+                              GValue     *value,
+                              GParamSpec *pspec)
+{
+	switch (prop_id) {
+	case PROP_N_WAITING_TASKS:
+		g_value_set_uint (value,
+		                  tracker_extract_get_n_waiting_tasks (TRACKER_EXTRACT (object)));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	}
+}
+
 static void
 tracker_extract_class_init (TrackerExtractClass *klass)
 {
@@ -108,15 +176,43 @@ tracker_extract_class_init (TrackerExtractClass *klass)
 	object_class = G_OBJECT_CLASS (klass);
 
 	object_class->finalize = tracker_extract_finalize;
+	object_class->get_property = tracker_extract_get_property;
+
+	props[PROP_N_WAITING_TASKS] =
+		g_param_spec_uint ("n-waiting-tasks",
+		                   "Waiting tasks",
+		                   "Files waiting for their device to have room for another worker",
+		                   0, G_MAXUINT, 0,
+		                   G_PARAM_READABLE |
+		                   G_PARAM_EXPLICIT_NOTIFY |
+		                   G_PARAM_STATIC_STRINGS);
+
+	g_object_class_install_properties (object_class, N_PROPS, props);
 }
 
 static void
 statistics_data_free (StatisticsData *data)
 {
-	g_timer_destroy (data->elapsed);
 	g_slice_free (StatisticsData, data);
 }
 
+/* Must be called with the task mutex held */
+static StatisticsData *
+statistics_data_lookup (TrackerExtractPrivate *priv,
+                        GModule               *module)
+{
+	StatisticsData *stats_data;
+
+	stats_data = g_hash_table_lookup (priv->statistics_data, module);
+
+	if (!stats_data) {
+		stats_data = g_slice_new0 (StatisticsData);
+		g_hash_table_insert (priv->statistics_data, module, stats_data);
+	}
+
+	return stats_data;
+}
+
 static void
 tracker_extract_init (TrackerExtract *object)
 {
@@ -124,13 +220,14 @@ tracker_extract_init (TrackerExtract *object)
 
 	priv = TRACKER_EXTRACT_GET_PRIVATE (object);
 	priv->single_thread_extractors = g_hash_table_new (NULL, NULL);
+	priv->statistics_data = g_hash_table_new_full (NULL, NULL, NULL,
+	                                               (GDestroyNotify) statistics_data_free);
+	priv->scheduler = tracker_device_scheduler_new (MAX_WORKERS);
 
 #ifdef G_ENABLE_DEBUG
 	if (TRACKER_DEBUG_CHECK (STATISTICS)) {
 		priv->total_elapsed = g_timer_new ();
 		g_timer_stop (priv->total_elapsed);
-		priv->statistics_data = g_hash_table_new_full (NULL, NULL, NULL,
-		                                               (GDestroyNotify) statistics_data_free);
 	}
 #endif
 
@@ -148,14 +245,40 @@ tracker_extract_finalize (GObject *object)
 
 	g_hash_table_destroy (priv->single_thread_extractors);
 
+	if (priv->budget_id) {
+		tracker_memory_budget_unregister (tracker_memory_budget_get_default (),
+		                                  priv->budget_id);
+	}
+
+	g_queue_foreach (&priv->idle_workers, (GFunc) tracker_extract_worker_free, NULL);
+	g_queue_clear (&priv->idle_workers);
+	/* Busy workers are killed, their requests are dropped */
+	g_queue_foreach (&priv->busy_workers, (GFunc) tracker_extract_worker_free, NULL);
+	g_queue_clear (&priv->busy_workers);
+	tracker_device_scheduler_free (priv->scheduler);
+	g_strfreev (priv->worker_argv);
+
+	/* Pending hints are dropped, only the one being issued is
+	 * waited for.
+	 */
+	if (priv->readahead_pool) {
+#if GLIB_CHECK_VERSION (2, 70, 0)
+		g_thread_pool_free (priv->readahead_pool, TRUE, TRUE);
+#else
+		g_atomic_int_set (&priv->readahead_dropped, TRUE);
+		g_thread_pool_free (priv->readahead_pool, FALSE, TRUE);
+#endif
+	}
+
 #ifdef G_ENABLE_DEBUG
 	if (TRACKER_DEBUG_CHECK (STATISTICS)) {
 		log_statistics (object);
-		g_hash_table_destroy (priv->statistics_data);
 		g_timer_destroy (priv->total_elapsed);
 	}
 #endif
 
+	g_hash_table_destroy (priv->statistics_data);
+
 	g_mutex_clear (&priv->task_mutex);
 
 	G_OBJECT_CLASS (tracker_extract_parent_class)->finalize (object);
@@ -185,18 +308,21 @@ log_statistics (GObject *object)
 			GModule *module = key;
 			StatisticsData *data = value;
 
-			if (data->extracted_count > 0 || data->failed_count > 0) {
+			if (module &&
+			    (data->extracted_count > 0 || data->failed_count > 0)) {
 				const gchar *name, *name_without_path;
+				gdouble elapsed;
 
 				name = g_module_name (module);
 				name_without_path = strrchr (name, G_DIR_SEPARATOR) + 1;
+				elapsed = (gdouble) data->elapsed / G_USEC_PER_SEC;
 
 				g_message ("    Module:'%s', extracted:%d, failures:%d, elapsed: %.2fs (%.2f%% of total)",
 				           name_without_path,
 				           data->extracted_count,
 				           data->failed_count,
-					   g_timer_elapsed (data->elapsed, NULL),
-					   (g_timer_elapsed (data->elapsed, NULL) / total_elapsed) * 100);
+					   elapsed,
+					   (elapsed / total_elapsed) * 100);
 			}
 		}
 
@@ -252,27 +378,26 @@ notify_task_finish (TrackerExtractTask *task,
 	 */
 	g_mutex_lock (&priv->task_mutex);
 
-#ifdef G_ENABLE_DEBUG
-	if (TRACKER_DEBUG_CHECK (STATISTICS)) {
-		if (task->module) {
-			stats_data = g_hash_table_lookup (priv->statistics_data,
-			                                  task->module);
-			stats_data->extracted_count++;
+	if (task->module) {
+		stats_data = statistics_data_lookup (priv, task->module);
+		stats_data->extracted_count++;
 
-			if (!success) {
-				stats_data->failed_count++;
-			}
-		} else {
-			priv->unhandled_count++;
+		if (!success) {
+			stats_data->failed_count++;
 		}
+	} else {
+		priv->unhandled_count++;
+	}
+
+	priv->running_tasks = g_list_remove (priv->running_tasks, task);
 
+#ifdef G_ENABLE_DEBUG
+	if (TRACKER_DEBUG_CHECK (STATISTICS)) {
 		if (!priv->running_tasks && g_timer_is_active (priv->total_elapsed))
 			g_timer_stop (priv->total_elapsed);
 	}
 #endif
 
-	priv->running_tasks = g_list_remove (priv->running_tasks, task);
-
 	g_mutex_unlock (&priv->task_mutex);
 }
 
@@ -288,6 +413,7 @@ get_file_metadata (TrackerExtractTask  *task,
 
 	file = g_file_new_for_uri (task->file);
 	info = tracker_extract_info_new (file, task->mimetype, task->graph);
+	tracker_extract_info_set_content_id (info, task->content_id);
 	g_object_unref (file);
 
 	if (!task->mimetype || !*task->mimetype) {
@@ -326,6 +452,13 @@ static gboolean
 task_deadline_cb (gpointer user_data)
 {
 	TrackerExtractTask *task = user_data;
+	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
+
+	if (task->module) {
+		g_mutex_lock (&priv->task_mutex);
+		statistics_data_lookup (priv, task->module)->timeout_count++;
+		g_mutex_unlock (&priv->task_mutex);
+	}
 
 	g_warning ("File '%s' took too long to process. Shutting down everything",
 	           task->file);
@@ -337,6 +470,7 @@ static TrackerExtractTask *
 extract_task_new (TrackerExtract *extract,
                   const gchar    *uri,
                   const gchar    *mimetype,
+                  const gchar    *content_id,
                   GCancellable   *cancellable,
                   GAsyncResult   *res,
                   GError        **error)
@@ -376,9 +510,11 @@ extract_task_new (TrackerExtract *extract,
 	task->res = (res) ? g_object_ref (res) : NULL;
 	task->file = g_strdup (uri);
 	task->mimetype = mimetype_used;
+	task->content_id = g_strdup (content_id);
 	task->extract = extract;
 
-	if (task->res) {
+	/* Workers have their own watchdog */
+	if (task->res && !TRACKER_EXTRACT_GET_PRIVATE (extract)->worker_argv) {
 		GSource *source;
 
 		source = g_timeout_source_new_seconds (DEADLINE_SECONDS);
@@ -407,11 +543,135 @@ extract_task_free (TrackerExtractTask *task)
 	}
 
 	g_free (task->mimetype);
+	g_free (task->content_id);
 	g_free (task->file);
 
 	g_slice_free (TrackerExtractTask, task);
 }
 
+static void
+readahead_request_free (ReadaheadRequest *request)
+{
+	g_free (request->path);
+	g_slice_free (ReadaheadRequest, request);
+}
+
+/* Runs in the readahead thread, as opening the file
+ * may already need a seek.
+ */
+static void
+readahead_file (ReadaheadRequest *request,
+                gpointer          user_data)
+{
+	struct stat st;
+	gint fd;
+
+#if !GLIB_CHECK_VERSION (2, 70, 0)
+	gint *dropped = user_data;
+
+	if (g_atomic_int_get (dropped)) {
+		readahead_request_free (request);
+		return;
+	}
+#endif
+
+	/* Don't block on FIFOs, nor touch the access time
+	 * of files that are only hinted.
+	 */
+#if defined(__linux__)
+	fd = open (request->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC | O_NOATIME, 0);
+	if (fd == -1 && errno == EPERM)
+		fd = open (request->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC, 0);
+#else
+	fd = open (request->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC, 0);
+#endif
+
+	if (fd >= 0 && fstat (fd, &st) == 0 && S_ISREG (st.st_mode)) {
+		gint64 head, tail;
+
+		head = MIN (request->head, st.st_size);
+		tail = MIN (request->tail, st.st_size - head);
+
+		/* A length of 0 means up to the end of file */
+		if (head > 0)
+			posix_fadvise (fd, 0, head, POSIX_FADV_WILLNEED);
+		if (tail > 0)
+			posix_fadvise (fd, st.st_size - tail, tail, POSIX_FADV_WILLNEED);
+	}
+
+	if (fd >= 0)
+		close (fd);
+
+	readahead_request_free (request);
+}
+
+/**
+ * tracker_extract_readahead:
+ * @extract: a #TrackerExtract
+ * @uri: URI of a file about to be extracted
+ * @mimetype: mimetype of the file
+ *
+ * Asks the kernel to start reading the parts of the file that the
+ * extractor for @mimetype is known to read, so the disk works while
+ * the files before it are parsed. Must be called from the main thread.
+ **/
+void
+tracker_extract_readahead (TrackerExtract *extract,
+                           const gchar    *uri,
+                           const gchar    *mimetype)
+{
+	TrackerExtractPrivate *priv;
+	ReadaheadRequest *request;
+	gint64 head, tail;
+	gchar *path;
+
+	g_return_if_fail (TRACKER_IS_EXTRACT (extract));
+	g_return_if_fail (uri != NULL);
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+
+	if (!mimetype ||
+	    !tracker_extract_module_manager_get_readahead (mimetype, &head, &tail))
+		return;
+
+	if (head == TRACKER_EXTRACT_READAHEAD_MAX_BYTES) {
+		TrackerConfig *config = tracker_main_get_config ();
+
+		head = config ? tracker_config_get_max_bytes (config) : 0;
+	}
+
+	if (head <= 0 && tail <= 0)
+		return;
+
+	/* Pages would be dropped again before being used */
+	if (tracker_memory_budget_get_state (tracker_memory_budget_get_default ()) !=
+	    TRACKER_MEMORY_BUDGET_OK)
+		return;
+
+	/* Only local files */
+	path = g_filename_from_uri (uri, NULL, NULL);
+	if (!path)
+		return;
+
+	if (!priv->readahead_pool) {
+#if GLIB_CHECK_VERSION (2, 70, 0)
+		priv->readahead_pool = g_thread_pool_new_full ((GFunc) readahead_file, NULL,
+		                                               (GDestroyNotify) readahead_request_free,
+		                                               1, FALSE, NULL);
+#else
+		priv->readahead_pool = g_thread_pool_new ((GFunc) readahead_file,
+		                                          &priv->readahead_dropped,
+		                                          1, FALSE, NULL);
+#endif
+	}
+
+	request = g_slice_new0 (ReadaheadRequest);
+	request->path = path;
+	request->head = head;
+	request->tail = tail;
+	g_thread_pool_push (priv->readahead_pool, request, NULL);
+}
+
 static gboolean
 filter_module (TrackerExtract *extract,
                GModule        *module)
@@ -459,12 +719,44 @@ filter_module (TrackerExtract *extract,
 	return filter;
 }
 
+static void
+get_usage (gboolean  whole_process,
+           guint64  *bytes_read,
+           guint64  *max_rss)
+{
+	struct rusage usage;
+	gint who = RUSAGE_SELF;
+
+#ifdef RUSAGE_THREAD
+	if (!whole_process)
+		who = RUSAGE_THREAD;
+#else
+	if (!whole_process) {
+		*bytes_read = 0;
+		*max_rss = 0;
+		return;
+	}
+#endif
+
+	/* Blocks are 512 bytes, max RSS is in KiB */
+	if (getrusage (who, &usage) == 0) {
+		*bytes_read = (guint64) usage.ru_inblock * 512;
+		*max_rss = (guint64) usage.ru_maxrss * 1024;
+		return;
+	}
+
+	*bytes_read = 0;
+	*max_rss = 0;
+}
+
 static gboolean
 get_metadata (TrackerExtractTask *task)
 {
 	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
 	TrackerExtractInfo *info;
 	GError *error = NULL;
+	guint64 start_bytes_read, start_max_rss;
+	gint64 start_time;
 
 #ifdef THREAD_ENABLE_TRACE
 	g_debug ("Thread:%p --> '%s': Collected metadata",
@@ -477,23 +769,8 @@ get_metadata (TrackerExtractTask *task)
 		return FALSE;
 	}
 
-#ifdef G_ENABLE_DEBUG
-	if (TRACKER_DEBUG_CHECK (STATISTICS)) {
-		StatisticsData *stats_data;
-
-		stats_data = g_hash_table_lookup (priv->statistics_data,
-						  task->module);
-		if (!stats_data) {
-			stats_data = g_slice_new0 (StatisticsData);
-			stats_data->elapsed = g_timer_new ();
-			g_hash_table_insert (priv->statistics_data,
-					     task->module,
-					     stats_data);
-		} else {
-			g_timer_continue (stats_data->elapsed);
-		}
-	}
-#endif
+	start_time = g_get_monotonic_time ();
+	get_usage (FALSE, &start_bytes_read, &start_max_rss);
 
 	if (!filter_module (task->extract, task->module) &&
 	    get_file_metadata (task, &info, &error)) {
@@ -511,15 +788,26 @@ get_metadata (TrackerExtractTask *task)
 		}
 	}
 
-#ifdef G_ENABLE_DEBUG
-	if (TRACKER_DEBUG_CHECK (STATISTICS)) {
+	if (task->module) {
 		StatisticsData *stats_data;
+		guint64 bytes_read, max_rss;
+		gint64 elapsed;
+
+		elapsed = g_get_monotonic_time () - start_time;
+		get_usage (FALSE, &bytes_read, &max_rss);
+
+		g_mutex_lock (&priv->task_mutex);
+		stats_data = statistics_data_lookup (priv, task->module);
+		stats_data->elapsed += elapsed;
+		stats_data->latency[tracker_latency_bucket (elapsed)]++;
+		stats_data->bytes_read += bytes_read - start_bytes_read;
+		stats_data->peak_rss_delta = MAX (stats_data->peak_rss_delta,
+		                                   max_rss - start_max_rss);
+		g_mutex_unlock (&priv->task_mutex);
 
-		stats_data = g_hash_table_lookup (priv->statistics_data,
-						  task->module);
-		g_timer_stop (stats_data->elapsed);
+		tracker_rate_limiter_consume (tracker_rate_limiter_get_default (),
+		                              1, bytes_read - start_bytes_read);
 	}
-#endif
 
 	extract_task_free (task);
 
@@ -546,6 +834,229 @@ single_thread_get_metadata (GAsyncQueue *queue)
 	return NULL;
 }
 
+/* Keeps a pre-forked worker around, so a killed one is replaced
+ * without making the next file wait for a process to start.
+ */
+static void
+ensure_spare_worker (TrackerExtract *extract)
+{
+	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+	TrackerExtractWorker *worker;
+	GError *error = NULL;
+
+	if (!g_queue_is_empty (&priv->idle_workers) ||
+	    priv->busy_workers.length >= MAX_WORKERS)
+		return;
+
+	/* Not worth keeping an extra process around if short on memory */
+	if (tracker_memory_budget_get_state (tracker_memory_budget_get_default ()) !=
+	    TRACKER_MEMORY_BUDGET_OK)
+		return;
+
+	worker = tracker_extract_worker_new ((const gchar * const *) priv->worker_argv,
+	                                     &error);
+	if (!worker) {
+		g_warning ("Could not spawn extraction worker: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+
+	g_queue_push_tail (&priv->idle_workers, worker);
+}
+
+static void schedule_worker_tasks (TrackerExtract *extract);
+
+static void
+worker_extract_cb (GObject      *object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+	TrackerExtractTask *task = user_data;
+	TrackerExtract *extract = task->extract;
+	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+	TrackerExtractWorker *worker = task->worker;
+	StatisticsData *stats_data;
+	GVariant *reply;
+	GError *error = NULL;
+	guint64 bytes_read = 0, rss_delta = 0;
+	gboolean timed_out = FALSE;
+	gint64 elapsed;
+
+	reply = tracker_extract_worker_extract_finish (worker, res, &error);
+	elapsed = g_get_monotonic_time () - task->start_time;
+
+	if (reply) {
+		TrackerResource *resource = NULL;
+		GVariant *serialized;
+		const gchar *domain, *message;
+		gboolean success;
+		gint code;
+
+		g_variant_get (reply, "(bmv&si&stt)",
+		               &success, &serialized, &domain, &code, &message,
+		               &bytes_read, &rss_delta);
+
+		if (success && serialized)
+			resource = tracker_resource_deserialize (serialized);
+
+		if (resource) {
+			TrackerExtractInfo *info;
+			GFile *file;
+
+			file = g_file_new_for_uri (task->file);
+			info = tracker_extract_info_new (file, task->mimetype, task->graph);
+			tracker_extract_info_set_resource (info, resource);
+			g_object_unref (resource);
+			g_object_unref (file);
+
+			task->success = TRUE;
+			g_task_return_pointer (G_TASK (task->res), info,
+			                       (GDestroyNotify) tracker_extract_info_unref);
+		} else if (*domain) {
+			g_task_return_new_error (G_TASK (task->res),
+			                         g_quark_from_string (domain),
+			                         code, "%s", message);
+		} else {
+			g_task_return_new_error (G_TASK (task->res),
+			                         tracker_extract_error_quark (),
+			                         TRACKER_EXTRACT_ERROR_NO_EXTRACTOR,
+			                         "Could not get any metadata for uri:'%s' and mime:'%s'",
+			                         task->file, task->mimetype);
+		}
+
+		g_clear_pointer (&serialized, g_variant_unref);
+		g_variant_unref (reply);
+	} else {
+		timed_out = g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+		g_task_return_error (G_TASK (task->res), error);
+	}
+
+	g_mutex_lock (&priv->task_mutex);
+	stats_data = statistics_data_lookup (priv, task->module);
+	stats_data->elapsed += elapsed;
+	stats_data->latency[tracker_latency_bucket (elapsed)]++;
+	stats_data->bytes_read += bytes_read;
+	stats_data->peak_rss_delta = MAX (stats_data->peak_rss_delta, rss_delta);
+	if (timed_out)
+		stats_data->timeout_count++;
+	g_mutex_unlock (&priv->task_mutex);
+
+	tracker_rate_limiter_consume (tracker_rate_limiter_get_default (),
+	                              1, bytes_read);
+
+	g_queue_remove (&priv->busy_workers, worker);
+	tracker_device_scheduler_release (priv->scheduler, task->device);
+
+	if (tracker_extract_worker_is_alive (worker)) {
+		g_queue_push_head (&priv->idle_workers, worker);
+	} else {
+		tracker_extract_worker_free (worker);
+		ensure_spare_worker (extract);
+	}
+
+	extract_task_free (task);
+
+	schedule_worker_tasks (extract);
+}
+
+static void
+run_task_in_worker (TrackerExtractTask *task)
+{
+	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
+	TrackerExtractWorker *worker;
+	GError *error = NULL;
+
+	/* May have been cancelled while waiting */
+	if (g_task_return_error_if_cancelled (G_TASK (task->res))) {
+		tracker_device_scheduler_release (priv->scheduler, task->device);
+		extract_task_free (task);
+		return;
+	}
+
+	worker = g_queue_pop_head (&priv->idle_workers);
+
+	if (!worker) {
+		worker = tracker_extract_worker_new ((const gchar * const *) priv->worker_argv,
+		                                     &error);
+		if (!worker) {
+			tracker_device_scheduler_release (priv->scheduler, task->device);
+			g_task_return_error (G_TASK (task->res), error);
+			extract_task_free (task);
+			return;
+		}
+	}
+
+	g_queue_push_tail (&priv->busy_workers, worker);
+	task->worker = worker;
+	task->start_time = g_get_monotonic_time ();
+
+	tracker_extract_worker_extract_async (worker,
+	                                      task->file,
+	                                      task->mimetype,
+	                                      task->graph,
+	                                      task->content_id,
+	                                      DEADLINE_SECONDS,
+	                                      task->cancellable,
+	                                      worker_extract_cb,
+	                                      task);
+
+	ensure_spare_worker (task->extract);
+}
+
+/* Hands waiting tasks over to workers, taking turns between the
+ * devices that have room for more.
+ */
+static void
+schedule_worker_tasks (TrackerExtract *extract)
+{
+	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+	TrackerExtractTask *task;
+	TrackerDeviceQueue *queue;
+
+	while ((task = tracker_device_scheduler_pop (priv->scheduler, &queue))) {
+		g_object_notify_by_pspec (G_OBJECT (extract), props[PROP_N_WAITING_TASKS]);
+		run_task_in_worker (task);
+	}
+}
+
+/* Runs in the main thread, queues the task on the device holding
+ * the file until a worker process can take it.
+ */
+static void
+dispatch_task_to_worker (TrackerExtractTask *task)
+{
+	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
+	TrackerExtract *extract = task->extract;
+	TrackerDeviceType device_type;
+	const gchar *device;
+	GFile *file;
+
+	if (g_task_return_error_if_cancelled (G_TASK (task->res))) {
+		extract_task_free (task);
+		return;
+	}
+
+	/* Nothing to isolate for the dummy extractor, or for
+	 * modules that are filtered out.
+	 */
+	if (!task->module || filter_module (task->extract, task->module)) {
+		get_metadata (task);
+		return;
+	}
+
+	file = g_file_new_for_uri (task->file);
+	device = tracker_file_get_device (file, &device_type);
+	g_object_unref (file);
+
+	task->device = tracker_device_scheduler_push (priv->scheduler,
+	                                              device, device_type,
+	                                              task);
+	g_object_notify_by_pspec (G_OBJECT (extract), props[PROP_N_WAITING_TASKS]);
+
+	/* May consume the task */
+	schedule_worker_tasks (extract);
+}
+
 /* This function is executed in the main thread, decides the
  * module that's going to be run for a given task, and dispatches
  * the task according to the threading strategy of that module.
@@ -556,6 +1067,7 @@ dispatch_task_cb (TrackerExtractTask *task)
 	TrackerExtractPrivate *priv;
 	GError *error = NULL;
 	GAsyncQueue *async_queue;
+	gint64 delay;
 
 #ifdef THREAD_ENABLE_TRACE
 	g_debug ("Thread:%p (Main) <-- '%s': Handling task...\n",
@@ -565,6 +1077,14 @@ dispatch_task_cb (TrackerExtractTask *task)
 
 	priv = TRACKER_EXTRACT_GET_PRIVATE (task->extract);
 
+	delay = tracker_rate_limiter_get_delay (tracker_rate_limiter_get_default ());
+
+	if (delay > 0) {
+		/* Over the I/O budget, start once there is room */
+		g_timeout_add (delay / 1000 + 1, (GSourceFunc) dispatch_task_cb, task);
+		return FALSE;
+	}
+
 	task->graph = tracker_extract_module_manager_get_graph (task->mimetype);
 	if (!task->graph) {
 		g_task_return_new_error (G_TASK (task->res),
@@ -589,6 +1109,11 @@ dispatch_task_cb (TrackerExtractTask *task)
 		                                                          &task->func);
 	}
 
+	if (priv->worker_argv) {
+		dispatch_task_to_worker (task);
+		return FALSE;
+	}
+
 	async_queue = g_hash_table_lookup (priv->single_thread_extractors,
 	                                   task->module);
 
@@ -625,6 +1150,7 @@ void
 tracker_extract_file (TrackerExtract      *extract,
                       const gchar         *file,
                       const gchar         *mimetype,
+                      const gchar         *content_id,
                       GCancellable        *cancellable,
                       GAsyncReadyCallback  cb,
                       gpointer             user_data)
@@ -645,7 +1171,7 @@ tracker_extract_file (TrackerExtract      *extract,
 
 	async_task = g_task_new (extract, cancellable, cb, user_data);
 
-	task = extract_task_new (extract, file, mimetype, cancellable,
+	task = extract_task_new (extract, file, mimetype, content_id, cancellable,
 	                         G_ASYNC_RESULT (async_task), &error);
 
 	if (error) {
@@ -688,7 +1214,7 @@ tracker_extract_get_metadata_by_cmdline (TrackerExtract             *object,
 
 	g_return_if_fail (uri != NULL);
 
-	task = extract_task_new (object, uri, mime, NULL, NULL, &error);
+	task = extract_task_new (object, uri, mime, NULL, NULL, NULL, &error);
 
 	if (error) {
 		g_printerr ("%s, %s\n",
@@ -788,3 +1314,269 @@ tracker_extract_file_finish (TrackerExtract  *extract,
 
 	return g_task_propagate_pointer (G_TASK (res), error);
 }
+
+static gsize
+report_worker_memory (gpointer user_data)
+{
+	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (user_data);
+	gsize total;
+	GList *l;
+
+	total = tracker_device_scheduler_get_n_waiting (priv->scheduler) *
+		ESTIMATED_TASK_SIZE;
+
+	for (l = priv->idle_workers.head; l; l = l->next)
+		total += tracker_extract_worker_get_rss (l->data);
+	for (l = priv->busy_workers.head; l; l = l->next)
+		total += tracker_extract_worker_get_rss (l->data);
+
+	return total;
+}
+
+static void
+shed_worker_memory (TrackerMemoryBudgetState state,
+                    gpointer                 user_data)
+{
+	TrackerExtractPrivate *priv = TRACKER_EXTRACT_GET_PRIVATE (user_data);
+
+	/* Idle workers are respawned on demand */
+	g_queue_foreach (&priv->idle_workers, (GFunc) tracker_extract_worker_free, NULL);
+	g_queue_clear (&priv->idle_workers);
+}
+
+/**
+ * tracker_extract_get_n_waiting_tasks:
+ * @extract: a #TrackerExtract
+ *
+ * Returns the number of files waiting for their device to have
+ * room for another worker. Must be called from the main thread.
+ *
+ * Returns: the number of waiting files
+ **/
+guint
+tracker_extract_get_n_waiting_tasks (TrackerExtract *extract)
+{
+	TrackerExtractPrivate *priv;
+
+	g_return_val_if_fail (TRACKER_IS_EXTRACT (extract), 0);
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+
+	return tracker_device_scheduler_get_n_waiting (priv->scheduler);
+}
+
+/**
+ * tracker_extract_get_n_busy_devices:
+ * @extract: a #TrackerExtract
+ *
+ * Returns the number of devices that files are being extracted
+ * from. Must be called from the main thread.
+ *
+ * Returns: the number of busy devices
+ **/
+guint
+tracker_extract_get_n_busy_devices (TrackerExtract *extract)
+{
+	TrackerExtractPrivate *priv;
+
+	g_return_val_if_fail (TRACKER_IS_EXTRACT (extract), 0);
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+
+	return tracker_device_scheduler_get_n_busy_devices (priv->scheduler);
+}
+
+/**
+ * tracker_extract_start_workers:
+ * @extract: a #TrackerExtract
+ * @argv: command line to spawn a worker process
+ *
+ * Makes @extract run modules in separate worker processes that
+ * serve requests through tracker_extract_run_worker(). A worker
+ * that crashes or takes longer than the deadline only fails the
+ * file it was handling. Must be called from the main thread.
+ **/
+void
+tracker_extract_start_workers (TrackerExtract      *extract,
+                               const gchar * const *argv)
+{
+	TrackerExtractPrivate *priv;
+
+	g_return_if_fail (TRACKER_IS_EXTRACT (extract));
+	g_return_if_fail (argv != NULL && argv[0] != NULL);
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+	g_return_if_fail (priv->worker_argv == NULL);
+
+	priv->worker_argv = g_strdupv ((GStrv) argv);
+	priv->budget_id =
+		tracker_memory_budget_register (tracker_memory_budget_get_default (),
+		                                "extract-workers",
+		                                report_worker_memory,
+		                                shed_worker_memory,
+		                                extract);
+	ensure_spare_worker (extract);
+}
+
+/**
+ * tracker_extract_run_worker:
+ * @extract: a #TrackerExtract
+ * @fd: socket connected to the parent process
+ *
+ * Serves extraction requests coming through @fd until the
+ * parent closes the connection. Runs in worker processes.
+ *
+ * Returns: exit status for the worker process
+ **/
+gint
+tracker_extract_run_worker (TrackerExtract *extract,
+                            gint            fd)
+{
+	GVariant *request;
+	GError *error = NULL;
+
+	g_return_val_if_fail (TRACKER_IS_EXTRACT (extract), EXIT_FAILURE);
+
+	if (!tracker_seccomp_init ())
+		g_assert_not_reached ();
+
+	while ((request = tracker_extract_worker_read_message (fd,
+	                                                       G_VARIANT_TYPE (TRACKER_EXTRACT_WORKER_REQUEST_TYPE),
+	                                                       &error)) != NULL) {
+		TrackerExtractTask *task;
+		TrackerExtractInfo *info;
+		GVariant *serialized = NULL;
+		GError *extract_error = NULL;
+		const gchar *uri, *mimetype, *graph, *content_id;
+		guint64 start_bytes_read, start_max_rss, bytes_read, max_rss;
+		gboolean sent;
+
+		g_variant_get (request, "(&s&s&s&s)", &uri, &mimetype, &graph, &content_id);
+		get_usage (TRUE, &start_bytes_read, &start_max_rss);
+
+		task = extract_task_new (extract, uri, mimetype,
+		                         *content_id ? content_id : NULL,
+		                         NULL, NULL, &extract_error);
+
+		if (task) {
+			task->graph = graph;
+			task->module = tracker_extract_module_manager_get_module (task->mimetype,
+			                                                          NULL,
+			                                                          &task->func);
+
+			if (!filter_module (extract, task->module) &&
+			    get_file_metadata (task, &info, &extract_error)) {
+				serialized = tracker_resource_serialize (tracker_extract_info_get_resource (info));
+				if (serialized)
+					g_variant_ref_sink (serialized);
+				tracker_extract_info_unref (info);
+			}
+
+			extract_task_free (task);
+		}
+
+		get_usage (TRUE, &bytes_read, &max_rss);
+
+		sent = tracker_extract_worker_write_message (fd,
+		                                             g_variant_new (TRACKER_EXTRACT_WORKER_REPLY_TYPE,
+		                                                            serialized != NULL,
+		                                                            serialized,
+		                                                            extract_error ? g_quark_to_string (extract_error->domain) : "",
+		                                                            extract_error ? extract_error->code : 0,
+		                                                            extract_error ? extract_error->message : "",
+		                                                            bytes_read - start_bytes_read,
+		                                                            max_rss - start_max_rss),
+		                                             &error);
+
+		g_clear_pointer (&serialized, g_variant_unref);
+		g_clear_error (&extract_error);
+		g_variant_unref (request);
+
+		if (!sent)
+			break;
+	}
+
+	if (error) {
+		g_warning ("Extraction worker failed: %s", error->message);
+		g_error_free (error);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static GVariant *
+statistics_data_to_variant (StatisticsData *data)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "calls",
+	                       g_variant_new_uint32 (data->extracted_count));
+	g_variant_builder_add (&builder, "{sv}", "successes",
+	                       g_variant_new_uint32 (data->extracted_count - data->failed_count));
+	g_variant_builder_add (&builder, "{sv}", "failures",
+	                       g_variant_new_uint32 (data->failed_count));
+	g_variant_builder_add (&builder, "{sv}", "timeouts",
+	                       g_variant_new_uint32 (data->timeout_count));
+	g_variant_builder_add (&builder, "{sv}", "elapsed",
+	                       g_variant_new_double ((gdouble) data->elapsed / G_USEC_PER_SEC));
+	g_variant_builder_add (&builder, "{sv}", "latency",
+	                       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+	                                                  data->latency,
+	                                                  TRACKER_LATENCY_N_BUCKETS,
+	                                                  sizeof (guint64)));
+	g_variant_builder_add (&builder, "{sv}", "bytes-read",
+	                       g_variant_new_uint64 (data->bytes_read));
+	g_variant_builder_add (&builder, "{sv}", "peak-rss-delta",
+	                       g_variant_new_uint64 (data->peak_rss_delta));
+
+	return g_variant_builder_end (&builder);
+}
+
+/* Returns a floating a{sv} with per-module counters, keyed by
+ * module file name, and the extractor queue depth.
+ */
+GVariant *
+tracker_extract_get_metrics (TrackerExtract *extract)
+{
+	TrackerExtractPrivate *priv;
+	GVariantBuilder builder, modules;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_return_val_if_fail (TRACKER_IS_EXTRACT (extract), NULL);
+
+	priv = TRACKER_EXTRACT_GET_PRIVATE (extract);
+
+	g_mutex_lock (&priv->task_mutex);
+
+	g_variant_builder_init (&modules, G_VARIANT_TYPE ("a{sv}"));
+	g_hash_table_iter_init (&iter, priv->statistics_data);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GModule *module = key;
+		const gchar *name;
+
+		if (!module)
+			continue;
+
+		name = strrchr (g_module_name (module), G_DIR_SEPARATOR) + 1;
+		g_variant_builder_add (&modules, "{sv}", name,
+		                       statistics_data_to_variant (value));
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "modules",
+	                       g_variant_builder_end (&modules));
+	g_variant_builder_add (&builder, "{sv}", "unhandled",
+	                       g_variant_new_uint32 (priv->unhandled_count));
+	g_variant_builder_add (&builder, "{sv}", "queue-depth",
+	                       g_variant_new_uint32 (g_list_length (priv->running_tasks)));
+	g_variant_builder_add (&builder, "{sv}", "waiting-for-device",
+	                       g_variant_new_uint32 (tracker_device_scheduler_get_n_waiting (priv->scheduler)));
+
+	g_mutex_unlock (&priv->task_mutex);
+
+	return g_variant_builder_end (&builder);
+}
@@ -63,6 +63,7 @@ TrackerExtract *tracker_extract_new                     (gboolean
 void            tracker_extract_file                    (TrackerExtract         *extract,
                                                          const gchar            *file,
                                                          const gchar            *mimetype,
+                                                         const gchar            *content_id,
                                                          GCancellable           *cancellable,
                                                          GAsyncReadyCallback     cb,
                                                          gpointer                user_data);
@@ -71,6 +72,8 @@ TrackerExtractInfo *
                                                          GAsyncResult           *res,
                                                          GError                **error);
 
+GVariant *      tracker_extract_get_metrics             (TrackerExtract         *extract);
+
 void            tracker_extract_dbus_start              (TrackerExtract         *extract);
 void            tracker_extract_dbus_stop               (TrackerExtract         *extract);
 
@@ -80,6 +83,16 @@ void            tracker_extract_get_metadata_by_cmdline (TrackerExtract
                                                          const gchar                *mime,
                                                          TrackerSerializationFormat  output_format);
 
+void            tracker_extract_start_workers           (TrackerExtract             *extract,
+                                                         const gchar * const        *argv);
+gint            tracker_extract_run_worker              (TrackerExtract             *extract,
+                                                         gint                        fd);
+guint           tracker_extract_get_n_waiting_tasks     (TrackerExtract             *extract);
+guint           tracker_extract_get_n_busy_devices      (TrackerExtract             *extract);
+void            tracker_extract_readahead               (TrackerExtract             *extract,
+                                                         const gchar                *uri,
+                                                         const gchar                *mimetype);
+
 G_END_DECLS
 
 #endif /* __TRACKERD_EXTRACT_H__ */
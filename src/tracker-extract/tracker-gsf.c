@@ -23,6 +23,7 @@
 /* Avoid warnings about deprecated GParameter from gsf headers */
 #define GLIB_VERSION_MIN_REQUIRED GLIB_VERSION_2_40
 #include <glib.h>
+#include <gio/gio.h>
 
 #include <libtracker-miners-common/tracker-file-utils.h>
 
@@ -38,141 +39,296 @@
 /* Note: 20 MBytes of max size is really assumed to be a safe limit. */
 #define XML_MAX_BYTES_READ         (20u << 20)  /* bytes */
 
-/**
- * based on find_member() from vsd_utils.c:
- * http://vsdump.sourcearchive.com/documentation/0.0.44/vsd__utils_8c-source.html
+/* A directory inside the archive, children are indexed by name so
+ * looking up a member does not walk the central directory again.
  */
+typedef struct {
+	GsfInfile *infile;
+	GHashTable *children; /* name -> index + 1 */
+} ZipDir;
+
+struct _TrackerGsfZip {
+	gchar *uri;
+	FILE *file;
+	GsfInput *src;
+	GHashTable *dirs; /* path -> ZipDir */
+	gsize bytes_remaining;
+};
+
+static ZipDir *
+zip_dir_new (GsfInfile *infile)
+{
+	ZipDir *dir;
+	gint i, n_children;
+
+	dir = g_slice_new0 (ZipDir);
+	dir->infile = infile;
+	dir->children = g_hash_table_new (g_str_hash, g_str_equal);
+
+	n_children = gsf_infile_num_children (infile);
+
+	for (i = 0; i < n_children; i++) {
+		const gchar *name;
+
+		/* Names are owned by the infile, which outlives the table */
+		name = gsf_infile_name_by_index (infile, i);
+		if (name)
+			g_hash_table_insert (dir->children, (gpointer) name,
+			                     GINT_TO_POINTER (i + 1));
+	}
+
+	return dir;
+}
+
+static void
+zip_dir_free (ZipDir *dir)
+{
+	g_hash_table_unref (dir->children);
+	g_object_unref (dir->infile);
+	g_slice_free (ZipDir, dir);
+}
+
 static GsfInput *
-find_member (GsfInfile *arch,
-             gchar const *name)
+zip_dir_get_child (ZipDir      *dir,
+                   const gchar *name)
 {
-	gchar const *slash;
+	gint index;
+
+	index = GPOINTER_TO_INT (g_hash_table_lookup (dir->children, name));
+	if (index == 0)
+		return NULL;
+
+	return gsf_infile_child_by_index (dir->infile, index - 1);
+}
+
+static ZipDir *
+lookup_dir (TrackerGsfZip  *zip,
+            ZipDir         *parent,
+            const gchar    *path,
+            const gchar    *name)
+{
+	GsfInput *member;
+	ZipDir *dir;
+
+	dir = g_hash_table_lookup (zip->dirs, path);
+	if (dir)
+		return dir;
 
-	slash = strchr (name, '/');
+	member = zip_dir_get_child (parent, name);
+	if (!member)
+		return NULL;
 
-	if (slash) {
-		gchar *dirname;
-		GsfInput *member;
+	if (!GSF_IS_INFILE (member) ||
+	    gsf_infile_num_children (GSF_INFILE (member)) < 0) {
+		g_object_unref (member);
+		return NULL;
+	}
 
-		dirname = g_strndup (name, slash - name);
+	dir = zip_dir_new (GSF_INFILE (member));
+	g_hash_table_insert (zip->dirs, g_strdup (path), dir);
 
-		/**
-		 * Ignore if the directory is the current one that is ".".
-		 * Go to next direcotry if exists
-		 */
+	return dir;
+}
 
-		if (strcmp (dirname, ".") == 0) {
-			member = find_member (arch, slash + 1);
-		} else if ((member = gsf_infile_child_by_name (arch, dirname)) != NULL) {
-			GsfInfile *dir;
+static GsfInput *
+find_member (TrackerGsfZip *zip,
+             const gchar   *name)
+{
+	GsfInput *member = NULL;
+	GString *path;
+	ZipDir *dir;
+	gchar **components;
+	guint i, n_components;
 
-			dir = GSF_INFILE (member);
-			member = find_member (dir, slash + 1);
-			g_object_unref (dir);
+	dir = g_hash_table_lookup (zip->dirs, "");
+	components = g_strsplit (name, "/", -1);
+	n_components = g_strv_length (components);
+	path = g_string_new (NULL);
+
+	for (i = 0; dir && i < n_components; i++) {
+		/* Ignore the current directory, and empty components */
+		if (components[i][0] == '\0' ||
+		    strcmp (components[i], ".") == 0)
+			continue;
+
+		if (i == n_components - 1) {
+			member = zip_dir_get_child (dir, components[i]);
+			break;
 		}
 
-		g_free (dirname);
-		return member;
-	} else {
-		return gsf_infile_child_by_name (arch, name);
+		if (path->len > 0)
+			g_string_append_c (path, '/');
+		g_string_append (path, components[i]);
+
+		dir = lookup_dir (zip, dir, path->str, components[i]);
 	}
+
+	g_string_free (path, TRUE);
+	g_strfreev (components);
+
+	return member;
 }
 
 /**
- * tracker_gsf_parse_xml_in_zip:
+ * tracker_gsf_zip_open:
  * @zip_file_uri: URI of the ZIP archive
+ * @error: return location for a #GError
+ *
+ * Opens a ZIP compressed archive, its central directory is read once
+ * and shared by all XML files parsed through the returned handle.
+ *
+ * Returns: a new #TrackerGsfZip, or %NULL on error. Free it with
+ * tracker_gsf_zip_close().
+ */
+TrackerGsfZip *
+tracker_gsf_zip_open (const gchar  *zip_file_uri,
+                      GError      **error)
+{
+	TrackerGsfZip *zip;
+	GsfInfile *infile;
+	GError *inner_error = NULL;
+	gchar *filename;
+
+	/* Get filename from the given URI */
+	filename = g_filename_from_uri (zip_file_uri, NULL, error);
+	if (!filename)
+		return NULL;
+
+	zip = g_slice_new0 (TrackerGsfZip);
+	zip->uri = g_strdup (zip_file_uri);
+	zip->bytes_remaining = XML_MAX_BYTES_READ;
+	zip->dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                   (GDestroyNotify) zip_dir_free);
+
+	zip->file = tracker_file_open (filename);
+	if (!zip->file) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+		             "Can't open file from uri '%s': %s",
+		             zip_file_uri, g_strerror (errno));
+		goto fail;
+	}
+
+	/* Create a new Input GSF object for the given file */
+	zip->src = gsf_input_stdio_new_FILE (filename, zip->file, TRUE);
+	if (!zip->src) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		             "Failed creating a GSF Input object for '%s'",
+		             zip_file_uri);
+		goto fail;
+	}
+
+	/* Input object is a Zip file */
+	infile = gsf_infile_zip_new (zip->src, &inner_error);
+	if (!infile) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+		             "'%s' Not a zip file: %s", zip_file_uri,
+		             inner_error ? inner_error->message : "no error given");
+		g_clear_error (&inner_error);
+		goto fail;
+	}
+
+	g_hash_table_insert (zip->dirs, g_strdup (""), zip_dir_new (infile));
+	g_free (filename);
+
+	return zip;
+
+fail:
+	g_free (filename);
+	tracker_gsf_zip_close (zip);
+
+	return NULL;
+}
+
+/**
+ * tracker_gsf_zip_close:
+ * @zip: a #TrackerGsfZip
+ *
+ * Closes the archive and frees @zip.
+ */
+void
+tracker_gsf_zip_close (TrackerGsfZip *zip)
+{
+	g_hash_table_unref (zip->dirs);
+	g_clear_object (&zip->src);
+
+	if (zip->file)
+		tracker_file_close (zip->file, FALSE);
+
+	g_free (zip->uri);
+	g_slice_free (TrackerGsfZip, zip);
+}
+
+/**
+ * tracker_gsf_zip_get_bytes_remaining:
+ * @zip: a #TrackerGsfZip
+ *
+ * Returns: the number of uncompressed bytes that may still be read
+ * from the XML files in @zip.
+ */
+gsize
+tracker_gsf_zip_get_bytes_remaining (TrackerGsfZip *zip)
+{
+	return zip->bytes_remaining;
+}
+
+/**
+ * tracker_gsf_zip_parse_xml:
+ * @zip: a #TrackerGsfZip
  * @xml_filename: Name of the XML file stored inside the ZIP archive
  * @context: Markup context to be used when parsing the XML
+ * @error: return location for a #GError
  *
  * This function reads and parses the contents of an XML file stored
- *  inside a ZIP compressed archive. Reading and parsing is done buffered, and
- *  maximum size of the uncompressed XML file is limited to be to 20MBytes.
+ *  inside the ZIP archive. Reading and parsing is done buffered, and
+ *  all XML files parsed from @zip share a maximum of 20MBytes of
+ *  uncompressed data.
  */
 void
-tracker_gsf_parse_xml_in_zip (const gchar          *zip_file_uri,
-                              const gchar          *xml_filename,
-                              GMarkupParseContext  *context,
-                              GError              **err)
+tracker_gsf_zip_parse_xml (TrackerGsfZip        *zip,
+                           const gchar          *xml_filename,
+                           GMarkupParseContext  *context,
+                           GError              **err)
 {
-	gchar *filename;
 	GError *error = NULL;
-	GsfInfile *infile = NULL;
-	GsfInput *src = NULL;
-	GsfInput *member = NULL;
-	FILE *file;
+	GsfInput *member;
+	guint8 buf[XML_BUFFER_SIZE];
+	size_t remaining_size, chunk_size;
 
 	g_debug ("Parsing '%s' XML file contained inside zip archive...",
 	         xml_filename);
 
-	/* Get filename from the given URI */
-	if ((filename = g_filename_from_uri (zip_file_uri,
-	                                     NULL, &error)) == NULL) {
-		g_warning ("Can't get filename from uri '%s': %s",
-		           zip_file_uri, error ? error->message : "no error given");
-	} else { /* Create a new Input GSF object for the given file */
-
-		file = tracker_file_open (filename);
-		if (!file) {
-			g_warning ("Can't open file from uri '%s': %s",
-			           zip_file_uri, g_strerror (errno));
-		} else if ((src = gsf_input_stdio_new_FILE (filename, file, TRUE)) == NULL) {
-			g_warning ("Failed creating a GSF Input object for '%s': %s",
-			           zip_file_uri, error ? error->message : "no error given");
-		}
-		/* Input object is a Zip file */
-		else if ((infile = gsf_infile_zip_new (src, &error)) == NULL) {
-			g_warning ("'%s' Not a zip file: %s",
-			           zip_file_uri, error ? error->message : "no error given");
-		}
-		/* Look for requested filename inside the ZIP file */
-		else if ((member = find_member (infile, xml_filename)) == NULL) {
-			g_warning ("No member '%s' in zip file '%s'",
-			           xml_filename, zip_file_uri);
-		}
-		/* Load whole contents of the internal file in the xml buffer */
-		else {
-			guint8 buf[XML_BUFFER_SIZE];
-			size_t remaining_size, chunk_size, accum;
-
-			/* Get whole size of the contents to read */
-			remaining_size = (size_t) gsf_input_size (GSF_INPUT (member));
-
-			/* Note that gsf_input_read() needs to be able to read ALL specified
-			 *  number of bytes, or it will fail */
-			chunk_size = MIN (remaining_size, XML_BUFFER_SIZE);
-
-			accum = 0;
-			while (!error &&
-			       accum  <= XML_MAX_BYTES_READ &&
-			       chunk_size > 0 &&
-			       gsf_input_read (GSF_INPUT (member), chunk_size, buf) != NULL) {
-
-				/* update accumulated count */
-				accum += chunk_size;
-
-				/* Pass the read stream to the context parser... */
-				g_markup_parse_context_parse (context, buf, chunk_size, &error);
-
-				/* update bytes to be read */
-				remaining_size -= chunk_size;
-				chunk_size = MIN (remaining_size, XML_BUFFER_SIZE);
-			}
-		}
+	/* Look for requested filename inside the ZIP file */
+	member = find_member (zip, xml_filename);
+	if (!member) {
+		g_warning ("No member '%s' in zip file '%s'",
+		           xml_filename, zip->uri);
+		return;
+	}
 
-		if (file) {
-			tracker_file_close (file, FALSE);
-		}
+	/* Get whole size of the contents to read */
+	remaining_size = (size_t) gsf_input_size (member);
+
+	/* Note that gsf_input_read() needs to be able to read ALL specified
+	 *  number of bytes, or it will fail */
+	chunk_size = MIN (remaining_size, XML_BUFFER_SIZE);
+
+	while (!error &&
+	       zip->bytes_remaining > 0 &&
+	       chunk_size > 0 &&
+	       gsf_input_read (member, chunk_size, buf) != NULL) {
+		/* update shared byte budget */
+		zip->bytes_remaining -= MIN (chunk_size, zip->bytes_remaining);
+
+		/* Pass the read stream to the context parser... */
+		g_markup_parse_context_parse (context, (const gchar *) buf, chunk_size, &error);
+
+		/* update bytes to be read */
+		remaining_size -= chunk_size;
+		chunk_size = MIN (remaining_size, XML_BUFFER_SIZE);
 	}
 
-	g_free (filename);
+	g_object_unref (member);
 
 	if (error)
 		g_propagate_error (err, error);
-	if (infile)
-		g_object_unref (infile);
-	if (src)
-		g_object_unref (src);
-	if (member)
-		g_object_unref (member);
 }
-
@@ -24,10 +24,18 @@
 
 G_BEGIN_DECLS
 
-void tracker_gsf_parse_xml_in_zip (const gchar          *zip_file_uri,
-                                   const gchar          *xml_filename,
-                                   GMarkupParseContext  *context,
-                                   GError              **error);
+typedef struct _TrackerGsfZip TrackerGsfZip;
+
+TrackerGsfZip *tracker_gsf_zip_open  (const gchar          *zip_file_uri,
+                                      GError              **error);
+void           tracker_gsf_zip_close (TrackerGsfZip        *zip);
+
+gsize tracker_gsf_zip_get_bytes_remaining (TrackerGsfZip *zip);
+
+void tracker_gsf_zip_parse_xml (TrackerGsfZip        *zip,
+                                const gchar          *xml_filename,
+                                GMarkupParseContext  *context,
+                                GError              **error);
 
 G_END_DECLS
 
@@ -45,6 +45,7 @@
 #include "tracker-extract.h"
 #include "tracker-extract-controller.h"
 #include "tracker-extract-decorator.h"
+#include "tracker-extract-worker.h"
 
 #ifdef THREAD_ENABLE_TRACE
 #warning Main thread traces enabled
@@ -71,6 +72,7 @@ static gchar *mime_type;
 static gchar *force_module;
 static gchar *output_format_name;
 static gboolean version;
+static gboolean worker;
 static gchar *domain_ontology_name = NULL;
 static guint shutdown_timeout_id = 0;
 
@@ -100,6 +102,9 @@ static GOptionEntry entries[] = {
 	  G_OPTION_ARG_NONE, &version,
 	  N_("Displays version information"),
 	  NULL },
+	{ "worker", 0, G_OPTION_FLAG_HIDDEN,
+	  G_OPTION_ARG_NONE, &worker,
+	  NULL, NULL },
 	{ NULL }
 };
 
@@ -236,6 +241,60 @@ run_standalone (TrackerConfig *config)
 	return EXIT_SUCCESS;
 }
 
+/* Serves extraction requests from the daemon, see
+ * tracker_extract_start_workers().
+ */
+static int
+run_worker (void)
+{
+	TrackerExtract *object;
+	gint retval;
+
+	tracker_locale_sanity_check ();
+	tracker_content_identifier_cache_init ();
+
+	/* Extractors get their settings through tracker_main_get_config() */
+	config = tracker_config_new ();
+
+	object = tracker_extract_new (TRUE, force_module);
+
+	if (!object) {
+		g_object_unref (config);
+		return EXIT_FAILURE;
+	}
+
+	tracker_module_manager_load_modules ();
+
+	retval = tracker_extract_run_worker (object, TRACKER_EXTRACT_WORKER_FD);
+
+	g_object_unref (object);
+	g_object_unref (config);
+
+	return retval;
+}
+
+/* Run modules in worker processes, so a file that crashes
+ * or hangs an extractor does not take the daemon with it.
+ */
+static void
+start_workers (TrackerExtract *extract)
+{
+	const gchar *worker_argv[7] = { "/proc/self/exe", "--worker", NULL, };
+	gint n_args = 2;
+
+	if (domain_ontology_name) {
+		worker_argv[n_args++] = "--domain-ontology";
+		worker_argv[n_args++] = domain_ontology_name;
+	}
+
+	if (force_module) {
+		worker_argv[n_args++] = "--force-module";
+		worker_argv[n_args++] = force_module;
+	}
+
+	tracker_extract_start_workers (extract, worker_argv);
+}
+
 static void
 on_domain_vanished (GDBusConnection *connection,
                     const gchar     *name,
@@ -383,6 +442,12 @@ main (int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	/* Workers don't talk to anything but the daemon */
+	if (worker) {
+		tracker_domain_ontology_unref (domain_ontology);
+		return run_worker ();
+	}
+
 	connection = g_bus_get_sync (TRACKER_IPC_BUS, NULL, &error);
 	if (error) {
 		g_critical ("Could not create DBus connection: %s\n",
@@ -415,6 +480,7 @@ main (int argc, char *argv[])
 	}
 
 	tracker_module_manager_load_modules ();
+	start_workers (extract);
 
 	miner_dbus_name = tracker_domain_ontology_get_domain (domain_ontology,
 	                                                      MINER_FS_NAME_SUFFIX);
@@ -19,6 +19,7 @@
 
 #include "config-miners.h"
 
+#include <errno.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -34,6 +35,38 @@
 /* Size of the buffer to use when reading, in bytes */
 #define BUFFER_SIZE 65535
 
+/* Size of the prefix used to rule out encodings, in bytes. Even, so
+ * UTF-16 is not cut in half.
+ */
+#define SAMPLE_SIZE 4096
+
+static gboolean
+sample_converts (const gchar *str,
+                 gsize        str_len,
+                 const gchar *encoding)
+{
+	GError *error = NULL;
+	gchar *utf8_str;
+
+	if (str_len <= SAMPLE_SIZE)
+		return TRUE;
+
+	utf8_str = g_convert (str, SAMPLE_SIZE, "UTF-8", encoding,
+	                      NULL, NULL, &error);
+	g_free (utf8_str);
+
+	/* A character cut by the end of the sample is fine */
+	if (!error ||
+	    g_error_matches (error, G_CONVERT_ERROR, G_CONVERT_ERROR_PARTIAL_INPUT)) {
+		g_clear_error (&error);
+		return TRUE;
+	}
+
+	g_error_free (error);
+
+	return FALSE;
+}
+
 static gchar *
 get_string_from_guessed_encoding (const gchar *str,
                                   gsize        str_len,
@@ -50,17 +83,21 @@ get_string_from_guessed_encoding (const gchar *str,
 		current = "windows-1252";
 
 	while (current) {
-		gchar *utf8_str;
+		gchar *utf8_str = NULL;
 		gsize bytes_read = 0;
 		gsize bytes_written = 0;
 
-		utf8_str = g_convert (str,
-		                      str_len,
-		                      "UTF-8",
-		                      current,
-		                      &bytes_read,
-		                      &bytes_written,
-		                      NULL);
+		/* Only convert the whole string if the sample converts */
+		if (sample_converts (str, str_len, current)) {
+			utf8_str = g_convert (str,
+			                      str_len,
+			                      "UTF-8",
+			                      current,
+			                      &bytes_read,
+			                      &bytes_written,
+			                      NULL);
+		}
+
 		if (utf8_str &&
 		    str_len == bytes_read) {
 			g_debug ("Converted %" G_GSIZE_FORMAT " bytes in '%s' codeset "
@@ -114,27 +151,13 @@ process_chunk (const gchar  *read_bytes,
 	 * UTF-16LE), so we can't rely on methods which assume
 	 * NUL-terminated strings, as g_strstr_len().
 	 */
-	if (s->len == 0) {
-		if (read_size == buffer_size) {
-			const gchar *i;
-			gboolean eol_found = FALSE;
-
-			i = read_bytes;
-			while (i != &read_bytes[read_size - 1]) {
-				if (*i == '\n') {
-					eol_found = TRUE;
-					break;
-				}
-				i++;
-			}
-
-			if (!eol_found) {
-				g_debug ("  No '\\n' in the first %" G_GSSIZE_FORMAT " bytes, "
-				         "not indexing file",
-				         read_size);
-				return FALSE;
-			}
-		}
+	if (s->len == 0 &&
+	    read_size == buffer_size &&
+	    !memchr (read_bytes, '\n', read_size - 1)) {
+		g_debug ("  No '\\n' in the first %" G_GSSIZE_FORMAT " bytes, "
+		         "not indexing file",
+		         read_size);
+		return FALSE;
 	}
 
 	/* Update remaining bytes */
@@ -146,8 +169,11 @@ process_chunk (const gchar  *read_bytes,
 	         read_size,
 	         *remaining_size);
 
-	/* Append non-NIL terminated bytes */
-	g_string_append_len (s, read_bytes, read_size);
+	/* Append non-NIL terminated bytes, unless they were read in place */
+	if (read_bytes != &s->str[s->len])
+		g_string_append_len (s, read_bytes, read_size);
+	else
+		g_string_set_size (s, s->len + read_size);
 
 	return TRUE;
 }
@@ -313,8 +339,8 @@ tracker_read_text_from_stream (GInputStream *stream,
  * @fd: input fd to read from
  * @max_bytes: max number of bytes to read from @fd
  *
- * Reads up to @max_bytes from @fd, and validates the read text as proper
- *  UTF-8. Will also properly close the FD when finishes.
+ * Reads up to @max_bytes from the beginning of @fd, and validates the read
+ *  text as proper UTF-8. Will also properly close the FD when finishes.
  *
  * If the input text is not UTF-8 it will also try to decode it based on the
  * current locale, or windows-1252, or UTF-16.
@@ -326,18 +352,10 @@ tracker_read_text_from_fd (gint     fd,
                            gsize    max_bytes,
                            GError **error)
 {
-	FILE *fz;
 	GString *s;
 	gsize n_bytes_remaining = max_bytes;
 
-	if ((fz = fdopen (fd, "r")) == NULL) {
-		g_set_error (error, TRACKER_EXTRACT_ERROR, TRACKER_EXTRACT_ERROR_IO_ERROR,
-		             "Cannot read from file so could not extract text.");
-		close (fd);
-		return NULL;
-	}
-
-	s = g_string_new ("");
+	s = g_string_sized_new (MIN (BUFFER_SIZE, max_bytes));
 
 	/* Reading in chunks of BUFFER_SIZE
 	 *   Loop is halted whenever one of this conditions is met:
@@ -348,17 +366,28 @@ tracker_read_text_from_fd (gint     fd,
 	 *     e) Stream has a single line of BUFFER_SIZE bytes with no EOL
 	 */
 	while (n_bytes_remaining > 0) {
-		gchar buf[BUFFER_SIZE];
-		gsize n_bytes_read;
+		gsize n_bytes_wanted, len;
+		gssize n_bytes_read;
 
-		/* Read bytes */
-		n_bytes_read = fread (buf,
-		                      1,
-		                      MIN (BUFFER_SIZE, n_bytes_remaining),
-		                      fz);
+		n_bytes_wanted = MIN (BUFFER_SIZE, n_bytes_remaining);
+		len = s->len;
+
+		/* Read straight into the string, past its current end */
+		g_string_set_size (s, len + n_bytes_wanted);
+		g_string_truncate (s, len);
+
+		n_bytes_read = pread (fd, &s->str[len], n_bytes_wanted, len);
+
+		if (n_bytes_read < 0) {
+			if (errno == EINTR)
+				continue;
+
+			g_debug ("  Could not read from file: %s", g_strerror (errno));
+			break;
+		}
 
 		/* Process read bytes, and halt loop if needed */
-		if (!process_chunk (buf,
+		if (!process_chunk (&s->str[len],
 		                    n_bytes_read,
 		                    BUFFER_SIZE,
 		                    &n_bytes_remaining,
@@ -372,7 +401,7 @@ tracker_read_text_from_fd (gint     fd,
 	if (posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED) != 0)
 		g_warning ("posix_fadvise() call failed: %m");
 #endif /* HAVE_POSIX_FADVISE */
-	fclose (fz);
+	close (fd);
 
 	/* Validate UTF-8 if something was read, and return it */
 	return process_whole_string (s, error);
@@ -43,3 +43,33 @@ tracker_test_helpers_free_nonutf8 (void)
 		nonutf8_str = NULL;
 	}
 }
+
+/* Size of the text used in performance tests */
+#define PERF_TEXT_SIZE (32 << 20)
+
+/* Returns PERF_TEXT_SIZE bytes of @line repeated, with @other_line
+ * after every 16 of them. Returns %NULL and skips the test unless
+ * running in performance mode.
+ */
+GString *
+tracker_test_helpers_get_perf_text (const gchar *line,
+                                    const gchar *other_line)
+{
+	GString *text;
+	gint i;
+
+	if (!g_test_perf ()) {
+		g_test_skip ("Only run in performance mode (-m perf)");
+		return NULL;
+	}
+
+	text = g_string_sized_new (PERF_TEXT_SIZE);
+
+	for (i = 0; text->len < PERF_TEXT_SIZE; i++) {
+		g_string_append (text, line);
+		if (i % 16 == 0)
+			g_string_append (text, other_line);
+	}
+
+	return text;
+}
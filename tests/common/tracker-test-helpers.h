@@ -26,6 +26,9 @@ G_BEGIN_DECLS
 const gchar *tracker_test_helpers_get_nonutf8  (void);
 void         tracker_test_helpers_free_nonutf8 (void);
 
+GString *    tracker_test_helpers_get_perf_text (const gchar *line,
+                                                 const gchar *other_line);
+
 G_END_DECLS
 
 #endif /* __TRACKER_TEST_HELPERS_H__ */
@@ -20,8 +20,13 @@
 Tests failure cases of tracker-extract.
 """
 
+import gi
+gi.require_version('Gio', '2.0')
+from gi.repository import Gio
+
 import os
 import shutil
+import time
 import unittest as ut
 
 import configuration as cfg
@@ -35,6 +40,10 @@ VALID_FILE_TITLE = 'Simply Juvenile'
 
 TRACKER_EXTRACT_FAILURE_DATA_SOURCE = 'tracker:extractor-failure-data-source'
 
+EXTRACT_BUSNAME = 'org.freedesktop.Tracker3.Miner.Extract'
+EXTRACT_OBJ_PATH = '/org/freedesktop/Tracker3/Extract'
+EXTRACT_METRICS_IFACE = 'org.freedesktop.Tracker3.Extract.Metrics'
+
 
 class ExtractorDecoratorTest(fixtures.TrackerMinerTest):
     def test_reextraction(self):
@@ -74,6 +83,43 @@ class ExtractorDecoratorTest(fixtures.TrackerMinerTest):
         finally:
             os.remove(file_path)
 
+    def get_metrics(self):
+        proxy = Gio.DBusProxy.new_sync(
+            self.sandbox.get_session_bus_connection(),
+            Gio.DBusProxyFlags.DO_NOT_AUTO_START_AT_CONSTRUCTION, None,
+            EXTRACT_BUSNAME, EXTRACT_OBJ_PATH, EXTRACT_METRICS_IFACE)
+        return proxy.GetMetrics()
+
+    def test_metrics(self):
+        """Tests the per-module metrics exported by tracker-extract."""
+        file_path = os.path.join(self.indexed_dir, os.path.basename(VALID_FILE))
+        expected = f'a nmm:MusicPiece ; nie:title "{VALID_FILE_TITLE}"'
+        with self.tracker.await_insert(fixtures.AUDIO_GRAPH, expected,
+                                       timeout=cfg.AWAIT_TIMEOUT):
+            shutil.copy(VALID_FILE, file_path)
+
+        try:
+            # Counters are updated after the result is handed over,
+            # give them a moment.
+            deadline = time.monotonic() + cfg.AWAIT_TIMEOUT
+            while True:
+                metrics = self.get_metrics()
+                modules = metrics['extractor']['modules']
+                if any(m['calls'] > 0 for m in modules.values()):
+                    break
+                self.assertLess(time.monotonic(), deadline)
+                time.sleep(0.1)
+
+            for name, module in modules.items():
+                self.assertEqual(module['calls'], module['successes'] + module['failures'])
+                self.assertEqual(sum(module['latency']), module['calls'], name)
+
+            decorator = metrics['decorator']
+            self.assertEqual(sum(decorator['commit-latency']), decorator['commits'])
+            self.assertGreaterEqual(metrics['extractor']['queue-depth'], 0)
+        finally:
+            os.remove(file_path)
+
 
 if __name__ == '__main__':
     fixtures.tracker_test_main()
@@ -0,0 +1,136 @@
+# Copyright (C) 2022, agent <agent@local>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the
+# Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+# Boston, MA  02110-1301, USA.
+
+"""
+Measures bytes read and latency of the generic media extractor.
+
+Each media file in test-extraction-data is extracted a few times with
+TRACKER_DEBUG=statistics, the figures are taken from the notes that the
+libav and GStreamer modules print after probing a file.
+
+Every file is extracted twice, once with TRACKER_EXTRACT_FULL_PROBE set
+as a baseline, probing as it was done before probing got bounded and the
+GStreamer discoverer got reused, and once with the current defaults.
+"""
+
+
+import os
+import pathlib
+import re
+import statistics
+import subprocess
+import sys
+import time
+
+import configuration as cfg
+
+
+DATA_DIR = pathlib.Path(__file__).parent / 'test-extraction-data'
+MEDIA_DIRS = ['audio', 'video']
+MEDIA_SUFFIXES = ['.flac', '.mkv', '.mov', '.mp3', '.mp4', '.ogg']
+ITERATIONS = 5
+
+PROBE_RE = re.compile(r"(?:Probed|Discovered) '.*', (\d+) bytes read in ([0-9.]+) seconds")
+
+
+def media_files():
+    for subdir in MEDIA_DIRS:
+        for path in sorted((DATA_DIR / subdir).iterdir()):
+            if path.suffix in MEDIA_SUFFIXES:
+                yield path
+
+
+def extract(path, full_probe):
+    env = os.environ.copy()
+    env['TRACKER_DEBUG'] = 'statistics'
+    env['G_MESSAGES_DEBUG'] = ''
+    env['GST_REGISTRY_FORK'] = 'no'
+    if full_probe:
+        env['TRACKER_EXTRACT_FULL_PROBE'] = '1'
+    else:
+        env.pop('TRACKER_EXTRACT_FULL_PROBE', None)
+
+    command = [cfg.TRACKER_EXTRACT_PATH, '--output-format', 'turtle',
+               '--file', str(path)]
+
+    start = time.monotonic()
+    p = subprocess.run(command, env=env, stdout=subprocess.DEVNULL,
+                       stderr=subprocess.PIPE, check=True)
+    wall = time.monotonic() - start
+
+    match = PROBE_RE.search(p.stderr.decode('utf-8', errors='replace'))
+    if match is None:
+        return None, None, wall
+
+    return int(match.group(1)), float(match.group(2)), wall
+
+
+def measure(path, full_probe):
+    bytes_read = None
+    probe_times = []
+    wall_times = []
+
+    for i in range(ITERATIONS):
+        bytes_read, probe, wall = extract(path, full_probe)
+        if probe is not None:
+            probe_times.append(probe)
+        wall_times.append(wall)
+
+    probe = statistics.median(probe_times) * 1000 if probe_times else None
+    return bytes_read, probe, statistics.median(wall_times) * 1000
+
+
+def format_figures(bytes_read, probe, wall):
+    return '%12s %10s %12.1f' % (
+        '-' if bytes_read is None else '%d' % bytes_read,
+        '-' if probe is None else '%.1f' % probe,
+        wall)
+
+
+def main():
+    print('%-40s %10s %-36s %-36s' % ('', '', 'Full probe (before)', 'Bounded probe (after)'))
+    print('%-40s %10s %12s %10s %12s %12s %10s %12s' % (
+        'File', 'Size',
+        'Bytes read', 'Probe ms', 'Process ms',
+        'Bytes read', 'Probe ms', 'Process ms'))
+
+    totals = {True: [0, 0.0], False: [0, 0.0]}
+
+    for path in media_files():
+        figures = {}
+
+        for full_probe in (True, False):
+            figures[full_probe] = measure(path, full_probe)
+            bytes_read, probe, wall = figures[full_probe]
+            totals[full_probe][0] += bytes_read or 0
+            totals[full_probe][1] += wall
+
+        print('%-40s %10d %s %s' % (
+            str(path.relative_to(DATA_DIR)), path.stat().st_size,
+            format_figures(*figures[True]),
+            format_figures(*figures[False])))
+
+    print('%-40s %10s %12d %10s %12.1f %12d %10s %12.1f' % (
+        'Total', '',
+        totals[True][0], '', totals[True][1],
+        totals[False][0], '', totals[False][1]))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
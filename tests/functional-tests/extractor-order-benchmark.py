@@ -0,0 +1,148 @@
+# Copyright (C) 2022, agent <agent@local>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the
+# Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+# Boston, MA  02110-1301, USA.
+
+"""
+Measures tracker-extract throughput on files taken in database order
+against inode order, the order the decorator uses on rotational disks.
+
+Every file is extracted by the real extractor, once with a cold page
+cache and once with a warm one. The warm run is the cost of starting
+the extractor and parsing, the difference between both is the time
+spent waiting for the disk.
+
+The files must be on a rotational device for the figures to mean
+anything, a loop mounted image marked as rotational will do:
+
+    truncate -s 2G /tmp/order.img
+    mkfs.ext4 /tmp/order.img
+    losetup -f --show /tmp/order.img      # e.g. /dev/loop0
+    echo 1 > /sys/block/loop0/queue/rotational
+    mount /dev/loop0 /mnt/order
+
+Then run with TRACKER_ORDER_BENCHMARK_DIR=/mnt/order. The benchmark
+is skipped if the variable is not set.
+
+With TRACKER_ORDER_BENCHMARK_READ_ONLY=1 the files are only read, the
+way the extractor reads text files, and no build tree is needed. This
+measures the disk side alone.
+"""
+
+
+import os
+import pathlib
+import random
+import statistics
+import subprocess
+import sys
+import time
+
+
+N_FILES = 500
+FILE_SIZE = 256 * 1024
+ITERATIONS = 3
+
+WORDS = [b'tracker', b'extract', b'inode', b'order', b'rotational',
+         b'seek', b'sweep', b'metadata', b'header', b'disk']
+
+
+def populate(directory):
+    files = sorted(directory.glob('dir-*/file-*.txt'))
+    if len(files) >= N_FILES:
+        return files
+
+    rng = random.Random(0)
+    for i in range(len(files), N_FILES):
+        # Spread files over a few directories, so inode and name
+        # order do not trivially match
+        subdir = directory / ('dir-%02d' % rng.randrange(16))
+        subdir.mkdir(exist_ok=True)
+        path = subdir / ('file-%05d.txt' % i)
+        text = bytearray()
+        while len(text) < FILE_SIZE:
+            text += rng.choice(WORDS) + (b'\n' if rng.random() < 0.1 else b' ')
+        path.write_bytes(bytes(text[:FILE_SIZE]))
+
+    os.sync()
+    return sorted(directory.glob('dir-*/file-*.txt'))
+
+
+def drop_caches(files):
+    for path in files:
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+        finally:
+            os.close(fd)
+
+
+def read_all(files):
+    start = time.monotonic()
+    for path in files:
+        with open(path, 'rb') as f:
+            f.read(FILE_SIZE)
+    return time.monotonic() - start
+
+
+def extract_all(files):
+    import configuration as cfg
+
+    env = os.environ.copy()
+    env['G_MESSAGES_DEBUG'] = ''
+
+    start = time.monotonic()
+    for path in files:
+        subprocess.run([cfg.TRACKER_EXTRACT_PATH, '--output-format', 'turtle',
+                        '--mime', 'text/plain', '--file', str(path)],
+                       env=env, stdout=subprocess.DEVNULL,
+                       stderr=subprocess.DEVNULL, check=True)
+    return time.monotonic() - start
+
+
+def main():
+    directory = os.environ.get('TRACKER_ORDER_BENCHMARK_DIR')
+    if not directory:
+        print('TRACKER_ORDER_BENCHMARK_DIR not set, skipping')
+        return 77
+
+    files = [p.resolve() for p in populate(pathlib.Path(directory))]
+    shuffled = list(files)
+    random.Random(1).shuffle(shuffled)
+    by_inode = sorted(files, key=lambda p: p.stat().st_ino)
+    run = read_all if os.environ.get('TRACKER_ORDER_BENCHMARK_READ_ONLY') else extract_all
+
+    print('%-10s %8s %10s %10s %10s %12s' % (
+        'Order', 'Files', 'Cold ms', 'Warm ms', 'Disk ms', 'Files/s'))
+
+    for name, order in [('database', shuffled), ('inode', by_inode)]:
+        cold = []
+        warm = []
+        for i in range(ITERATIONS):
+            drop_caches(files)
+            cold.append(run(order))
+            warm.append(run(order))
+
+        cold_s = statistics.median(cold)
+        warm_s = statistics.median(warm)
+        print('%-10s %8d %10.1f %10.1f %10.1f %12.1f' % (
+            name, len(order), cold_s * 1000, warm_s * 1000,
+            (cold_s - warm_s) * 1000, len(order) / cold_s))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,152 @@
+# Copyright (C) 2022, agent <agent@local>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the
+# Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+# Boston, MA  02110-1301, USA.
+
+"""
+Tests extraction in tracker-extract worker processes.
+
+Markdown files go to an extractor that crashes or hangs on request,
+see test-extractors/tracker-extract-test-faults.c.
+"""
+
+import gi
+gi.require_version('Gio', '2.0')
+from gi.repository import Gio
+
+import os
+import pathlib
+import time
+import unittest as ut
+
+import configuration as cfg
+import fixtures
+
+
+EXTRACT_BUSNAME = 'org.freedesktop.Tracker3.Miner.Extract'
+EXTRACT_OBJ_PATH = '/org/freedesktop/Tracker3/Extract'
+EXTRACT_METRICS_IFACE = 'org.freedesktop.Tracker3.Extract.Metrics'
+
+# Same as DEADLINE_SECONDS in tracker-extract.c
+EXTRACT_DEADLINE = 30
+
+
+def link_dir_contents(source_dir, target_dir):
+    os.makedirs(target_dir, exist_ok=True)
+    for name in os.listdir(source_dir):
+        os.symlink(os.path.join(source_dir, name), os.path.join(target_dir, name))
+
+
+class ExtractorWorkersTest(fixtures.TrackerMinerTest):
+    def environment(self):
+        extra_env = super(ExtractorWorkersTest, self).environment()
+
+        # The rules and modules of the build tree, plus the faulty extractor
+        rules_dir = os.path.join(self.workdir, 'extract-rules')
+        modules_dir = os.path.join(self.workdir, 'extract-modules')
+        link_dir_contents(cfg.config['TEST_EXTRACTOR_RULES_DIR'], rules_dir)
+        link_dir_contents(cfg.config['TEST_EXTRACTORS_DIR'], modules_dir)
+
+        faults_dir = cfg.config['TEST_FAULTS_EXTRACTOR_DIR']
+        os.symlink(os.path.join(faults_dir, '05-test-faults.rule'),
+                   os.path.join(rules_dir, '05-test-faults.rule'))
+        os.symlink(os.path.join(faults_dir, 'libextract-test-faults.so'),
+                   os.path.join(modules_dir, 'libextract-test-faults.so'))
+
+        extra_env['TRACKER_EXTRACTOR_RULES_DIR'] = rules_dir
+        extra_env['TRACKER_EXTRACTORS_DIR'] = modules_dir
+        self.cache_dir = extra_env['XDG_CACHE_HOME']
+        return extra_env
+
+    def worker_pids(self):
+        """Returns the worker processes of the tracker-extract under test."""
+        pids = {}
+        cache_env = ('XDG_CACHE_HOME=' + self.cache_dir).encode()
+        for proc in pathlib.Path('/proc').iterdir():
+            if not proc.name.isdigit():
+                continue
+            try:
+                if b'--worker' not in (proc / 'cmdline').read_bytes().split(b'\0'):
+                    continue
+                if cache_env not in (proc / 'environ').read_bytes().split(b'\0'):
+                    continue
+                stat = (proc / 'stat').read_text()
+            except OSError:
+                continue
+            # The parent pid comes after the parenthesized command name
+            pids[int(proc.name)] = int(stat[stat.rindex(')') + 2:].split()[1])
+        return pids
+
+    def module_metrics(self):
+        proxy = Gio.DBusProxy.new_sync(
+            self.sandbox.get_session_bus_connection(),
+            Gio.DBusProxyFlags.DO_NOT_AUTO_START_AT_CONSTRUCTION, None,
+            EXTRACT_BUSNAME, EXTRACT_OBJ_PATH, EXTRACT_METRICS_IFACE)
+        modules = proxy.GetMetrics()['extractor']['modules']
+        return next((m for name, m in modules.items() if 'test-faults' in name), {})
+
+    def await_condition(self, condition, timeout):
+        deadline = time.monotonic() + timeout
+        while not condition():
+            self.assertLess(time.monotonic(), deadline)
+            time.sleep(0.1)
+
+    def extract_text(self, filename, text):
+        path = os.path.join(self.indexed_dir, filename)
+        with self.await_document_inserted(path, content=text):
+            with open(path, 'w') as f:
+                f.write(text)
+
+    def assert_worker_replaced(self, before, after):
+        # Only the worker that had the file is gone, the daemon is the same
+        self.assertEqual(len(set(before) - set(after)), 1)
+        self.assertTrue(set(after) - set(before))
+        self.assertEqual(set(before.values()), set(after.values()))
+
+    def test_text_extraction(self):
+        """Text extractors get their settings in worker processes."""
+        self.extract_text('text.txt', 'Extracted in a worker')
+        self.assertTrue(self.worker_pids())
+
+    def test_crashing_file(self):
+        """A crashing file takes down only its worker, which is replaced."""
+        self.extract_text('before.txt', 'Before the crash')
+        before = self.worker_pids()
+
+        with open(os.path.join(self.indexed_dir, 'crash.md'), 'w') as f:
+            f.write('crash')
+        self.await_condition(lambda: self.module_metrics().get('failures', 0) > 0,
+                             cfg.AWAIT_TIMEOUT)
+
+        self.extract_text('after.txt', 'After the crash')
+        self.assert_worker_replaced(before, self.worker_pids())
+
+    def test_hanging_file(self):
+        """A hanging file gets its worker killed, which is replaced."""
+        self.extract_text('before.txt', 'Before the hang')
+        self.extract_text('unaffected.md', 'Not hanging')
+        before = self.worker_pids()
+
+        with open(os.path.join(self.indexed_dir, 'hang.md'), 'w') as f:
+            f.write('hang')
+        self.await_condition(lambda: self.module_metrics().get('timeouts', 0) > 0,
+                             EXTRACT_DEADLINE + cfg.AWAIT_TIMEOUT)
+
+        self.extract_text('after.txt', 'After the hang')
+        self.assert_worker_replaced(before, self.worker_pids())
+
+
+if __name__ == '__main__':
+    fixtures.tracker_test_main()
@@ -34,6 +34,8 @@ import shutil
 import time
 import unittest as ut
 
+from gi.repository import GLib
+
 import configuration as cfg
 import fixtures
 
@@ -421,5 +423,98 @@ class MinerCrawlTest(fixtures.TrackerMinerTest):
         self.assertIn(self.uri("test-monitored/dir1/visible.txt"), unpacked_result)
 
 
+class MinerDataSourceTest(fixtures.TrackerMinerTest):
+    """
+    Tests the data source of files moving between indexing roots.
+    """
+
+    def config(self):
+        settings = super(MinerDataSourceTest, self).config()
+        settings['org.freedesktop.Tracker3.Miner.Files']['index-single-directories'] = \
+            GLib.Variant.new_strv([self.path("test-single")])
+        return settings
+
+    def setUp(self):
+        os.makedirs(self.path("test-single"), exist_ok=True)
+        fixtures.TrackerMinerTest.setUp(self)
+
+    def __get_data_sources(self, filepath):
+        result = self.tracker.query("""
+          SELECT DISTINCT ?ds WHERE {
+              ?u a nfo:FileDataObject ;
+                 nie:url \"%s\" ;
+                 nie:dataSource ?ds
+          }
+          """ % (self.uri(filepath)))
+        return [r[0] for r in result]
+
+    def test_01_update_after_move_between_roots(self):
+        """
+        Modify a file moved to another root, it must have one data source
+        """
+        source = self.path("test-monitored/moving.txt")
+        dest = self.path("test-single/moving.txt")
+
+        with self.await_document_inserted(source):
+            with open(source, 'w') as f:
+                f.write(DEFAULT_TEXT)
+
+        resource_id = self.tracker.get_content_resource_id(url=self.uri(source))
+        with self.await_document_uri_change(resource_id, source, dest):
+            shutil.move(source, dest)
+
+        with self.await_document_inserted(dest, content="Modified"):
+            with open(dest, 'w') as f:
+                f.write("Modified")
+
+        root_urn = self.tracker.query("""
+          SELECT DISTINCT ?ie WHERE {
+              ?u a nfo:FileDataObject ;
+                 nie:url \"%s\" ;
+                 nie:interpretedAs ?ie
+          }
+          """ % (self.uri("test-single")))[0][0]
+        self.assertEqual(self.__get_data_sources(dest), [root_urn])
+
+    def test_02_file_properties(self):
+        """
+        Files inside indexed folders get all their nfo:FileDataObject properties
+        """
+        dirpath = self.path("test-monitored/properties")
+        filepath = os.path.join(dirpath, "file.txt")
+
+        with self.await_insert_dir(dirpath):
+            os.makedirs(dirpath)
+        with self.await_document_inserted(filepath):
+            with open(filepath, 'w') as f:
+                f.write(DEFAULT_TEXT)
+
+        result = self.tracker.query("""
+          SELECT DISTINCT ?name ?size ?container ?ds ?id WHERE {
+              ?u a nfo:FileDataObject ;
+                 nie:url \"%s\" ;
+                 nfo:fileName ?name ;
+                 nfo:fileSize ?size ;
+                 nfo:fileLastModified ?modified ;
+                 nfo:fileLastAccessed ?accessed ;
+                 nfo:belongsToContainer ?container ;
+                 nie:dataSource ?ds ;
+                 dc:identifier ?id .
+          }
+          """ % (self.uri(filepath)))
+        self.assertEqual(len(result), 1)
+
+        name, size, container, ds, identifier = result[0]
+        self.assertEqual(name, "file.txt")
+        self.assertEqual(int(size), len(DEFAULT_TEXT))
+        self.assertEqual(container, self.tracker.query("""
+          SELECT ?ie WHERE { ?ie nie:isStoredAs <%s> }
+          """ % (self.uri(dirpath)))[0][0])
+        self.assertEqual(ds, self.tracker.query("""
+          SELECT ?ie WHERE { ?ie nie:isStoredAs <%s> }
+          """ % (self.uri("test-monitored")))[0][0])
+        self.assertTrue(identifier.startswith("urn:fileid:"))
+
+
 if __name__ == "__main__":
     fixtures.tracker_test_main()
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Extractor misbehaving on request, for testing how extraction
+ * workers cope. Files saying "crash" abort the process, files saying
+ * "hang" never return, anything else is stored as plain text.
+ */
+
+#include <stdlib.h>
+
+#include <libtracker-extract/tracker-extract.h>
+
+G_MODULE_EXPORT gboolean
+tracker_extract_get_metadata (TrackerExtractInfo  *info,
+                              GError             **error)
+{
+	TrackerResource *metadata;
+	gchar *path, *content, *resource_uri;
+	gboolean retval;
+
+	path = g_file_get_path (tracker_extract_info_get_file (info));
+	retval = g_file_get_contents (path, &content, NULL, error);
+	g_free (path);
+
+	if (!retval)
+		return FALSE;
+
+	g_strstrip (content);
+
+	if (g_strcmp0 (content, "crash") == 0)
+		abort ();
+
+	if (g_strcmp0 (content, "hang") == 0) {
+		while (TRUE)
+			g_usleep (G_USEC_PER_SEC);
+	}
+
+	resource_uri = tracker_extract_info_get_content_id (info, NULL);
+	metadata = tracker_resource_new (resource_uri);
+	tracker_resource_add_uri (metadata, "rdf:type", "nfo:PlainTextDocument");
+	tracker_resource_set_string (metadata, "nie:plainTextContent", content);
+	g_free (resource_uri);
+	g_free (content);
+
+	tracker_extract_info_set_resource (info, metadata);
+	g_object_unref (metadata);
+
+	return TRUE;
+}
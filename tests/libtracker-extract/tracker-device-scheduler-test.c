@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include <glib.h>
+
+#include "tracker-extract/tracker-device-scheduler.h"
+
+static void
+push_tasks (TrackerDeviceScheduler *scheduler,
+            const gchar            *device,
+            TrackerDeviceType       device_type,
+            const gchar * const    *tasks)
+{
+        gint i;
+
+        for (i = 0; tasks[i]; i++) {
+                tracker_device_scheduler_push (scheduler, device, device_type,
+                                               (gpointer) tasks[i]);
+        }
+}
+
+static TrackerDeviceQueue *
+assert_pop (TrackerDeviceScheduler *scheduler,
+            const gchar            *expected_task)
+{
+        TrackerDeviceQueue *queue = NULL;
+        const gchar *task;
+
+        task = tracker_device_scheduler_pop (scheduler, &queue);
+        g_assert_cmpstr (task, ==, expected_task);
+
+        return queue;
+}
+
+static void
+test_device_scheduler_rotational (void)
+{
+        const gchar *hdd_tasks[] = { "hdd1", "hdd2", "hdd3", NULL };
+        const gchar *ssd_tasks[] = { "ssd1", "ssd2", "ssd3", NULL };
+        TrackerDeviceScheduler *scheduler;
+        TrackerDeviceQueue *hdd;
+
+        scheduler = tracker_device_scheduler_new (4);
+        push_tasks (scheduler, "sda", TRACKER_DEVICE_TYPE_ROTATIONAL, hdd_tasks);
+        push_tasks (scheduler, "nvme0n1", TRACKER_DEVICE_TYPE_SOLID_STATE, ssd_tasks);
+        g_assert_cmpuint (tracker_device_scheduler_get_n_waiting (scheduler), ==, 6);
+
+        /* The rotational disk takes one worker, the SSD the rest */
+        hdd = assert_pop (scheduler, "hdd1");
+        assert_pop (scheduler, "ssd1");
+        assert_pop (scheduler, "ssd2");
+        assert_pop (scheduler, "ssd3");
+        assert_pop (scheduler, NULL);
+
+        g_assert_cmpuint (tracker_device_scheduler_get_n_busy (scheduler), ==, 4);
+        g_assert_cmpuint (tracker_device_scheduler_get_n_busy_devices (scheduler), ==, 2);
+        g_assert_cmpuint (tracker_device_scheduler_get_n_waiting (scheduler), ==, 2);
+
+        /* The next file on the disk waits for the current one */
+        tracker_device_scheduler_release (scheduler, hdd);
+        hdd = assert_pop (scheduler, "hdd2");
+        assert_pop (scheduler, NULL);
+
+        tracker_device_scheduler_release (scheduler, hdd);
+        assert_pop (scheduler, "hdd3");
+        g_assert_cmpuint (tracker_device_scheduler_get_n_waiting (scheduler), ==, 0);
+
+        tracker_device_scheduler_free (scheduler);
+}
+
+static void
+test_device_scheduler_round_robin (void)
+{
+        const gchar *a_tasks[] = { "a1", "a2", NULL };
+        const gchar *b_tasks[] = { "b1", "b2", "b3", NULL };
+        const gchar *c_tasks[] = { "c1", NULL };
+        TrackerDeviceScheduler *scheduler;
+
+        scheduler = tracker_device_scheduler_new (8);
+        push_tasks (scheduler, "sda", TRACKER_DEVICE_TYPE_SOLID_STATE, a_tasks);
+        push_tasks (scheduler, "sdb", TRACKER_DEVICE_TYPE_SOLID_STATE, b_tasks);
+        push_tasks (scheduler, "sdc", TRACKER_DEVICE_TYPE_SOLID_STATE, c_tasks);
+
+        /* Devices take turns, those running out drop off */
+        assert_pop (scheduler, "a1");
+        assert_pop (scheduler, "b1");
+        assert_pop (scheduler, "c1");
+        assert_pop (scheduler, "a2");
+        assert_pop (scheduler, "b2");
+        assert_pop (scheduler, "b3");
+        assert_pop (scheduler, NULL);
+
+        g_assert_cmpuint (tracker_device_scheduler_get_n_busy_devices (scheduler), ==, 3);
+
+        tracker_device_scheduler_free (scheduler);
+}
+
+static void
+test_device_scheduler_limits (void)
+{
+        const gchar *remote_tasks[] = { "nfs1", "nfs2", "nfs3", NULL };
+        const gchar *ssd_tasks[] = { "ssd1", "ssd2", "ssd3", NULL };
+        TrackerDeviceScheduler *scheduler;
+        TrackerDeviceQueue *nfs, *ssd;
+
+        scheduler = tracker_device_scheduler_new (3);
+        push_tasks (scheduler, "server:/export", TRACKER_DEVICE_TYPE_REMOTE, remote_tasks);
+        push_tasks (scheduler, NULL, TRACKER_DEVICE_TYPE_UNKNOWN, ssd_tasks);
+
+        /* Remote mounts take two workers, all devices share the total */
+        nfs = assert_pop (scheduler, "nfs1");
+        ssd = assert_pop (scheduler, "ssd1");
+        assert_pop (scheduler, "nfs2");
+        assert_pop (scheduler, NULL);
+
+        tracker_device_scheduler_release (scheduler, nfs);
+        assert_pop (scheduler, "ssd2");
+        assert_pop (scheduler, NULL);
+
+        tracker_device_scheduler_release (scheduler, ssd);
+        assert_pop (scheduler, "nfs3");
+        g_assert_cmpuint (tracker_device_scheduler_get_n_busy (scheduler), ==, 3);
+        g_assert_cmpuint (tracker_device_scheduler_get_n_waiting (scheduler), ==, 1);
+
+        tracker_device_scheduler_free (scheduler);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/tracker-extract/device-scheduler/rotational",
+                         test_device_scheduler_rotational);
+        g_test_add_func ("/tracker-extract/device-scheduler/round-robin",
+                         test_device_scheduler_round_robin);
+        g_test_add_func ("/tracker-extract/device-scheduler/limits",
+                         test_device_scheduler_limits);
+
+        return g_test_run ();
+}
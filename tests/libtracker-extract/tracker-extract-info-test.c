@@ -42,6 +42,31 @@ test_extract_info_setters (void)
         g_object_unref (file);
 }
 
+static void
+test_extract_info_content_id (void)
+{
+        TrackerExtractInfo *info;
+        GFile *file;
+        gchar *content_id;
+
+        file = g_file_new_for_path ("./imaginary-file-3");
+
+        info = tracker_extract_info_new (file, "imaginary/mime", NULL);
+        tracker_extract_info_set_content_id (info, "urn:fileid:fs:1234");
+
+        content_id = tracker_extract_info_get_content_id (info, NULL);
+        g_assert_cmpstr (content_id, ==, "urn:fileid:fs:1234");
+        g_free (content_id);
+
+        content_id = tracker_extract_info_get_content_id (info, "2");
+        g_assert_cmpstr (content_id, ==, "urn:fileid:fs:1234/2");
+        g_free (content_id);
+
+        tracker_extract_info_unref (info);
+
+        g_object_unref (file);
+}
+
 static void
 test_extract_info_empty_objects (void)
 {
@@ -68,6 +93,8 @@ main (int argc, char **argv)
                          test_extract_info_empty_objects);
         g_test_add_func ("/libtracker-extract/extract-info/setters",
                          test_extract_info_setters);
+        g_test_add_func ("/libtracker-extract/extract-info/content_id",
+                         test_extract_info_content_id);
 
         return g_test_run ();
 }
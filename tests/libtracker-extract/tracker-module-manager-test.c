@@ -73,6 +73,21 @@ test_extract_rules (void)
 	g_assert_cmpint (g_list_length (l), ==, 0);
 }
 
+static void
+test_extract_rules_readahead (void)
+{
+	gint64 head, tail;
+
+	g_assert_true (tracker_extract_module_manager_get_readahead ("audio/mpeg", &head, &tail));
+	g_assert_cmpint (head, ==, 65536);
+	g_assert_cmpint (tail, ==, 4096);
+
+	// The image/* rule has no hints
+	g_assert_false (tracker_extract_module_manager_get_readahead ("image/png", &head, &tail));
+	g_assert_cmpint (head, ==, 0);
+	g_assert_cmpint (tail, ==, 0);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -81,5 +96,7 @@ main (int argc, char **argv)
 
 	g_test_add_func ("/libtracker-extract/module-manager/extract-rules",
 	                 test_extract_rules);
+	g_test_add_func ("/libtracker-extract/module-manager/extract-rules-readahead",
+	                 test_extract_rules_readahead);
 	return g_test_run ();
 }
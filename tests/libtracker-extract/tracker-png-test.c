@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <png.h>
+#include <glib/gstdio.h>
+
+#include <libtracker-extract/tracker-extract.h>
+
+/* The PNG extract module is built into this test */
+gboolean tracker_extract_get_metadata (TrackerExtractInfo  *info,
+                                       GError             **error);
+
+static void
+set_text (png_textp    text,
+          gint         compression,
+          const gchar *key,
+          const gchar *value)
+{
+	memset (text, 0, sizeof (png_text));
+	text->compression = compression;
+	text->key = (png_charp) key;
+	text->text = (png_charp) value;
+	text->text_length = strlen (value);
+}
+
+static gchar *
+write_png (guint width,
+           guint height)
+{
+	png_structp png_ptr;
+	png_infop info_ptr, end_ptr;
+	png_text texts[3];
+	png_bytep row;
+	GRand *rand;
+	gchar *path;
+	FILE *f;
+	guint i, j;
+	gint fd;
+
+	fd = g_file_open_tmp ("tracker-png-test-XXXXXX.png", &path, NULL);
+	g_assert_cmpint (fd, >=, 0);
+	f = fdopen (fd, "wb");
+	g_assert_nonnull (f);
+
+	png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	info_ptr = png_create_info_struct (png_ptr);
+	end_ptr = png_create_info_struct (png_ptr);
+	png_init_io (png_ptr, f);
+
+	png_set_IHDR (png_ptr, info_ptr, width, height, 8,
+	              PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+	              PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+	set_text (&texts[0], PNG_TEXT_COMPRESSION_NONE, "Software", "tracker-png-test");
+	png_set_text (png_ptr, info_ptr, texts, 1);
+	png_write_info (png_ptr, info_ptr);
+
+	/* Noise, so image data does not compress away */
+	rand = g_rand_new_with_seed (width * height);
+	row = g_malloc (width * 3);
+
+	for (i = 0; i < height; i++) {
+		for (j = 0; j < width * 3; j++)
+			row[j] = g_rand_int_range (rand, 0, 256);
+		png_write_row (png_ptr, row);
+	}
+
+	g_free (row);
+	g_rand_free (rand);
+
+	/* Metadata after the image data */
+	set_text (&texts[0], PNG_TEXT_COMPRESSION_NONE, "Title", "Chunk walker");
+	set_text (&texts[1], PNG_TEXT_COMPRESSION_zTXt, "Description", "A compressed description");
+	set_text (&texts[2], PNG_ITXT_COMPRESSION_zTXt, "Comment", "An international comment");
+	png_set_text (png_ptr, end_ptr, texts, 3);
+	png_write_end (png_ptr, end_ptr);
+
+	png_destroy_info_struct (png_ptr, &end_ptr);
+	png_destroy_write_struct (&png_ptr, &info_ptr);
+	fclose (f);
+
+	return path;
+}
+
+static TrackerResource *
+extract_png (const gchar *path)
+{
+	TrackerExtractInfo *info;
+	TrackerResource *resource;
+	GError *error = NULL;
+	GFile *file;
+
+	file = g_file_new_for_path (path);
+	info = tracker_extract_info_new (file, "image/png", NULL);
+
+	g_assert_true (tracker_extract_get_metadata (info, &error));
+	g_assert_no_error (error);
+
+	resource = g_object_ref (tracker_extract_info_get_resource (info));
+
+	tracker_extract_info_unref (info);
+	g_object_unref (file);
+
+	return resource;
+}
+
+/* What the extractor used to do: decode every row to get to the
+ * chunks after the image data.
+ */
+static void
+read_png_decoding_rows (const gchar *path)
+{
+	png_structp png_ptr;
+	png_infop info_ptr, end_ptr;
+	png_bytep row_data;
+	png_uint_32 row;
+	FILE *f;
+
+	f = fopen (path, "rb");
+	g_assert_nonnull (f);
+
+	png_ptr = png_create_read_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	info_ptr = png_create_info_struct (png_ptr);
+	end_ptr = png_create_info_struct (png_ptr);
+
+	png_init_io (png_ptr, f);
+	png_read_info (png_ptr, info_ptr);
+
+	row_data = png_malloc (png_ptr, png_get_rowbytes (png_ptr, info_ptr));
+	for (row = 0; row < png_get_image_height (png_ptr, info_ptr); row++)
+		png_read_row (png_ptr, row_data, NULL);
+	png_free (png_ptr, row_data);
+
+	png_read_end (png_ptr, end_ptr);
+
+	png_destroy_read_struct (&png_ptr, &info_ptr, &end_ptr);
+	fclose (f);
+}
+
+static void
+test_png_trailing_metadata (void)
+{
+	TrackerResource *resource;
+	gchar *path;
+
+	path = write_png (64, 48);
+	resource = extract_png (path);
+
+	g_assert_cmpint (tracker_resource_get_first_int64 (resource, "nfo:width"), ==, 64);
+	g_assert_cmpint (tracker_resource_get_first_int64 (resource, "nfo:height"), ==, 48);
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:title"), ==, "Chunk walker");
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:description"), ==, "A compressed description");
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:comment"), ==, "An international comment");
+
+	g_object_unref (resource);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_png_benchmark (void)
+{
+	TrackerResource *resource;
+	GTimer *timer;
+	gdouble decoding, walking;
+	gchar *path;
+
+	if (!g_test_perf ()) {
+		g_test_skip ("Only run in performance mode (-m perf)");
+		return;
+	}
+
+	path = write_png (8000, 6000);
+	timer = g_timer_new ();
+
+	read_png_decoding_rows (path);
+	decoding = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	resource = extract_png (path);
+	walking = g_timer_elapsed (timer, NULL);
+
+	g_assert_cmpstr (tracker_resource_get_first_string (resource, "nie:title"), ==, "Chunk walker");
+
+	g_test_message ("48 megapixel PNG: %f s decoding rows, %f s walking chunks",
+	                decoding, walking);
+	g_test_minimized_result (walking, "Chunk walking extraction: %f s", walking);
+
+	g_object_unref (resource);
+	g_timer_destroy (timer);
+	g_unlink (path);
+	g_free (path);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/libtracker-extract/png/trailing-metadata",
+	                 test_png_trailing_metadata);
+	g_test_add_func ("/libtracker-extract/png/benchmark",
+	                 test_png_benchmark);
+
+	return g_test_run ();
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "config-miners.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libtracker-extract/tracker-extract.h>
+
+#include <tracker-test-helpers.h>
+
+#include "tracker-extract/tracker-read.h"
+
+#define BENCHMARK_ITERATIONS 8
+
+/* Same chunk size as tracker-read.c */
+#define BUFFER_SIZE 65535
+
+static gchar *
+write_temp_file (const gchar *contents,
+                 gssize       len)
+{
+        GError *error = NULL;
+        gchar *path;
+        gint fd;
+
+        fd = g_file_open_tmp ("tracker-read-test-XXXXXX", &path, &error);
+        g_assert_no_error (error);
+        close (fd);
+
+        g_file_set_contents (path, contents, len, &error);
+        g_assert_no_error (error);
+
+        return path;
+}
+
+static gchar *
+read_path (const gchar *path,
+           gsize        max_bytes)
+{
+        GError *error = NULL;
+        gchar *text;
+        gint fd;
+
+        fd = g_open (path, O_RDONLY, 0);
+        g_assert_cmpint (fd, >=, 0);
+
+        /* Closes the fd */
+        text = tracker_read_text_from_fd (fd, max_bytes, &error);
+        g_assert_no_error (error);
+
+        return text;
+}
+
+/* The read loop of tracker_read_text_from_fd() before it used
+ * pread(), with the same validation, as a baseline.
+ */
+static gchar *
+read_path_with_stdio (const gchar *path,
+                      gsize        max_bytes)
+{
+        gsize n_bytes_remaining = max_bytes, valid_len = 0;
+        GString *s;
+        FILE *fz;
+
+        fz = g_fopen (path, "r");
+        g_assert_nonnull (fz);
+
+        s = g_string_new ("");
+
+        while (n_bytes_remaining > 0) {
+                gchar buf[BUFFER_SIZE];
+                gsize n_bytes_read;
+
+                n_bytes_read = fread (buf, 1,
+                                      MIN (BUFFER_SIZE, n_bytes_remaining),
+                                      fz);
+                if (n_bytes_read == 0)
+                        break;
+
+                n_bytes_remaining -= n_bytes_read;
+                g_string_append_len (s, buf, n_bytes_read);
+        }
+
+#ifdef HAVE_POSIX_FADVISE
+        posix_fadvise (fileno (fz), 0, 0, POSIX_FADV_DONTNEED);
+#endif /* HAVE_POSIX_FADVISE */
+        fclose (fz);
+
+        tracker_text_validate_utf8 (s->str, s->len, NULL, &valid_len);
+        g_string_truncate (s, valid_len);
+
+        return g_string_free (s, FALSE);
+}
+
+static void
+test_read_text_from_fd (void)
+{
+        const gchar *contents = "First line\nSecond l\xC3\xADne\n";
+        gchar *path, *text;
+
+        path = write_temp_file (contents, -1);
+
+        text = read_path (path, 1024);
+        g_assert_cmpstr (text, ==, contents);
+        g_free (text);
+
+        /* Cut at max_bytes, and back to the last whole character */
+        text = read_path (path, 20);
+        g_assert_cmpstr (text, ==, "First line\nSecond l");
+        g_free (text);
+
+        g_unlink (path);
+        g_free (path);
+}
+
+static void
+test_read_text_from_fd_benchmark (void)
+{
+        gdouble reference = 0, elapsed = 0;
+        GString *contents;
+        GTimer *timer;
+        gchar *path;
+        gint i;
+
+        contents = tracker_test_helpers_get_perf_text ("static void do_something (int argc, char **argv);\n",
+                                                       "/* Ca\xC3\xB1\xC3\xB3n \xE8\xAA\x9E */\n");
+        if (!contents)
+                return;
+
+        path = write_temp_file (contents->str, contents->len);
+        timer = g_timer_new ();
+
+        /* Both paths drop the file from the page cache when done,
+         * the same way tracker_read_text_from_fd() does.
+         */
+        for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+                gchar *text;
+
+                g_timer_start (timer);
+                text = read_path_with_stdio (path, contents->len);
+                reference += g_timer_elapsed (timer, NULL);
+                g_assert_cmpuint (strlen (text), ==, contents->len);
+                g_free (text);
+
+                g_timer_start (timer);
+                text = read_path (path, contents->len);
+                elapsed += g_timer_elapsed (timer, NULL);
+                g_assert_cmpuint (strlen (text), ==, contents->len);
+                g_free (text);
+        }
+
+        g_test_message ("%" G_GSIZE_FORMAT " bytes: %f s fread(), %f s pread() per read",
+                        contents->len,
+                        reference / BENCHMARK_ITERATIONS,
+                        elapsed / BENCHMARK_ITERATIONS);
+        g_test_minimized_result (elapsed / BENCHMARK_ITERATIONS,
+                                 "Reading text: %f s",
+                                 elapsed / BENCHMARK_ITERATIONS);
+
+        g_timer_destroy (timer);
+        g_unlink (path);
+        g_free (path);
+        g_string_free (contents, TRUE);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/tracker-extract/read/text-from-fd",
+                         test_read_text_from_fd);
+        g_test_add_func ("/tracker-extract/read/text-from-fd-benchmark",
+                         test_read_text_from_fd_benchmark);
+
+        return g_test_run ();
+}
@@ -28,6 +28,8 @@
 
 #include <libtracker-extract/tracker-extract.h>
 
+#include <tracker-test-helpers.h>
+
 static void
 test_guess_date_failures_subprocess ()
 {
@@ -204,6 +206,155 @@ test_text_validate_utf8 ()
 	g_string_free (s, TRUE);
 }
 
+static void
+test_text_validate_utf8_long ()
+{
+	const gchar *invalid[] = {
+		"\xC0\xAF",         /* Overlong */
+		"\xE0\x80\xAF",     /* Overlong */
+		"\xED\xA0\x80",     /* Surrogate */
+		"\xF4\x90\x80\x80", /* Past U+10FFFF */
+		"\xFF",
+		"\x80",
+		NULL
+	};
+	gchar text[64];
+	gsize utf8_len;
+	gint i, offset;
+
+	/* Invalid sequences at every offset of a string long enough
+	 * to go through the ASCII fast path, results must match
+	 * g_utf8_validate().
+	 */
+	for (i = 0; invalid[i] != NULL; i++) {
+		for (offset = 0; offset < 32; offset++) {
+			const gchar *end;
+
+			memset (text, 'a', sizeof (text));
+			memcpy (&text[offset], invalid[i], strlen (invalid[i]));
+
+			g_utf8_validate (text, sizeof (text), &end);
+
+			utf8_len = 0;
+			tracker_text_validate_utf8 (text, sizeof (text), NULL, &utf8_len);
+			g_assert_cmpuint (utf8_len, ==, end - text);
+			g_assert_cmpuint (utf8_len, ==, offset);
+		}
+	}
+
+	/* Nul bytes stop validation too */
+	memset (text, 'a', sizeof (text));
+	text[20] = '\0';
+	utf8_len = 0;
+	tracker_text_validate_utf8 (text, sizeof (text), NULL, &utf8_len);
+	g_assert_cmpuint (utf8_len, ==, 20);
+
+	/* Multibyte characters mixed with ASCII */
+	memset (text, 'a', sizeof (text));
+	memcpy (&text[10], "\xF0\x90\x8E\x84", 4);
+	memcpy (&text[30], "\xE8\xAA\x9E", 3);
+	memcpy (&text[61], "\xE8\xAA", 2);
+	utf8_len = 0;
+	tracker_text_validate_utf8 (text, sizeof (text), NULL, &utf8_len);
+	g_assert_cmpuint (utf8_len, ==, 61);
+}
+
+static void
+test_text_validate_utf8_benchmark ()
+{
+	GString *text;
+	GTimer *timer;
+	const gchar *end;
+	gdouble reference, elapsed;
+	gsize utf8_len = 0;
+
+	/* Mostly ASCII, like source code and logs */
+	text = tracker_test_helpers_get_perf_text ("static void do_something (int argc, char **argv); ",
+	                                           "/* Ca\xC3\xB1\xC3\xB3n \xE8\xAA\x9E */\n");
+	if (!text)
+		return;
+
+	timer = g_timer_new ();
+	g_utf8_validate (text->str, text->len, &end);
+	reference = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	tracker_text_validate_utf8 (text->str, text->len, NULL, &utf8_len);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	g_assert_cmpuint (utf8_len, ==, end - text->str);
+
+	g_test_message ("%" G_GSIZE_FORMAT " bytes: %f s g_utf8_validate(), %f s tracker_text_validate_utf8()",
+	                text->len, reference, elapsed);
+	g_test_minimized_result (elapsed, "UTF-8 validation: %f s", elapsed);
+
+	g_timer_destroy (timer);
+	g_string_free (text, TRUE);
+}
+
+static void
+test_text_normalize ()
+{
+	struct {
+		const gchar *text;
+		guint max_words;
+		const gchar *expected;
+		guint n_words;
+	} tests[] = {
+		{ "Hello, world! 123 caf\xC3\xA9", 100, "Hello world caf\xC3\xA9", 3 },
+		{ "one two three four", 1, "one two ", 2 },
+		{ "  leading and trailing  ", 100, "leading and trailing ", 3 },
+		{ "\xE8\xAA\x9E\xE2\x82\xAC\xE8\xAA\x9E", 100, "\xE8\xAA\x9E \xE8\xAA\x9E", 2 },
+		/* Invalid bytes break words, stray continuation bytes are skipped */
+		{ "ab\xFF" "cd", 100, "ab cd", 2 },
+		{ "abc\x80\x80 def", 100, "abc def", 2 },
+		{ "", 100, "", 0 },
+	};
+	guint i;
+
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+
+	for (i = 0; i < G_N_ELEMENTS (tests); i++) {
+		gchar *result;
+		guint n_words = 0;
+
+		result = tracker_text_normalize (tests[i].text, tests[i].max_words, &n_words);
+		g_assert_cmpstr (result, ==, tests[i].expected);
+		g_assert_cmpuint (n_words, ==, tests[i].n_words);
+		g_free (result);
+	}
+
+	G_GNUC_END_IGNORE_DEPRECATIONS
+}
+
+static void
+test_text_normalize_benchmark ()
+{
+	GString *text;
+	GTimer *timer;
+	gchar *result;
+	guint n_words;
+
+	text = tracker_test_helpers_get_perf_text ("The quick brown fox jumps over the lazy dog, 42 times. ",
+	                                           "Caf\xC3\xA9 \xE8\xAA\x9E\n");
+	if (!text)
+		return;
+
+	timer = g_timer_new ();
+
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	result = tracker_text_normalize (text->str, G_MAXUINT, &n_words);
+	G_GNUC_END_IGNORE_DEPRECATIONS
+
+	g_test_minimized_result (g_timer_elapsed (timer, NULL),
+	                         "Normalizing %" G_GSIZE_FORMAT " bytes, %u words: %f s",
+	                         text->len, n_words, g_timer_elapsed (timer, NULL));
+
+	g_free (result);
+	g_timer_destroy (timer);
+	g_string_free (text, TRUE);
+}
+
 static void
 test_date_to_iso8601 ()
 {
@@ -297,6 +448,14 @@ main (int argc, char **argv)
 	                 test_guess_date_failures_subprocess);
         g_test_add_func ("/libtracker-extract/tracker-utils/text-validate-utf8",
                          test_text_validate_utf8);
+        g_test_add_func ("/libtracker-extract/tracker-utils/text-validate-utf8-long",
+                         test_text_validate_utf8_long);
+        g_test_add_func ("/libtracker-extract/tracker-utils/text-validate-utf8-benchmark",
+                         test_text_validate_utf8_benchmark);
+        g_test_add_func ("/libtracker-extract/tracker-utils/text-normalize",
+                         test_text_normalize);
+        g_test_add_func ("/libtracker-extract/tracker-utils/text-normalize-benchmark",
+                         test_text_normalize_benchmark);
         g_test_add_func ("/libtracker-extract/tracker-utils/date_to_iso8601",
                          test_date_to_iso8601);
         g_test_add_func ("/libtracker-extract/tracker-utils/coalesce_strip",
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <glib-object.h>
+
+/* NOTE: We're not including tracker-miner.h here because this is private. */
+#include <libtracker-miner/tracker-fair-queue.h>
+
+static TrackerFairQueue *
+fair_queue_new (void)
+{
+	return tracker_fair_queue_new (g_str_hash, g_str_equal,
+	                               (GBoxedCopyFunc) g_strdup, g_free);
+}
+
+static gchar *
+pop_key (TrackerFairQueue *queue)
+{
+	gchar *text, *key;
+
+	/* Elements are "key:n" strings */
+	text = tracker_fair_queue_pop (queue, NULL);
+	key = g_strndup (text, strchr (text, ':') - text);
+	g_free (text);
+
+	return key;
+}
+
+static void
+add_elements (TrackerFairQueue *queue,
+              const gchar      *key,
+              gint              n_elements,
+              gint              priority)
+{
+	gint i;
+
+	for (i = 0; i < n_elements; i++) {
+		tracker_fair_queue_add (queue, key,
+		                        g_strdup_printf ("%s:%d", key, i),
+		                        priority);
+	}
+}
+
+static void
+test_fair_queue_emptiness (void)
+{
+	TrackerFairQueue *queue;
+
+	queue = fair_queue_new ();
+
+	g_assert_true (tracker_fair_queue_is_empty (queue));
+	g_assert_cmpint (tracker_fair_queue_get_length (queue), ==, 0);
+	g_assert_null (tracker_fair_queue_peek (queue, NULL));
+	g_assert_null (tracker_fair_queue_pop (queue, NULL));
+
+	tracker_fair_queue_unref (queue);
+}
+
+static void
+test_fair_queue_round_robin (void)
+{
+	TrackerFairQueue *queue;
+	gchar *key;
+	gint i;
+
+	queue = fair_queue_new ();
+
+	/* A large key queued first must not starve the small one */
+	add_elements (queue, "big", 100, 0);
+	add_elements (queue, "small", 3, 0);
+	g_assert_cmpint (tracker_fair_queue_get_length (queue), ==, 103);
+	g_assert_cmpint (tracker_fair_queue_get_key_length (queue, "small"), ==, 3);
+
+	for (i = 0; i < 6; i++) {
+		key = pop_key (queue);
+		g_assert_cmpstr (key, ==, (i % 2 == 0) ? "big" : "small");
+		g_free (key);
+	}
+
+	g_assert_cmpint (tracker_fair_queue_get_key_length (queue, "small"), ==, 0);
+	g_assert_cmpint (tracker_fair_queue_get_length (queue), ==, 97);
+
+	while (!tracker_fair_queue_is_empty (queue))
+		g_free (tracker_fair_queue_pop (queue, NULL));
+
+	tracker_fair_queue_unref (queue);
+}
+
+static void
+test_fair_queue_weights (void)
+{
+	TrackerFairQueue *queue;
+	gint counts[2] = { 0, 0 };
+	gchar *key;
+	gint i;
+
+	queue = fair_queue_new ();
+	tracker_fair_queue_set_weight (queue, "a", 3);
+	g_assert_cmpuint (tracker_fair_queue_get_weight (queue, "a"), ==, 3);
+	g_assert_cmpuint (tracker_fair_queue_get_weight (queue, "b"), ==, 1);
+
+	add_elements (queue, "a", 30, 0);
+	add_elements (queue, "b", 30, 0);
+
+	for (i = 0; i < 20; i++) {
+		key = pop_key (queue);
+		counts[g_str_equal (key, "a") ? 0 : 1]++;
+		g_free (key);
+	}
+
+	g_assert_cmpint (counts[0], ==, 15);
+	g_assert_cmpint (counts[1], ==, 5);
+
+	while (!tracker_fair_queue_is_empty (queue))
+		g_free (tracker_fair_queue_pop (queue, NULL));
+
+	tracker_fair_queue_unref (queue);
+}
+
+static void
+test_fair_queue_priorities (void)
+{
+	TrackerFairQueue *queue;
+	gchar *text;
+	gint priority;
+
+	queue = fair_queue_new ();
+
+	add_elements (queue, "a", 2, 10);
+	add_elements (queue, "b", 1, 0);
+	tracker_fair_queue_add (queue, NULL, g_strdup ("none:0"), 5);
+
+	/* Priorities are strict across keys */
+	text = tracker_fair_queue_peek (queue, &priority);
+	g_assert_cmpstr (text, ==, "b:0");
+	g_assert_cmpint (priority, ==, 0);
+
+	text = tracker_fair_queue_pop (queue, &priority);
+	g_assert_cmpstr (text, ==, "b:0");
+	g_free (text);
+
+	text = tracker_fair_queue_pop (queue, &priority);
+	g_assert_cmpstr (text, ==, "none:0");
+	g_assert_cmpint (priority, ==, 5);
+	g_free (text);
+
+	text = tracker_fair_queue_pop (queue, &priority);
+	g_assert_cmpstr (text, ==, "a:0");
+	g_assert_cmpint (priority, ==, 10);
+	g_free (text);
+
+	text = tracker_fair_queue_pop (queue, &priority);
+	g_assert_cmpstr (text, ==, "a:1");
+	g_free (text);
+
+	g_assert_true (tracker_fair_queue_is_empty (queue));
+	tracker_fair_queue_unref (queue);
+}
+
+static gboolean
+has_prefix (gconstpointer a,
+            gconstpointer b)
+{
+	return g_str_has_prefix (a, b);
+}
+
+static void
+test_fair_queue_removal (void)
+{
+	TrackerFairQueue *queue;
+	GList *node;
+	gchar *text;
+
+	queue = fair_queue_new ();
+
+	add_elements (queue, "a", 3, 0);
+	add_elements (queue, "b", 3, 0);
+	node = tracker_fair_queue_add (queue, "c", g_strdup ("c:0"), 0);
+
+	g_free (node->data);
+	tracker_fair_queue_remove_node (queue, "c", node);
+	g_assert_cmpint (tracker_fair_queue_get_length (queue), ==, 6);
+	g_assert_cmpint (tracker_fair_queue_get_key_length (queue, "c"), ==, 0);
+
+	g_assert_true (tracker_fair_queue_foreach_remove (queue, has_prefix, "a:", g_free));
+	g_assert_false (tracker_fair_queue_foreach_remove (queue, has_prefix, "a:", g_free));
+	g_assert_cmpint (tracker_fair_queue_get_length (queue), ==, 3);
+
+	text = tracker_fair_queue_pop (queue, NULL);
+	g_assert_cmpstr (text, ==, "b:0");
+	g_free (text);
+
+	g_assert_true (tracker_fair_queue_foreach_remove (queue, has_prefix, "b:", g_free));
+	g_assert_true (tracker_fair_queue_is_empty (queue));
+
+	tracker_fair_queue_unref (queue);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/libtracker-miner/tracker-fair-queue/emptiness",
+	                 test_fair_queue_emptiness);
+	g_test_add_func ("/libtracker-miner/tracker-fair-queue/round_robin",
+	                 test_fair_queue_round_robin);
+	g_test_add_func ("/libtracker-miner/tracker-fair-queue/weights",
+	                 test_fair_queue_weights);
+	g_test_add_func ("/libtracker-miner/tracker-fair-queue/priorities",
+	                 test_fair_queue_priorities);
+	g_test_add_func ("/libtracker-miner/tracker-fair-queue/removal",
+	                 test_fair_queue_removal);
+
+	return g_test_run ();
+}
@@ -29,6 +29,7 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 
+#include <libtracker-miners-common/tracker-common.h>
 #include <libtracker-miner/tracker-miner-enums.h>
 #include <libtracker-miner/tracker-file-notifier.h>
 
@@ -592,6 +593,159 @@ test_file_notifier_crawling_ignore_within_recursive (TestCommonContext *fixture,
 	tracker_file_notifier_stop (fixture->notifier);
 }
 
+static gchar *
+test_common_context_get_content_id (TestCommonContext *fixture,
+                                    const gchar       *filename)
+{
+	GFile *file;
+	gchar *path, *content_id;
+
+	path = g_build_filename (fixture->test_path, filename, NULL);
+	file = g_file_new_for_path (path);
+	content_id = tracker_file_get_content_identifier (file, NULL, NULL);
+	g_object_unref (file);
+	g_free (path);
+
+	return content_id;
+}
+
+static void
+test_file_notifier_crawling_offline_moves (TestCommonContext *fixture,
+                                           gconstpointer      data)
+{
+	FilesystemOperation expected_results[] = {
+		{ OPERATION_MOVE, "recursive/old-folder", "recursive/folder" },
+		{ OPERATION_MOVE, "recursive/old-bbb", "recursive/bbb" },
+		{ OPERATION_CREATE, "recursive/ccc", NULL },
+	};
+	gchar *root_uri, *folder_id, *aaa_id, *bbb_id, *sparql;
+	GError *error = NULL;
+
+	CREATE_FOLDER (fixture, "recursive/folder");
+	CREATE_UPDATE_FILE (fixture, "recursive/folder/aaa");
+	CREATE_UPDATE_FILE (fixture, "recursive/bbb");
+	CREATE_UPDATE_FILE (fixture, "recursive/ccc");
+
+	/* Pretend the store knows about these files in their
+	 * former locations. The notifier is not asked for
+	 * modification times, so those are 0 on both sides.
+	 */
+	root_uri = g_strdup_printf ("file://%s/recursive", fixture->test_path);
+	folder_id = test_common_context_get_content_id (fixture, "recursive/folder");
+	aaa_id = test_common_context_get_content_id (fixture, "recursive/folder/aaa");
+	bbb_id = test_common_context_get_content_id (fixture, "recursive/bbb");
+
+	sparql = g_strdup_printf ("INSERT DATA { GRAPH tracker:FileSystem {"
+	                          "  <urn:test:root> a nfo:Folder ; nie:rootElementOf <urn:test:root> ."
+	                          "  <%s> a nfo:FileDataObject ; nie:interpretedAs <urn:test:root> ;"
+	                          "    nie:dataSource <urn:test:root> ;"
+	                          "    nfo:fileLastModified '1970-01-01T00:00:00Z' ."
+	                          "  <%s> a nfo:Folder ."
+	                          "  <%s/old-folder> a nfo:FileDataObject ; nie:interpretedAs <%s> ;"
+	                          "    nie:dataSource <urn:test:root> ;"
+	                          "    nfo:fileLastModified '1970-01-01T00:00:00Z' ."
+	                          "  <%s> a nie:InformationElement ."
+	                          "  <%s/old-folder/aaa> a nfo:FileDataObject ; nie:interpretedAs <%s> ;"
+	                          "    nie:dataSource <urn:test:root> ;"
+	                          "    nfo:fileLastModified '1970-01-01T00:00:00Z' ."
+	                          "  <%s> a nie:InformationElement ."
+	                          "  <%s/old-bbb> a nfo:FileDataObject ; nie:interpretedAs <%s> ;"
+	                          "    nie:dataSource <urn:test:root> ;"
+	                          "    nfo:fileLastModified '1970-01-01T00:00:00Z' ."
+	                          "}}",
+	                          root_uri,
+	                          folder_id, root_uri, folder_id,
+	                          aaa_id, root_uri, aaa_id,
+	                          bbb_id, root_uri, bbb_id);
+	tracker_sparql_connection_update (fixture->connection, sparql, NULL, &error);
+	g_assert_no_error (error);
+
+	test_common_context_index_dir (fixture, "recursive",
+	                               TRACKER_DIRECTORY_FLAG_RECURSE |
+	                               TRACKER_DIRECTORY_FLAG_CHECK_MTIME);
+
+	tracker_file_notifier_start (fixture->notifier);
+
+	test_common_context_expect_results (fixture, expected_results,
+	                                    G_N_ELEMENTS (expected_results),
+	                                    2, TRUE);
+
+	tracker_file_notifier_stop (fixture->notifier);
+
+	g_free (sparql);
+	g_free (bbb_id);
+	g_free (aaa_id);
+	g_free (folder_id);
+	g_free (root_uri);
+}
+
+static void
+directory_finished_cb (TrackerFileNotifier *notifier,
+                       GFile               *directory,
+                       guint                directories_found,
+                       guint                directories_ignored,
+                       guint                files_found,
+                       guint                files_ignored,
+                       gpointer             user_data)
+{
+	GPtrArray *finished = user_data;
+
+	g_ptr_array_add (finished, g_file_get_basename (directory));
+}
+
+static void
+test_file_notifier_crawling_interleaved_roots (TestCommonContext *fixture,
+                                               gconstpointer      data)
+{
+	FilesystemOperation expected_results[] = {
+		{ OPERATION_CREATE, "recursive", NULL },
+		{ OPERATION_CREATE, "recursive/a", NULL },
+		{ OPERATION_CREATE, "recursive/a/b", NULL },
+		{ OPERATION_CREATE, "recursive/a/b/c", NULL },
+		{ OPERATION_CREATE, "recursive/a/b/c/d", NULL },
+		{ OPERATION_CREATE, "recursive/a/b/c/d/aaa", NULL },
+		{ OPERATION_CREATE, "non-recursive", NULL },
+		{ OPERATION_CREATE, "non-recursive/bbb", NULL },
+	};
+	GPtrArray *finished;
+
+	CREATE_FOLDER (fixture, "recursive/a");
+	CREATE_FOLDER (fixture, "recursive/a/b");
+	CREATE_FOLDER (fixture, "recursive/a/b/c");
+	CREATE_FOLDER (fixture, "recursive/a/b/c/d");
+	CREATE_UPDATE_FILE (fixture, "recursive/a/b/c/d/aaa");
+	CREATE_UPDATE_FILE (fixture, "non-recursive/bbb");
+
+	test_common_context_index_dir (fixture, "recursive",
+	                               TRACKER_DIRECTORY_FLAG_RECURSE |
+	                               TRACKER_DIRECTORY_FLAG_CHECK_MTIME);
+	test_common_context_index_dir (fixture, "non-recursive",
+	                               TRACKER_DIRECTORY_FLAG_NONE |
+	                               TRACKER_DIRECTORY_FLAG_CHECK_MTIME);
+
+	finished = g_ptr_array_new_with_free_func (g_free);
+	g_signal_connect (fixture->notifier, "directory-finished",
+	                  G_CALLBACK (directory_finished_cb), finished);
+
+	tracker_file_notifier_start (fixture->notifier);
+
+	test_common_context_expect_results (fixture, expected_results,
+	                                    G_N_ELEMENTS (expected_results),
+	                                    2, TRUE);
+
+	tracker_file_notifier_stop (fixture->notifier);
+
+	/* The small root took turns with the deeper one,
+	 * instead of waiting for it to be fully crawled.
+	 */
+	g_assert_cmpuint (finished->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (finished, 0), ==, "non-recursive");
+	g_assert_cmpstr (g_ptr_array_index (finished, 1), ==, "recursive");
+
+	g_signal_handlers_disconnect_by_data (fixture->notifier, finished);
+	g_ptr_array_unref (finished);
+}
+
 static void
 test_file_notifier_changes_remove_non_recursive (TestCommonContext *fixture,
 						 gconstpointer      data)
@@ -782,6 +936,10 @@ main (gint    argc,
 	          test_file_notifier_crawling_recursive_within_non_recursive);
 	test_add ("/libtracker-miner/file-notifier/crawling-ignore-within-recursive",
 	          test_file_notifier_crawling_ignore_within_recursive);
+	test_add ("/libtracker-miner/file-notifier/crawling-offline-moves",
+	          test_file_notifier_crawling_offline_moves);
+	test_add ("/libtracker-miner/file-notifier/crawling-interleaved-roots",
+	          test_file_notifier_crawling_interleaved_roots);
 
 	/* Config changes */
 	test_add ("/libtracker-miner/file-notifier/changes-remove-non-recursive",
@@ -2027,6 +2027,242 @@ test_api_check_file (TrackerMinerFSTestFixture *fixture,
 	g_free (content);
 }
 
+static void
+test_api_hold_subtree (TrackerMinerFSTestFixture *fixture,
+                       gconstpointer              data)
+{
+	GFile *held, *file;
+	gchar *content;
+
+	CREATE_FOLDER (fixture, "recursive");
+	CREATE_FOLDER (fixture, "recursive/held");
+	CREATE_FOLDER (fixture, "recursive/other");
+
+	fixture_add_indexed_folder (fixture, "recursive",
+	                            TRACKER_DIRECTORY_FLAG_MONITOR |
+	                            TRACKER_DIRECTORY_FLAG_CHECK_MTIME |
+	                            TRACKER_DIRECTORY_FLAG_RECURSE);
+
+	tracker_miner_start (TRACKER_MINER (fixture->miner));
+
+	fixture_iterate (fixture);
+
+	held = fixture_get_relative_file (fixture, "recursive/held");
+	tracker_miner_fs_hold_subtree (fixture->miner, held);
+
+	CREATE_UPDATE_FILE (fixture, "recursive/held/a");
+	CREATE_UPDATE_FILE (fixture, "recursive/other/b");
+
+	file = fixture_get_relative_file (fixture, "recursive/held/a");
+	tracker_miner_fs_check_file (fixture->miner, file, G_PRIORITY_DEFAULT, FALSE);
+	g_object_unref (file);
+
+	file = fixture_get_relative_file (fixture, "recursive/other/b");
+	tracker_miner_fs_check_file (fixture->miner, file, G_PRIORITY_DEFAULT, FALSE);
+	g_object_unref (file);
+
+	/* Events elsewhere go through, the held ones wait */
+	fixture_iterate_timed (fixture, 1);
+	g_assert_true (tracker_miner_fs_has_items_to_process (fixture->miner));
+
+	content = fixture_get_content (fixture);
+	g_assert_cmpstr (content, ==,
+	                 "recursive,"
+	                 "recursive/held,"
+	                 "recursive/other,"
+	                 "recursive/other/b");
+	g_free (content);
+
+	tracker_miner_fs_release_subtree (fixture->miner, held);
+	g_object_unref (held);
+
+	fixture_iterate (fixture);
+
+	content = fixture_get_content (fixture);
+	g_assert_cmpstr (content, ==,
+	                 "recursive,"
+	                 "recursive/held,"
+	                 "recursive/held/a,"
+	                 "recursive/other,"
+	                 "recursive/other/b");
+	g_free (content);
+}
+
+static gint64
+frozen_clock (gpointer user_data)
+{
+	return *((gint64 *) user_data);
+}
+
+static void
+test_api_check_file_rate_limit (TrackerMinerFSTestFixture *fixture,
+                                gconstpointer              data)
+{
+	TrackerRateLimiter *limiter = tracker_rate_limiter_get_default ();
+	const gchar *names[] = { "a", "b", "c", "d" };
+	gint64 now = 0;
+	gint i;
+
+	CREATE_FOLDER (fixture, "recursive");
+	CREATE_FOLDER (fixture, "not-indexed");
+
+	fixture_add_indexed_folder (fixture, "recursive",
+	                            TRACKER_DIRECTORY_FLAG_MONITOR |
+	                            TRACKER_DIRECTORY_FLAG_CHECK_MTIME |
+	                            TRACKER_DIRECTORY_FLAG_RECURSE);
+
+	tracker_miner_start (TRACKER_MINER (fixture->miner));
+
+	fixture_iterate (fixture);
+
+	test_miner_reset_counters ((TestMiner *) fixture->miner);
+
+	/* Two files per second, with time standing still */
+	tracker_rate_limiter_set_clock (limiter, frozen_clock, &now);
+	tracker_rate_limiter_set_file_rate (limiter, 2);
+
+	for (i = 0; i < G_N_ELEMENTS (names); i++) {
+		gchar *path;
+		GFile *file;
+
+		path = g_build_filename ("not-indexed", names[i], NULL);
+		CREATE_UPDATE_FILE (fixture, path);
+		file = fixture_get_relative_file (fixture, path);
+		tracker_miner_fs_check_file (fixture->miner, file, G_PRIORITY_DEFAULT, FALSE);
+		g_object_unref (file);
+		g_free (path);
+	}
+
+	/* Events not coming from crawling are charged when processed,
+	 * the budget runs out after the third.
+	 */
+	fixture_iterate_timed (fixture, 1);
+	g_assert_cmpint (((TestMiner *) fixture->miner)->n_process_file, ==, 3);
+
+	now += 10 * G_USEC_PER_SEC;
+	fixture_iterate (fixture);
+	g_assert_cmpint (((TestMiner *) fixture->miner)->n_process_file, ==, 4);
+
+	tracker_rate_limiter_set_file_rate (limiter, 0);
+	tracker_rate_limiter_set_clock (limiter, NULL, NULL);
+}
+
+static void
+check_files_cb (GObject      *object,
+                GAsyncResult *res,
+                gpointer      user_data)
+{
+	gboolean *finished = user_data;
+	GError *error = NULL;
+
+	g_assert_true (tracker_miner_fs_check_files_finish (TRACKER_MINER_FS (object),
+	                                                    res, &error));
+	g_assert_no_error (error);
+	*finished = TRUE;
+}
+
+static void
+test_api_check_files (TrackerMinerFSTestFixture *fixture,
+                      gconstpointer              data)
+{
+	GList *files = NULL;
+	gboolean finished = FALSE;
+	gchar *content;
+
+	CREATE_FOLDER (fixture, "recursive");
+	CREATE_FOLDER (fixture, "not-indexed");
+	CREATE_UPDATE_FILE (fixture, "recursive/a");
+	CREATE_UPDATE_FILE (fixture, "not-indexed/b");
+	CREATE_UPDATE_FILE (fixture, "not-indexed/c");
+
+	fixture_add_indexed_folder (fixture, "recursive",
+	                            TRACKER_DIRECTORY_FLAG_MONITOR |
+	                            TRACKER_DIRECTORY_FLAG_CHECK_MTIME |
+	                            TRACKER_DIRECTORY_FLAG_RECURSE);
+
+	tracker_miner_start (TRACKER_MINER (fixture->miner));
+
+	fixture_iterate (fixture);
+
+	test_miner_reset_counters ((TestMiner *) fixture->miner);
+
+	files = g_list_prepend (files, fixture_get_relative_file (fixture, "recursive/a"));
+	files = g_list_prepend (files, fixture_get_relative_file (fixture, "not-indexed/b"));
+	files = g_list_prepend (files, fixture_get_relative_file (fixture, "not-indexed/c"));
+	tracker_miner_fs_check_files (fixture->miner, files, G_PRIORITY_HIGH, FALSE,
+	                              NULL, check_files_cb, &finished);
+	g_list_free_full (files, g_object_unref);
+
+	while (!finished)
+		g_main_context_iteration (NULL, TRUE);
+
+	/* All files must be in the store by the time the callback runs */
+	content = fixture_get_content (fixture);
+	g_assert_cmpstr (content, ==,
+	                 "not-indexed/b,"
+	                 "not-indexed/c,"
+	                 "recursive,"
+	                 "recursive/a");
+	g_free (content);
+
+	g_assert_cmpint (((TestMiner *) fixture->miner)->n_process_file, ==, 3);
+}
+
+static void
+test_api_check_files_parents (TrackerMinerFSTestFixture *fixture,
+                              gconstpointer              data)
+{
+	GList *files = NULL;
+	gboolean finished = FALSE;
+	gchar *content;
+
+	CREATE_FOLDER (fixture, "recursive");
+
+	fixture_add_indexed_folder (fixture, "recursive",
+	                            TRACKER_DIRECTORY_FLAG_CHECK_MTIME |
+	                            TRACKER_DIRECTORY_FLAG_RECURSE);
+
+	tracker_miner_start (TRACKER_MINER (fixture->miner));
+
+	fixture_iterate (fixture);
+
+	/* Not monitored, so only found through the request */
+	CREATE_FOLDER (fixture, "recursive/a");
+	CREATE_FOLDER (fixture, "recursive/a/b");
+	CREATE_FOLDER (fixture, "recursive/a/b/c");
+	CREATE_UPDATE_FILE (fixture, "recursive/a/b/c/x");
+	CREATE_UPDATE_FILE (fixture, "recursive/a/b/y");
+	CREATE_UPDATE_FILE (fixture, "recursive/a/z");
+
+	test_miner_reset_counters ((TestMiner *) fixture->miner);
+
+	files = g_list_prepend (files, fixture_get_relative_file (fixture, "recursive/a/z"));
+	files = g_list_prepend (files, fixture_get_relative_file (fixture, "recursive/a/b/y"));
+	files = g_list_prepend (files, fixture_get_relative_file (fixture, "recursive/a/b/c/x"));
+	tracker_miner_fs_check_files (fixture->miner, files, G_PRIORITY_HIGH, TRUE,
+	                              NULL, check_files_cb, &finished);
+	g_list_free_full (files, g_object_unref);
+
+	while (!finished)
+		g_main_context_iteration (NULL, TRUE);
+
+	content = fixture_get_content (fixture);
+	g_assert_cmpstr (content, ==,
+	                 "recursive,"
+	                 "recursive/a,"
+	                 "recursive/a/b,"
+	                 "recursive/a/b/c,"
+	                 "recursive/a/b/c/x,"
+	                 "recursive/a/b/y,"
+	                 "recursive/a/z");
+	g_free (content);
+
+	/* The root and the three folders are checked once for the
+	 * whole request, then the three files.
+	 */
+	g_assert_cmpint (((TestMiner *) fixture->miner)->n_process_file, ==, 7);
+}
+
 gint
 main (gint    argc,
       gchar **argv)
@@ -2120,6 +2356,14 @@ main (gint    argc,
 	/* API tests */
 	ADD_TEST ("api/check_file",
 	          test_api_check_file);
+	ADD_TEST ("api/check_files",
+	          test_api_check_files);
+	ADD_TEST ("api/check_files_parents",
+	          test_api_check_files_parents);
+	ADD_TEST ("api/check_file_rate_limit",
+	          test_api_check_file_rate_limit);
+	ADD_TEST ("api/hold_subtree",
+	          test_api_hold_subtree);
 
 	return g_test_run ();
 }
@@ -395,6 +395,150 @@ test_file_utils_cmp ()
         g_assert_true (tracker_file_cmp (two, three));
 }
 
+static void
+test_file_utils_get_device ()
+{
+        GFile *one, *two;
+        TrackerDeviceType type_one, type_two;
+        const gchar *device_one, *device_two;
+
+        one = g_file_new_for_path (TEST_FILENAME);
+        two = g_file_new_for_path (TEST_HIDDEN_FILENAME);
+
+        /* Files in the same folder share the device, if known */
+        device_one = tracker_file_get_device (one, &type_one);
+        device_two = tracker_file_get_device (two, &type_two);
+        g_assert_true (device_one == device_two);
+        g_assert_cmpint (type_one, ==, type_two);
+
+        if (device_one)
+                g_assert_true (device_one == g_intern_string (device_one));
+
+        g_object_unref (one);
+        g_object_unref (two);
+}
+
+static void
+create_sysfs_file (const gchar *root,
+                   const gchar *path,
+                   const gchar *contents)
+{
+        g_autoptr(GError) error = NULL;
+        gchar *full_path, *dir;
+
+        full_path = g_build_filename (root, path, NULL);
+        dir = g_path_get_dirname (full_path);
+        g_assert_cmpint (g_mkdir_with_parents (dir, 0700), ==, 0);
+
+        if (contents) {
+                g_file_set_contents (full_path, contents, -1, &error);
+                g_assert_no_error (error);
+        } else {
+                g_assert_cmpint (g_mkdir (full_path, 0700), ==, 0);
+        }
+
+        g_free (full_path);
+        g_free (dir);
+}
+
+static void
+create_sysfs_link (const gchar *root,
+                   const gchar *path,
+                   const gchar *target)
+{
+        gchar *full_path, *dir;
+
+        full_path = g_build_filename (root, path, NULL);
+        dir = g_path_get_dirname (full_path);
+        g_assert_cmpint (g_mkdir_with_parents (dir, 0700), ==, 0);
+        g_assert_cmpint (symlink (target, full_path), ==, 0);
+
+        g_free (full_path);
+        g_free (dir);
+}
+
+static void
+remove_tree (const gchar *path)
+{
+        GDir *dir;
+        const gchar *name;
+
+        dir = g_dir_open (path, 0, NULL);
+
+        if (dir && !g_file_test (path, G_FILE_TEST_IS_SYMLINK)) {
+                while ((name = g_dir_read_name (dir)) != NULL) {
+                        gchar *child = g_build_filename (path, name, NULL);
+
+                        remove_tree (child);
+                        g_free (child);
+                }
+        }
+
+        g_clear_pointer (&dir, g_dir_close);
+        g_assert_cmpint (g_remove (path), ==, 0);
+}
+
+static void
+assert_lookup_device (const gchar       *sysfs_root,
+                      const gchar       *devname,
+                      const gchar       *fs_type,
+                      const gchar       *expected_device,
+                      TrackerDeviceType  expected_type)
+{
+        TrackerDeviceType type;
+        const gchar *device;
+
+        type = tracker_file_system_lookup_device (sysfs_root, devname, fs_type, &device);
+        g_assert_cmpint (type, ==, expected_type);
+        g_assert_cmpstr (device, ==, expected_device);
+        g_assert_true (device == g_intern_string (expected_device));
+}
+
+static void
+test_file_system_lookup_device ()
+{
+        g_autoptr(GError) error = NULL;
+        gchar *root;
+
+        root = g_dir_make_tmp ("tracker-sysfs-XXXXXX", &error);
+        g_assert_no_error (error);
+
+        /* A rotational disk and an SSD, with a partition each */
+        create_sysfs_file (root, "devices/pci0/block/trackertestsda/queue/rotational", "1\n");
+        create_sysfs_file (root, "devices/pci0/block/trackertestsda/trackertestsda1", NULL);
+        create_sysfs_file (root, "devices/pci0/block/trackertestnvme0n1/queue/rotational", "0\n");
+        create_sysfs_file (root, "devices/pci0/block/trackertestnvme0n1/trackertestnvme0n1p2", NULL);
+        create_sysfs_link (root, "class/block/trackertestsda",
+                           "../../devices/pci0/block/trackertestsda");
+        create_sysfs_link (root, "class/block/trackertestsda1",
+                           "../../devices/pci0/block/trackertestsda/trackertestsda1");
+        create_sysfs_link (root, "class/block/trackertestnvme0n1p2",
+                           "../../devices/pci0/block/trackertestnvme0n1/trackertestnvme0n1p2");
+
+        /* Partitions resolve to their disk */
+        assert_lookup_device (root, "/dev/trackertestsda1", "ext4",
+                              "trackertestsda", TRACKER_DEVICE_TYPE_ROTATIONAL);
+        assert_lookup_device (root, "/dev/trackertestsda", "ext4",
+                              "trackertestsda", TRACKER_DEVICE_TYPE_ROTATIONAL);
+        assert_lookup_device (root, "/dev/trackertestnvme0n1p2", "btrfs",
+                              "trackertestnvme0n1", TRACKER_DEVICE_TYPE_SOLID_STATE);
+
+        /* Remote mounts go by their source */
+        assert_lookup_device (root, "server:/export", "nfs4",
+                              "server:/export", TRACKER_DEVICE_TYPE_REMOTE);
+        assert_lookup_device (root, "//server/share", "cifs",
+                              "//server/share", TRACKER_DEVICE_TYPE_REMOTE);
+
+        /* Unknown to sysfs, or not a block device */
+        assert_lookup_device (root, "/dev/trackertestmissing", "ext4",
+                              "/dev/trackertestmissing", TRACKER_DEVICE_TYPE_UNKNOWN);
+        assert_lookup_device (root, "tmpfs", "tmpfs",
+                              "tmpfs", TRACKER_DEVICE_TYPE_UNKNOWN);
+
+        remove_tree (root);
+        g_free (root);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -432,6 +576,10 @@ main (int argc, char **argv)
                          test_file_utils_is_hidden);
         g_test_add_func ("/libtracker-common/file-utils/cmp",
                          test_file_utils_cmp);
+        g_test_add_func ("/libtracker-common/file-utils/get_device",
+                         test_file_utils_get_device);
+        g_test_add_func ("/libtracker-common/file-utils/lookup_device",
+                         test_file_system_lookup_device);
 
 	result = g_test_run ();
 
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include "config-miners.h"
+
+#include <glib.h>
+#include <libtracker-miners-common/tracker-common.h>
+
+typedef struct {
+        gsize usage;
+        gsize shed_to;
+        guint n_shed;
+        TrackerMemoryBudgetState last_state;
+} Consumer;
+
+static gsize
+consumer_report (gpointer user_data)
+{
+        Consumer *consumer = user_data;
+
+        return consumer->usage;
+}
+
+static void
+consumer_shed (TrackerMemoryBudgetState state,
+               gpointer                 user_data)
+{
+        Consumer *consumer = user_data;
+
+        consumer->n_shed++;
+        consumer->last_state = state;
+        consumer->usage = MIN (consumer->usage, consumer->shed_to);
+}
+
+static void
+test_memory_budget_unlimited (void)
+{
+        TrackerMemoryBudget *budget;
+        Consumer consumer = { 1000, 0, };
+
+        budget = tracker_memory_budget_new ();
+        tracker_memory_budget_register (budget, "consumer",
+                                        consumer_report, consumer_shed,
+                                        &consumer);
+
+        tracker_memory_budget_check (budget);
+        g_assert_cmpint (tracker_memory_budget_get_state (budget), ==, TRACKER_MEMORY_BUDGET_OK);
+        g_assert_cmpuint (consumer.n_shed, ==, 0);
+
+        g_object_unref (budget);
+}
+
+static void
+test_memory_budget_shed_over_limit (void)
+{
+        TrackerMemoryBudget *budget;
+        Consumer a = { 600, 100, }, b = { 600, 600, };
+
+        budget = tracker_memory_budget_new ();
+        tracker_memory_budget_register (budget, "a", consumer_report, consumer_shed, &a);
+        tracker_memory_budget_register (budget, "b", consumer_report, consumer_shed, &b);
+
+        tracker_memory_budget_set_limit (budget, 1000);
+        g_assert_cmpuint (a.n_shed, ==, 1);
+        g_assert_cmpuint (b.n_shed, ==, 1);
+        g_assert_cmpint (a.last_state, ==, TRACKER_MEMORY_BUDGET_OVER);
+
+        /* 700 bytes after shedding are within budget */
+        g_assert_cmpint (tracker_memory_budget_get_state (budget), ==, TRACKER_MEMORY_BUDGET_OK);
+
+        g_object_unref (budget);
+}
+
+static void
+test_memory_budget_hysteresis (void)
+{
+        TrackerMemoryBudget *budget;
+        Consumer consumer = { 1200, G_MAXSIZE, };
+
+        budget = tracker_memory_budget_new ();
+        tracker_memory_budget_register (budget, "consumer",
+                                        consumer_report, consumer_shed,
+                                        &consumer);
+        tracker_memory_budget_set_limit (budget, 1000);
+        g_assert_cmpint (tracker_memory_budget_get_state (budget), ==, TRACKER_MEMORY_BUDGET_OVER);
+
+        /* Just below the limit is not enough to get back to normal */
+        consumer.usage = 950;
+        tracker_memory_budget_check (budget);
+        g_assert_cmpint (tracker_memory_budget_get_state (budget), ==, TRACKER_MEMORY_BUDGET_OVER);
+
+        consumer.usage = 800;
+        tracker_memory_budget_check (budget);
+        g_assert_cmpint (tracker_memory_budget_get_state (budget), ==, TRACKER_MEMORY_BUDGET_OK);
+
+        g_object_unref (budget);
+}
+
+static void
+test_memory_budget_critical (void)
+{
+        TrackerMemoryBudget *budget;
+        Consumer consumer = { 10, 0, };
+
+        budget = tracker_memory_budget_new ();
+        tracker_memory_budget_register (budget, "consumer",
+                                        consumer_report, consumer_shed,
+                                        &consumer);
+
+        tracker_memory_budget_shed (budget, TRACKER_MEMORY_BUDGET_CRITICAL);
+        g_assert_cmpuint (consumer.n_shed, ==, 1);
+        g_assert_cmpint (consumer.last_state, ==, TRACKER_MEMORY_BUDGET_CRITICAL);
+        g_assert_cmpint (tracker_memory_budget_get_state (budget), ==, TRACKER_MEMORY_BUDGET_CRITICAL);
+
+        /* The critical state holds for a while, regardless of usage */
+        tracker_memory_budget_check (budget);
+        g_assert_cmpint (tracker_memory_budget_get_state (budget), ==, TRACKER_MEMORY_BUDGET_CRITICAL);
+
+        g_object_unref (budget);
+}
+
+static void
+test_memory_budget_usage (void)
+{
+        TrackerMemoryBudget *budget;
+        Consumer a = { 100, 0, }, b = { 200, 0, };
+        GVariant *usage, *subsystems;
+        guint32 state;
+        guint64 limit, value;
+        guint id;
+
+        budget = tracker_memory_budget_new ();
+        tracker_memory_budget_set_limit (budget, 5000);
+        tracker_memory_budget_register (budget, "a", consumer_report, NULL, &a);
+        id = tracker_memory_budget_register (budget, "b", consumer_report, NULL, &b);
+
+        usage = tracker_memory_budget_get_usage (budget);
+        g_variant_ref_sink (usage);
+        g_variant_get (usage, "(ut@a{st})", &state, &limit, &subsystems);
+        g_assert_cmpuint (state, ==, TRACKER_MEMORY_BUDGET_OK);
+        g_assert_cmpuint (limit, ==, 5000);
+        g_assert_cmpuint (g_variant_n_children (subsystems), ==, 2);
+        g_assert_true (g_variant_lookup (subsystems, "b", "t", &value));
+        g_assert_cmpuint (value, ==, 200);
+        g_variant_unref (subsystems);
+        g_variant_unref (usage);
+
+        tracker_memory_budget_unregister (budget, id);
+
+        usage = tracker_memory_budget_get_usage (budget);
+        g_variant_ref_sink (usage);
+        g_variant_get (usage, "(ut@a{st})", &state, &limit, &subsystems);
+        g_assert_cmpuint (g_variant_n_children (subsystems), ==, 1);
+        g_assert_false (g_variant_lookup (subsystems, "b", "t", &value));
+        g_variant_unref (subsystems);
+        g_variant_unref (usage);
+
+        g_object_unref (budget);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/libtracker-miners-common/memory-budget/unlimited",
+                         test_memory_budget_unlimited);
+        g_test_add_func ("/libtracker-miners-common/memory-budget/shed-over-limit",
+                         test_memory_budget_shed_over_limit);
+        g_test_add_func ("/libtracker-miners-common/memory-budget/hysteresis",
+                         test_memory_budget_hysteresis);
+        g_test_add_func ("/libtracker-miners-common/memory-budget/critical",
+                         test_memory_budget_critical);
+        g_test_add_func ("/libtracker-miners-common/memory-budget/usage",
+                         test_memory_budget_usage);
+
+        return g_test_run ();
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include "config-miners.h"
+
+#include <glib.h>
+#include <libtracker-miners-common/tracker-common.h>
+
+static TrackerMountTrie *
+create_trie (void)
+{
+        TrackerMountTrie *trie;
+
+        trie = tracker_mount_trie_new ();
+        tracker_mount_trie_add (trie, "/", "root-id", "sda",
+                                TRACKER_DEVICE_TYPE_ROTATIONAL);
+        tracker_mount_trie_add (trie, "/home", "home-id", "nvme0n1",
+                                TRACKER_DEVICE_TYPE_SOLID_STATE);
+        tracker_mount_trie_add (trie, "/home/user/nfs", "nfs-id", "server:/export",
+                                TRACKER_DEVICE_TYPE_REMOTE);
+        tracker_mount_trie_add (trie, "/run/tmpfs", NULL, NULL,
+                                TRACKER_DEVICE_TYPE_UNKNOWN);
+
+        return trie;
+}
+
+static void
+assert_lookup (TrackerMountTrie  *trie,
+               const gchar       *path,
+               const gchar       *expected_id,
+               const gchar       *expected_device,
+               TrackerDeviceType  expected_type)
+{
+        TrackerDeviceType type;
+        const gchar *device;
+        gchar *id;
+
+        tracker_mount_trie_lookup (trie, path, &id, &device, &type);
+        g_assert_cmpstr (id, ==, expected_id);
+        g_assert_cmpstr (device, ==, expected_device);
+        g_assert_cmpint (type, ==, expected_type);
+        g_free (id);
+}
+
+static void
+test_mount_trie_longest_prefix (void)
+{
+        TrackerMountTrie *trie;
+
+        trie = create_trie ();
+
+        assert_lookup (trie, "/etc/passwd", "root-id", "sda",
+                       TRACKER_DEVICE_TYPE_ROTATIONAL);
+        assert_lookup (trie, "/home/user/doc.txt", "home-id", "nvme0n1",
+                       TRACKER_DEVICE_TYPE_SOLID_STATE);
+        assert_lookup (trie, "/home/user/nfs/a/b", "nfs-id", "server:/export",
+                       TRACKER_DEVICE_TYPE_REMOTE);
+
+        /* Matching is per path component, not per character */
+        assert_lookup (trie, "/homework/file", "root-id", "sda",
+                       TRACKER_DEVICE_TYPE_ROTATIONAL);
+        assert_lookup (trie, "/home/user/nfsdata", "home-id", "nvme0n1",
+                       TRACKER_DEVICE_TYPE_SOLID_STATE);
+
+        /* Mount points themselves belong to the parent mount */
+        assert_lookup (trie, "/home", "root-id", "sda",
+                       TRACKER_DEVICE_TYPE_ROTATIONAL);
+        assert_lookup (trie, "/home/", "root-id", "sda",
+                       TRACKER_DEVICE_TYPE_ROTATIONAL);
+
+        /* A mount without ID or device falls back to the parent one */
+        assert_lookup (trie, "/run/tmpfs/file", "root-id", "sda",
+                       TRACKER_DEVICE_TYPE_ROTATIONAL);
+
+        /* Redundant separators are ignored */
+        assert_lookup (trie, "//home///user//file", "home-id", "nvme0n1",
+                       TRACKER_DEVICE_TYPE_SOLID_STATE);
+
+        tracker_mount_trie_unref (trie);
+}
+
+static void
+test_mount_trie_shadowing (void)
+{
+        TrackerMountTrie *trie;
+
+        trie = create_trie ();
+
+        /* Later entries in the mount table shadow earlier ones */
+        tracker_mount_trie_add (trie, "/home/", "other-id", "sdb",
+                                TRACKER_DEVICE_TYPE_ROTATIONAL);
+
+        assert_lookup (trie, "/home/user/doc.txt", "other-id", "sdb",
+                       TRACKER_DEVICE_TYPE_ROTATIONAL);
+        /* Mounts below the shadowed one are unaffected */
+        assert_lookup (trie, "/home/user/nfs/a", "nfs-id", "server:/export",
+                       TRACKER_DEVICE_TYPE_REMOTE);
+
+        tracker_mount_trie_unref (trie);
+}
+
+static void
+test_mount_trie_empty (void)
+{
+        TrackerMountTrie *trie;
+        TrackerDeviceType type;
+        const gchar *device;
+        gchar *id;
+
+        trie = tracker_mount_trie_new ();
+
+        g_assert_false (tracker_mount_trie_lookup (trie, "/home/user/file",
+                                                   &id, &device, &type));
+        g_assert_null (id);
+        g_assert_null (device);
+        g_assert_cmpint (type, ==, TRACKER_DEVICE_TYPE_UNKNOWN);
+
+        tracker_mount_trie_unref (trie);
+}
+
+static void
+test_mount_trie_swap (void)
+{
+        TrackerMountTrie *current, *reader, *old;
+        TrackerDeviceType type;
+        const gchar *device;
+        gchar *id;
+
+        current = create_trie ();
+
+        /* A reader takes a reference, then the mounts change */
+        reader = tracker_mount_trie_ref (current);
+
+        old = current;
+        current = tracker_mount_trie_new ();
+        tracker_mount_trie_add (current, "/", "new-root-id", "sdc",
+                                TRACKER_DEVICE_TYPE_SOLID_STATE);
+        tracker_mount_trie_unref (old);
+
+        /* The reader still sees the trie it started with */
+        assert_lookup (reader, "/home/user/doc.txt", "home-id", "nvme0n1",
+                       TRACKER_DEVICE_TYPE_SOLID_STATE);
+
+        /* Results are copied out, they survive the trie */
+        tracker_mount_trie_lookup (reader, "/home/user/nfs/a", &id, &device, &type);
+        tracker_mount_trie_unref (reader);
+        g_assert_cmpstr (id, ==, "nfs-id");
+        g_assert_cmpstr (device, ==, "server:/export");
+        g_assert_cmpint (type, ==, TRACKER_DEVICE_TYPE_REMOTE);
+        g_free (id);
+
+        /* New readers see the new trie */
+        assert_lookup (current, "/home/user/doc.txt", "new-root-id", "sdc",
+                       TRACKER_DEVICE_TYPE_SOLID_STATE);
+
+        tracker_mount_trie_unref (current);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/libtracker-miners-common/mount-trie/longest-prefix",
+                         test_mount_trie_longest_prefix);
+        g_test_add_func ("/libtracker-miners-common/mount-trie/shadowing",
+                         test_mount_trie_shadowing);
+        g_test_add_func ("/libtracker-miners-common/mount-trie/empty",
+                         test_mount_trie_empty);
+        g_test_add_func ("/libtracker-miners-common/mount-trie/swap",
+                         test_mount_trie_swap);
+
+        return g_test_run ();
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include "config-miners.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libtracker-miners-common/tracker-common.h>
+
+typedef struct {
+        gchar *path;
+} PressureFixture;
+
+static void
+write_pressure (PressureFixture *fixture,
+                const gchar     *resource,
+                gdouble          some_avg10)
+{
+        gchar *filename, *contents, value[G_ASCII_DTOSTR_BUF_SIZE];
+
+        g_ascii_formatd (value, sizeof (value), "%.2f", some_avg10);
+        contents = g_strdup_printf ("some avg10=%s avg60=0.00 avg300=0.00 total=0\n"
+                                    "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n",
+                                    value);
+        filename = g_build_filename (fixture->path, resource, NULL);
+        g_assert_true (g_file_set_contents (filename, contents, -1, NULL));
+        g_free (filename);
+        g_free (contents);
+}
+
+static void
+write_all (PressureFixture *fixture,
+           gdouble          cpu,
+           gdouble          io,
+           gdouble          memory)
+{
+        write_pressure (fixture, "cpu", cpu);
+        write_pressure (fixture, "io", io);
+        write_pressure (fixture, "memory", memory);
+}
+
+static void
+fixture_setup (PressureFixture *fixture,
+               gconstpointer    data)
+{
+        fixture->path = g_dir_make_tmp ("tracker-pressure-test-XXXXXX", NULL);
+        g_assert_nonnull (fixture->path);
+}
+
+static void
+fixture_teardown (PressureFixture *fixture,
+                  gconstpointer    data)
+{
+        const gchar *resources[] = {
+                "cpu", "io", "memory",
+                "cpu.pressure", "io.pressure", "memory.pressure",
+        };
+        gint i;
+
+        for (i = 0; i < G_N_ELEMENTS (resources); i++) {
+                gchar *filename;
+
+                filename = g_build_filename (fixture->path, resources[i], NULL);
+                g_unlink (filename);
+                g_free (filename);
+        }
+
+        g_rmdir (fixture->path);
+        g_free (fixture->path);
+}
+
+static void
+test_pressure_unavailable (PressureFixture *fixture,
+                           gconstpointer    data)
+{
+        TrackerPressure *pressure;
+
+        pressure = tracker_pressure_new (fixture->path);
+        g_assert_false (tracker_pressure_is_available (pressure));
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), ==, 0);
+        g_object_unref (pressure);
+}
+
+static void
+test_pressure_levels (PressureFixture *fixture,
+                      gconstpointer    data)
+{
+        TrackerPressure *pressure;
+
+        write_all (fixture, 1.5, 2.25, 0);
+
+        pressure = tracker_pressure_new (fixture->path);
+        g_assert_true (tracker_pressure_is_available (pressure));
+        g_assert_cmpfloat_with_epsilon (tracker_pressure_get_level (pressure, TRACKER_PRESSURE_CPU), 1.5, 0.001);
+        g_assert_cmpfloat_with_epsilon (tracker_pressure_get_level (pressure, TRACKER_PRESSURE_IO), 2.25, 0.001);
+        g_assert_cmpfloat_with_epsilon (tracker_pressure_get_level (pressure, TRACKER_PRESSURE_MEMORY), 0, 0.001);
+        g_object_unref (pressure);
+}
+
+static void
+test_pressure_cgroup (PressureFixture *fixture,
+                      gconstpointer    data)
+{
+        TrackerPressure *pressure;
+
+        /* Cgroup directories name the files after the resource */
+        write_pressure (fixture, "cpu.pressure", 3);
+        write_pressure (fixture, "io.pressure", 4.5);
+        write_pressure (fixture, "memory.pressure", 0);
+
+        pressure = tracker_pressure_new (fixture->path);
+        g_assert_true (tracker_pressure_is_available (pressure));
+        g_assert_cmpfloat_with_epsilon (tracker_pressure_get_level (pressure, TRACKER_PRESSURE_CPU), 3, 0.001);
+        g_assert_cmpfloat_with_epsilon (tracker_pressure_get_level (pressure, TRACKER_PRESSURE_IO), 4.5, 0.001);
+
+        write_pressure (fixture, "io.pressure", 50);
+        tracker_pressure_update (pressure);
+        g_assert_cmpfloat_with_epsilon (tracker_pressure_get_level (pressure, TRACKER_PRESSURE_IO), 50, 0.001);
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), >, 0);
+        g_object_unref (pressure);
+}
+
+static void
+test_pressure_backoff_and_recovery (PressureFixture *fixture,
+                                    gconstpointer    data)
+{
+        TrackerPressure *pressure;
+        gdouble pacing, prev;
+        gint i;
+
+        write_all (fixture, 0, 0, 0);
+
+        pressure = tracker_pressure_new (fixture->path);
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), ==, 0);
+
+        /* IO over its target backs off quickly */
+        write_all (fixture, 0, 50, 0);
+        tracker_pressure_update (pressure);
+        pacing = tracker_pressure_get_pacing (pressure);
+        g_assert_cmpfloat (pacing, >, 0.25);
+
+        tracker_pressure_update (pressure);
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), >, pacing);
+
+        /* Pressure close to the target holds pacing */
+        write_all (fixture, 0, 9, 0);
+        pacing = tracker_pressure_get_pacing (pressure);
+        tracker_pressure_update (pressure);
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), ==, pacing);
+
+        /* And no pressure recovers slowly, down to full speed */
+        write_all (fixture, 0, 0, 0);
+        prev = tracker_pressure_get_pacing (pressure);
+
+        for (i = 0; i < 100 && prev > 0; i++) {
+                tracker_pressure_update (pressure);
+                pacing = tracker_pressure_get_pacing (pressure);
+                g_assert_cmpfloat (pacing, <, prev);
+                g_assert_cmpfloat (prev - pacing, <, 0.1);
+                prev = pacing;
+        }
+
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), ==, 0);
+        g_object_unref (pressure);
+}
+
+static void
+test_pressure_scale_limit (PressureFixture *fixture,
+                           gconstpointer    data)
+{
+        TrackerPressure *pressure;
+        guint limit, prev;
+        gint i;
+
+        write_all (fixture, 0, 0, 0);
+
+        pressure = tracker_pressure_new (fixture->path);
+        g_assert_cmpuint (tracker_pressure_scale_limit (pressure, 4), ==, 4);
+        g_assert_cmpuint (tracker_pressure_scale_limit (pressure, 1), ==, 1);
+
+        /* Pressure lowers the limit, down to 1 */
+        write_all (fixture, 0, 50, 0);
+        prev = 4;
+
+        for (i = 0; i < 100 && prev > 1; i++) {
+                tracker_pressure_update (pressure);
+                limit = tracker_pressure_scale_limit (pressure, 4);
+                g_assert_cmpuint (limit, <=, prev);
+                prev = limit;
+        }
+
+        g_assert_cmpuint (tracker_pressure_scale_limit (pressure, 4), ==, 1);
+
+        /* And it goes back up once the pressure is gone */
+        write_all (fixture, 0, 0, 0);
+
+        for (i = 0; i < 100 && prev < 4; i++) {
+                tracker_pressure_update (pressure);
+                limit = tracker_pressure_scale_limit (pressure, 4);
+                g_assert_cmpuint (limit, >=, prev);
+                prev = limit;
+        }
+
+        g_assert_cmpuint (tracker_pressure_scale_limit (pressure, 4), ==, 4);
+        g_object_unref (pressure);
+}
+
+static void
+test_pressure_targets (PressureFixture *fixture,
+                       gconstpointer    data)
+{
+        TrackerPressure *pressure;
+
+        write_all (fixture, 50, 0, 0);
+
+        pressure = tracker_pressure_new (fixture->path);
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), >, 0);
+
+        /* CPU pressure is ignored with a 0 target */
+        tracker_pressure_set_target (pressure, TRACKER_PRESSURE_CPU, 0);
+        tracker_pressure_update (pressure);
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), <, 0.5);
+        g_object_unref (pressure);
+
+        /* Or under a high enough target */
+        pressure = g_object_new (TRACKER_TYPE_PRESSURE,
+                                 "path", fixture->path,
+                                 "cpu-target", 80,
+                                 NULL);
+        g_assert_cmpfloat (tracker_pressure_get_pacing (pressure), ==, 0);
+        g_object_unref (pressure);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add ("/libtracker-miners-common/pressure/unavailable",
+                    PressureFixture, NULL,
+                    fixture_setup, test_pressure_unavailable, fixture_teardown);
+        g_test_add ("/libtracker-miners-common/pressure/levels",
+                    PressureFixture, NULL,
+                    fixture_setup, test_pressure_levels, fixture_teardown);
+        g_test_add ("/libtracker-miners-common/pressure/cgroup",
+                    PressureFixture, NULL,
+                    fixture_setup, test_pressure_cgroup, fixture_teardown);
+        g_test_add ("/libtracker-miners-common/pressure/backoff-and-recovery",
+                    PressureFixture, NULL,
+                    fixture_setup, test_pressure_backoff_and_recovery, fixture_teardown);
+        g_test_add ("/libtracker-miners-common/pressure/scale-limit",
+                    PressureFixture, NULL,
+                    fixture_setup, test_pressure_scale_limit, fixture_teardown);
+        g_test_add ("/libtracker-miners-common/pressure/targets",
+                    PressureFixture, NULL,
+                    fixture_setup, test_pressure_targets, fixture_teardown);
+
+        return g_test_run ();
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2022, agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+#include "config-miners.h"
+
+#include <glib.h>
+#include <libtracker-miners-common/tracker-common.h>
+
+static gint64
+fake_clock (gpointer user_data)
+{
+        return *(gint64 *) user_data;
+}
+
+static TrackerRateLimiter *
+create_limiter (gint64 *now)
+{
+        TrackerRateLimiter *limiter;
+
+        limiter = tracker_rate_limiter_new ();
+        tracker_rate_limiter_set_clock (limiter, fake_clock, now);
+
+        return limiter;
+}
+
+static void
+test_rate_limiter_unlimited (void)
+{
+        TrackerRateLimiter *limiter;
+        gint64 now = 0;
+
+        limiter = create_limiter (&now);
+        tracker_rate_limiter_consume (limiter, 1000000, G_MAXUINT32);
+        g_assert_cmpint (tracker_rate_limiter_get_delay (limiter), ==, 0);
+        g_object_unref (limiter);
+}
+
+static void
+test_rate_limiter_files (void)
+{
+        TrackerRateLimiter *limiter;
+        gint64 now = 0, delay;
+
+        limiter = create_limiter (&now);
+        tracker_rate_limiter_set_file_rate (limiter, 10);
+
+        /* A second worth of files is allowed as a burst */
+        tracker_rate_limiter_consume (limiter, 10, 0);
+        g_assert_cmpint (tracker_rate_limiter_get_delay (limiter), ==, 0);
+
+        /* Going over it has to be paid by waiting */
+        tracker_rate_limiter_consume (limiter, 5, 0);
+        delay = tracker_rate_limiter_get_delay (limiter);
+        g_assert_cmpint (delay, ==, G_USEC_PER_SEC / 2 + 1);
+
+        /* Part of the wait is not enough */
+        now += delay / 2;
+        g_assert_cmpint (tracker_rate_limiter_get_delay (limiter), >, 0);
+
+        now += delay - delay / 2;
+        g_assert_cmpint (tracker_rate_limiter_get_delay (limiter), ==, 0);
+
+        g_object_unref (limiter);
+}
+
+static void
+test_rate_limiter_burst (void)
+{
+        TrackerRateLimiter *limiter;
+        gint64 now = 0;
+
+        limiter = create_limiter (&now);
+        tracker_rate_limiter_set_file_rate (limiter, 10);
+
+        /* Idle time only accumulates a second worth of budget */
+        now += 10 * G_USEC_PER_SEC;
+        tracker_rate_limiter_consume (limiter, 20, 0);
+        g_assert_cmpint (tracker_rate_limiter_get_delay (limiter), ==, G_USEC_PER_SEC + 1);
+
+        g_object_unref (limiter);
+}
+
+static void
+test_rate_limiter_bytes (void)
+{
+        TrackerRateLimiter *limiter;
+        gint64 now = 0;
+
+        limiter = create_limiter (&now);
+        g_object_set (limiter, "read-rate", 1, NULL);
+        tracker_rate_limiter_consume (limiter, 1, 3 * 1024);
+
+        /* 2 KiB over a 1 KiB/s rate, files are not limited */
+        g_assert_cmpint (tracker_rate_limiter_get_delay (limiter), ==, 2 * G_USEC_PER_SEC + 1);
+
+        now += G_USEC_PER_SEC;
+        g_assert_cmpint (tracker_rate_limiter_get_delay (limiter), ==, G_USEC_PER_SEC + 1);
+
+        /* Lifting the limit lifts the delay */
+        g_object_set (limiter, "read-rate", 0, NULL);
+        g_assert_cmpint (tracker_rate_limiter_get_delay (limiter), ==, 0);
+
+        g_object_unref (limiter);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+        g_test_init (&argc, &argv, NULL);
+
+        g_test_add_func ("/libtracker-miners-common/rate-limiter/unlimited",
+                         test_rate_limiter_unlimited);
+        g_test_add_func ("/libtracker-miners-common/rate-limiter/files",
+                         test_rate_limiter_files);
+        g_test_add_func ("/libtracker-miners-common/rate-limiter/burst",
+                         test_rate_limiter_burst);
+        g_test_add_func ("/libtracker-miners-common/rate-limiter/bytes",
+                         test_rate_limiter_bytes);
+
+        return g_test_run ();
+}
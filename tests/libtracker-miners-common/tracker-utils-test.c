@@ -133,6 +133,18 @@ test_strhex (void)
 
 }
 
+static void
+test_latency_bucket (void)
+{
+	g_assert_cmpuint (tracker_latency_bucket (0), ==, 0);
+	g_assert_cmpuint (tracker_latency_bucket (999), ==, 0);
+	g_assert_cmpuint (tracker_latency_bucket (1000), ==, 1);
+	g_assert_cmpuint (tracker_latency_bucket (3999), ==, 2);
+	g_assert_cmpuint (tracker_latency_bucket (4000), ==, 3);
+	g_assert_cmpuint (tracker_latency_bucket (G_USEC_PER_SEC), ==, 10);
+	g_assert_cmpuint (tracker_latency_bucket (G_MAXINT64), ==, TRACKER_LATENCY_N_BUCKETS - 1);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -160,6 +172,9 @@ main (int argc, char **argv)
         g_test_add_func ("/libtracker-common/tracker-utils/strhex",
                          test_strhex);
 
+	g_test_add_func ("/libtracker-common/tracker-utils/latency_bucket",
+	                 test_latency_bucket);
+
 	ret = g_test_run ();
 
 	return ret;